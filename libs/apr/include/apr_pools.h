@@ -428,6 +428,14 @@ APR_DECLARE(void) apr_pool_mutex_set(apr_pool_t *pool,
 									 apr_thread_mutex_t *mutex);
 #endif
 
+/**
+ * Report the number of bytes held by the memory nodes of a pool
+ * @param pool The pool to inspect
+ * @return The number of bytes, not including subpools or memory
+ *         sitting on the free list of the pool's allocator
+ */
+APR_DECLARE(apr_size_t) apr_pool_bytes_reserved(apr_pool_t *pool);
+
 
 /*
  * User data management
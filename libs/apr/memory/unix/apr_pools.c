@@ -516,6 +516,23 @@ APR_DECLARE(void) apr_pool_mutex_set(apr_pool_t *pool,
 }
 #endif
 
+APR_DECLARE(apr_size_t) apr_pool_bytes_reserved(apr_pool_t *pool)
+{
+#if APR_POOL_DEBUG
+    return apr_pool_num_bytes(pool, 0);
+#else
+    apr_memnode_t *node = pool->active;
+    apr_size_t size = 0;
+
+    do {
+        size += (apr_size_t)(node->index + 1) << BOUNDARY_INDEX;
+        node = node->next;
+    } while (node != pool->active);
+
+    return size;
+#endif
+}
+
 
 #if !APR_POOL_DEBUG
 /*
@@ -100,6 +100,14 @@
 #include <time.h>
 #include <fcntl.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TELETONE_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TELETONE_NEON 1
+#include <arm_neon.h>
+#endif
+
 #define LOW_ENG 10000000
 #define ZC 2
 static teletone_detection_descriptor_t dtmf_detect_row[GRID_FACTOR];
@@ -112,11 +120,6 @@ static float dtmf_col[] = {1209.0f, 1336.0f, 1477.0f, 1633.0f};
 
 static char dtmf_positions[] = "123A" "456B" "789C" "*0#D";
 
-static void goertzel_init(teletone_goertzel_state_t *goertzel_state, teletone_detection_descriptor_t *tdesc) {
-	goertzel_state->v2 = goertzel_state->v3 = 0.0;
-	goertzel_state->fac = tdesc->fac;
-}
-
 TELETONE_API(void) teletone_goertzel_update(teletone_goertzel_state_t *goertzel_state,
 							  int16_t sample_buffer[],
 							  int samples)
@@ -135,6 +138,137 @@ TELETONE_API(void) teletone_goertzel_update(teletone_goertzel_state_t *goertzel_
 #endif
 
 #define teletone_goertzel_result(gs) (double)(((gs)->v3 * (gs)->v3 + (gs)->v2 * (gs)->v2 - (gs)->v2 * (gs)->v3 * (gs)->fac))
+#define teletone_goertzel_bank_result(bank, x) (double)(((bank)->v3[x] * (bank)->v3[x] + (bank)->v2[x] * (bank)->v2[x] - (bank)->v2[x] * (bank)->v3[x] * (double)(bank)->fac[x]))
+
+/* DTMF bank layout, GRID_FACTOR lanes per group */
+#define DTMF_ROW 0
+#define DTMF_COL GRID_FACTOR
+#define DTMF_ROW_2ND (GRID_FACTOR * 2)
+#define DTMF_COL_2ND (GRID_FACTOR * 3)
+
+static void goertzel_bank_set(teletone_goertzel_bank_t *bank, int lane, float fac)
+{
+	bank->fac[lane] = fac;
+	if (lane >= bank->lanes) {
+		bank->lanes = (lane + 4) & ~3;
+	}
+}
+
+static void goertzel_bank_reset(teletone_goertzel_bank_t *bank)
+{
+	memset(bank->v2, 0, sizeof(bank->v2));
+	memset(bank->v3, 0, sizeof(bank->v3));
+}
+
+/* Every lane runs v3' = fac * v3 - v2 + x in single precision. The recurrence
+ * of a lane depends on its previous sample, so the speedup comes from stepping
+ * 4 independent lanes per instruction and keeping up to 16 of them in
+ * registers for the whole buffer. The C version does the same float math. */
+
+#if defined(TELETONE_SSE2)
+static void goertzel_bank_update_x4(float *v2p, float *v3p, const float *facp, int16_t sample_buffer[], int samples)
+{
+	__m128 v2a = _mm_loadu_ps(v2p), v2b = _mm_loadu_ps(v2p + 4), v2c = _mm_loadu_ps(v2p + 8), v2d = _mm_loadu_ps(v2p + 12);
+	__m128 v3a = _mm_loadu_ps(v3p), v3b = _mm_loadu_ps(v3p + 4), v3c = _mm_loadu_ps(v3p + 8), v3d = _mm_loadu_ps(v3p + 12);
+	__m128 fa = _mm_loadu_ps(facp), fb = _mm_loadu_ps(facp + 4), fc = _mm_loadu_ps(facp + 8), fd = _mm_loadu_ps(facp + 12);
+	__m128 x, v1;
+	int i;
+
+	for (i = 0; i < samples; i++) {
+		x = _mm_set1_ps((float)sample_buffer[i]);
+		v1 = v2a; v2a = v3a; v3a = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fa, v2a), v1), x);
+		v1 = v2b; v2b = v3b; v3b = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fb, v2b), v1), x);
+		v1 = v2c; v2c = v3c; v3c = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fc, v2c), v1), x);
+		v1 = v2d; v2d = v3d; v3d = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fd, v2d), v1), x);
+	}
+
+	_mm_storeu_ps(v2p, v2a); _mm_storeu_ps(v2p + 4, v2b); _mm_storeu_ps(v2p + 8, v2c); _mm_storeu_ps(v2p + 12, v2d);
+	_mm_storeu_ps(v3p, v3a); _mm_storeu_ps(v3p + 4, v3b); _mm_storeu_ps(v3p + 8, v3c); _mm_storeu_ps(v3p + 12, v3d);
+}
+
+static void goertzel_bank_update_x1(float *v2p, float *v3p, const float *facp, int16_t sample_buffer[], int samples)
+{
+	__m128 v2 = _mm_loadu_ps(v2p), v3 = _mm_loadu_ps(v3p), fac = _mm_loadu_ps(facp), v1;
+	int i;
+
+	for (i = 0; i < samples; i++) {
+		v1 = v2;
+		v2 = v3;
+		v3 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fac, v2), v1), _mm_set1_ps((float)sample_buffer[i]));
+	}
+
+	_mm_storeu_ps(v2p, v2);
+	_mm_storeu_ps(v3p, v3);
+}
+#elif defined(TELETONE_NEON)
+static void goertzel_bank_update_x4(float *v2p, float *v3p, const float *facp, int16_t sample_buffer[], int samples)
+{
+	float32x4_t v2a = vld1q_f32(v2p), v2b = vld1q_f32(v2p + 4), v2c = vld1q_f32(v2p + 8), v2d = vld1q_f32(v2p + 12);
+	float32x4_t v3a = vld1q_f32(v3p), v3b = vld1q_f32(v3p + 4), v3c = vld1q_f32(v3p + 8), v3d = vld1q_f32(v3p + 12);
+	float32x4_t fa = vld1q_f32(facp), fb = vld1q_f32(facp + 4), fc = vld1q_f32(facp + 8), fd = vld1q_f32(facp + 12);
+	float32x4_t x, v1;
+	int i;
+
+	for (i = 0; i < samples; i++) {
+		x = vdupq_n_f32((float)sample_buffer[i]);
+		v1 = v2a; v2a = v3a; v3a = vaddq_f32(vsubq_f32(vmulq_f32(fa, v2a), v1), x);
+		v1 = v2b; v2b = v3b; v3b = vaddq_f32(vsubq_f32(vmulq_f32(fb, v2b), v1), x);
+		v1 = v2c; v2c = v3c; v3c = vaddq_f32(vsubq_f32(vmulq_f32(fc, v2c), v1), x);
+		v1 = v2d; v2d = v3d; v3d = vaddq_f32(vsubq_f32(vmulq_f32(fd, v2d), v1), x);
+	}
+
+	vst1q_f32(v2p, v2a); vst1q_f32(v2p + 4, v2b); vst1q_f32(v2p + 8, v2c); vst1q_f32(v2p + 12, v2d);
+	vst1q_f32(v3p, v3a); vst1q_f32(v3p + 4, v3b); vst1q_f32(v3p + 8, v3c); vst1q_f32(v3p + 12, v3d);
+}
+
+static void goertzel_bank_update_x1(float *v2p, float *v3p, const float *facp, int16_t sample_buffer[], int samples)
+{
+	float32x4_t v2 = vld1q_f32(v2p), v3 = vld1q_f32(v3p), fac = vld1q_f32(facp), v1;
+	int i;
+
+	for (i = 0; i < samples; i++) {
+		v1 = v2;
+		v2 = v3;
+		v3 = vaddq_f32(vsubq_f32(vmulq_f32(fac, v2), v1), vdupq_n_f32((float)sample_buffer[i]));
+	}
+
+	vst1q_f32(v2p, v2);
+	vst1q_f32(v3p, v3);
+}
+#else
+static void goertzel_bank_update_lanes(float *v2p, float *v3p, const float *facp, int lanes, int16_t sample_buffer[], int samples)
+{
+	float v1, x;
+	int i, l;
+
+	for (i = 0; i < samples; i++) {
+		x = (float)sample_buffer[i];
+		for (l = 0; l < lanes; l++) {
+			v1 = v2p[l];
+			v2p[l] = v3p[l];
+			v3p[l] = (float)(facp[l] * v2p[l]) - v1 + x;
+		}
+	}
+}
+
+#define goertzel_bank_update_x4(_v2, _v3, _fac, _buf, _samples) goertzel_bank_update_lanes(_v2, _v3, _fac, 16, _buf, _samples)
+#define goertzel_bank_update_x1(_v2, _v3, _fac, _buf, _samples) goertzel_bank_update_lanes(_v2, _v3, _fac, 4, _buf, _samples)
+#endif
+
+TELETONE_API(void) teletone_goertzel_bank_update(teletone_goertzel_bank_t *bank,
+									   int16_t sample_buffer[],
+									   int samples)
+{
+	int lane = 0;
+
+	for (; lane + 16 <= bank->lanes; lane += 16) {
+		goertzel_bank_update_x4(bank->v2 + lane, bank->v3 + lane, bank->fac + lane, sample_buffer, samples);
+	}
+
+	for (; lane < bank->lanes; lane += 4) {
+		goertzel_bank_update_x1(bank->v2 + lane, bank->v3 + lane, bank->fac + lane, sample_buffer, samples);
+	}
+}
 
 TELETONE_API(void) teletone_dtmf_detect_init (teletone_dtmf_detect_state_t *dtmf_detect_state, int sample_rate)
 {
@@ -146,6 +280,7 @@ TELETONE_API(void) teletone_dtmf_detect_init (teletone_dtmf_detect_state_t *dtmf
 	}
 
 	dtmf_detect_state->hit1 = dtmf_detect_state->hit2 = 0;
+	memset(&dtmf_detect_state->bank, 0, sizeof(dtmf_detect_state->bank));
 
 	for (i = 0;	 i < GRID_FACTOR;  i++) {
 		theta = (float)(M_TWO_PI*(dtmf_row[i]/(float)sample_rate));
@@ -160,13 +295,14 @@ TELETONE_API(void) teletone_dtmf_detect_init (teletone_dtmf_detect_state_t *dtmf
 		theta = (float)(M_TWO_PI*(dtmf_col[i]*2.0/(float)sample_rate));
 		dtmf_detect_col_2nd[i].fac = (float)(2.0*cos(theta));
 	
-		goertzel_init (&dtmf_detect_state->row_out[i], &dtmf_detect_row[i]);
-		goertzel_init (&dtmf_detect_state->col_out[i], &dtmf_detect_col[i]);
-		goertzel_init (&dtmf_detect_state->row_out2nd[i], &dtmf_detect_row_2nd[i]);
-		goertzel_init (&dtmf_detect_state->col_out2nd[i], &dtmf_detect_col_2nd[i]);
+		goertzel_bank_set(&dtmf_detect_state->bank, DTMF_ROW + i, dtmf_detect_row[i].fac);
+		goertzel_bank_set(&dtmf_detect_state->bank, DTMF_COL + i, dtmf_detect_col[i].fac);
+		goertzel_bank_set(&dtmf_detect_state->bank, DTMF_ROW_2ND + i, dtmf_detect_row_2nd[i].fac);
+		goertzel_bank_set(&dtmf_detect_state->bank, DTMF_COL_2ND + i, dtmf_detect_col_2nd[i].fac);
 	
 		dtmf_detect_state->energy = 0.0;
 	}
+	goertzel_bank_reset(&dtmf_detect_state->bank);
 	dtmf_detect_state->current_sample = 0;
 	dtmf_detect_state->detected_digits = 0;
 	dtmf_detect_state->lost_digits = 0;
@@ -201,6 +337,9 @@ TELETONE_API(void) teletone_multi_tone_init(teletone_multi_tone_t *mt, teletone_
 		mt->hit_factor = 2;
 	}
 
+	/* unused lanes must keep a coefficient of 0 and lanes must not carry over from a previous map */
+	memset(&mt->bank, 0, sizeof(mt->bank));
+
 	for(x = 0; x < TELETONE_MAX_TONES; x++) {
 		if ((int) map->freqs[x] == 0) {
 			break;
@@ -208,9 +347,9 @@ TELETONE_API(void) teletone_multi_tone_init(teletone_multi_tone_t *mt, teletone_
 		mt->tone_count++;
 		theta = (float)(M_TWO_PI*(map->freqs[x]/(float)mt->sample_rate));
 		mt->tdd[x].fac = (float)(2.0 * cos(theta));
-		goertzel_init (&mt->gs[x], &mt->tdd[x]);
-		goertzel_init (&mt->gs2[x], &mt->tdd[x]);
+		goertzel_bank_set(&mt->bank, x, mt->tdd[x].fac);
 	}
+	goertzel_bank_reset(&mt->bank);
 
 }
 
@@ -219,7 +358,7 @@ TELETONE_API(int) teletone_multi_tone_detect (teletone_multi_tone_t *mt,
 								int samples)
 {
 	int sample, limit = 0, j, x = 0;
-	float v1, famp;
+	float famp;
 	float eng_sum = 0, eng_all[TELETONE_MAX_TONES] = {0.0};
 	int gtest = 0, see_hit = 0;
 
@@ -239,18 +378,10 @@ TELETONE_API(int) teletone_multi_tone_detect (teletone_multi_tone_t *mt,
 			famp = sample_buffer[j];
 			
 			mt->energy += famp*famp;
-
-			for(x = 0; x < TELETONE_MAX_TONES && x < mt->tone_count; x++) {
-				v1 = mt->gs[x].v2;
-				mt->gs[x].v2 = mt->gs[x].v3;
-				mt->gs[x].v3 = (float)(mt->gs[x].fac * mt->gs[x].v2 - v1 + famp);
-	
-				v1 = mt->gs2[x].v2;
-				mt->gs2[x].v2 = mt->gs2[x].v3;
-				mt->gs2[x].v3 = (float)(mt->gs2[x].fac*mt->gs2[x].v2 - v1 + famp);
-			}
 		}
 
+		teletone_goertzel_bank_update(&mt->bank, sample_buffer + sample, limit - sample);
+
 		mt->current_sample += (limit - sample);
 		if (mt->current_sample < mt->min_samples) {
 			continue;
@@ -258,13 +389,15 @@ TELETONE_API(int) teletone_multi_tone_detect (teletone_multi_tone_t *mt,
 
 		eng_sum = 0;
 		for(x = 0; x < TELETONE_MAX_TONES && x < mt->tone_count; x++) {
-			eng_all[x] = (float)(teletone_goertzel_result (&mt->gs[x]));
+			eng_all[x] = (float)(teletone_goertzel_bank_result (&mt->bank, x));
 			eng_sum += eng_all[x];
 		}
 
+		/* The second set of filters used to run with the same coefficients as the
+		   first, so its result is the same lane compared at double precision */
 		gtest = 0;
 		for(x = 0; x < TELETONE_MAX_TONES && x < mt->tone_count; x++) {
-			gtest += teletone_goertzel_result (&mt->gs2[x]) < eng_all[x] ? 1 : 0;
+			gtest += teletone_goertzel_bank_result (&mt->bank, x) < eng_all[x] ? 1 : 0;
 		}
 
 		if ((gtest >= 2 || gtest == mt->tone_count) && eng_sum > 42.0 * mt->energy) {
@@ -291,10 +424,7 @@ TELETONE_API(int) teletone_multi_tone_detect (teletone_multi_tone_t *mt,
 		}
 
 		/* Reinitialise the detector for the next block */
-		for(x = 0; x < TELETONE_MAX_TONES && x < mt->tone_count; x++) {
-			goertzel_init (&mt->gs[x], &mt->tdd[x]);
-			goertzel_init (&mt->gs2[x], &mt->tdd[x]);
-		}
+		goertzel_bank_reset(&mt->bank);
 
 		mt->energy = 0.0;
 		mt->current_sample = 0;
@@ -311,7 +441,6 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 	float row_energy[GRID_FACTOR];
 	float col_energy[GRID_FACTOR];
 	float famp;
-	float v1;
 	int i;
 	int j;
 	int sample;
@@ -330,42 +459,19 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 		}
 
 		for (j = sample;  j < limit;  j++) {
-			int x = 0;
 			famp = sample_buffer[j];
 			
 			dtmf_detect_state->energy += famp*famp;
-
-			for(x = 0; x < GRID_FACTOR; x++) {
-				v1 = dtmf_detect_state->row_out[x].v2;
-				dtmf_detect_state->row_out[x].v2 = dtmf_detect_state->row_out[x].v3;
-				dtmf_detect_state->row_out[x].v3 = (float)(dtmf_detect_state->row_out[x].fac*dtmf_detect_state->row_out[x].v2 - v1 + famp);
-	
-				v1 = dtmf_detect_state->col_out[x].v2;
-				dtmf_detect_state->col_out[x].v2 = dtmf_detect_state->col_out[x].v3;
-				dtmf_detect_state->col_out[x].v3 = (float)(dtmf_detect_state->col_out[x].fac*dtmf_detect_state->col_out[x].v2 - v1 + famp);
-
-				v1 = dtmf_detect_state->col_out2nd[x].v2;
-				dtmf_detect_state->col_out2nd[x].v2 = dtmf_detect_state->col_out2nd[x].v3;
-				dtmf_detect_state->col_out2nd[x].v3 = (float)(dtmf_detect_state->col_out2nd[x].fac*dtmf_detect_state->col_out2nd[x].v2 - v1 + famp);
-		
-				v1 = dtmf_detect_state->row_out2nd[x].v2;
-				dtmf_detect_state->row_out2nd[x].v2 = dtmf_detect_state->row_out2nd[x].v3;
-				dtmf_detect_state->row_out2nd[x].v3 = (float)(dtmf_detect_state->row_out2nd[x].fac*dtmf_detect_state->row_out2nd[x].v2 - v1 + famp);
-			}
-
 		}
 
+		teletone_goertzel_bank_update(&dtmf_detect_state->bank, sample_buffer + sample, limit - sample);
+
 		if (dtmf_detect_state->zc > 0) {
 			if (dtmf_detect_state->energy < LOW_ENG && dtmf_detect_state->lenergy < LOW_ENG) {
 				if (!--dtmf_detect_state->zc) {
 					/* Reinitialise the detector for the next block */
 					dtmf_detect_state->hit1 = dtmf_detect_state->hit2 = 0;
-					for (i = 0;	 i < GRID_FACTOR;  i++) {
-						goertzel_init (&dtmf_detect_state->row_out[i], &dtmf_detect_row[i]);
-						goertzel_init (&dtmf_detect_state->col_out[i], &dtmf_detect_col[i]);
-						goertzel_init (&dtmf_detect_state->row_out2nd[i], &dtmf_detect_row_2nd[i]);
-						goertzel_init (&dtmf_detect_state->col_out2nd[i], &dtmf_detect_col_2nd[i]);
-					}
+					goertzel_bank_reset(&dtmf_detect_state->bank);
 					dtmf_detect_state->dur -= samples;
 					return TT_HIT_END;
 				}
@@ -387,15 +493,15 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 		}
 		/* We are at the end of a DTMF detection block */
 		/* Find the peak row and the peak column */
-		row_energy[0] = teletone_goertzel_result (&dtmf_detect_state->row_out[0]);
-		col_energy[0] = teletone_goertzel_result (&dtmf_detect_state->col_out[0]);
+		row_energy[0] = teletone_goertzel_bank_result (&dtmf_detect_state->bank, DTMF_ROW);
+		col_energy[0] = teletone_goertzel_bank_result (&dtmf_detect_state->bank, DTMF_COL);
 
 		for (best_row = best_col = 0, i = 1;  i < GRID_FACTOR;	i++) {
-			row_energy[i] = teletone_goertzel_result (&dtmf_detect_state->row_out[i]);
+			row_energy[i] = teletone_goertzel_bank_result (&dtmf_detect_state->bank, DTMF_ROW + i);
 			if (row_energy[i] > row_energy[best_row]) {
 				best_row = i;
 			}
-			col_energy[i] = teletone_goertzel_result (&dtmf_detect_state->col_out[i]);
+			col_energy[i] = teletone_goertzel_bank_result (&dtmf_detect_state->bank, DTMF_COL + i);
 			if (col_energy[i] > col_energy[best_col]) {
 				best_col = i;
 			}
@@ -415,8 +521,8 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 			}
 			/* ... and second harmonic test */
 			if (i >= GRID_FACTOR && (row_energy[best_row] + col_energy[best_col]) > 42.0*dtmf_detect_state->energy &&
-				teletone_goertzel_result (&dtmf_detect_state->col_out2nd[best_col])*DTMF_2ND_HARMONIC_COL < col_energy[best_col] &&
-				teletone_goertzel_result (&dtmf_detect_state->row_out2nd[best_row])*DTMF_2ND_HARMONIC_ROW < row_energy[best_row]) {
+				teletone_goertzel_bank_result (&dtmf_detect_state->bank, DTMF_COL_2ND + best_col)*DTMF_2ND_HARMONIC_COL < col_energy[best_col] &&
+				teletone_goertzel_bank_result (&dtmf_detect_state->bank, DTMF_ROW_2ND + best_row)*DTMF_2ND_HARMONIC_ROW < row_energy[best_row]) {
 				hit = dtmf_positions[(best_row << 2) + best_col];
 				/* Look for two successive similar results */
 				/* The logic in the next test is:
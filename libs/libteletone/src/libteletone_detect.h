@@ -149,6 +149,20 @@ extern "C" {
 		double fac;
 	} teletone_goertzel_state_t;
 	
+	/*! \brief The number of filters in a goertzel bank, TELETONE_MAX_TONES rounded up to a multiple of 4 */
+#define TELETONE_BANK_LANES ((TELETONE_MAX_TONES + 3) & ~3)
+
+	/*! \brief A set of goertzel filters stepped together one sample at a time.
+	  The state is kept as parallel arrays so 4 filters fit in one SIMD register.
+	  Unused lanes have a coefficient of 0 and are never read back.
+	*/
+	typedef struct {
+		float v2[TELETONE_BANK_LANES];
+		float v3[TELETONE_BANK_LANES];
+		float fac[TELETONE_BANK_LANES];
+		int lanes;
+	} teletone_goertzel_bank_t;
+
 	/*! \brief A container for a DTMF detection state.*/
 	typedef struct {
 		int hit1;
@@ -159,10 +173,8 @@ extern "C" {
 		int zc;
 		
 
-		teletone_goertzel_state_t row_out[GRID_FACTOR];
-		teletone_goertzel_state_t col_out[GRID_FACTOR];
-		teletone_goertzel_state_t row_out2nd[GRID_FACTOR];
-		teletone_goertzel_state_t col_out2nd[GRID_FACTOR];
+		/* rows, columns, row 2nd harmonics and column 2nd harmonics, GRID_FACTOR lanes each */
+		teletone_goertzel_bank_t bank;
 		float energy;
 		float lenergy;
 	
@@ -187,8 +199,7 @@ extern "C" {
 		int sample_rate;
 
 		teletone_detection_descriptor_t tdd[TELETONE_MAX_TONES];
-		teletone_goertzel_state_t gs[TELETONE_MAX_TONES];
-		teletone_goertzel_state_t gs2[TELETONE_MAX_TONES];
+		teletone_goertzel_bank_t bank;
 		int tone_count;
 
 		float energy;
@@ -263,6 +274,16 @@ TELETONE_API(void) teletone_goertzel_update(teletone_goertzel_state_t *goertzel_
 								  int samples);
 
 
+	/*! 
+	  \brief Step every filter of a goertzel bank through a sample buffer
+	  \param bank the goertzel bank to step the samples through
+	  \param sample_buffer an array aof 16 bit signed linear samples
+	  \param samples the number of samples present in sample_buffer
+	*/
+TELETONE_API(void) teletone_goertzel_bank_update(teletone_goertzel_bank_t *bank,
+									   int16_t sample_buffer[],
+									   int samples);
+
 
 #ifdef __cplusplus
 }
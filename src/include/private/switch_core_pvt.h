@@ -202,8 +202,11 @@ struct switch_core_session {
 };
 
 struct switch_media_bug {
-	switch_buffer_t *raw_write_buffer;
-	switch_buffer_t *raw_read_buffer;
+	/* produced by the session read/write threads, drained by switch_core_media_bug_read */
+	switch_ring_buffer_t *raw_write_buffer;
+	switch_ring_buffer_t *raw_read_buffer;
+	/* set by any thread, acted on by the reader before it next drains the rings */
+	volatile switch_atomic_t flush_req;
 	switch_frame_t *read_replace_frame_in;
 	switch_frame_t *read_replace_frame_out;
 	switch_frame_t *write_replace_frame_in;
@@ -212,7 +215,6 @@ struct switch_media_bug {
 	switch_frame_t *native_write_frame;
 	switch_media_bug_callback_t callback;
 	switch_mutex_t *read_mutex;
-	switch_mutex_t *write_mutex;
 	switch_core_session_t *session;
 	void *user_data;
 	uint32_t flags;
@@ -315,6 +317,9 @@ struct switch_runtime {
 	uint32_t port_alloc_flags;
 	char *event_channel_key_separator;
 	uint32_t max_audio_channels;
+	uint32_t file_write_behind_threads;
+	uint32_t module_load_threads;
+	int rtp_bridge_relay;
 
 	uint32_t max_reg_count, reg_count; // add by zz
 };
@@ -347,4 +352,6 @@ void switch_core_session_init(switch_memory_pool_t *pool);
 void switch_core_session_uninit(void);
 void switch_core_state_machine_init(switch_memory_pool_t *pool);
 switch_memory_pool_t *switch_core_memory_init(void);
+void switch_core_file_init(switch_memory_pool_t *pool);
+void switch_core_file_shutdown(void);
 void switch_core_memory_stop(void);
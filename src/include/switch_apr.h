@@ -424,6 +424,16 @@ SWITCH_DECLARE(void) switch_atomic_inc(volatile switch_atomic_t *mem);
  */
 SWITCH_DECLARE(int)  switch_atomic_dec(volatile switch_atomic_t *mem);
 
+/**
+ * Compare the uint32 value at the specified location with cmp and, if equal,
+ * replace it with with (full memory barrier).
+ * @param mem The location of the value.
+ * @param with The value to store if the comparison succeeds.
+ * @param cmp The value to compare against.
+ * @return The old value at mem.
+ */
+SWITCH_DECLARE(uint32_t) switch_atomic_cas(volatile switch_atomic_t *mem, uint32_t with, uint32_t cmp);
+
 /** @} */
 
 /**
@@ -1329,6 +1339,11 @@ SWITCH_DECLARE(switch_status_t) switch_mcast_interface(switch_socket_t *sock, sw
 #define SWITCH_POLLHUP 0x020			/**< Hangup occurred */
 #define SWITCH_POLLNVAL 0x040		/**< Descriptior invalid */
 
+/**
+ * Pollset flags
+ */
+#define SWITCH_POLLSET_THREADSAFE 0x001	/**< Adding or removing a descriptor is thread safe */
+
 /**
  * Setup a pollset object
  * @param pollset  The pointer in which to return the newly created object
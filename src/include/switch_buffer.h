@@ -164,6 +164,37 @@ SWITCH_DECLARE(switch_size_t) switch_buffer_zwrite(_In_ switch_buffer_t *buffer,
 
 SWITCH_DECLARE(void *) switch_buffer_get_head_pointer(switch_buffer_t *buffer);
 
+/*! \brief Allocate a new lock free single-producer / single-consumer ring
+ * \param pool Pool to allocate the ring from (NULL to use malloc)
+ * \param ring returned pointer to the new ring
+ * \param size length required by the ring (rounded up to a power of two)
+ * \return status
+ * \note exactly one thread may write and exactly one thread may read/toss/zero at a time
+ */
+SWITCH_DECLARE(switch_status_t) switch_ring_buffer_create(switch_memory_pool_t *pool, switch_ring_buffer_t **ring, switch_size_t size);
+
+/*! \brief Write data into the ring, all or nothing
+ * \return datalen on success, 0 if there is not enough free space
+ */
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_write(switch_ring_buffer_t *ring, const void *data, switch_size_t datalen);
+
+/*! \brief Read up to datalen bytes from the ring
+ * \return the number of bytes read
+ */
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_read(switch_ring_buffer_t *ring, void *data, switch_size_t datalen);
+
+/*! \brief Copy up to datalen bytes from the ring without consuming them */
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_peek(switch_ring_buffer_t *ring, void *data, switch_size_t datalen);
+
+/*! \brief Consume up to datalen bytes without copying them (reader side) */
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_toss(switch_ring_buffer_t *ring, switch_size_t datalen);
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_inuse(switch_ring_buffer_t *ring);
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_freespace(switch_ring_buffer_t *ring);
+
+/*! \brief Discard everything currently in the ring (reader side) */
+SWITCH_DECLARE(void) switch_ring_buffer_zero(switch_ring_buffer_t *ring);
+SWITCH_DECLARE(void) switch_ring_buffer_destroy(switch_ring_buffer_t **ring);
+
 /** @} */
 
 SWITCH_END_EXTERN_C
@@ -276,6 +276,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_pop(switch_core_session_t
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_exec_all(switch_core_session_t *orig_session,
 															   const char *function, switch_media_bug_exec_cb_t cb, void *user_data);
 SWITCH_DECLARE(uint32_t) switch_core_media_bug_patch_video(switch_core_session_t *orig_session, switch_frame_t *frame);
+/*!
+  \brief Count the active media bugs on a session
+  \param orig_session the session
+  \param function only count bugs added by this function, NULL counts them all
+  \return the number of bugs
+*/
 SWITCH_DECLARE(uint32_t) switch_core_media_bug_count(switch_core_session_t *orig_session, const char *function);
 SWITCH_DECLARE(void) switch_media_bug_set_spy_fmt(switch_media_bug_t *bug, switch_vid_spy_fmt_t spy_fmt);
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_push_spy_frame(switch_media_bug_t *bug, switch_frame_t *frame, switch_rw_t rw);
@@ -422,12 +428,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_transfer_callback(switch_c
   \param bug the bug to read from
   \param frame the frame to write the data to
   \return the amount of data
+  \note the bug buffers are single consumer rings, only one thread may read a given bug at a time
 */
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(_In_ switch_media_bug_t *bug, _In_ switch_frame_t *frame, switch_bool_t fill);
 
 /*!
   \brief Flush the read and write buffers for the bug
   \param bug the bug to flush the read and write buffers on
+  \note safe from any thread, the buffered audio is discarded by the reader before its next read
 */
 SWITCH_DECLARE(void) switch_core_media_bug_flush(_In_ switch_media_bug_t *bug);
 
@@ -627,6 +635,35 @@ SWITCH_DECLARE(void) switch_core_memory_pool_tag(switch_memory_pool_t *pool, con
 
 SWITCH_DECLARE(void) switch_core_pool_stats(switch_stream_handle_t *stream);
 
+typedef struct {
+	uint32_t slots;
+	uint32_t depth;
+	uint32_t cached;
+	uint64_t live;
+	uint64_t requests;
+	uint64_t hits;
+	uint64_t released;
+	uint64_t dropped;
+	switch_size_t cached_bytes;
+	switch_size_t released_bytes;
+	switch_size_t live_bytes;
+} switch_memory_pool_stats_t;
+
+/*!
+  \brief Configure the per-core cache of recycled memory pools
+  \param depth pools kept per core, 0 disables the cache
+  \param prealloc bytes reserved up front in every new pool
+  \param huge_pages advise transparent huge pages for preallocations of 2MB or more
+  \note a destroyed pool is cleared right away and kept by the core that destroyed it, pools past the depth go to the pool thread as before
+*/
+SWITCH_DECLARE(void) switch_core_memory_pool_cache_set(uint32_t depth, switch_size_t prealloc, switch_bool_t huge_pages);
+
+/*!
+  \brief Collect memory pool counters
+  \param stats the counters; live_bytes is estimated from the average size of released pools
+*/
+SWITCH_DECLARE(void) switch_core_memory_pool_stats(switch_memory_pool_stats_t *stats);
+
 SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(_Out_ switch_memory_pool_t **pool,
 																	_In_z_ const char *file, _In_z_ const char *func, _In_ int line);
 
@@ -1323,6 +1360,24 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(_In_ switch_core_
 SWITCH_DECLARE(switch_bool_t) switch_core_session_transcoding(switch_core_session_t *session_a, switch_core_session_t *session_b, switch_media_type_t type);
 SWITCH_DECLARE(void) switch_core_session_passthru(switch_core_session_t *session, switch_media_type_t type, switch_bool_t on);
 
+/*!
+  \brief Relay audio from one bridged session to the other below the session threads when both legs share a codec
+  \param session_a the session to read from
+  \param session_b the session to write to
+  \return SWITCH_STATUS_SUCCESS while the relay is running, SWITCH_STATUS_FALSE when the frames must go through session_a
+  \note an active relay is stopped when the legs no longer qualify (bugs, hold, transcoding, rtp_bridge_relay=false)
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_session_rtp_relay_start(switch_core_session_t *session_a, switch_core_session_t *session_b);
+SWITCH_DECLARE(void) switch_core_session_rtp_relay_stop(switch_core_session_t *session);
+
+/*!
+  \brief Wait for the audio relay reading from a session to stop
+  \param session the session
+  \param ms the longest time to wait
+  \return SWITCH_STATUS_SUCCESS if the relay is still running after ms
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_session_rtp_relay_wait(switch_core_session_t *session, uint32_t ms);
+
 /*!
   \brief Read a video frame from a session
   \param session the session to read from
@@ -1987,6 +2042,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_command(switch_file_handle_t *f
 SWITCH_DECLARE(switch_status_t) switch_core_file_truncate(switch_file_handle_t *fh, int64_t offset);
 SWITCH_DECLARE(switch_bool_t) switch_core_file_has_video(switch_file_handle_t *fh, switch_bool_t CHECK_OPEN);
 
+/*!
+  \brief Get the write-behind counters of a file handle
+  \param fh the file handle (valid until switch_core_file_close)
+  \param stats the counters to fill in
+  \return SWITCH_STATUS_SUCCESS if the handle is writing behind
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_file_get_write_behind_stats(switch_file_handle_t *fh, switch_file_write_behind_stats_t *stats);
+
 
 ///\}
 
@@ -2777,6 +2840,22 @@ SWITCH_DECLARE(void) switch_sql_queue_manager_resume(switch_sql_queue_manager_t
 SWITCH_DECLARE(int) switch_sql_queue_manager_size(switch_sql_queue_manager_t *qm, uint32_t index);
 SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push_confirm(switch_sql_queue_manager_t *qm, const char *sql, uint32_t pos, switch_bool_t dup);
 SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push(switch_sql_queue_manager_t *qm, const char *sql, uint32_t pos, switch_bool_t dup);
+
+/*!
+  \brief Queue one row for a table, the queue manager batches consecutive rows for the same table and columns into one statement
+  \param qm the queue manager
+  \param pos the queue to use
+  \param table the table name
+  \param columns comma separated column names
+  \param key a column from columns whose existing rows are deleted before the insert, or NULL for a plain insert
+  \param values one value per column, NULL values are written as NULL
+  \param nvalues the number of values
+  \return SWITCH_STATUS_SUCCESS when the row was queued
+*/
+SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push_row(switch_sql_queue_manager_t *qm, uint32_t pos, const char *table,
+																  const char *columns, const char *key, const char *const *values, uint32_t nvalues);
+SWITCH_DECLARE(void) switch_sql_queue_manager_stats(switch_sql_queue_manager_t *qm, switch_stream_handle_t *stream);
+SWITCH_DECLARE(void) switch_core_sqldb_queue_stats(switch_stream_handle_t *stream);
 SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_destroy(switch_sql_queue_manager_t **qmp);
 SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_init_name(const char *name,
 																   switch_sql_queue_manager_t **qmp,
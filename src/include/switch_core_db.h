@@ -261,6 +261,14 @@ SWITCH_DECLARE(int) switch_core_db_finalize(switch_core_db_stmt_t *pStmt);
  */
 SWITCH_DECLARE(int) switch_core_db_prepare(switch_core_db_t *db, const char *zSql, int nBytes, switch_core_db_stmt_t **ppStmt, const char **pzTail);
 
+/**
+ * Same as switch_core_db_prepare() but the statement keeps its SQL text:
+ * it is recompiled transparently after a schema change and
+ * switch_core_db_step() returns the specific error code instead of
+ * SWITCH_CORE_DB_ERROR. Use this for statements that are kept and reused.
+ */
+SWITCH_DECLARE(int) switch_core_db_prepare_v2(switch_core_db_t *db, const char *zSql, int nBytes, switch_core_db_stmt_t **ppStmt, const char **pzTail);
+
 /**
  * After an SQL query has been compiled with a call to either
  * switch_core_db_prepare(), then this function must be
@@ -485,6 +485,13 @@ SWITCH_DECLARE(switch_status_t) switch_chromakey_destroy(switch_chromakey_t **ck
 SWITCH_DECLARE(switch_status_t) switch_chromakey_create(switch_chromakey_t **ckP);
 SWITCH_DECLARE(void) switch_chromakey_set_default_threshold(switch_chromakey_t *ck, uint32_t threshold);
 SWITCH_DECLARE(void) switch_chromakey_process(switch_chromakey_t *ck, switch_image_t *img);
+
+/*!\brief Select the pixel blending kernels used by patch, overlay and chromakey
+*
+* \param[in]    level     "scalar", "sse2", "avx2" or "auto", NULL only queries
+* \return                  The name of the kernel set in use
+*/
+SWITCH_DECLARE(const char *) switch_core_video_simd(const char *level);
 SWITCH_DECLARE(switch_image_t *) switch_chromakey_cache_image(switch_chromakey_t *ck);
 SWITCH_DECLARE(switch_shade_t) switch_chromakey_str2shade(switch_chromakey_t *ck, const char *shade_name);
 
@@ -100,6 +100,8 @@ struct switch_event {
 	unsigned long key;
 	struct switch_event *next;
 	int flags;
+	/*! channel variables not yet copied into the headers */
+	switch_event_snapshot_t *snapshot;
 };
 
 typedef struct switch_serial_event_s {
@@ -227,6 +229,34 @@ SWITCH_DECLARE(switch_status_t) switch_event_dup(switch_event_t **event, switch_
 SWITCH_DECLARE(void) switch_event_merge(switch_event_t *event, switch_event_t *tomerge);
 SWITCH_DECLARE(switch_status_t) switch_event_dup_reply(switch_event_t **event, switch_event_t *todup);
 
+/*!
+  \brief Build an immutable, refcounted copy of a set of variables for lazy use in events
+  \param variables headers exposed as variable_<name>
+  \param scope_variables stack of events (linked by next) exposed as scope_variable_<name>
+  \return the snapshot with one reference held by the caller
+*/
+SWITCH_DECLARE(switch_event_snapshot_t *) switch_event_snapshot_create(switch_event_t *variables, switch_event_t *scope_variables);
+
+/*!
+  \brief Drop a reference to a snapshot, freeing it with the last one
+  \param snapshot the snapshot to release, set to NULL
+*/
+SWITCH_DECLARE(void) switch_event_snapshot_release(switch_event_snapshot_t **snapshot);
+
+/*!
+  \brief Attach a snapshot to an event; its headers are added when first needed
+  \param event the event
+  \param snapshot the snapshot, the event takes its own reference
+*/
+SWITCH_DECLARE(void) switch_event_set_snapshot(switch_event_t *event, switch_event_snapshot_t *snapshot);
+
+/*!
+  \brief Copy the headers of an attached snapshot into the event
+  \param event the event
+  \note only needed by code walking event->headers directly on events that were not delivered through the event system
+*/
+SWITCH_DECLARE(void) switch_event_materialize(switch_event_t *event);
+
 /*!
   \brief Fire an event with full arguement list
   \param file the calling file
@@ -254,6 +284,19 @@ SWITCH_DECLARE(void) switch_event_prep_for_delivery_detailed(const char *file, c
 SWITCH_DECLARE(switch_status_t) switch_event_bind(const char *id, switch_event_types_t event, const char *subclass_name, switch_event_callback_t callback,
 												  void *user_data);
 
+/*!
+  \brief Bind an event callback that only reads headers through switch_event_get_header and friends
+  \note channel variables attached as a snapshot are not copied into the event for this callback
+  \param id an identifier token of the binder
+  \param event the event enumeration to bind to
+  \param subclass_name the event subclass to bind to in the case if SWITCH_EVENT_CUSTOM
+  \param callback the callback functon to bind
+  \param user_data optional user specific data to pass whenever the callback is invoked
+  \return SWITCH_STATUS_SUCCESS if the event was binded
+*/
+SWITCH_DECLARE(switch_status_t) switch_event_bind_lazy(const char *id, switch_event_types_t event, const char *subclass_name,
+													   switch_event_callback_t callback, void *user_data);
+
 SWITCH_DECLARE(switch_status_t) switch_event_get_custom_events(switch_console_callback_match_t **matches);
 
 /*!
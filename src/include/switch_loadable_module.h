@@ -292,6 +292,17 @@ SWITCH_DECLARE(int) switch_loadable_module_get_codecs(const switch_codec_impleme
 */
 SWITCH_DECLARE(int) switch_loadable_module_get_codecs_sorted(const switch_codec_implementation_t **array, char fmtp_array[SWITCH_MAX_CODECS][MAX_FMTP_LEN], int arraylen, char **prefs, int preflen);
 
+/*!
+  \brief Retrieve the codecs named in a comma separated codec string, sorted as switch_loadable_module_get_codecs_sorted would
+  \param array the array to populate
+  \param fmtp_array the fmtp strings of the entries in array (may be NULL)
+  \param arraylen the max size in elements of the array
+  \param codec_string the codec preference string e.g. "OPUS,PCMU@20i,PCMA@20i"
+  \return the number of elements added to the array
+  \note the resolved set is cached by codec_string until the next codec module load or unload.
+*/
+SWITCH_DECLARE(int) switch_loadable_module_get_codecs_by_string(const switch_codec_implementation_t **array, char fmtp_array[SWITCH_MAX_CODECS][MAX_FMTP_LEN], int arraylen, const char *codec_string);
+
 /*!
   \brief Execute a registered API command
   \param cmd the name of the API command to execute
@@ -383,6 +383,8 @@ struct switch_file_handle {
 	int64_t vpos;
 	void *muxbuf;
 	switch_size_t muxlen;
+	/*! set when writes are queued to the core file writer threads */
+	switch_file_write_behind_t *write_behind;
 };
 
 /*! \brief Abstract interface to an asr module */
@@ -93,6 +93,28 @@ SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resa
  */
 SWITCH_DECLARE(void) switch_resample_destroy(switch_audio_resampler_t **resampler);
 
+/*!
+  \brief Start the cache of idle resamplers (called by the core at startup)
+  \param pool the pool to allocate the cache lock from
+ */
+SWITCH_DECLARE(void) switch_resample_cache_init(switch_memory_pool_t *pool);
+
+/*!
+  \brief Set how many idle resamplers are kept for reuse by switch_resample_create
+  \param size the number of idle resamplers to keep, 0 disables the cache
+ */
+SWITCH_DECLARE(void) switch_resample_cache_set(uint32_t size);
+
+/*!
+  \brief Get the number of idle resamplers currently held by the cache
+ */
+SWITCH_DECLARE(uint32_t) switch_resample_cache_idle(void);
+
+/*!
+  \brief Free every idle resampler and stop caching (called by the core at shutdown)
+ */
+SWITCH_DECLARE(void) switch_resample_cache_shutdown(void);
+
 /*!
   \brief Resample one float buffer into another using specifications of a given handle
   \param resampler the resample handle
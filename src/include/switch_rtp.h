@@ -207,6 +207,13 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_set_remote_ssrc(switch_rtp_t *rtp_ses
 */
 SWITCH_DECLARE(switch_port_t) switch_rtp_set_end_port(switch_port_t port);
 
+/*!
+  \brief Set the number of threads that run DTLS handshakes off the media threads (only before switch_rtp_init)
+  \param threads new value (0 runs handshakes inline on the media thread)
+  \return the current number of DTLS handshake threads
+*/
+SWITCH_DECLARE(int) switch_rtp_set_dtls_handshake_threads(int threads);
+
 /*!
   \brief Request a new port to be used for media
   \param ip the ip to request a port from
@@ -303,6 +310,38 @@ SWITCH_DECLARE(void) switch_rtp_kill_socket(switch_rtp_t *rtp_session);
 SWITCH_DECLARE(void) switch_rtp_break(switch_rtp_t *rtp_session);
 SWITCH_DECLARE(void) switch_rtp_flush(switch_rtp_t *rtp_session);
 
+/*!
+  \brief Relay media arriving on one RTP session straight out of another on the core relay thread
+  \param src the session to read from
+  \param dst the session to write to
+  \return SWITCH_STATUS_SUCCESS if the relay was started
+  \note seq, ts, ssrc and payload type are rewritten for dst and SRTP is re-applied as needed.
+  The relay stops on its own when a packet it cannot forward arrives (DTMF, CN, STUN, new source),
+  leaving that packet for the regular read path.
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_relay_start(switch_rtp_t *src, switch_rtp_t *dst);
+
+/*!
+  \brief Stop any relay reading from or writing to an RTP session
+  \param rtp_session the RTP session
+*/
+SWITCH_DECLARE(void) switch_rtp_relay_stop(switch_rtp_t *rtp_session);
+
+/*!
+  \brief Test if media from an RTP session is being relayed
+  \param rtp_session the RTP session
+  \return SWITCH_TRUE while a relay is reading from the session
+*/
+SWITCH_DECLARE(switch_bool_t) switch_rtp_relay_active(switch_rtp_t *rtp_session);
+
+/*!
+  \brief Wait for the relay reading from an RTP session to stop
+  \param rtp_session the RTP session
+  \param ms the longest time to wait
+  \return SWITCH_STATUS_SUCCESS if the relay is still running after ms, SWITCH_STATUS_FALSE once it has stopped
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_relay_wait(switch_rtp_t *rtp_session, uint32_t ms);
+
 /*!
   \brief Test if an RTP session is ready
   \param rtp_session an RTP session to test
@@ -1917,6 +1917,7 @@ SWITCH_FILE_PAUSE =             (1 <<  8) - Pause
 SWITCH_FILE_NATIVE =            (1 <<  9) - File is in native format (no transcoding)
 SWITCH_FILE_SEEK = 				(1 << 10) - File has done a seek
 SWITCH_FILE_OPEN =              (1 << 11) - File is open
+SWITCH_FILE_WRITE_BEHIND =      (1 << 22) - Hand writes to the core file writer threads
 </pre>
  */
 typedef enum {
@@ -1941,10 +1942,25 @@ typedef enum {
 	SWITCH_FILE_BREAK_ON_CHANGE = (1 << 18),
 	SWITCH_FILE_FLAG_VIDEO = (1 << 19),
 	SWITCH_FILE_FLAG_VIDEO_EOF = (1 << 20),
-	SWITCH_FILE_PRE_CLOSED = (1 << 21)
+	SWITCH_FILE_PRE_CLOSED = (1 << 21),
+	SWITCH_FILE_WRITE_BEHIND = (1 << 22)
 } switch_file_flag_enum_t;
 typedef uint32_t switch_file_flag_t;
 
+/*! \brief Counters for a file handle writing through the write-behind workers */
+typedef struct {
+	/*! bytes currently waiting to be written */
+	switch_size_t backlog_bytes;
+	/*! high water mark of backlog_bytes */
+	switch_size_t max_backlog_bytes;
+	/*! frames (and the samples in them) dropped because the backlog was full */
+	uint32_t dropped_frames;
+	switch_size_t dropped_samples;
+	/*! number of batched file_write calls made by the workers */
+	uint32_t batches;
+	switch_size_t bytes_written;
+} switch_file_write_behind_stats_t;
+
 typedef enum {
 	SWITCH_IO_FLAG_NONE = 0,
 	SWITCH_IO_FLAG_NOBLOCK = (1 << 0),
@@ -2303,6 +2319,7 @@ typedef struct switch_rtcp switch_rtcp_t;
 typedef struct switch_core_session_message switch_core_session_message_t;
 typedef struct switch_event_header switch_event_header_t;
 typedef struct switch_event switch_event_t;
+typedef struct switch_event_snapshot switch_event_snapshot_t;
 typedef struct switch_event_subclass switch_event_subclass_t;
 typedef struct switch_event_node switch_event_node_t;
 typedef struct switch_loadable_module switch_loadable_module_t;
@@ -2311,6 +2328,7 @@ typedef struct switch_rtcp_frame switch_rtcp_frame_t;
 typedef struct switch_channel switch_channel_t;
 typedef struct switch_sql_queue_manager switch_sql_queue_manager_t;
 typedef struct switch_file_handle switch_file_handle_t;
+typedef struct switch_file_write_behind switch_file_write_behind_t;
 typedef struct switch_core_session switch_core_session_t;
 typedef struct switch_caller_profile switch_caller_profile_t;
 typedef struct switch_caller_extension switch_caller_extension_t;
@@ -2321,6 +2339,7 @@ typedef struct switch_codec switch_codec_t;
 typedef struct switch_core_thread_session switch_core_thread_session_t;
 typedef struct switch_codec_implementation switch_codec_implementation_t;
 typedef struct switch_buffer switch_buffer_t;
+typedef struct switch_ring_buffer switch_ring_buffer_t;
 typedef union  switch_codec_settings switch_codec_settings_t;
 typedef struct switch_codec_fmtp switch_codec_fmtp_t;
 typedef struct switch_coredb_handle switch_coredb_handle_t;
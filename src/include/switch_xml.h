@@ -72,7 +72,9 @@ SWITCH_BEGIN_EXTERN_C
 	SWITCH_XML_NAMEM = (1 << 1),	// name is malloced
 	SWITCH_XML_TXTM = (1 << 2),	// txt is malloced
 	SWITCH_XML_DUP = (1 << 3),	// attribute name and value are strduped
-	SWITCH_XML_CDATA = (1 << 4) // body is in CDATA
+	SWITCH_XML_CDATA = (1 << 4), // body is in CDATA
+	SWITCH_XML_ARENA = (1 << 5), // tag lives in its root's arena
+	SWITCH_XML_ARENA_ATTR = (1 << 6) // attribute list lives in its root's arena
 } switch_xml_flag_t;
 
 /*! \brief A representation of an XML tree */
@@ -135,6 +137,20 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str(_In_z_ char *s, _In_ switch_si
 ///\return a formated xml node or NULL
 SWITCH_DECLARE(switch_xml_t) switch_xml_parse_fd(int fd);
 
+///\brief Parses a file descriptor in chunks into a compact tree whose tags, attribute lists and
+///\ strings live in a few arena blocks owned by the root. The tree works with every accessor and
+///\ is released with switch_xml_free().
+///\param fd
+///\return a formated xml node or NULL when the document is malformed or uses DTDs, processing
+///\ instructions or UTF-16, which are left to switch_xml_parse_fd()
+SWITCH_DECLARE(switch_xml_t) switch_xml_parse_fd_stream(int fd);
+
+///\brief bytes held by the arena of the tree xml belongs to, 0 if it was not built by switch_xml_parse_fd_stream()
+SWITCH_DECLARE(switch_size_t) switch_xml_arena_size(switch_xml_t xml);
+
+///\brief let switch_xml_parse_file() use switch_xml_parse_fd_stream() (the default)
+SWITCH_DECLARE(void) switch_xml_set_stream_parse(switch_bool_t on);
+
 ///\brief a wrapper for switch_xml_parse_fd() that accepts a file name
 ///\param file a file to parse
 ///\return a formated xml node or NULL
@@ -396,9 +412,37 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_in_domain(_In_z_ const ch
 																 _Out_opt_ switch_xml_t *ingroup);
 
 
+/*!
+ * \brief locate a user merged with its domain and group, served from the user cache when the user is cacheable
+ * \note the returned tree may be shared with the cache, it must be released with switch_xml_free and never modified
+ */
 SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_merged(const char *key, const char *user_name, const char *domain_name,
 															  const char *ip, switch_xml_t *user, switch_event_t *params);
+/*!
+ * \brief clear the user cache, a single user when key, user_name and domain_name are set, a whole domain when only domain_name is set, otherwise everything
+ * \return the number of cached users removed
+ */
 SWITCH_DECLARE(uint32_t) switch_xml_clear_user_cache(const char *key, const char *user_name, const char *domain_name);
+
+typedef struct {
+	uint32_t shards;
+	uint32_t entries;
+	uint32_t negative_entries;
+	uint32_t negative_ms;
+	uint32_t refresh_ahead;
+	uint64_t hits;
+	uint64_t negative_hits;
+	uint64_t misses;
+	uint64_t expired;
+	uint64_t refreshes;
+	uint64_t invalidated;
+} switch_xml_user_cache_stats_t;
+
+SWITCH_DECLARE(void) switch_xml_user_cache_stats(switch_xml_user_cache_stats_t *stats);
+///\brief how long, in ms, a user the directory does not know is remembered (0 disables negative caching)
+SWITCH_DECLARE(void) switch_xml_set_user_cache_negative_ms(uint32_t ms);
+///\brief refresh a cached user in the background once this percentage of its cacheable time is left (0 disables)
+SWITCH_DECLARE(void) switch_xml_set_user_cache_refresh_ahead(uint32_t percent);
 SWITCH_DECLARE(void) switch_xml_merge_user(switch_xml_t user, switch_xml_t domain, switch_xml_t group);
 
 SWITCH_DECLARE(switch_xml_t) switch_xml_dup(switch_xml_t xml);
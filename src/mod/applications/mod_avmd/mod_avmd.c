@@ -206,16 +206,15 @@ struct avmd_buffer {
     size_t samples_streak, samples_streak_amp; /* number of DESA samples in single streak without reset needed to validate SMA estimator */
 };
 
+/*! A detector is queued to the shared worker pool once per frame, the workers keep no per session state. */
 struct avmd_detector {
-    switch_thread_t *thread;
     switch_mutex_t  *mutex;
     uint8_t                     flag_processing_done;
-    uint8_t                     flag_should_exit;
     enum avmd_detection_mode    result;
-    switch_thread_cond_t        *cond_start_processing;
     struct avmd_buffer          buffer;
     avmd_session_t              *s;
     size_t                      samples;
+    size_t                      pos;
     uint8_t                     idx;
     uint8_t                     lagged, lag;
 };
@@ -245,8 +244,16 @@ static struct avmd_globals
     struct avmd_settings    settings;
     switch_memory_pool_t    *pool;
     size_t                  session_n;
+
+    /* detector worker pool shared by all sessions, sized once at load */
+    uint32_t                detector_threads;
+    uint32_t                workers_n;
+    switch_thread_t         **workers;
+    switch_queue_t          *detector_queue;
 } avmd_globals;
 
+#define AVMD_DETECTOR_QUEUE_LEN 16384
+
 static void avmd_process(avmd_session_t *session, switch_frame_t *frame, uint8_t direction);
 
 static switch_bool_t avmd_callback(switch_media_bug_t * bug, void *user_data, switch_abc_type_t type);
@@ -280,102 +287,82 @@ static void avmd_reloadxml_event_handler(switch_event_t *event);
 static void avmd_show(switch_stream_handle_t *stream, switch_mutex_t *mutex);
 
 static void* SWITCH_THREAD_FUNC
-avmd_detector_func(switch_thread_t *thread, void *arg);
+avmd_detector_worker(switch_thread_t *thread, void *arg);
 
 static uint8_t
 avmd_detection_in_progress(avmd_session_t *s);
 
-static switch_status_t avmd_launch_threads(avmd_session_t *s) {
-	uint8_t                 idx;
-	struct avmd_detector    *d;
+static switch_status_t avmd_start_workers(void) {
 	switch_threadattr_t     *thd_attr = NULL;
+	uint32_t                n;
 
-	idx = 0;
-	while (idx < s->settings.detectors_n) {
-		d = &s->detectors[idx];
-		d->flag_processing_done = 1;
-		d->flag_should_exit = 0;
-		d->result = AVMD_DETECT_NONE;
-		d->lagged = 0;
-		d->lag = 0;
-		switch_threadattr_create(&thd_attr, avmd_globals.pool);
-		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-		if (switch_thread_create(&d->thread, thd_attr, avmd_detector_func, d, switch_core_session_get_pool(s->session)) != SWITCH_STATUS_SUCCESS) {
-			return SWITCH_STATUS_FALSE;
-		}
-
-		if (s->settings.debug) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "AVMD: started thread idx=%u\n", idx);
-		}
+	n = avmd_globals.detector_threads;
+	if (n == 0) {
+		n = switch_core_cpu_count();
+	}
+	if (n == 0) {
+		n = 1;
+	}
 
-		++idx;
+	if (switch_queue_create(&avmd_globals.detector_queue, AVMD_DETECTOR_QUEUE_LEN, avmd_globals.pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
 	}
+	avmd_globals.workers = switch_core_alloc(avmd_globals.pool, n * sizeof(switch_thread_t *));
 
-	idx = 0;
-	while (idx < s->settings.detectors_lagged_n) {
-		d = &s->detectors[s->settings.detectors_n + idx];
-		d->flag_processing_done = 1;
-		d->flag_should_exit = 0;
-		d->result = AVMD_DETECT_NONE;
-		d->lagged = 1;
-		d->lag = idx + 1;
+	for (avmd_globals.workers_n = 0; avmd_globals.workers_n < n; avmd_globals.workers_n++) {
 		switch_threadattr_create(&thd_attr, avmd_globals.pool);
 		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-		if (switch_thread_create(&d->thread, thd_attr, avmd_detector_func, d, switch_core_session_get_pool(s->session)) != SWITCH_STATUS_SUCCESS) {
-			return SWITCH_STATUS_FALSE;
-		}
-
-		if (s->settings.debug) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "AVMD: started lagged thread idx=%u\n", s->settings.detectors_n + idx);
+		if (switch_thread_create(&avmd_globals.workers[avmd_globals.workers_n], thd_attr, avmd_detector_worker, NULL, avmd_globals.pool) != SWITCH_STATUS_SUCCESS) {
+			break;
 		}
+	}
 
-		++idx;
+	if (avmd_globals.workers_n == 0) {
+		return SWITCH_STATUS_FALSE;
 	}
 
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "AVMD: started %u detector threads\n", avmd_globals.workers_n);
 	return SWITCH_STATUS_SUCCESS;
 }
 
-static void avmd_join_threads(avmd_session_t *s) {
-    uint8_t                 idx;
-    struct avmd_detector    *d;
-    switch_status_t         status;
+static void avmd_stop_workers(void) {
+	switch_status_t         status;
+	uint32_t                idx;
 
-    idx = 0;
-    while (idx < s->settings.detectors_n) {
-        d = &s->detectors[idx];
-        switch_mutex_lock(d->mutex);
-        if (d->thread != NULL) {
-            d->flag_should_exit = 1;
-            d->samples = 0;
-            switch_thread_cond_signal(d->cond_start_processing);
-            switch_mutex_unlock(d->mutex);
-            switch_thread_join(&status, d->thread);
-            d->thread = NULL;
-            switch_mutex_destroy(d->mutex);
-            switch_thread_cond_destroy(d->cond_start_processing);
-        } else {
-            switch_mutex_unlock(d->mutex);
-        }
-        ++idx;
-    }
-    idx = 0;
-    while (idx < s->settings.detectors_lagged_n) {
-        d = &s->detectors[s->settings.detectors_n + idx];
-        switch_mutex_lock(d->mutex);
-        if (d->thread != NULL) {
-            d->flag_should_exit = 1;
-            d->samples = 0;
-            switch_thread_cond_signal(d->cond_start_processing);
-            switch_mutex_unlock(d->mutex);
-            switch_thread_join(&status, d->thread);
-            d->thread = NULL;
-            switch_mutex_destroy(d->mutex);
-            switch_thread_cond_destroy(d->cond_start_processing);
-        } else {
-            switch_mutex_unlock(d->mutex);
-        }
-        ++idx;
-    }
+	if (avmd_globals.detector_queue == NULL) {
+		return;
+	}
+
+	/* one NULL per worker, each worker exits on the first one it pops */
+	for (idx = 0; idx < avmd_globals.workers_n; idx++) {
+		switch_queue_push(avmd_globals.detector_queue, NULL);
+	}
+	for (idx = 0; idx < avmd_globals.workers_n; idx++) {
+		switch_thread_join(&status, avmd_globals.workers[idx]);
+	}
+	avmd_globals.workers_n = 0;
+	avmd_globals.detector_queue = NULL;
+}
+
+static void avmd_reset_detectors(avmd_session_t *s) {
+	uint8_t                 idx;
+	struct avmd_detector    *d;
+
+	idx = 0;
+	while (idx < (s->settings.detectors_n + s->settings.detectors_lagged_n)) {
+		d = &s->detectors[idx];
+		d->flag_processing_done = 1;
+		d->result = AVMD_DETECT_NONE;
+		d->pos = s->pos;
+		if (idx < s->settings.detectors_n) {
+			d->lagged = 0;
+			d->lag = 0;
+		} else {
+			d->lagged = 1;
+			d->lag = idx - s->settings.detectors_n + 1;
+		}
+		++idx;
+	}
 }
 
 static switch_status_t avmd_init_buffer(struct avmd_buffer *b, size_t buf_sz, uint8_t resolution, uint8_t offset, switch_core_session_t *fs_session) {
@@ -483,11 +470,8 @@ static switch_status_t init_avmd_session_data(avmd_session_t *avmd_session, swit
             }
             d->s = avmd_session;
             d->flag_processing_done = 1;
-            d->flag_should_exit = 1;
             d->idx = idx;
-            d->thread = NULL;
             switch_mutex_init(&d->mutex, SWITCH_MUTEX_DEFAULT, switch_core_session_get_pool(fs_session));
-            switch_thread_cond_create(&d->cond_start_processing, switch_core_session_get_pool(fs_session));
             ++offset;
             ++idx;
         }
@@ -503,11 +487,8 @@ static switch_status_t init_avmd_session_data(avmd_session_t *avmd_session, swit
             }
             d->s = avmd_session;
             d->flag_processing_done = 1;
-            d->flag_should_exit = 1;
             d->idx = avmd_session->settings.detectors_n + idx;
-            d->thread = NULL;
             switch_mutex_init(&d->mutex, SWITCH_MUTEX_DEFAULT, switch_core_session_get_pool(fs_session));
-            switch_thread_cond_create(&d->cond_start_processing, switch_core_session_get_pool(fs_session));
             ++idx;
     }
     switch_mutex_init(&avmd_session->mutex_detectors_done, SWITCH_MUTEX_DEFAULT, switch_core_session_get_pool(fs_session));
@@ -523,11 +504,10 @@ end:
 
 static void avmd_session_close(avmd_session_t *s) {
     uint8_t                 idx;
-    struct avmd_detector    *d;
-    switch_status_t         status;
 
     switch_mutex_lock(s->mutex);
 
+    /* no worker touches the session once every queued detector is done */
     switch_mutex_lock(s->mutex_detectors_done);
     while (avmd_detection_in_progress(s) == 1) {
         switch_thread_cond_wait(s->cond_detectors_done, s->mutex_detectors_done);
@@ -536,20 +516,7 @@ static void avmd_session_close(avmd_session_t *s) {
 
     idx = 0;
     while (idx < (s->settings.detectors_n + s->settings.detectors_lagged_n)) {
-        d = &s->detectors[idx];
-        switch_mutex_lock(d->mutex);
-        d = &s->detectors[idx];
-        d->flag_processing_done = 0;
-        d->flag_should_exit = 1;
-        d->samples = 0;
-        switch_thread_cond_signal(d->cond_start_processing);
-        switch_mutex_unlock(d->mutex);
-
-        switch_thread_join(&status, d->thread);
-        d->thread = NULL;
-
-        switch_mutex_destroy(d->mutex);
-        switch_thread_cond_destroy(d->cond_start_processing);
+        switch_mutex_destroy(s->detectors[idx].mutex);
         ++idx;
     }
     switch_mutex_unlock(s->mutex);
@@ -954,6 +921,13 @@ static switch_status_t avmd_load_xml_configuration(switch_mutex_t *mutex) {
 					if(!avmd_parse_u8_user_input(value, &avmd_globals.settings.detectors_lagged_n, 0, UINT8_MAX)) {
 						bad_lagged = 0;
 					}
+				} else if (!strcmp(name, "detector_threads")) {
+					int n = atoi(value);
+					if (n >= 0 && n <= 1024) {
+						avmd_globals.detector_threads = n;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "AVMD config parameter 'detector_threads' invalid - using default\n");
+					}
 				}
 			} // for
 		} // if list
@@ -1123,6 +1097,8 @@ static void avmd_show(switch_stream_handle_t *stream, switch_mutex_t *mutex) {
     stream->write_function(stream, "sessions                       \t%"PRId64"\n", avmd_globals.session_n);
     stream->write_function(stream, "detectors n                    \t%u\n", avmd_globals.settings.detectors_n);
     stream->write_function(stream, "detectors lagged n             \t%u\n", avmd_globals.settings.detectors_lagged_n);
+    stream->write_function(stream, "detector threads               \t%u\n", avmd_globals.workers_n);
+    stream->write_function(stream, "detectors queued               \t%u\n", avmd_globals.detector_queue ? switch_queue_size(avmd_globals.detector_queue) : 0);
     stream->write_function(stream, "\n\n");
 
     if (mutex != NULL) {
@@ -1193,6 +1169,14 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_avmd_load) {
     }
 #endif
 
+    if (avmd_start_workers() != SWITCH_STATUS_SUCCESS) {
+        switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't start avmd detector threads!\n");
+        avmd_stop_workers();
+        switch_event_unbind_callback(avmd_reloadxml_event_handler);
+        avmd_unregister_all_events();
+        return SWITCH_STATUS_TERM;
+    }
+
     SWITCH_ADD_APP(app_interface, "avmd_start","Start avmd detection", "Start avmd detection", avmd_start_app, "", SAF_NONE);
     SWITCH_ADD_APP(app_interface, "avmd_stop","Stop avmd detection", "Stop avmd detection", avmd_stop_app, "", SAF_NONE);
     SWITCH_ADD_APP(app_interface, "avmd","Beep detection", "Advanced detection of voicemail beeps", avmd_start_function, AVMD_SYNTAX, SAF_NONE);
@@ -1501,13 +1485,12 @@ SWITCH_STANDARD_APP(avmd_start_app) {
         }
     }
 
-    status = avmd_launch_threads(avmd_session);
-    if (status != SWITCH_STATUS_SUCCESS) {
-        switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Failed to start detection threads\n");
-        avmd_join_threads(avmd_session);
-        switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Joined detection threads\n");
+    if (avmd_globals.workers_n == 0) {
+        switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "No detection threads running\n");
+        status = SWITCH_STATUS_FALSE;
         goto end_unlock;
     }
+    avmd_reset_detectors(avmd_session);
 
     status = switch_core_media_bug_add(session, "avmd", NULL, avmd_callback, avmd_session, 0, flags, &bug); /* Add a media bug that allows me to intercept the audio stream */
     if (status != SWITCH_STATUS_SUCCESS) { /* If adding a media bug fails exit */
@@ -1653,6 +1636,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_avmd_shutdown) {
 #endif
 
     switch_event_unbind_callback(avmd_reloadxml_event_handler);
+    avmd_stop_workers();
     switch_mutex_unlock(avmd_globals.mutex);
     switch_mutex_destroy(avmd_globals.mutex);
     switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Advanced voicemail detection disabled\n");
@@ -2085,14 +2069,14 @@ static void avmd_process(avmd_session_t *s, switch_frame_t *frame, uint8_t direc
     while (idx < (s->settings.detectors_n + s->settings.detectors_lagged_n)) {
         d = &s->detectors[idx];
         switch_mutex_lock(d->mutex);
-        d = &s->detectors[idx];
         if (d->result == AVMD_DETECT_NONE) {
             d->flag_processing_done = 0;
-            d->flag_should_exit = 0;
             d->samples = (s->frame_n == 0 ? frame->samples - AVMD_P : frame->samples);
-            switch_thread_cond_signal(d->cond_start_processing);
+            switch_mutex_unlock(d->mutex);
+            switch_queue_push(avmd_globals.detector_queue, d);
+        } else {
+            switch_mutex_unlock(d->mutex);
         }
-        switch_mutex_unlock(d->mutex);
         ++idx;
     }
 
@@ -2240,66 +2224,61 @@ static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, circ_buff
     return AVMD_DETECT_NONE;
 }
 
-static void* SWITCH_THREAD_FUNC
-avmd_detector_func(switch_thread_t *thread, void *arg) {
-    size_t      sample_n = 0, samples = AVMD_P;
-    size_t      pos;
+/*! \brief Run one queued detector over the current frame of its session. */
+static void avmd_detector_run(struct avmd_detector *d) {
+    size_t      sample_n = 0, samples;
     uint8_t     resolution, offset;
-    avmd_session_t  *s;
+    avmd_session_t  *s = d->s;
     enum avmd_detection_mode res = AVMD_DETECT_NONE;
-    struct avmd_detector *d;
 
+    switch_mutex_lock(d->mutex);
+    resolution = d->buffer.resolution;
+    offset = d->buffer.offset;
+    samples = d->samples;
 
-    d = (struct avmd_detector*) arg;
-    s = d->s;
-    pos = s->pos;
-    while (1) {
-        switch_mutex_lock(d->mutex);
-        while ((d->flag_processing_done == 1) && (d->flag_should_exit == 0)) {
-            switch_thread_cond_wait(d->cond_start_processing, d->mutex);
-        }
-        /* master set processing_done flag to 0 or thread should exit */
-        if (d->flag_should_exit == 1) {
-            d->flag_processing_done = 1;
-            goto end;
-        }
-        resolution = d->buffer.resolution;
-        offset = d->buffer.offset;
-        samples = d->samples;
-
-        if (d->lagged == 1) {
-            if (d->lag > 0) {
-                --d->lag;
-                goto done;
-            }
-            pos += AVMD_P;
+    if (d->lagged == 1) {
+        if (d->lag > 0) {
+            --d->lag;
+            switch_mutex_unlock(d->mutex);
+            goto done;
         }
+        d->pos += AVMD_P;
+    }
+    switch_mutex_unlock(d->mutex);
 
-        switch_mutex_unlock(d->mutex);
-        sample_n = 1;
-        while (sample_n <= samples) {
-            if (((sample_n + offset) % resolution) == 0) {
-                res = avmd_process_sample(d->s, &s->b, sample_n, pos, d);
-                if (res != AVMD_DETECT_NONE) {
-                    break;
-                }
+    sample_n = 1;
+    while (sample_n <= samples) {
+        if (((sample_n + offset) % resolution) == 0) {
+            res = avmd_process_sample(s, &s->b, sample_n, d->pos, d);
+            if (res != AVMD_DETECT_NONE) {
+                break;
             }
-            ++sample_n;
         }
-        switch_mutex_lock(d->mutex);
-done:
-        d->flag_processing_done = 1;
-        d->result = res;
-        switch_mutex_unlock(d->mutex);
-
-        switch_mutex_lock(s->mutex_detectors_done);
-        switch_thread_cond_signal(s->cond_detectors_done);
-        switch_mutex_unlock(s->mutex_detectors_done);
+        ++sample_n;
     }
-    return NULL;
 
-end:
+done:
+    /* Publish under the session lock so the waiter can't see the detector done,
+     * close the session and free it before we are out of its mutex. */
+    switch_mutex_lock(s->mutex_detectors_done);
+    switch_mutex_lock(d->mutex);
+    d->flag_processing_done = 1;
+    d->result = res;
     switch_mutex_unlock(d->mutex);
+    switch_thread_cond_signal(s->cond_detectors_done);
+    switch_mutex_unlock(s->mutex_detectors_done);
+}
+
+static void* SWITCH_THREAD_FUNC
+avmd_detector_worker(switch_thread_t *thread, void *arg) {
+    void *pop = NULL;
+
+    while (switch_queue_pop(avmd_globals.detector_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+        if (pop == NULL) {
+            break;
+        }
+        avmd_detector_run((struct avmd_detector *) pop);
+    }
     return NULL;
 }
 
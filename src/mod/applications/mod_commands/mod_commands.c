@@ -699,6 +699,27 @@ SWITCH_STANDARD_API(pool_stats_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_STANDARD_API(memory_function)
+{
+	switch_memory_pool_stats_t stats;
+
+	switch_core_memory_pool_stats(&stats);
+
+	stream->write_function(stream, "pool-cache-slots: %u\n", stats.slots);
+	stream->write_function(stream, "pool-cache-size: %u\n", stats.depth);
+	stream->write_function(stream, "pools-live: %" SWITCH_UINT64_T_FMT "\n", stats.live);
+	stream->write_function(stream, "pools-cached: %u\n", stats.cached);
+	stream->write_function(stream, "pools-requested: %" SWITCH_UINT64_T_FMT "\n", stats.requests);
+	stream->write_function(stream, "pools-recycled: %" SWITCH_UINT64_T_FMT "\n", stats.hits);
+	stream->write_function(stream, "pools-released: %" SWITCH_UINT64_T_FMT "\n", stats.released);
+	stream->write_function(stream, "pools-dropped: %" SWITCH_UINT64_T_FMT "\n", stats.dropped);
+	stream->write_function(stream, "recycle-hit-rate: %.2f%%\n", stats.requests ? (double) stats.hits * 100 / stats.requests : 0.0);
+	stream->write_function(stream, "bytes-live: %" SWITCH_SIZE_T_FMT "\n", stats.live_bytes);
+	stream->write_function(stream, "bytes-cached: %" SWITCH_SIZE_T_FMT "\n", stats.cached_bytes);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(db_cache_function)
 {
 	int argc;
@@ -2575,7 +2596,9 @@ SWITCH_STANDARD_API(ctl_function)
 			stream->write_function(stream, "+OK SQL DEBUG [%s]\n", x ? "on" : "off");
 
 		} else if (!strcasecmp(argv[0], "sql")) {
-			if (argv[1]) {
+			if (argv[1] && !strcasecmp(argv[1], "stats")) {
+				switch_core_sqldb_queue_stats(stream);
+			} else if (argv[1]) {
 				int x = 0;
 				if (!strcasecmp(argv[1], "start")) {
 					x = 1;
@@ -6641,6 +6664,8 @@ SWITCH_STANDARD_API(xml_flush_function)
 
 	if (argc == 3) {
 		r = switch_xml_clear_user_cache(argv[0], argv[1], argv[2]);
+	} else if (argc == 1) {
+		r = switch_xml_clear_user_cache(NULL, NULL, argv[0]);
 	} else {
 		r = switch_xml_clear_user_cache(NULL, NULL, NULL);
 	}
@@ -6652,6 +6677,30 @@ SWITCH_STANDARD_API(xml_flush_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_STANDARD_API(xml_cache_stats_function)
+{
+	switch_xml_user_cache_stats_t stats;
+	uint64_t lookups;
+
+	switch_xml_user_cache_stats(&stats);
+	lookups = stats.hits + stats.negative_hits + stats.misses + stats.expired;
+
+	stream->write_function(stream, "shards: %u\n", stats.shards);
+	stream->write_function(stream, "users: %u\n", stats.entries);
+	stream->write_function(stream, "unknown-users: %u\n", stats.negative_entries);
+	stream->write_function(stream, "negative-ms: %u\n", stats.negative_ms);
+	stream->write_function(stream, "refresh-ahead: %u%%\n", stats.refresh_ahead);
+	stream->write_function(stream, "hits: %" SWITCH_UINT64_T_FMT "\n", stats.hits);
+	stream->write_function(stream, "negative-hits: %" SWITCH_UINT64_T_FMT "\n", stats.negative_hits);
+	stream->write_function(stream, "misses: %" SWITCH_UINT64_T_FMT "\n", stats.misses);
+	stream->write_function(stream, "expired: %" SWITCH_UINT64_T_FMT "\n", stats.expired);
+	stream->write_function(stream, "refreshes: %" SWITCH_UINT64_T_FMT "\n", stats.refreshes);
+	stream->write_function(stream, "invalidated: %" SWITCH_UINT64_T_FMT "\n", stats.invalidated);
+	stream->write_function(stream, "hit-rate: %.2f%%\n", lookups ? (double) (stats.hits + stats.negative_hits) * 100 / lookups : 0.0);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(escape_function)
 {
 	int len;
@@ -7522,6 +7571,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "load", "Load Module", load_function, LOAD_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "log", "Log", log_function, LOG_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "md5", "Return md5 hash", md5_function, "<data>");
+	SWITCH_ADD_API(commands_api_interface, "memory", "Memory pool usage and recycle counters", memory_function, "");
 	SWITCH_ADD_API(commands_api_interface, "module_exists", "Check if module exists", module_exists_function, "<module>");
 	SWITCH_ADD_API(commands_api_interface, "msleep", "Sleep N milliseconds", msleep_function, "<milliseconds>");
 	SWITCH_ADD_API(commands_api_interface, "nat_map", "Manage NAT", nat_map_function, "[status|republish|reinit] | [add|del] <port> [tcp|udp] [static]");
@@ -7615,7 +7665,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "uuid_jitterbuffer", "uuid_jitterbuffer", uuid_jitterbuffer_function, JITTERBUFFER_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "uuid_zombie_exec", "Set zombie_exec flag on the specified uuid", uuid_zombie_exec_function, "<uuid>");
 	SWITCH_ADD_API(commands_api_interface, "uuid_xfer_zombie", "Allow A leg to hangup and continue originating", uuid_xfer_zombie, XFER_ZOMBIE_SYNTAX);
-	SWITCH_ADD_API(commands_api_interface, "xml_flush_cache", "Clear xml cache", xml_flush_function, "<id> <key> <val>");
+	SWITCH_ADD_API(commands_api_interface, "xml_cache_stats", "Show xml user cache counters", xml_cache_stats_function, "");
+	SWITCH_ADD_API(commands_api_interface, "xml_flush_cache", "Clear xml cache", xml_flush_function, "[<id> <key> <val>|<domain>]");
 	SWITCH_ADD_API(commands_api_interface, "xml_locate", "Find some xml", xml_locate_function, "[root | <section> <tag> <tag_attr_name> <tag_attr_val>]");
 	SWITCH_ADD_API(commands_api_interface, "xml_wrap", "Wrap another api command in xml", xml_wrap_api_function, "<command> <args>");
 	SWITCH_ADD_API(commands_api_interface, "file_exists", "Check if a file exists on server", file_exists_function, "<file>");
@@ -7642,6 +7693,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	switch_console_set_complete("add fsctl debug_level");
 	switch_console_set_complete("add fsctl debug_pool");
 	switch_console_set_complete("add fsctl debug_sql");
+	switch_console_set_complete("add fsctl sql stats");
 	switch_console_set_complete("add fsctl last_sps");
 	switch_console_set_complete("add fsctl default_dtmf_duration");
 	switch_console_set_complete("add fsctl hupall");
@@ -120,6 +120,8 @@ api_command_t conference_api_sub_commands[] = {
 	{"vid-layout", (void_fn_t) & conference_api_sub_vid_layout, CONF_API_SUB_ARGS_SPLIT, "vid-layout", "<layout name>|group <group name> [<canvas id>]"},
 	{"vid-write-png", (void_fn_t) & conference_api_sub_write_png, CONF_API_SUB_ARGS_SPLIT, "vid-write-png", "<path>"},
 	{"vid-fps", (void_fn_t) & conference_api_sub_vid_fps, CONF_API_SUB_ARGS_SPLIT, "vid-fps", "<fps>"},
+	{"vid-timing", (void_fn_t) & conference_api_sub_vid_timing, CONF_API_SUB_ARGS_SPLIT, "vid-timing", "[<canvas_id>]"},
+	{"vid-ladder", (void_fn_t) & conference_api_sub_vid_ladder, CONF_API_SUB_ARGS_SPLIT, "vid-ladder", ""},
 	{"vid-res", (void_fn_t) & conference_api_sub_vid_res, CONF_API_SUB_ARGS_SPLIT, "vid-res", "<WxH>"},
 	{"vid-fgimg", (void_fn_t) & conference_api_sub_canvas_fgimg, CONF_API_SUB_ARGS_SPLIT, "vid-fgimg", "<file> | clear [<canvas-id>]"},
 	{"vid-bgimg", (void_fn_t) & conference_api_sub_canvas_bgimg, CONF_API_SUB_ARGS_SPLIT, "vid-bgimg", "<file> | clear [<canvas-id>]"},
@@ -1967,6 +1969,89 @@ switch_status_t conference_api_sub_vid_fps(conference_obj_t *conference, switch_
 
 }
 
+switch_status_t conference_api_sub_vid_timing(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
+{
+	int i, canvas_id = -1;
+
+	if (!conference->canvas_count) {
+		stream->write_function(stream, "-ERR Conference is not in mixing mode\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (argv[2]) {
+		canvas_id = atoi(argv[2]) - 1;
+
+		if (canvas_id < 0 || canvas_id > conference->canvas_count) {
+			stream->write_function(stream, "-ERR Invalid canvas\n");
+			return SWITCH_STATUS_SUCCESS;
+		}
+	}
+
+	switch_mutex_lock(conference->canvas_mutex);
+	for (i = 0; i <= conference->canvas_count; i++) {
+		mcu_canvas_t *canvas = conference->canvases[i];
+		mcu_canvas_timing_t total, last;
+		uint64_t frames;
+
+		if (!canvas || (canvas_id > -1 && i != canvas_id)) continue;
+
+		total = canvas->timing;
+		last = canvas->last_timing;
+		frames = total.frames ? total.frames : 1;
+
+		stream->write_function(stream, "Canvas %d: %" SWITCH_UINT64_T_FMT " frames\n", i + 1, total.frames);
+		stream->write_function(stream, "  avg  wait %" SWITCH_TIME_T_FMT "us scale %" SWITCH_TIME_T_FMT "us patch %" SWITCH_TIME_T_FMT "us encode %" SWITCH_TIME_T_FMT "us\n",
+							   total.wait / frames, total.scale / frames, total.patch / frames, total.encode / frames);
+		stream->write_function(stream, "  last wait %" SWITCH_TIME_T_FMT "us scale %" SWITCH_TIME_T_FMT "us patch %" SWITCH_TIME_T_FMT "us encode %" SWITCH_TIME_T_FMT "us\n",
+							   last.wait, last.scale, last.patch, last.encode);
+	}
+	switch_mutex_unlock(conference->canvas_mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+switch_status_t conference_api_sub_vid_ladder(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
+{
+	int i, j;
+
+	if (!conference->ladder_count) {
+		stream->write_function(stream, "-ERR Conference has no video-encode-ladder\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_mutex_lock(conference->member_mutex);
+	for (i = 0; i <= conference->canvas_count; i++) {
+		mcu_canvas_t *canvas = conference->canvases[i];
+
+		if (!canvas) continue;
+
+		for (j = 0; j < MAX_MUX_CODECS && canvas->write_codecs[j]; j++) {
+			codec_set_t *codec_set = canvas->write_codecs[j];
+			conference_ladder_rung_t *lr = &conference->ladder[codec_set->ladder_rung];
+			conference_member_t *imember;
+			uint64_t frames = codec_set->encoded_frames ? codec_set->encoded_frames : 1;
+			int members = 0;
+
+			if (!switch_core_codec_ready(&codec_set->codec)) continue;
+
+			for (imember = conference->members; imember; imember = imember->next) {
+				if (imember->watching_canvas_id == canvas->canvas_id && imember->video_codec_index == j) {
+					members++;
+				}
+			}
+
+			stream->write_function(stream, "Canvas %d rung %d %dx%d %dkps %s group %s: members %d frames %" SWITCH_UINT64_T_FMT
+								   " avg bytes %" SWITCH_UINT64_T_FMT " avg encode %" SWITCH_TIME_T_FMT "us\n",
+								   i + 1, codec_set->ladder_rung + 1, lr->width, lr->height, conference_video_ladder_rung_kps(conference, codec_set->ladder_rung),
+								   codec_set->codec.implementation->iananame, switch_str_nil(codec_set->video_codec_group), members,
+								   codec_set->encoded_frames, codec_set->encoded_bytes / frames, codec_set->encode_time / (switch_time_t) frames);
+		}
+	}
+	switch_mutex_unlock(conference->member_mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 switch_status_t conference_api_sub_write_png(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
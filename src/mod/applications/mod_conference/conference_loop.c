@@ -1297,6 +1297,9 @@ void conference_loop_output(conference_member_t *member)
 {
 	switch_channel_t *channel;
 	switch_frame_t write_frame = { 0 };
+	switch_frame_t enc_frame = { 0 };
+	conference_enc_record_t enc_rec = { 0 };
+	uint32_t bind_count = 0;
 	uint8_t *data = NULL;
 	switch_timer_t timer = { 0 };
 	uint32_t interval;
@@ -1345,6 +1348,9 @@ void conference_loop_output(conference_member_t *member)
 
 	write_frame.codec = &member->write_codec;
 
+	enc_frame.data = switch_core_session_alloc(member->session, SWITCH_RECOMMENDED_BUFFER_SIZE);
+	enc_frame.buflen = SWITCH_RECOMMENDED_BUFFER_SIZE;
+
 	/* Start the input thread */
 	conference_loop_launch_input(member, switch_core_session_get_pool(member->session));
 
@@ -1457,6 +1463,11 @@ void conference_loop_output(conference_member_t *member)
 		//	continue;
 		//}
 
+		/* the write codec can be renegotiated or adapt its bitrate, look again about once a second */
+		if (conference_utils_test_flag(member->conference, CFLAG_MINIMIZE_AUDIO_ENCODING) && !(bind_count++ % 50)) {
+			conference_member_bind_audio_codec(member, bytes);
+		}
+
 		switch_mutex_lock(member->write_mutex);
 
 
@@ -1530,24 +1541,46 @@ void conference_loop_output(conference_member_t *member)
 			if ((write_frame.datalen = (uint32_t) switch_buffer_read(use_buffer, write_frame.data, bytes))) {
 				write_frame.samples = write_frame.datalen / 2 / member->conference->channels;
 
-				if( !conference_utils_member_test_flag(member, MFLAG_CAN_HEAR)) {
-					memset(write_frame.data, 255, write_frame.datalen);
-				} else if (member->volume_out_level) { /* Check for output volume adjustments */
-					switch_change_sln_volume(write_frame.data, write_frame.samples * member->conference->channels, member->volume_out_level);
+				enc_rec.set = NULL;
+				enc_rec.datalen = 0;
+
+				if (member->enc_buffer && switch_buffer_read(member->enc_buffer, &enc_rec, sizeof(enc_rec)) == sizeof(enc_rec) && enc_rec.datalen) {
+					switch_buffer_read(member->enc_buffer, enc_frame.data, enc_rec.datalen);
 				}
 
-				//write_frame.timestamp = timer.samplecount;
+				/* the conference already encoded this mix for everyone with our encoder settings, send that packet as is */
+				if (enc_rec.datalen && write_frame.datalen == bytes && conference_utils_member_test_flag(member, MFLAG_CAN_HEAR) &&
+					!member->volume_out_level && !member->fnode && !switch_core_media_bug_count(member->session, NULL)) {
+					enc_frame.codec = &enc_rec.set->codec;
+					enc_frame.datalen = enc_rec.datalen;
+					enc_frame.samples = write_frame.samples;
+					enc_frame.rate = member->conference->rate;
+
+					if (switch_core_session_write_frame(member->session, &enc_frame, SWITCH_IO_FLAG_NONE, 0) != SWITCH_STATUS_SUCCESS) {
+						switch_mutex_unlock(member->audio_out_mutex);
+						switch_mutex_unlock(member->write_mutex);
+						break;
+					}
+				} else {
+					if( !conference_utils_member_test_flag(member, MFLAG_CAN_HEAR)) {
+						memset(write_frame.data, 255, write_frame.datalen);
+					} else if (member->volume_out_level) { /* Check for output volume adjustments */
+						switch_change_sln_volume(write_frame.data, write_frame.samples * member->conference->channels, member->volume_out_level);
+					}
+
+					//write_frame.timestamp = timer.samplecount;
 
-				if (member->fnode) {
-					conference_member_add_file_data(member, write_frame.data, write_frame.datalen);
-				}
+					if (member->fnode) {
+						conference_member_add_file_data(member, write_frame.data, write_frame.datalen);
+					}
 
-				conference_member_check_channels(&write_frame, member, SWITCH_FALSE);
+					conference_member_check_channels(&write_frame, member, SWITCH_FALSE);
 
-				if (switch_core_session_write_frame(member->session, &write_frame, SWITCH_IO_FLAG_NONE, 0) != SWITCH_STATUS_SUCCESS) {
-					switch_mutex_unlock(member->audio_out_mutex);
-					switch_mutex_unlock(member->write_mutex);
-					break;
+					if (switch_core_session_write_frame(member->session, &write_frame, SWITCH_IO_FLAG_NONE, 0) != SWITCH_STATUS_SUCCESS) {
+						switch_mutex_unlock(member->audio_out_mutex);
+						switch_mutex_unlock(member->write_mutex);
+						break;
+					}
 				}
 			}
 
@@ -1558,6 +1591,9 @@ void conference_loop_output(conference_member_t *member)
 			if (switch_buffer_inuse(member->mux_buffer)) {
 				switch_mutex_lock(member->audio_out_mutex);
 				switch_buffer_zero(member->mux_buffer);
+				if (member->enc_buffer) {
+					switch_buffer_zero(member->enc_buffer);
+				}
 				switch_mutex_unlock(member->audio_out_mutex);
 			}
 			conference_utils_member_clear_flag_locked(member, MFLAG_FLUSH_BUFFER);
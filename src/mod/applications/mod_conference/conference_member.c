@@ -521,6 +521,176 @@ void conference_member_check_channels(switch_frame_t *frame, conference_member_t
 }
 
 
+/* Bind the member to the conference encoder whose settings match its own audio write codec, so members that hear
+   the same mix send the same packets.  Runs on the member's output thread, which owns the write codec. */
+void conference_member_bind_audio_codec(conference_member_t *member, uint32_t bytes)
+{
+	conference_obj_t *conference = member->conference;
+	switch_codec_t *check_codec = NULL;
+	switch_codec_control_type_t rtype = SCCT_NONE;
+	void *ret = NULL;
+	codec_set_t *set = NULL, *tomb = NULL;
+	char key[128] = "";
+	int i, slot = -1;
+
+	if (!conference_utils_test_flag(conference, CFLAG_MINIMIZE_AUDIO_ENCODING) || conference_utils_member_test_flag(member, MFLAG_NO_MINIMIZE_ENCODING) ||
+		conference_utils_member_test_flag(member, MFLAG_POSITIONAL) || member->read_impl.number_of_channels != conference->channels ||
+		bytes != switch_samples_per_packet(conference->rate, conference->interval) * 2 * conference->channels) {
+		goto done;
+	}
+
+	if (!(check_codec = switch_core_session_get_write_codec(member->session)) || !switch_core_codec_ready(check_codec) ||
+		check_codec->implementation->actual_samples_per_second != conference->rate ||
+		check_codec->implementation->number_of_channels != conference->channels) {
+		goto done;
+	}
+
+	/* only codecs that can describe their encoder state take part */
+	if (switch_core_codec_control(check_codec, SCC_CODEC_SPECIFIC, SCCT_STRING, "encoder_key", SCCT_NONE, NULL, &rtype, &ret) != SWITCH_STATUS_SUCCESS ||
+		rtype != SCCT_STRING || zstr((char *) ret) || !strncasecmp((char *) ret, "ERROR", 5)) {
+		goto done;
+	}
+
+	switch_copy_string(key, (char *) ret, sizeof(key));
+
+	switch_mutex_lock(conference->mutex);
+
+	for (i = 0; i < conference->audio_write_codecs_count; i++) {
+		if (!strcmp(conference->audio_write_codecs[i]->encoder_key, key)) {
+			set = conference->audio_write_codecs[i];
+			slot = i;
+			break;
+		}
+
+		if (!tomb && !switch_core_codec_ready(&conference->audio_write_codecs[i]->codec)) {
+			tomb = conference->audio_write_codecs[i];
+			slot = i;
+		}
+	}
+
+	/* no member is bound to a tombstone, so its slot is free to try again with this member's encoder,
+	   first for the same key and otherwise for a new one */
+	if (set && !switch_core_codec_ready(&set->codec)) {
+		tomb = set;
+		set = NULL;
+	}
+
+	if (!set && (tomb || i < MAX_MUX_CODECS)) {
+		if (tomb) {
+			set = tomb;
+			if (strcmp(set->encoder_key, key)) {
+				set->encoder_key = switch_core_strdup(conference->pool, key);
+			}
+			set->frame_count = 0;
+			set->frame.datalen = 0;
+		} else {
+			slot = i;
+			set = switch_core_alloc(conference->pool, sizeof(codec_set_t));
+			set->encoder_key = switch_core_strdup(conference->pool, key);
+			set->packet = switch_core_alloc(conference->pool, SWITCH_RECOMMENDED_BUFFER_SIZE);
+		}
+
+		if (switch_core_codec_copy(check_codec, &set->codec, NULL, conference->pool) == SWITCH_STATUS_SUCCESS) {
+			/* a member encoder that has adapted its bitrate or loss settings can not be reproduced, keep the slot as a tombstone */
+			rtype = SCCT_NONE;
+			ret = NULL;
+
+			if (switch_core_codec_control(&set->codec, SCC_CODEC_SPECIFIC, SCCT_STRING, "encoder_key", SCCT_NONE, NULL, &rtype, &ret) != SWITCH_STATUS_SUCCESS ||
+				rtype != SCCT_STRING || zstr((char *) ret) || strcmp((char *) ret, key)) {
+				switch_core_codec_destroy(&set->codec);
+			}
+		}
+
+		if (!tomb) {
+			conference->audio_write_codecs[slot] = set;
+			conference->audio_write_codecs_count = slot + 1;
+		}
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Setting up shared audio write codec %s at slot %d key %s%s\n",
+						  check_codec->implementation->iananame, slot, key, switch_core_codec_ready(&set->codec) ? "" : " (unusable)");
+	}
+
+	if (set && !switch_core_codec_ready(&set->codec)) {
+		set = NULL;
+	}
+
+	switch_mutex_unlock(conference->mutex);
+
+ done:
+
+	if (set != member->audio_codec_set) {
+		switch_mutex_lock(member->audio_out_mutex);
+
+		if (set && !member->enc_buffer) {
+			if (switch_buffer_create_dynamic(&member->enc_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_ENC_BUFFER_MAX) != SWITCH_STATUS_SUCCESS) {
+				set = NULL;
+			} else {
+				/* records are written alongside every mixed frame from now on, start both buffers empty so they line up */
+				switch_buffer_zero(member->mux_buffer);
+			}
+		} else if (!set && member->enc_buffer) {
+			switch_buffer_destroy(&member->enc_buffer);
+		}
+
+		member->audio_codec_set = set;
+		switch_mutex_unlock(member->audio_out_mutex);
+	}
+}
+
+/* Called by the conference thread with member->audio_out_mutex held, right after a mixed frame went into the member's
+   mux_buffer.  shared means the frame is the plain conference mix, so it can be encoded once for everyone on the same set. */
+void conference_member_write_enc_record(conference_member_t *member, int16_t *data, uint32_t bytes, switch_bool_t shared)
+{
+	conference_obj_t *conference = member->conference;
+	conference_enc_record_t rec = { 0 };
+	codec_set_t *set = member->audio_codec_set;
+
+	if (!member->enc_buffer) {
+		return;
+	}
+
+	if (shared && set) {
+		if (set->frame_count != conference->audio_frame_count) {
+			uint32_t rate = conference->rate, flag = 0;
+			switch_time_t start = switch_time_now();
+
+			set->frame.datalen = SWITCH_RECOMMENDED_BUFFER_SIZE;
+
+			if (switch_core_codec_encode(&set->codec, NULL, data, bytes, conference->rate,
+										 set->packet, &set->frame.datalen, &rate, &flag) == SWITCH_STATUS_SUCCESS) {
+				set->encoded_frames++;
+				set->encoded_bytes += set->frame.datalen;
+				set->encode_time += switch_time_now() - start;
+			} else {
+				set->frame.datalen = 0;
+			}
+
+			set->frame_count = conference->audio_frame_count;
+		}
+
+		if (set->frame.datalen) {
+			rec.set = set;
+			rec.datalen = set->frame.datalen;
+		}
+	}
+
+	/* a full enc_buffer means the output thread is that far behind: drop its backlog from both buffers
+	   and start again from this frame so every mixed frame keeps exactly one record */
+	if (switch_buffer_freespace(member->enc_buffer) < sizeof(rec) + rec.datalen) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_WARNING, "Member %u encoded audio backlog full, dropping it\n", member->id);
+		switch_buffer_zero(member->enc_buffer);
+		switch_buffer_zero(member->mux_buffer);
+		switch_buffer_write(member->mux_buffer, data, bytes);
+	}
+
+	switch_buffer_write(member->enc_buffer, &rec, sizeof(rec));
+
+	if (rec.datalen) {
+		switch_buffer_write(member->enc_buffer, set->packet, rec.datalen);
+	}
+}
+
+
 void conference_member_add_file_data(conference_member_t *member, int16_t *data, switch_size_t file_data_len)
 {
 	switch_size_t file_sample_len;
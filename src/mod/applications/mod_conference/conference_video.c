@@ -503,12 +503,12 @@ static void set_bounds(int *x, int *y, int img_w, int img_h, int crop_w, int cro
 
 }
 
-void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg, switch_bool_t freeze)
+/* caller must hold the canvas mutex, either itself or on behalf of the layer pool */
+static void scale_and_patch_layer(mcu_layer_t *layer, switch_image_t *ximg, switch_bool_t freeze)
 {
 	switch_image_t *IMG, *img;
 	int img_changed = 0, want_w = 0, want_h = 0, border = 0;
-
-	switch_mutex_lock(layer->canvas->mutex);
+	switch_time_t start = switch_time_now(), scaled = 0;
 
 	IMG = layer->canvas->img;
 	img = ximg ? ximg : layer->cur_img;
@@ -516,7 +516,6 @@ void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg,
 	switch_assert(IMG);
 
 	if (!img) {
-		switch_mutex_unlock(layer->canvas->mutex);
 		return;
 	}
 	//printf("RAW %dx%d\n", img->d_w, img->d_h);
@@ -858,8 +857,11 @@ void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg,
 
 		//printf("SCALE %d,%d %dx%d\n", x_pos, y_pos, img_w, img_h);
 
+		scaled = switch_time_now();
 		switch_img_scale(img, &layer->img, img_w, img_h);
-		
+		scaled = switch_time_now() - scaled;
+		layer->scale_time += scaled;
+
 		if (layer->logo_img) {
 			//int ew = layer->screen_w - (border * 2), eh = layer->screen_h - (layer->banner_img ? layer->banner_img->d_h : 0) - (border * 2);
 			int ew = layer->img->d_w - (border * 2), eh = layer->img->d_h - (border * 2);
@@ -924,8 +926,14 @@ void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg,
 		switch_img_patch(IMG, img, 0, 0);
 	}
 
-	switch_mutex_unlock(layer->canvas->mutex);
+	layer->patch_time += switch_time_now() - start - scaled;
+}
 
+void conference_video_scale_and_patch(mcu_layer_t *layer, switch_image_t *ximg, switch_bool_t freeze)
+{
+	switch_mutex_lock(layer->canvas->mutex);
+	scale_and_patch_layer(layer, ximg, freeze);
+	switch_mutex_unlock(layer->canvas->mutex);
 }
 
 void conference_video_set_canvas_bgcolor(mcu_canvas_t *canvas, char *color)
@@ -1857,6 +1865,110 @@ void conference_video_destroy_canvas(mcu_canvas_t **canvasP) {
 	*canvasP = NULL;
 }
 
+/* "1920x1080:4mb,1280x720:1500kb,640x360" highest rung first, the bandwidth is optional */
+void conference_video_parse_ladder(conference_obj_t *conference, const char *str)
+{
+	char *dup = switch_core_strdup(conference->pool, str);
+	char *argv[MAX_LADDER_RUNGS] = { 0 };
+	int argc, i, j;
+
+	conference->ladder_count = 0;
+	argc = switch_separate_string(dup, ',', argv, MAX_LADDER_RUNGS);
+
+	for (i = 0; i < argc; i++) {
+		conference_ladder_rung_t rung = { 0 };
+		char *p;
+
+		rung.width = atoi(argv[i]);
+
+		if ((p = strchr(argv[i], 'x'))) {
+			rung.height = atoi(p + 1);
+		}
+
+		if ((p = strchr(argv[i], ':')) && strcasecmp(p + 1, "auto")) {
+			rung.kps = switch_parse_bandwidth_string(p + 1);
+		}
+
+		if (rung.width < 160 || rung.height < 90) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Invalid video-encode-ladder rung [%s], skipping\n", argv[i]);
+			continue;
+		}
+
+		/* keep the rungs ordered largest first */
+		for (j = conference->ladder_count; j > 0 && conference->ladder[j - 1].width * conference->ladder[j - 1].height < rung.width * rung.height; j--) {
+			conference->ladder[j] = conference->ladder[j - 1];
+		}
+
+		conference->ladder[j] = rung;
+		conference->ladder_count++;
+	}
+}
+
+int conference_video_ladder_rung_kps(conference_obj_t *conference, int rung)
+{
+	conference_ladder_rung_t *lr = &conference->ladder[rung];
+
+	if (lr->kps > 0) {
+		return lr->kps;
+	}
+
+	return switch_calc_bitrate(lr->width, lr->height, conference->video_quality, conference->video_fps.fps);
+}
+
+/* pick the best rung the member can take based on the bandwidth negotiated for it, less what loss feedback has cut */
+static void check_ladder_rung(conference_obj_t *conference, conference_member_t *member)
+{
+	int kps = member->max_bw_out, rung;
+
+	if (!conference->ladder_count) {
+		return;
+	}
+
+	if (!kps) {
+		kps = conference->video_codec_settings.video.bandwidth;
+	}
+
+	if (kps) {
+		kps -= (int)(kps * switch_core_media_get_media_bw_mult(member->session));
+	}
+
+	for (rung = 0; kps && rung < conference->ladder_count - 1; rung++) {
+		int need = conference_video_ladder_rung_kps(conference, rung);
+
+		/* climbing back up needs some headroom so members do not flap between two rungs */
+		if (rung < member->video_ladder_rung) {
+			need += need / 4;
+		}
+
+		if (kps >= need) {
+			break;
+		}
+	}
+
+	if (rung != member->video_ladder_rung) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_DEBUG, "%s moving to video ladder rung %dx%d at %dkps\n",
+						  switch_channel_get_name(member->channel), conference->ladder[rung].width, conference->ladder[rung].height, kps);
+		member->video_ladder_rung = rung;
+		member->video_codec_index = -1;
+	}
+}
+
+static void setup_ladder_codec(conference_obj_t *conference, mcu_canvas_t *canvas, codec_set_t *codec_set, int rung)
+{
+	conference_ladder_rung_t *lr = &conference->ladder[rung];
+	int32_t bw = conference_video_ladder_rung_kps(conference, rung);
+
+	codec_set->ladder_rung = rung;
+
+	if (lr->width != canvas->width || lr->height != canvas->height) {
+		codec_set->scaled_img = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, lr->width, lr->height, 16);
+	}
+
+	switch_core_codec_control(&codec_set->codec, SCC_VIDEO_BANDWIDTH, SCCT_INT, &bw, SCCT_NONE, NULL, NULL, NULL);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Video ladder rung %d encoding %dx%d at %dkps\n", rung, lr->width, lr->height, bw);
+}
+
 void conference_video_write_canvas_image_to_codec_group(conference_obj_t *conference, mcu_canvas_t *canvas, codec_set_t *codec_set,
 														int codec_index, uint32_t timestamp, switch_bool_t need_refresh,
 														switch_bool_t send_keyframe, switch_bool_t need_reset)
@@ -1897,14 +2009,19 @@ void conference_video_write_canvas_image_to_codec_group(conference_obj_t *confer
 		frame->img = scaled_img;
 	}
 
+	codec_set->encoded_frames++;
+
 	do {
+		switch_time_t encode_start = switch_time_now();
 
 		frame->data = ((unsigned char *)frame->packet) + 12;
 		frame->datalen = SWITCH_DEFAULT_VIDEO_SIZE;
 
 		encode_status = switch_core_codec_encode_video(&codec_set->codec, frame);
+		codec_set->encode_time += switch_time_now() - encode_start;
 
 		if (encode_status == SWITCH_STATUS_SUCCESS || encode_status == SWITCH_STATUS_MORE_DATA) {
+			codec_set->encoded_bytes += frame->datalen;
 
 			switch_assert((encode_status == SWITCH_STATUS_SUCCESS && frame->m) || !frame->m);
 
@@ -2187,88 +2304,103 @@ void conference_video_launch_muxing_thread(conference_obj_t *conference, mcu_can
 							 super ? conference_video_super_muxing_thread_run : conference_video_muxing_thread_run, canvas, conference->pool);
 	}
 	switch_mutex_unlock(conference_globals.hash_mutex);
-}
 
-void *SWITCH_THREAD_FUNC conference_video_layer_thread_run(switch_thread_t *thread, void *obj)
-{
-	conference_member_t *member = (conference_member_t *) obj;
-
-	if (switch_thread_rwlock_tryrdlock(member->rwlock) != SWITCH_STATUS_SUCCESS) {
-		return NULL;
-	}
-
-	//switch_core_autobind_cpu();
-	member->layer_thread_running = 1;
+	conference_video_layer_pool_start();
+}
 
-	switch_mutex_lock(member->layer_cond_mutex);
-	
-	while(conference_utils_member_test_flag(member, MFLAG_RUNNING) && member->layer_thread_running) {
-		mcu_layer_t *layer = NULL;
-		mcu_canvas_t *canvas = NULL;
-		
+#define LAYER_POOL_MAX_THREADS 16
 
-		switch_thread_cond_wait(member->layer_cond, member->layer_cond_mutex);
+/* Layers of every canvas are scaled and patched by one shared set of workers.
+ * The canvas thread holds canvas->mutex from queueing its layers until the last one
+ * is done, and runs queued jobs itself while it waits. */
+static struct {
+	switch_queue_t *queue;
+	switch_thread_t *threads[LAYER_POOL_MAX_THREADS];
+	int thread_count;
+} layer_pool;
 
-		if (!conference_utils_member_test_flag(member, MFLAG_RUNNING)) {
-			break;
-		}
+static void run_layer_job(mcu_layer_t *layer)
+{
+	mcu_canvas_t *canvas = layer->canvas;
 
+	scale_and_patch_layer(layer, NULL, SWITCH_FALSE);
+	layer->need_patch = 0;
+	switch_atomic_dec(&canvas->layer_jobs);
+}
 
-		if (member->video_layer_id > -1 && member->canvas_id > -1) {
-			canvas = member->conference->canvases[member->canvas_id];
-			layer = &canvas->layers[member->video_layer_id];
-		}
+static void *SWITCH_THREAD_FUNC conference_video_layer_pool_run(switch_thread_t *thread, void *obj)
+{
+	void *pop;
 
-		if (layer) {
-			if (layer->need_patch) {
-				conference_video_scale_and_patch(layer, NULL, SWITCH_FALSE);
-				layer->need_patch = 0;
-			}
-		}
+	while (switch_queue_pop(layer_pool.queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		run_layer_job((mcu_layer_t *) pop);
 	}
 
-	switch_mutex_unlock(member->layer_cond_mutex);
-
-	member->layer_thread_running = 0;
-
-	switch_thread_rwlock_unlock(member->rwlock);
-
 	return NULL;
 }
 
-void conference_video_wake_layer_thread(conference_member_t *member)
+void conference_video_layer_pool_start(void)
 {
-	if (member->layer_cond) {
-		if (switch_mutex_trylock(member->layer_cond_mutex) == SWITCH_STATUS_SUCCESS) {
-			switch_thread_cond_signal(member->layer_cond);
-			switch_mutex_unlock(member->layer_cond_mutex);
+	switch_threadattr_t *thd_attr = NULL;
+	int i, count = switch_core_cpu_count() - 1;
+
+	if (count < 2) {
+		return;
+	}
+
+	if (count > LAYER_POOL_MAX_THREADS) {
+		count = LAYER_POOL_MAX_THREADS;
+	}
+
+	switch_mutex_lock(conference_globals.hash_mutex);
+	if (!layer_pool.queue) {
+		switch_queue_create(&layer_pool.queue, MCU_MAX_LAYERS * 4, conference_globals.conference_pool);
+
+		for (i = 0; i < count; i++) {
+			switch_threadattr_create(&thd_attr, conference_globals.conference_pool);
+			switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+			if (switch_thread_create(&layer_pool.threads[i], thd_attr, conference_video_layer_pool_run, NULL,
+									 conference_globals.conference_pool) != SWITCH_STATUS_SUCCESS) {
+				break;
+			}
 		}
-		
+
+		layer_pool.thread_count = i;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Started %d video layer threads\n", layer_pool.thread_count);
 	}
+	switch_mutex_unlock(conference_globals.hash_mutex);
 }
-	
 
-void conference_video_launch_layer_thread(conference_member_t *member)
+void conference_video_layer_pool_shutdown(void)
 {
-	switch_threadattr_t *thd_attr = NULL;
+	switch_status_t st;
+	int i;
 
-	if (switch_core_cpu_count() < 3) {
+	if (!layer_pool.queue) {
 		return;
 	}
 
-	if (!member->layer_cond) {
-		switch_thread_cond_create(&member->layer_cond, member->pool);
-		switch_mutex_init(&member->layer_cond_mutex, SWITCH_MUTEX_NESTED, member->pool);
+	for (i = 0; i < layer_pool.thread_count; i++) {
+		switch_queue_push(layer_pool.queue, NULL);
 	}
 
-	switch_mutex_lock(conference_globals.hash_mutex);
-	if (!member->video_layer_thread) {
-		switch_threadattr_create(&thd_attr, member->pool);
-		//switch_threadattr_priority_set(thd_attr, SWITCH_PRI_REALTIME);
-		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-		switch_thread_create(&member->video_layer_thread, thd_attr, conference_video_layer_thread_run, member, member->pool);
+	for (i = 0; i < layer_pool.thread_count; i++) {
+		switch_thread_join(&st, layer_pool.threads[i]);
+	}
+
+	layer_pool.thread_count = 0;
+	layer_pool.queue = NULL;
+}
+
+/* canvas->mutex must be held until wait_for_canvas() returns */
+static void queue_layer_job(mcu_layer_t *layer)
+{
+	layer->need_patch = 1;
+	switch_atomic_inc(&layer->canvas->layer_jobs);
+
+	if (!layer_pool.thread_count || switch_queue_trypush(layer_pool.queue, layer) != SWITCH_STATUS_SUCCESS) {
+		run_layer_job(layer);
 	}
-	switch_mutex_unlock(conference_globals.hash_mutex);
 }
 
 
@@ -3047,29 +3179,45 @@ void conference_video_check_auto_bitrate(conference_member_t *member, mcu_layer_
 
 static void wait_for_canvas(mcu_canvas_t *canvas)
 {
-	switch_mutex_lock(canvas->write_mutex);
-	for (;;) {
-		int x = 0;
-		int i = 0;
-
-		for (i = 0; i < canvas->total_layers; i++) {
-			mcu_layer_t *layer = &canvas->layers[i];
+	void *pop;
 
-			if (layer->need_patch) {
-				if (layer->member_id && layer->member && conference_utils_member_test_flag(layer->member, MFLAG_RUNNING) && layer->member->fb) {
-					conference_video_wake_layer_thread(layer->member);
-					x++;
-				} else {
-					layer->need_patch = 0;
-				}
+	while (switch_atomic_read(&canvas->layer_jobs)) {
+		if (layer_pool.thread_count && switch_queue_trypop(layer_pool.queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			if (pop) {
+				run_layer_job((mcu_layer_t *) pop);
+			} else {
+				switch_queue_push(layer_pool.queue, NULL);
 			}
+		} else {
+			switch_cond_next();
 		}
+	}
+}
 
-		if (!x) break;
+/* fold the per layer stage times of the frame just composed into the canvas totals */
+static void collect_canvas_timing(mcu_canvas_t *canvas, switch_time_t wait, switch_time_t encode)
+{
+	mcu_canvas_timing_t last = { 0 };
+	int i;
+
+	for (i = 0; i < MCU_MAX_LAYERS; i++) {
+		mcu_layer_t *layer = &canvas->layers[i];
 
-		switch_cond_next();
+		last.scale += layer->scale_time;
+		last.patch += layer->patch_time;
+		layer->scale_time = layer->patch_time = 0;
 	}
-	switch_mutex_unlock(canvas->write_mutex);
+
+	last.frames = 1;
+	last.wait = wait;
+	last.encode = encode;
+
+	canvas->last_timing = last;
+	canvas->timing.frames++;
+	canvas->timing.wait += last.wait;
+	canvas->timing.scale += last.scale;
+	canvas->timing.patch += last.patch;
+	canvas->timing.encode += last.encode;
 }
 
 static void personal_attach(mcu_layer_t *layer, conference_member_t *member)
@@ -3161,6 +3309,7 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 		switch_frame_t file_frame = { 0 };
 		int j = 0, personal = conference_utils_test_flag(conference, CFLAG_PERSONAL_CANVAS) ? 1 : 0;
 		int video_count = 0;
+		switch_time_t compose_start = 0, encode_start = 0;
 
 		if (!personal) {
 			if (canvas->new_vlayout && switch_mutex_trylock(conference->canvas_mutex) == SWITCH_STATUS_SUCCESS) {
@@ -3353,9 +3502,12 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 				min_members++;
 
 				if (switch_channel_test_flag(imember->channel, CF_VIDEO_READY)) {
+					check_ladder_rung(conference, imember);
+
 					if (imember->video_codec_index < 0 && (check_codec = switch_core_session_get_video_write_codec(imember->session))) {
 						for (i = 0; canvas->write_codecs[i] && switch_core_codec_ready(&canvas->write_codecs[i]->codec) && i < MAX_MUX_CODECS; i++) {
-							if (check_codec->implementation->codec_id == canvas->write_codecs[i]->codec.implementation->codec_id) {
+							if (check_codec->implementation->codec_id == canvas->write_codecs[i]->codec.implementation->codec_id &&
+								canvas->write_codecs[i]->ladder_rung == imember->video_ladder_rung) {
 								if ((zstr(imember->video_codec_group) && zstr(canvas->write_codecs[i]->video_codec_group)) || 
 									(!strcmp(switch_str_nil(imember->video_codec_group), switch_str_nil(canvas->write_codecs[i]->video_codec_group)))) {
 								
@@ -3413,7 +3565,9 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 								canvas->write_codecs[i]->frame.data = ((uint8_t *)canvas->write_codecs[i]->frame.packet) + 12;
 								canvas->write_codecs[i]->frame.packetlen = buflen;
 								canvas->write_codecs[i]->frame.buflen = buflen - 12;
-								if (conference->scale_h264_canvas_width > 0 && conference->scale_h264_canvas_height > 0 && !strcmp(check_codec->implementation->iananame, "H264")) {
+								if (conference->ladder_count) {
+									setup_ladder_codec(conference, canvas, canvas->write_codecs[i], imember->video_ladder_rung);
+								} else if (conference->scale_h264_canvas_width > 0 && conference->scale_h264_canvas_height > 0 && !strcmp(check_codec->implementation->iananame, "H264")) {
 									int32_t bw = -1;
 
 									canvas->write_codecs[i]->fps_divisor = conference->scale_h264_canvas_fps_divisor;
@@ -3997,7 +4151,11 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 			}
 			switch_mutex_unlock(conference->file_mutex);
 
+			compose_start = switch_micro_time_now();
+
 			if (!canvas->playing_video_file) {
+				/* non overlapping layers cover disjoint parts of the canvas so they can be composed in any order */
+				switch_mutex_lock(canvas->mutex);
 				for (i = 0; i < canvas->total_layers; i++) {
 					mcu_layer_t *layer = &canvas->layers[i];
 
@@ -4007,20 +4165,14 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 							canvas->refresh++;
 						}
 
-						if (layer->member && switch_core_cpu_count() > 2) {
-							layer->need_patch = 1;
-							conference_video_wake_layer_thread(layer->member);
-						} else {
-							conference_video_scale_and_patch(layer, NULL, SWITCH_FALSE);
-						}
-
+						queue_layer_job(layer);
 						layer->tagged = 0;
 					}
 				}
 
-				switch_core_timer_next(&canvas->timer);
 				wait_for_canvas(canvas);
-				
+
+				/* overlapping layers are stacked in layer order on top of the rest */
 				for (i = 0; i < canvas->total_layers; i++) {
 					mcu_layer_t *layer = &canvas->layers[i];
 					
@@ -4034,14 +4186,12 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 							canvas->refresh++;
 						}
 
-						if (layer->member && switch_core_cpu_count() > 2) {
-							layer->need_patch = 1;
-							conference_video_wake_layer_thread(layer->member);
-						} else {
-							conference_video_scale_and_patch(layer, NULL, SWITCH_FALSE);
-						}
+						scale_and_patch_layer(layer, NULL, SWITCH_FALSE);
 					}
 				}
+				switch_mutex_unlock(canvas->mutex);
+
+				switch_core_timer_next(&canvas->timer);
 			}
 
 			if (canvas->refresh > 1) {
@@ -4143,6 +4293,8 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 				wait_for_canvas(canvas);
 			}
 
+			encode_start = switch_time_now();
+
 			if (canvas->fgimg) {
 				conference_video_set_canvas_fgimg(canvas, NULL);
 			}
@@ -4230,6 +4382,8 @@ void *SWITCH_THREAD_FUNC conference_video_muxing_thread_run(switch_thread_t *thr
 			}
 
 			switch_mutex_unlock(conference->member_mutex);
+
+			collect_canvas_timing(canvas, compose_start - now, switch_time_now() - encode_start);
 		} // NOT PERSONAL
 	}
 
@@ -4406,9 +4560,12 @@ void *SWITCH_THREAD_FUNC conference_video_super_muxing_thread_run(switch_thread_
 				min_members++;
 
 				if (switch_channel_test_flag(imember->channel, CF_VIDEO_READY)) {
+					check_ladder_rung(conference, imember);
+
 					if (imember->video_codec_index < 0 && (check_codec = switch_core_session_get_video_write_codec(imember->session))) {
 						for (i = 0; canvas->write_codecs[i] && switch_core_codec_ready(&canvas->write_codecs[i]->codec) && i < MAX_MUX_CODECS; i++) {
-							if (check_codec->implementation->codec_id == canvas->write_codecs[i]->codec.implementation->codec_id) {
+							if (check_codec->implementation->codec_id == canvas->write_codecs[i]->codec.implementation->codec_id &&
+								canvas->write_codecs[i]->ladder_rung == imember->video_ladder_rung) {
 								if ((zstr(imember->video_codec_group) && zstr(canvas->write_codecs[i]->video_codec_group)) || 
 									(!strcmp(switch_str_nil(imember->video_codec_group), switch_str_nil(canvas->write_codecs[i]->video_codec_group)))) {
 								
@@ -4441,7 +4598,9 @@ void *SWITCH_THREAD_FUNC conference_video_super_muxing_thread_run(switch_thread_
 								canvas->write_codecs[i]->frame.data = ((uint8_t *)canvas->write_codecs[i]->frame.packet) + 12;
 								canvas->write_codecs[i]->frame.packetlen = buflen;
 								canvas->write_codecs[i]->frame.buflen = buflen - 12;
-								if (conference->scale_h264_canvas_width > 0 && conference->scale_h264_canvas_height > 0 && !strcmp(check_codec->implementation->iananame, "H264")) {
+								if (conference->ladder_count) {
+									setup_ladder_codec(conference, canvas, canvas->write_codecs[i], imember->video_ladder_rung);
+								} else if (conference->scale_h264_canvas_width > 0 && conference->scale_h264_canvas_height > 0 && !strcmp(check_codec->implementation->iananame, "H264")) {
 									int32_t bw = -1;
 
 									canvas->write_codecs[i]->fps_divisor = conference->scale_h264_canvas_fps_divisor;
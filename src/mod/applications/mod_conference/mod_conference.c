@@ -254,6 +254,7 @@ void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, void *ob
 
 		switch_mutex_lock(conference->mutex);
 		has_file_data = ready = total = 0;
+		conference->audio_frame_count++;
 
 		floor_holder = conference->floor_holder;
 
@@ -614,7 +615,10 @@ void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, void *ob
 				if (!conference_utils_member_test_flag(omember, MFLAG_CAN_HEAR)) {
 					switch_mutex_lock(omember->audio_out_mutex);
 					memset(write_frame, 255, bytes);
-					ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes);
+					/* the enc record only follows a frame that made it into the mux buffer, or the two drift apart */
+					if ((ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes))) {
+						conference_member_write_enc_record(omember, write_frame, bytes, SWITCH_FALSE);
+					}
 					switch_mutex_unlock(omember->audio_out_mutex);
 					if (!ok) {
 						switch_mutex_unlock(conference->mutex);
@@ -669,7 +673,11 @@ void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, void *ob
 
 				if (!omember->channel || switch_channel_test_flag(omember->channel, CF_AUDIO)) {
 					switch_mutex_lock(omember->audio_out_mutex);
-					ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes);
+					/* without our own audio or relationships to take out, this is the plain mix everyone silent hears */
+					if ((ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes))) {
+						conference_member_write_enc_record(omember, write_frame, bytes,
+														   !conference_utils_member_test_flag(omember, MFLAG_HAS_AUDIO) && !conference->relationship_total);
+					}
 					switch_mutex_unlock(omember->audio_out_mutex);
 					if (!ok) {
 						switch_mutex_unlock(conference->mutex);
@@ -695,7 +703,9 @@ void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, void *ob
 				}
 
 				switch_mutex_lock(omember->audio_out_mutex);
-				ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes);
+				if ((ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes))) {
+					conference_member_write_enc_record(omember, write_frame, bytes, SWITCH_TRUE);
+				}
 				switch_mutex_unlock(omember->audio_out_mutex);
 
 				if (!ok) {
@@ -837,6 +847,12 @@ void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, void *ob
 	switch_thread_rwlock_unlock(conference->rwlock);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Write Lock OFF\n");
 
+	for (x = 0; x < (uint32_t) conference->audio_write_codecs_count; x++) {
+		if (switch_core_codec_ready(&conference->audio_write_codecs[x]->codec)) {
+			switch_core_codec_destroy(&conference->audio_write_codecs[x]->codec);
+		}
+	}
+
 	if (conference->la) {
 		switch_live_array_destroy(&conference->la);
 	}
@@ -2459,7 +2475,6 @@ SWITCH_STANDARD_APP(conference_function)
 
 	if (conference->conference_video_mode == CONF_VIDEO_MODE_MUX) {
 		conference_video_launch_muxing_write_thread(&member);
-		conference_video_launch_layer_thread(&member);
 	}
 
 	msg.from = __FILE__;
@@ -2514,18 +2529,6 @@ SWITCH_STANDARD_APP(conference_function)
 		member.video_muxing_write_thread = NULL;
 	}
 
-	if (member.video_layer_thread) {
-		switch_status_t st = SWITCH_STATUS_SUCCESS;
-
-		while(member.layer_thread_running) {
-			conference_video_wake_layer_thread(&member);
-			switch_yield(10000);
-		}
-		
-		switch_thread_join(&st, member.video_layer_thread);
-		member.video_layer_thread = NULL;
-	}
-
 	/* Remove the caller from the conference */
 	conference_member_del(member.conference, &member);
 
@@ -2548,6 +2551,7 @@ SWITCH_STANDARD_APP(conference_function)
 	switch_buffer_destroy(&member.resample_buffer);
 	switch_buffer_destroy(&member.audio_buffer);
 	switch_buffer_destroy(&member.mux_buffer);
+	switch_buffer_destroy(&member.enc_buffer);
 
 	if (member.fb) {
 		switch_frame_buffer_destroy(&member.fb);
@@ -2779,6 +2783,7 @@ conference_obj_t *conference_new(char *name, conference_xml_cfg_t cfg, switch_co
 	int scale_h264_canvas_height = 0;
 	int scale_h264_canvas_fps_divisor = 0;
 	char *scale_h264_canvas_bandwidth = NULL;
+	char *video_encode_ladder = NULL;
 	char *video_codec_config_profile_name = NULL;
 	int tmp;
 
@@ -3142,6 +3147,8 @@ conference_obj_t *conference_new(char *name, conference_xml_cfg_t cfg, switch_co
 				if (scale_h264_canvas_fps_divisor < 0) scale_h264_canvas_fps_divisor = 0;
 			} else if (!strcasecmp(var, "scale-h264-canvas-bandwidth") && !zstr(val)) {
 				scale_h264_canvas_bandwidth = val;
+			} else if (!strcasecmp(var, "video-encode-ladder") && !zstr(val)) {
+				video_encode_ladder = val;
 			} else if (!strcasecmp(var, "video-codec-config-profile-name") && !zstr(val)) {
 				video_codec_config_profile_name = val;
 			}
@@ -3409,6 +3416,16 @@ conference_obj_t *conference_new(char *name, conference_xml_cfg_t cfg, switch_co
 		conference_utils_set_cflags(conference_flags, conference->flags);
 	}
 
+	if (video_encode_ladder && conference->conference_video_mode == CONF_VIDEO_MODE_MUX) {
+		conference_video_parse_ladder(conference, video_encode_ladder);
+
+		/* the ladder only makes sense with encoders shared between members */
+		if (conference->ladder_count && !conference_utils_test_flag(conference, CFLAG_MINIMIZE_VIDEO_ENCODING)) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "video-encode-ladder enables minimize-video-encoding\n");
+			conference_utils_set_flag(conference, CFLAG_MINIMIZE_VIDEO_ENCODING);
+		}
+	}
+
 	if (!zstr(sound_prefix)) {
 		conference->sound_prefix = switch_core_strdup(conference->pool, sound_prefix);
 	} else {
@@ -4012,6 +4029,8 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_conference_shutdown)
 			switch_yield(100000);
 		}
 
+		conference_video_layer_pool_shutdown();
+
 		switch_event_unbind_callback(conference_event_pres_handler);
 		switch_event_unbind_callback(conference_data_event_handler);
 		switch_event_unbind_callback(conference_event_call_setup_handler);
@@ -67,6 +67,8 @@
 #define CONF_DBLOCK_SIZE CONF_BUFFER_SIZE
 #define CONF_DBUFFER_SIZE CONF_BUFFER_SIZE
 #define CONF_DBUFFER_MAX 0
+/* cap on a member's shared encoder records, a few seconds of packets at any interval */
+#define CONF_ENC_BUFFER_MAX CONF_BUFFER_SIZE
 #define CONF_CHAT_PROTO "conf"
 
 #ifndef MIN
@@ -255,6 +257,7 @@ typedef enum {
 	CFLAG_VIDEO_MUTE_EXIT_CANVAS,
 	CFLAG_NO_MOH,
 	CFLAG_DED_VID_LAYER_AUDIO_FLOOR,
+	CFLAG_MINIMIZE_AUDIO_ENCODING,
 	/////////////////////////////////
 	CFLAG_MAX
 } conference_flag_t;
@@ -490,6 +493,8 @@ typedef struct mcu_layer_s {
 	switch_img_fit_t logo_fit;
 	struct mcu_canvas_s *canvas;
 	int need_patch;
+	switch_time_t scale_time;
+	switch_time_t patch_time;
 	conference_member_t *member;
 	switch_frame_t bug_frame;
 	switch_frame_geometry_t last_geometry;
@@ -531,8 +536,37 @@ typedef struct codec_set_s {
 	uint8_t fps_divisor;
 	uint32_t frame_count;
 	char *video_codec_group;
+	int ladder_rung;
+	uint64_t encoded_frames;
+	uint64_t encoded_bytes;
+	switch_time_t encode_time;
+	char *encoder_key;
 } codec_set_t;
 
+/* one per mixed frame in a member's enc_buffer, followed by datalen bytes of audio encoded by set */
+typedef struct conference_enc_record_s {
+	codec_set_t *set;
+	uint32_t datalen;
+} conference_enc_record_t;
+
+#define MAX_LADDER_RUNGS 4
+
+/* one resolution of the encode ladder, kps 0 means calculated from size and fps */
+typedef struct conference_ladder_rung_s {
+	int width;
+	int height;
+	int kps;
+} conference_ladder_rung_t;
+
+
+/* per canvas frame stage totals in microseconds */
+typedef struct mcu_canvas_timing_s {
+	uint64_t frames;
+	switch_time_t wait;
+	switch_time_t scale;
+	switch_time_t patch;
+	switch_time_t encode;
+} mcu_canvas_timing_t;
 
 typedef struct mcu_canvas_s {
 	int width;
@@ -571,6 +605,9 @@ typedef struct mcu_canvas_s {
 	codec_set_t *write_codecs[MAX_MUX_CODECS];
 	int write_codecs_count;
 	switch_bool_t disable_auto_clear;
+	switch_atomic_t layer_jobs;
+	mcu_canvas_timing_t timing;
+	mcu_canvas_timing_t last_timing;
 } mcu_canvas_t;
 
 /* Record Node */
@@ -755,11 +792,16 @@ typedef struct conference_obj {
 	int scale_h264_canvas_height;
 	int scale_h264_canvas_fps_divisor;
 	char *scale_h264_canvas_bandwidth;
+	conference_ladder_rung_t ladder[MAX_LADDER_RUNGS];
+	int ladder_count;
 	uint32_t moh_wait;
 	uint32_t floor_holder_score_iir;
 	char *default_layout_name;
 	int mux_paused;
 	char *video_codec_config_profile_name;
+	codec_set_t *audio_write_codecs[MAX_MUX_CODECS];
+	int audio_write_codecs_count;
+	uint32_t audio_frame_count;
 } conference_obj_t;
 
 /* Relationship with another member */
@@ -778,7 +820,9 @@ struct conference_member {
 	switch_memory_pool_t *pool;
 	switch_buffer_t *audio_buffer;
 	switch_buffer_t *mux_buffer;
+	switch_buffer_t *enc_buffer;
 	switch_buffer_t *resample_buffer;
+	codec_set_t *audio_codec_set;
 	member_flag_t flags[MFLAG_MAX];
 	int32_t score;
 	int32_t last_score;
@@ -848,11 +892,7 @@ struct conference_member {
 	switch_queue_t *dtmf_queue;
 	switch_queue_t *video_queue;
 	switch_thread_t *video_muxing_write_thread;
-	switch_thread_t *video_layer_thread;
-	int layer_thread_running;
 	switch_thread_t *input_thread;
-	switch_thread_cond_t *layer_cond;
-	switch_mutex_t *layer_cond_mutex;
 	cJSON *json;
 	cJSON *status_field;
 	uint8_t loop_loop;
@@ -863,6 +903,7 @@ struct conference_member {
 	int watching_canvas_id;
 	int layer_timeout;
 	int video_codec_index;
+	int video_ladder_rung;
 	int video_codec_id;
 	char *video_banner_text;
 	switch_image_t *video_logo;
@@ -1083,11 +1124,15 @@ switch_status_t conference_al_parse_position(al_handle_t *al, const char *data);
 switch_status_t conference_video_thread_callback(switch_core_session_t *session, switch_frame_t *frame, void *user_data);
 switch_status_t conference_text_thread_callback(switch_core_session_t *session, switch_frame_t *frame, void *user_data);
 void *SWITCH_THREAD_FUNC conference_video_muxing_write_thread_run(switch_thread_t *thread, void *obj);
-void conference_video_launch_layer_thread(conference_member_t *member);
-void conference_video_wake_layer_thread(conference_member_t *member);
+void conference_video_layer_pool_start(void);
+void conference_video_parse_ladder(conference_obj_t *conference, const char *str);
+int conference_video_ladder_rung_kps(conference_obj_t *conference, int rung);
+void conference_video_layer_pool_shutdown(void);
 
 int conference_member_noise_gate_check(conference_member_t *member);
 void conference_member_check_channels(switch_frame_t *frame, conference_member_t *member, switch_bool_t in);
+void conference_member_bind_audio_codec(conference_member_t *member, uint32_t bytes);
+void conference_member_write_enc_record(conference_member_t *member, int16_t *data, uint32_t bytes, switch_bool_t shared);
 
 void conference_fnode_toggle_pause(conference_file_node_t *fnode, switch_stream_handle_t *stream);
 void conference_fnode_check_status(conference_file_node_t *fnode, switch_stream_handle_t *stream);
@@ -1231,6 +1276,8 @@ switch_status_t conference_api_sub_vid_mute_img(conference_member_t *member, swi
 switch_status_t conference_api_sub_vid_codec_group(conference_member_t *member, switch_stream_handle_t *stream, void *data);
 switch_status_t conference_api_sub_vid_logo_img(conference_member_t *member, switch_stream_handle_t *stream, void *data);
 switch_status_t conference_api_sub_vid_fps(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
+switch_status_t conference_api_sub_vid_ladder(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
+switch_status_t conference_api_sub_vid_timing(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
 switch_status_t conference_api_sub_vid_res(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
 switch_status_t conference_api_sub_canvas_fgimg(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
 switch_status_t conference_api_sub_canvas_bgimg(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv);
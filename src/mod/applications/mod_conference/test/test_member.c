@@ -92,6 +92,92 @@ FST_CORE_BEGIN("./conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(member_shared_encoder)
+		{
+			conference_obj_t conference = { 0 };
+			conference_member_t members[2] = { { 0 } };
+			codec_set_t set = { 0 };
+			conference_enc_record_t rec;
+			int16_t data[160] = { 0 };
+			uint32_t bytes = sizeof(data);
+			int i;
+
+			conference.rate = 8000;
+			conference.audio_frame_count = 1;
+			set.packet = switch_core_alloc(fst_pool, SWITCH_RECOMMENDED_BUFFER_SIZE);
+			fst_requires(switch_core_codec_init(&set.codec, "PCMU", NULL, NULL, 8000, 20, 1,
+												SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE, NULL, fst_pool) == SWITCH_STATUS_SUCCESS);
+
+			for (i = 0; i < 2; i++) {
+				members[i].conference = &conference;
+				members[i].audio_codec_set = &set;
+				fst_requires(switch_buffer_create_dynamic(&members[i].enc_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_ENC_BUFFER_MAX) == SWITCH_STATUS_SUCCESS);
+			}
+
+			/* both members hear the plain mix of the same frame, it is encoded once */
+			conference_member_write_enc_record(&members[0], data, bytes, SWITCH_TRUE);
+			conference_member_write_enc_record(&members[1], data, bytes, SWITCH_TRUE);
+			fst_check_int_equals(set.encoded_frames, 1);
+
+			for (i = 0; i < 2; i++) {
+				fst_check(switch_buffer_read(members[i].enc_buffer, &rec, sizeof(rec)) == sizeof(rec));
+				fst_check(rec.set == &set);
+				fst_check_int_equals(rec.datalen, 160);
+				fst_check(switch_buffer_toss(members[i].enc_buffer, rec.datalen) == rec.datalen);
+			}
+
+			/* the next frame is encoded again, a frame that is not the plain mix gets an empty record */
+			conference.audio_frame_count++;
+			conference_member_write_enc_record(&members[0], data, bytes, SWITCH_TRUE);
+			conference_member_write_enc_record(&members[1], data, bytes, SWITCH_FALSE);
+			fst_check_int_equals(set.encoded_frames, 2);
+			fst_check(switch_buffer_read(members[1].enc_buffer, &rec, sizeof(rec)) == sizeof(rec));
+			fst_check(rec.set == NULL);
+			fst_check_int_equals(rec.datalen, 0);
+
+			for (i = 0; i < 2; i++) {
+				switch_buffer_destroy(&members[i].enc_buffer);
+			}
+			switch_core_codec_destroy(&set.codec);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(member_shared_encoder_full_buffer)
+		{
+			conference_obj_t conference = { 0 };
+			conference_member_t smember = { 0 };
+			conference_member_t *member = &smember;
+			codec_set_t set = { 0 };
+			int16_t data[160] = { 0 };
+			uint32_t bytes = sizeof(data), rec_len = sizeof(conference_enc_record_t) + 160;
+			int i;
+
+			conference.rate = 8000;
+			set.packet = switch_core_alloc(fst_pool, SWITCH_RECOMMENDED_BUFFER_SIZE);
+			fst_requires(switch_core_codec_init(&set.codec, "PCMU", NULL, NULL, 8000, 20, 1,
+												SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE, NULL, fst_pool) == SWITCH_STATUS_SUCCESS);
+
+			member->conference = &conference;
+			member->audio_codec_set = &set;
+			fst_requires(switch_buffer_create_dynamic(&member->mux_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_DBUFFER_MAX) == SWITCH_STATUS_SUCCESS);
+			fst_requires(switch_buffer_create_dynamic(&member->enc_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_ENC_BUFFER_MAX) == SWITCH_STATUS_SUCCESS);
+
+			/* nobody reads: once the enc buffer is full both buffers must still hold one record per mixed frame */
+			for (i = 0; i < (int) (CONF_ENC_BUFFER_MAX / rec_len) * 2; i++) {
+				conference.audio_frame_count++;
+				fst_requires(switch_buffer_write(member->mux_buffer, data, bytes));
+				conference_member_write_enc_record(member, data, bytes, SWITCH_TRUE);
+				fst_requires(switch_buffer_inuse(member->mux_buffer) / bytes == switch_buffer_inuse(member->enc_buffer) / rec_len);
+			}
+
+			fst_check(switch_buffer_inuse(member->enc_buffer) <= CONF_ENC_BUFFER_MAX);
+
+			switch_buffer_destroy(&member->mux_buffer);
+			switch_buffer_destroy(&member->enc_buffer);
+			switch_core_codec_destroy(&set.codec);
+		}
+		FST_TEST_END()
+
 	}
 	FST_SUITE_END()
 }
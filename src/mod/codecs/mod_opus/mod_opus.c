@@ -142,6 +142,7 @@ struct opus_context {
 	dec_stats_t decoder_stats;
 	enc_stats_t encoder_stats;
 	codec_control_state_t control_state;
+	char encoder_key[128];
 };
 
 struct {
@@ -1177,6 +1178,22 @@ static switch_status_t switch_opus_control(switch_codec_t *codec,
 						context->use_jb_lookahead = switch_true(arg);
 					}
 					reply = context->use_jb_lookahead ? "LOOKAHEAD ON" : "LOOKAHEAD OFF";
+				} else if (!strcasecmp(command, "encoder_key") && context->encoder_object) {
+					/* two encoders with the same key turn identical input into identical packets */
+					opus_int32 bitrate = 0, fec = 0, dtx = 0, vbr = 0, complexity = 0, plpct = 0, max_bw = 0;
+
+					opus_encoder_ctl(context->encoder_object, OPUS_GET_BITRATE(&bitrate));
+					opus_encoder_ctl(context->encoder_object, OPUS_GET_INBAND_FEC(&fec));
+					opus_encoder_ctl(context->encoder_object, OPUS_GET_DTX(&dtx));
+					opus_encoder_ctl(context->encoder_object, OPUS_GET_VBR(&vbr));
+					opus_encoder_ctl(context->encoder_object, OPUS_GET_COMPLEXITY(&complexity));
+					opus_encoder_ctl(context->encoder_object, OPUS_GET_PACKET_LOSS_PERC(&plpct));
+					opus_encoder_ctl(context->encoder_object, OPUS_GET_MAX_BANDWIDTH(&max_bw));
+
+					switch_snprintf(context->encoder_key, sizeof(context->encoder_key), "opus/%d/%d/%d/%d/%d/%d/%d/%d/%d/%d",
+									codec->implementation->actual_samples_per_second, codec->implementation->number_of_channels,
+									codec->implementation->microseconds_per_packet / 1000, bitrate, fec, dtx, vbr, complexity, plpct, max_bw);
+					reply = context->encoder_key;
 				}
 			}
 
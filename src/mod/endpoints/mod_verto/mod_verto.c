@@ -47,6 +47,9 @@ SWITCH_MODULE_DEFINITION(mod_verto, mod_verto_load, mod_verto_shutdown, mod_vert
 
 //////////////////////////
 #include <mod_verto.h>
+#ifdef VERTO_HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
 #ifndef WIN32
 #include <sys/param.h>
 #endif
@@ -1863,6 +1866,47 @@ error:
 	return;
 }
 
+static void jsock_speed_test_reply(jsock_t *jsock, int size, switch_time_t a, switch_time_t b)
+{
+	char repl[2048] = "";
+	int i, j, loops, rem, dur = 0;
+
+	switch_snprintf(repl, sizeof(repl), "#SPU %ld", (long)((b - a) / 1000));
+	switch_mutex_lock(jsock->write_mutex);
+	ws_write_frame(&jsock->ws, WSOC_TEXT, repl, strlen(repl));
+	switch_mutex_unlock(jsock->write_mutex);
+	loops = size / 1024;
+	rem = size % 1024;
+	switch_snprintf(repl, sizeof(repl), "#SPB ");
+	memset(repl+4, '.', 1024);
+
+	for (j = 0; j < 10 ; j++) {
+		int ddur = 0;
+		a = switch_time_now();
+		for (i = 0; i < loops; i++) {
+			switch_mutex_lock(jsock->write_mutex);
+			ws_write_frame(&jsock->ws, WSOC_TEXT, repl, 1024);
+			switch_mutex_unlock(jsock->write_mutex);
+		}
+		if (rem) {
+			switch_mutex_lock(jsock->write_mutex);
+			ws_write_frame(&jsock->ws, WSOC_TEXT, repl, rem);
+			switch_mutex_unlock(jsock->write_mutex);
+		}
+		b = switch_time_now();
+		ddur += (int)((b - a) / 1000);
+		dur += ddur;
+
+	}
+
+	dur /= j+1;
+
+	switch_snprintf(repl, sizeof(repl), "#SPD %d", dur);
+	switch_mutex_lock(jsock->write_mutex);
+	ws_write_frame(&jsock->ws, WSOC_TEXT, repl, strlen(repl));
+	switch_mutex_unlock(jsock->write_mutex);
+}
+
 static void client_run(jsock_t *jsock)
 {
 	if (ws_init(&jsock->ws, jsock->client_socket, (jsock->ptype & PTYPE_CLIENT_SSL) ? jsock->profile->ssl_ctx : NULL, 0, 1, !!jsock->profile->vhosts) < 0) {
@@ -1909,17 +1953,13 @@ static void client_run(jsock_t *jsock)
 				char *s = (char *) data;
 
 				if (*s == '#') {
-					char repl[2048] = "";
 					switch_time_t a, b;
 
 					if (s[1] == 'S' && s[2] == 'P') {
 
 						if (s[3] == 'U') {
-							int i, size = 0;
+							int size = 0;
 							char *p = s+4;
-							int loops = 0;
-							int rem = 0;
-							int dur = 0, j = 0;
 
 							if ((size = atoi(p)) <= 0) {
 								continue;
@@ -1936,32 +1976,7 @@ static void client_run(jsock_t *jsock)
 
 							if (s[0] != '#') goto nm;
 
-							switch_snprintf(repl, sizeof(repl), "#SPU %ld", (long)((b - a) / 1000));
-							ws_write_frame(&jsock->ws, WSOC_TEXT, repl, strlen(repl));
-							loops = size / 1024;
-							rem = size % 1024;
-							switch_snprintf(repl, sizeof(repl), "#SPB ");
-							memset(repl+4, '.', 1024);
-
-							for (j = 0; j < 10 ; j++) {
-								int ddur = 0;
-								a = switch_time_now();
-								for (i = 0; i < loops; i++) {
-									ws_write_frame(&jsock->ws, WSOC_TEXT, repl, 1024);
-								}
-								if (rem) {
-									ws_write_frame(&jsock->ws, WSOC_TEXT, repl, rem);
-								}
-								b = switch_time_now();
-								ddur += (int)((b - a) / 1000);
-								dur += ddur;
-
-							}
-
-							dur /= j+1;
-
-							switch_snprintf(repl, sizeof(repl), "#SPD %d", dur);
-							ws_write_frame(&jsock->ws, WSOC_TEXT, repl, strlen(repl));
+							jsock_speed_test_reply(jsock, size, a, b);
 						}
 					}
 
@@ -2002,26 +2017,19 @@ static void jsock_flush(jsock_t *jsock)
 	switch_mutex_unlock(jsock->write_mutex);
 }
 
-static void *SWITCH_THREAD_FUNC client_thread(switch_thread_t *thread, void *obj)
+static void jsock_setup(jsock_t *jsock)
 {
-	switch_event_t *s_event;
-
-	jsock_t *jsock = (jsock_t *) obj;
-
 	switch_event_create(&jsock->params, SWITCH_EVENT_CHANNEL_DATA);
 	switch_event_create(&jsock->vars, SWITCH_EVENT_CHANNEL_DATA);
 	switch_event_create(&jsock->user_vars, SWITCH_EVENT_CHANNEL_DATA);
 
 
 	add_jsock(jsock);
+}
 
-    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s Starting client thread.\n", jsock->name);
-
-	if ((jsock->ptype & PTYPE_CLIENT) || (jsock->ptype & PTYPE_CLIENT_SSL)) {
-		client_run(jsock);
-	} else {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s Ending client thread.\n", jsock->name);
-	}
+static void jsock_teardown(jsock_t *jsock)
+{
+	switch_event_t *s_event;
 
 	detach_calls(jsock);
 
@@ -2052,10 +2060,592 @@ static void *SWITCH_THREAD_FUNC client_thread(switch_thread_t *thread, void *obj
 	switch_thread_rwlock_wrlock(jsock->rwlock);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s Thread ended\n", jsock->name);
 	switch_thread_rwlock_unlock(jsock->rwlock);
+}
+
+static void *SWITCH_THREAD_FUNC client_thread(switch_thread_t *thread, void *obj)
+{
+	jsock_t *jsock = (jsock_t *) obj;
+
+	jsock_setup(jsock);
+
+    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s Starting client thread.\n", jsock->name);
+
+	if ((jsock->ptype & PTYPE_CLIENT) || (jsock->ptype & PTYPE_CLIENT_SSL)) {
+		client_run(jsock);
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s Ending client thread.\n", jsock->name);
+	}
+
+	jsock_teardown(jsock);
+
+	return NULL;
+}
+
+/*
+ * Event driven connection handling (io-threads > 0).
+ *
+ * Instead of one thread per connection, every socket is registered with one of a few epoll loops.
+ * The loop threads do the TLS and WebSocket handshakes and the frame parsing without ever blocking,
+ * and only hand complete messages to a small pool of workers.  A connection is serviced by at most
+ * one worker at a time (io_scheduled) so its messages are still processed in order, exactly like the
+ * dedicated client thread would.  Plain HTTP requests on vhost enabled profiles are short lived and
+ * are handed off to a regular thread running http_run().
+ */
+
+#ifdef VERTO_HAVE_EPOLL
+
+static void jsock_io_schedule(jsock_t *jsock)
+{
+	if (!switch_atomic_cas(&jsock->io_scheduled, 1, 0)) {
+		switch_queue_push(verto_globals.io_work_queue, jsock);
+	}
+}
+
+static void jsock_io_destroy(jsock_t *jsock)
+{
+	switch_memory_pool_t *pool = jsock->pool;
+	void *pop;
+
+	detach_jsock(jsock);
+	ws_destroy(&jsock->ws);
+
+	jsock_teardown(jsock);
+
+	while (switch_queue_trypop(jsock->input_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		free(pop);
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+}
+
+static void jsock_io_dispatch(jsock_t *jsock, char *s)
+{
+	if (jsock->spu_size > 0) {
+		/* upload leg of a speed test, see client_run() */
+		if (s[0] == '#' && s[1] && s[2] && s[3] == 'B') {
+			return;
+		}
+
+		if (s[0] == '#') {
+			jsock_speed_test_reply(jsock, jsock->spu_size, jsock->spu_start, switch_time_now());
+			jsock->spu_size = 0;
+			return;
+		}
+
+		jsock->spu_size = 0;
+	} else if (*s == '#') {
+		if (s[1] == 'S' && s[2] == 'P' && s[3] == 'U') {
+			if ((jsock->spu_size = atoi(s + 4)) > 0) {
+				jsock->spu_start = switch_time_now();
+			}
+		}
+
+		return;
+	}
+
+	if (process_input(jsock, (uint8_t *) s, strlen(s)) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s Input Error\n", jsock->name);
+		jsock->drop = 1;
+		return;
+	}
+
+	if (!switch_test_flag(jsock, JPFLAG_CHECK_ATTACH) && switch_test_flag(jsock, JPFLAG_AUTHED)) {
+		attach_calls(jsock);
+		switch_set_flag(jsock, JPFLAG_CHECK_ATTACH);
+	}
+}
+
+static void jsock_io_service(jsock_t *jsock)
+{
+	void *pop;
+
+	for (;;) {
+		while (switch_queue_trypop(jsock->input_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			char *s = (char *) pop;
+
+			if (!jsock->drop) {
+				jsock_io_dispatch(jsock, s);
+			}
+
+			free(s);
+		}
+
+		if (jsock->io_closed) {
+			/* the loop thread gave the connection up, nothing else references it now */
+			jsock_io_destroy(jsock);
+			return;
+		}
+
+		if (jsock->ws.pong_pending) {
+			switch_mutex_lock(jsock->write_mutex);
+			ws_flush_pong(&jsock->ws);
+			switch_mutex_unlock(jsock->write_mutex);
+		}
+
+		jsock_check_event_queue(jsock);
+
+		switch_atomic_cas(&jsock->io_scheduled, 0, 1);
+
+		if ((switch_queue_size(jsock->input_queue) || jsock->io_closed) && !switch_atomic_cas(&jsock->io_scheduled, 1, 0)) {
+			continue;
+		}
+
+		break;
+	}
+}
+
+static void *SWITCH_THREAD_FUNC jsock_io_worker(switch_thread_t *thread, void *obj)
+{
+	void *pop;
+
+	while (switch_queue_pop(verto_globals.io_work_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		if (!pop) {
+			break;
+		}
+
+		jsock_io_service((jsock_t *) pop);
+	}
+
+	return NULL;
+}
+
+static void *SWITCH_THREAD_FUNC jsock_http_thread(switch_thread_t *thread, void *obj)
+{
+	jsock_t *jsock = (jsock_t *) obj;
+
+	jsock->ws.block = 1;
+	http_run(jsock);
+	ws_close(&jsock->ws, WS_NONE);
+
+	detach_jsock(jsock);
+	ws_destroy(&jsock->ws);
+
+	jsock_teardown(jsock);
 
 	return NULL;
 }
 
+static void jsock_http_launch(jsock_t *jsock)
+{
+	switch_thread_data_t *td;
+
+	td = switch_core_alloc(jsock->pool, sizeof(*td));
+
+	td->alloc = 0;
+	td->func = jsock_http_thread;
+	td->obj = jsock;
+	td->pool = jsock->pool;
+
+	switch_thread_pool_launch_thread(&td);
+}
+
+static void jsock_io_unlink(jsock_io_loop_t *loop, jsock_t *jsock)
+{
+	jsock_t *p, *last = NULL;
+
+	if (jsock->ws.sock != ws_sock_invalid) {
+		epoll_ctl(loop->efd, EPOLL_CTL_DEL, jsock->ws.sock, NULL);
+	}
+
+	if (jsock->io_deferred) {
+		for (p = loop->deferred; p; p = p->io_defer_next) {
+			if (p == jsock) {
+				if (last) {
+					last->io_defer_next = p->io_defer_next;
+				} else {
+					loop->deferred = p->io_defer_next;
+				}
+				break;
+			}
+
+			last = p;
+		}
+
+		jsock->io_deferred = 0;
+		jsock->io_defer_next = NULL;
+		last = NULL;
+	}
+
+	switch_mutex_lock(loop->mutex);
+	for (p = loop->head; p; p = p->io_next) {
+		if (p == jsock) {
+			if (last) {
+				last->io_next = p->io_next;
+			} else {
+				loop->head = p->io_next;
+			}
+			loop->count--;
+			break;
+		}
+
+		last = p;
+	}
+	switch_mutex_unlock(loop->mutex);
+
+	jsock->io_next = NULL;
+}
+
+static void jsock_io_close(jsock_io_loop_t *loop, jsock_t *jsock)
+{
+	jsock_io_unlink(loop, jsock);
+	jsock->io_closed = 1;
+	jsock_io_schedule(jsock);
+}
+
+static void jsock_io_read(jsock_io_loop_t *loop, jsock_t *jsock)
+{
+	for (;;) {
+		switch_ssize_t bytes;
+		ws_opcode_t oc;
+		uint8_t *data;
+		char *msg = NULL;
+
+		if (switch_queue_size(jsock->input_queue) >= MAX_INPUT_QUEUE_LEN - 1) {
+			/* the worker is behind, stop reading until it catches up */
+			struct epoll_event e = { 0 };
+
+			e.data.ptr = jsock;
+			epoll_ctl(loop->efd, EPOLL_CTL_MOD, jsock->ws.sock, &e);
+			jsock->io_paused = 1;
+			return;
+		}
+
+		/* writers can stall on a slow peer, never wait for them here: park the socket and retry shortly */
+		if (switch_mutex_trylock(jsock->write_mutex) != SWITCH_STATUS_SUCCESS) {
+			struct epoll_event e = { 0 };
+
+			e.data.ptr = jsock;
+			epoll_ctl(loop->efd, EPOLL_CTL_MOD, jsock->ws.sock, &e);
+
+			if (!jsock->io_deferred) {
+				jsock->io_deferred = 1;
+				jsock->io_defer_next = loop->deferred;
+				loop->deferred = jsock;
+			}
+			return;
+		}
+
+		jsock->ws.nb_write = 1;
+		bytes = ws_read_frame_nb(&jsock->ws, &oc, &data);
+		jsock->ws.nb_write = 0;
+
+		if (bytes > 0 && data) {
+			switch_malloc(msg, bytes + 1);
+			memcpy(msg, data, bytes + 1);
+		}
+		switch_mutex_unlock(jsock->write_mutex);
+
+		if (jsock->ws.pong_pending) {
+			jsock_io_schedule(jsock);
+		}
+
+		if (bytes == -2) {
+			return;
+		}
+
+		if (bytes < 0) {
+			if (!jsock->ws.handshake && jsock->profile->vhosts) {
+				jsock_io_unlink(loop, jsock);
+				jsock_http_launch(jsock);
+				return;
+			}
+
+			if (bytes == -WS_RECV_CLOSE) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "%s Client sent close request\n", jsock->name);
+			} else if (!jsock->ws.handshake) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "%s WS SETUP FAILED\n", jsock->name);
+			} else {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s BAD READ %" SWITCH_SSIZE_T_FMT "\n", jsock->name, bytes);
+			}
+
+			jsock_io_close(loop, jsock);
+			return;
+		}
+
+		if (msg) {
+			switch_queue_push(jsock->input_queue, msg);
+			jsock_io_schedule(jsock);
+		}
+	}
+}
+
+static void jsock_io_retry_deferred(jsock_io_loop_t *loop)
+{
+	jsock_t *jsock, *next;
+
+	jsock = loop->deferred;
+	loop->deferred = NULL;
+
+	for (; jsock; jsock = next) {
+		next = jsock->io_defer_next;
+		jsock->io_defer_next = NULL;
+		jsock->io_deferred = 0;
+
+		if (jsock->io_closed) {
+			continue;
+		}
+
+		if (!jsock->io_paused) {
+			struct epoll_event e = { 0 };
+
+			e.events = EPOLLIN | EPOLLRDHUP;
+			e.data.ptr = jsock;
+			epoll_ctl(loop->efd, EPOLL_CTL_MOD, jsock->ws.sock, &e);
+		}
+
+		jsock_io_read(loop, jsock);
+	}
+}
+
+static void jsock_io_sweep(jsock_io_loop_t *loop)
+{
+	jsock_t *jsock, *next;
+	switch_time_t now = switch_micro_time_now();
+
+	switch_mutex_lock(loop->mutex);
+	for (jsock = loop->head; jsock; jsock = next) {
+		next = jsock->io_next;
+
+		if (jsock->drop || !jsock->profile->running || !verto_globals.io_running) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s Dropping Connection\n", jsock->name);
+			jsock_io_close(loop, jsock);
+			continue;
+		}
+
+		if (!jsock->ws.handshake && now - jsock->io_start > IO_HANDSHAKE_TIMEOUT) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "%s WS handshake timeout\n", jsock->name);
+			jsock_io_close(loop, jsock);
+			continue;
+		}
+
+		if (jsock->io_deferred) {
+			continue;
+		}
+
+		if (jsock->io_paused && switch_queue_size(jsock->input_queue) < MAX_INPUT_QUEUE_LEN / 2) {
+			struct epoll_event e = { 0 };
+
+			e.events = EPOLLIN | EPOLLRDHUP;
+			e.data.ptr = jsock;
+			epoll_ctl(loop->efd, EPOLL_CTL_MOD, jsock->ws.sock, &e);
+			jsock->io_paused = 0;
+
+			/* frames may already be waiting in our own or the SSL buffers */
+			jsock_io_read(loop, jsock);
+			continue;
+		}
+
+		if (switch_queue_size(jsock->event_queue)) {
+			jsock_io_schedule(jsock);
+		}
+	}
+	switch_mutex_unlock(loop->mutex);
+}
+
+static void *SWITCH_THREAD_FUNC jsock_io_thread(switch_thread_t *thread, void *obj)
+{
+	jsock_io_loop_t *loop = (jsock_io_loop_t *) obj;
+	struct epoll_event events[128];
+	switch_time_t last_sweep = 0;
+
+	while (verto_globals.io_running) {
+		switch_time_t now;
+		int i, n;
+
+		n = epoll_wait(loop->efd, events, sizeof(events) / sizeof(events[0]), loop->deferred ? 2 : 50);
+
+		if (n < 0 && errno != EINTR) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "I/O thread %d epoll_wait failed: %s\n", loop->idx, strerror(errno));
+			switch_yield(100000);
+		}
+
+		for (i = 0; i < n; i++) {
+			jsock_t *jsock = (jsock_t *) events[i].data.ptr;
+
+			if (jsock->io_closed) {
+				continue;
+			}
+
+			if ((events[i].events & (EPOLLERR | EPOLLHUP)) && !(events[i].events & EPOLLIN)) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "%s POLL HANGUP DETECTED (peer closed its end of socket)\n", jsock->name);
+				jsock_io_close(loop, jsock);
+				continue;
+			}
+
+			/* EPOLLRDHUP with data still pending is drained here, the read then reports the close */
+			jsock_io_read(loop, jsock);
+		}
+
+		if (loop->deferred) {
+			jsock_io_retry_deferred(loop);
+		}
+
+		now = switch_micro_time_now();
+
+		if (now - last_sweep >= 50000) {
+			jsock_io_sweep(loop);
+			last_sweep = now;
+		}
+	}
+
+	/* anything still registered is closed, the workers are stopped after us */
+	jsock_io_sweep(loop);
+
+	return NULL;
+}
+
+static switch_status_t jsock_io_add(jsock_t *jsock)
+{
+	jsock_io_loop_t *loop;
+	struct epoll_event e = { 0 };
+	uint32_t idx;
+
+	switch_queue_create(&jsock->input_queue, MAX_INPUT_QUEUE_LEN, jsock->pool);
+
+	jsock_setup(jsock);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s Starting event driven client.\n", jsock->name);
+
+	if (ws_init(&jsock->ws, jsock->client_socket, (jsock->ptype & PTYPE_CLIENT_SSL) ? jsock->profile->ssl_ctx : NULL, 0, 0, !!jsock->profile->vhosts) < 0) {
+		if (jsock->profile->vhosts) {
+			jsock_http_launch(jsock);
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "%s WS SETUP FAILED\n", jsock->name);
+			jsock->io_closed = 1;
+			jsock_io_schedule(jsock);
+		}
+
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	idx = switch_atomic_read(&verto_globals.io_next_loop);
+	switch_atomic_inc(&verto_globals.io_next_loop);
+	loop = &verto_globals.io_loops[idx % verto_globals.io_threads];
+
+	jsock->io_loop = loop;
+	jsock->io_start = switch_micro_time_now();
+
+	switch_mutex_lock(loop->mutex);
+	jsock->io_next = loop->head;
+	loop->head = jsock;
+	loop->count++;
+
+	e.events = EPOLLIN | EPOLLRDHUP;
+	e.data.ptr = jsock;
+
+	if (epoll_ctl(loop->efd, EPOLL_CTL_ADD, jsock->ws.sock, &e) < 0) {
+		switch_mutex_unlock(loop->mutex);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s Cannot add socket to I/O thread %d: %s\n", jsock->name, loop->idx, strerror(errno));
+		jsock_io_close(loop, jsock);
+		return SWITCH_STATUS_SUCCESS;
+	}
+	switch_mutex_unlock(loop->mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void jsock_io_start(void)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	int i;
+
+	if (verto_globals.io_threads <= 0) {
+		return;
+	}
+
+	verto_globals.io_loops = switch_core_alloc(verto_globals.pool, sizeof(jsock_io_loop_t) * verto_globals.io_threads);
+	verto_globals.io_worker_threads = switch_core_alloc(verto_globals.pool, sizeof(switch_thread_t *) * verto_globals.io_workers);
+	switch_queue_create(&verto_globals.io_work_queue, MAX_QUEUE_LEN, verto_globals.pool);
+
+	verto_globals.io_running = 1;
+
+	switch_threadattr_create(&thd_attr, verto_globals.pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	for (i = 0; i < verto_globals.io_threads; i++) {
+		jsock_io_loop_t *loop = &verto_globals.io_loops[i];
+
+		loop->idx = i;
+
+		if ((loop->efd = epoll_create(1024)) < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create epoll descriptor: %s\n", strerror(errno));
+			verto_globals.io_threads = i;
+			break;
+		}
+
+		switch_mutex_init(&loop->mutex, SWITCH_MUTEX_NESTED, verto_globals.pool);
+		switch_thread_create(&loop->thread, thd_attr, jsock_io_thread, loop, verto_globals.pool);
+	}
+
+	for (i = 0; i < verto_globals.io_workers; i++) {
+		switch_thread_create(&verto_globals.io_worker_threads[i], thd_attr, jsock_io_worker, NULL, verto_globals.pool);
+	}
+
+	if (!verto_globals.io_threads) {
+		verto_globals.io_running = 0;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Serving WebSocket clients from %d I/O threads and %d workers\n",
+					  verto_globals.io_threads, verto_globals.io_workers);
+}
+
+static void jsock_io_stop(void)
+{
+	switch_status_t st;
+	int i;
+
+	if (!verto_globals.io_loops) {
+		return;
+	}
+
+	verto_globals.io_running = 0;
+
+	for (i = 0; i < verto_globals.io_threads; i++) {
+		jsock_io_loop_t *loop = &verto_globals.io_loops[i];
+
+		if (loop->thread) {
+			switch_thread_join(&st, loop->thread);
+		}
+
+		if (loop->efd >= 0) {
+			close(loop->efd);
+		}
+	}
+
+	for (i = 0; i < verto_globals.io_workers; i++) {
+		switch_queue_push(verto_globals.io_work_queue, NULL);
+	}
+
+	for (i = 0; i < verto_globals.io_workers; i++) {
+		if (verto_globals.io_worker_threads[i]) {
+			switch_thread_join(&st, verto_globals.io_worker_threads[i]);
+		}
+	}
+
+	verto_globals.io_loops = NULL;
+}
+
+#else
+
+static switch_status_t jsock_io_add(jsock_t *jsock)
+{
+	return SWITCH_STATUS_FALSE;
+}
+
+static void jsock_io_start(void)
+{
+	if (verto_globals.io_threads > 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "io-threads is not supported on this platform, using a thread per client\n");
+		verto_globals.io_threads = 0;
+	}
+}
+
+static void jsock_io_stop(void)
+{
+}
+
+#endif
+
 
 static switch_bool_t auth_api_command(jsock_t *jsock, const char *api_cmd, const char *arg)
 {
@@ -4305,6 +4895,11 @@ static int start_jsock(verto_profile_t *profile, ws_socket_t sock, int family)
 	switch_mutex_init(&jsock->filter_mutex, SWITCH_MUTEX_NESTED, jsock->pool);
 	switch_queue_create(&jsock->event_queue, MAX_QUEUE_LEN, jsock->pool);
 	switch_thread_rwlock_create(&jsock->rwlock, jsock->pool);
+
+	if (verto_globals.io_running && jsock_io_add(jsock) == SWITCH_STATUS_SUCCESS) {
+		return 0;
+	}
+
 	switch_thread_pool_launch_thread(&td);
 
 	return 0;
@@ -4996,6 +5591,20 @@ static switch_status_t parse_config(const char *cf)
 				if (tmp > 0) {
 					verto_globals.detach_timeout = tmp;
 				}
+			} else if (!strcasecmp(var, "io-threads") && val) {
+				int tmp = atoi(val);
+				if (tmp >= 0 && tmp <= VERTO_MAX_IO_THREADS) {
+					verto_globals.io_threads = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "io-threads must be between 0 and %d\n", VERTO_MAX_IO_THREADS);
+				}
+			} else if (!strcasecmp(var, "io-worker-threads") && val) {
+				int tmp = atoi(val);
+				if (tmp > 0 && tmp <= VERTO_MAX_IO_WORKERS) {
+					verto_globals.io_workers = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "io-worker-threads must be between 1 and %d\n", VERTO_MAX_IO_WORKERS);
+				}
 			}
 		}
 	}
@@ -5019,6 +5628,8 @@ static int init(void)
 
 	verto_globals.running = 1;
 
+	jsock_io_start();
+
 	return 0;
 }
 
@@ -5087,6 +5698,15 @@ static switch_status_t cmd_status(char **argv, int argc, switch_stream_handle_t
 	stream->write_function(stream, "%s\n", line);
 	stream->write_function(stream, "%d profile%s , %d client%s\n", cp, cp == 1 ? "" : "s", cc, cc == 1 ? "" : "s");
 
+	if (verto_globals.io_running) {
+		stream->write_function(stream, "%d I/O thread%s (clients:", verto_globals.io_threads, verto_globals.io_threads == 1 ? "" : "s");
+		for (i = 0; i < verto_globals.io_threads; i++) {
+			stream->write_function(stream, " %u", verto_globals.io_loops[i].count);
+		}
+		stream->write_function(stream, "), %d worker%s, %u pending\n", verto_globals.io_workers, verto_globals.io_workers == 1 ? "" : "s",
+							   switch_queue_size(verto_globals.io_work_queue));
+	}
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -6172,6 +6792,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_verto_load)
 	switch_mutex_init(&verto_globals.detach2_mutex, SWITCH_MUTEX_NESTED, verto_globals.pool);
 	switch_thread_cond_create(&verto_globals.detach_cond, verto_globals.pool);
 	verto_globals.detach_timeout = 120;
+	verto_globals.io_workers = 16;
 
 
 
@@ -6251,6 +6872,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_verto_shutdown)
 
 	switch_core_unregister_secondary_recover_callback(modname);
 	do_shutdown();
+	jsock_io_stop();
 	attach_wake();
 	attach_wake();
 
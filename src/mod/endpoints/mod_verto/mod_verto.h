@@ -64,6 +64,14 @@
 
 #define MAX_QUEUE_LEN 100000
 #define MAX_MISSED 500
+#define MAX_INPUT_QUEUE_LEN 256
+#define IO_HANDSHAKE_TIMEOUT 10000000
+
+#if defined(__linux__)
+#define VERTO_HAVE_EPOLL 1
+#endif
+#define VERTO_MAX_IO_THREADS 64
+#define VERTO_MAX_IO_WORKERS 256
 
 #define MAXPENDING 10000
 #define STACK_SIZE 80 * 1024
@@ -97,13 +105,13 @@ typedef enum {
 } jpflag_t;
 
 struct verto_profile_s;
+struct jsock_io_loop_s;
 
 struct jsock_s {
 	ws_socket_t client_socket;
 	switch_memory_pool_t *pool;
 	switch_thread_t *thread;
 	wsh_t ws;
-	unsigned char buf[65535];
 	char *name;
 	jsock_type_t ptype;
 	struct sockaddr_in remote_addr;
@@ -152,11 +160,36 @@ struct jsock_s {
 	int lost_events;
 	int ready;
 
+	/* set when the connection is served by the shared I/O threads instead of its own thread */
+	struct jsock_io_loop_s *io_loop;
+	struct jsock_s *io_next;
+	switch_queue_t *input_queue;
+	switch_atomic_t io_scheduled;
+	uint8_t io_closed;
+	uint8_t io_paused;
+	/* the socket was busy writing when it became readable, retried by the loop thread */
+	uint8_t io_deferred;
+	struct jsock_s *io_defer_next;
+	switch_time_t io_start;
+	int spu_size;
+	switch_time_t spu_start;
+
 	struct jsock_s *next;
 };
 
 typedef struct jsock_s jsock_t;
 
+typedef struct jsock_io_loop_s {
+	int efd;
+	int idx;
+	switch_thread_t *thread;
+	switch_mutex_t *mutex;
+	jsock_t *head;
+	uint32_t count;
+	/* only touched by the loop thread */
+	jsock_t *deferred;
+} jsock_io_loop_t;
+
 #define MAX_BIND 25
 #define MAX_RTPIP 25
 
@@ -322,6 +355,14 @@ struct globals_s {
 	uint32_t detach_timeout;
 
 	switch_event_channel_id_t event_channel_id;
+
+	int io_threads;
+	int io_workers;
+	int io_running;
+	switch_atomic_t io_next_loop;
+	jsock_io_loop_t *io_loops;
+	switch_thread_t **io_worker_threads;
+	switch_queue_t *io_work_queue;
 };
 
 
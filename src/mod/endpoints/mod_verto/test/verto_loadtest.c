@@ -0,0 +1,508 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2014, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * verto_loadtest.c -- open lots of mostly idle WebSocket clients against a verto profile
+ *
+ * Every client does the WebSocket upgrade and then sends a JSON-RPC "echo" request every
+ * -i seconds, measuring the time until a reply comes back (an "Authentication Required"
+ * error counts as a reply, the point is the I/O path, not the dialplan).
+ *
+ *   make test/verto_loadtest
+ *   test/verto_loadtest -h 127.0.0.1 -p 8081 -c 20000 -r 500 -i 10 -d 120
+ *
+ * Run it once against the default thread per client mode and once with io-threads set
+ * in verto.conf and compare the latency columns and the server's thread count / RSS.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define RBUF_LEN 16384
+
+typedef enum {
+	CS_CONNECTING,
+	CS_UPGRADING,
+	CS_OPEN,
+	CS_DEAD
+} client_state_t;
+
+typedef struct client_s {
+	int fd;
+	client_state_t state;
+	char rbuf[RBUF_LEN];
+	size_t rlen;
+	int64_t next_send;
+	int64_t sent_at;
+	uint32_t id;
+} client_t;
+
+static struct {
+	const char *host;
+	int port;
+	int count;
+	int rate;
+	int interval;
+	int duration;
+	struct sockaddr_in addr;
+	int efd;
+	client_t *clients;
+	int started;
+	int open;
+	int failed;
+	uint64_t sent;
+	uint64_t received;
+	uint64_t lat_sum;
+	uint64_t lat_count;
+	int64_t lat_max;
+} lt;
+
+static int64_t now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void client_fail(client_t *c)
+{
+	if (c->state == CS_OPEN) {
+		lt.open--;
+	}
+
+	if (c->fd >= 0) {
+		epoll_ctl(lt.efd, EPOLL_CTL_DEL, c->fd, NULL);
+		close(c->fd);
+		c->fd = -1;
+	}
+
+	c->state = CS_DEAD;
+	lt.failed++;
+}
+
+static int client_send_all(client_t *c, const void *data, size_t len)
+{
+	size_t wrote = 0;
+
+	while (wrote < len) {
+		ssize_t r = send(c->fd, (const char *)data + wrote, len - wrote, MSG_NOSIGNAL);
+
+		if (r < 0) {
+			if (errno == EAGAIN || errno == EINTR) {
+				usleep(1000);
+				continue;
+			}
+			return -1;
+		}
+
+		wrote += r;
+	}
+
+	return 0;
+}
+
+static int client_send_text(client_t *c, const char *text)
+{
+	uint8_t frame[512];
+	size_t len = strlen(text), hlen = 2, i;
+	uint8_t mask[4];
+	uint32_t r = (uint32_t)rand();
+
+	if (len + 8 > sizeof(frame)) {
+		return -1;
+	}
+
+	memcpy(mask, &r, 4);
+	frame[0] = 0x81;
+
+	if (len < 126) {
+		frame[1] = 0x80 | (uint8_t)len;
+	} else {
+		frame[1] = 0x80 | 126;
+		frame[2] = (uint8_t)(len >> 8);
+		frame[3] = (uint8_t)(len & 0xff);
+		hlen = 4;
+	}
+
+	memcpy(frame + hlen, mask, 4);
+
+	for (i = 0; i < len; i++) {
+		frame[hlen + 4 + i] = (uint8_t)text[i] ^ mask[i % 4];
+	}
+
+	return client_send_all(c, frame, hlen + 4 + len);
+}
+
+static void client_start(client_t *c)
+{
+	struct epoll_event e = { 0 };
+	int flag = 1;
+
+	c->rlen = 0;
+	c->sent_at = 0;
+
+	if ((c->fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+		c->state = CS_DEAD;
+		lt.failed++;
+		return;
+	}
+
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+	fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL, 0) | O_NONBLOCK);
+
+	if (connect(c->fd, (struct sockaddr *)&lt.addr, sizeof(lt.addr)) < 0 && errno != EINPROGRESS) {
+		client_fail(c);
+		return;
+	}
+
+	c->state = CS_CONNECTING;
+	e.events = EPOLLIN | EPOLLOUT;
+	e.data.ptr = c;
+	epoll_ctl(lt.efd, EPOLL_CTL_ADD, c->fd, &e);
+}
+
+static void client_writable(client_t *c)
+{
+	char req[512];
+	struct epoll_event e = { 0 };
+	int err = 0;
+	socklen_t elen = sizeof(err);
+
+	if (c->state != CS_CONNECTING) {
+		return;
+	}
+
+	if (getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &elen) < 0 || err) {
+		client_fail(c);
+		return;
+	}
+
+	snprintf(req, sizeof(req),
+			 "GET / HTTP/1.1\r\n"
+			 "Host: %s:%d\r\n"
+			 "Upgrade: websocket\r\n"
+			 "Connection: Upgrade\r\n"
+			 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+			 "Sec-WebSocket-Protocol: verto\r\n"
+			 "Sec-WebSocket-Version: 13\r\n\r\n", lt.host, lt.port);
+
+	if (client_send_all(c, req, strlen(req)) < 0) {
+		client_fail(c);
+		return;
+	}
+
+	c->state = CS_UPGRADING;
+	e.events = EPOLLIN;
+	e.data.ptr = c;
+	epoll_ctl(lt.efd, EPOLL_CTL_MOD, c->fd, &e);
+}
+
+static void client_frames(client_t *c)
+{
+	size_t pos = 0;
+
+	for (;;) {
+		uint8_t *p = (uint8_t *)c->rbuf + pos;
+		size_t avail = c->rlen - pos, hlen = 2;
+		uint64_t plen;
+
+		if (avail < 2) {
+			break;
+		}
+
+		plen = p[1] & 0x7f;
+
+		if (plen == 126) {
+			hlen = 4;
+		} else if (plen == 127) {
+			hlen = 10;
+		}
+
+		if (avail < hlen) {
+			break;
+		}
+
+		if (plen == 126) {
+			plen = ((uint64_t)p[2] << 8) | p[3];
+		} else if (plen == 127) {
+			int i;
+
+			for (plen = 0, i = 0; i < 8; i++) {
+				plen = (plen << 8) | p[2 + i];
+			}
+		}
+
+		if (hlen + plen > RBUF_LEN) {
+			/* large server push, we are not interested in the content */
+			client_fail(c);
+			return;
+		}
+
+		if (avail < hlen + plen) {
+			break;
+		}
+
+		if ((p[0] & 0x0f) == 0x1) {
+			lt.received++;
+
+			if (c->sent_at) {
+				int64_t lat = now_us() - c->sent_at;
+
+				lt.lat_sum += lat;
+				lt.lat_count++;
+				if (lat > lt.lat_max) {
+					lt.lat_max = lat;
+				}
+				c->sent_at = 0;
+			}
+		} else if ((p[0] & 0x0f) == 0x8) {
+			client_fail(c);
+			return;
+		}
+
+		pos += hlen + plen;
+	}
+
+	if (pos) {
+		memmove(c->rbuf, c->rbuf + pos, c->rlen - pos);
+		c->rlen -= pos;
+	}
+}
+
+static void client_readable(client_t *c)
+{
+	for (;;) {
+		ssize_t r = recv(c->fd, c->rbuf + c->rlen, RBUF_LEN - c->rlen - 1, 0);
+
+		if (r < 0 && (errno == EAGAIN || errno == EINTR)) {
+			return;
+		}
+
+		if (r <= 0) {
+			client_fail(c);
+			return;
+		}
+
+		c->rlen += r;
+
+		if (c->state == CS_UPGRADING) {
+			char *end;
+
+			c->rbuf[c->rlen] = '\0';
+
+			if (!(end = strstr(c->rbuf, "\r\n\r\n"))) {
+				continue;
+			}
+
+			if (strncmp(c->rbuf, "HTTP/1.1 101", 12)) {
+				client_fail(c);
+				return;
+			}
+
+			end += 4;
+			c->rlen -= (end - c->rbuf);
+			memmove(c->rbuf, end, c->rlen);
+			c->state = CS_OPEN;
+			c->next_send = now_us() + (int64_t)(rand() % (lt.interval * 1000)) * 1000;
+			lt.open++;
+		}
+
+		if (c->state == CS_OPEN) {
+			client_frames(c);
+
+			if (c->state != CS_OPEN) {
+				return;
+			}
+		}
+	}
+}
+
+static void send_due(int64_t now)
+{
+	int i;
+
+	for (i = 0; i < lt.started; i++) {
+		client_t *c = &lt.clients[i];
+		char msg[256];
+
+		if (c->state != CS_OPEN || c->sent_at || now < c->next_send) {
+			continue;
+		}
+
+		snprintf(msg, sizeof(msg), "{\"jsonrpc\":\"2.0\",\"method\":\"echo\",\"params\":{\"client\":%d},\"id\":%u}", i, ++c->id);
+
+		if (client_send_text(c, msg) < 0) {
+			client_fail(c);
+			continue;
+		}
+
+		c->sent_at = now;
+		c->next_send = now + (int64_t)lt.interval * 1000000;
+		lt.sent++;
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-h host] [-p port] [-c clients] [-r connects/sec] [-i request interval sec] [-d duration sec]\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct epoll_event events[256];
+	struct rlimit rl;
+	struct hostent *he;
+	int64_t start, last_report, last_connect;
+	int opt;
+
+	lt.host = "127.0.0.1";
+	lt.port = 8081;
+	lt.count = 1000;
+	lt.rate = 200;
+	lt.interval = 10;
+	lt.duration = 60;
+
+	while ((opt = getopt(argc, argv, "h:p:c:r:i:d:")) != -1) {
+		switch (opt) {
+		case 'h': lt.host = optarg; break;
+		case 'p': lt.port = atoi(optarg); break;
+		case 'c': lt.count = atoi(optarg); break;
+		case 'r': lt.rate = atoi(optarg); break;
+		case 'i': lt.interval = atoi(optarg); break;
+		case 'd': lt.duration = atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+
+	if (lt.count <= 0 || lt.rate <= 0 || lt.interval <= 0 || lt.duration <= 0) {
+		usage(argv[0]);
+	}
+
+	if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < (rlim_t)lt.count + 64) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+
+	if (!(he = gethostbyname(lt.host))) {
+		fprintf(stderr, "cannot resolve %s\n", lt.host);
+		return 1;
+	}
+
+	lt.addr.sin_family = AF_INET;
+	lt.addr.sin_port = htons(lt.port);
+	memcpy(&lt.addr.sin_addr, he->h_addr_list[0], sizeof(lt.addr.sin_addr));
+
+	if ((lt.efd = epoll_create(1024)) < 0 || !(lt.clients = calloc(lt.count, sizeof(client_t)))) {
+		fprintf(stderr, "setup failed: %s\n", strerror(errno));
+		return 1;
+	}
+
+	srand((unsigned)getpid());
+	start = last_report = last_connect = now_us();
+
+	printf("%8s %8s %8s %12s %12s %10s %10s\n", "time", "open", "failed", "sent", "received", "avg ms", "max ms");
+
+	for (;;) {
+		int64_t now = now_us();
+		int i, n;
+
+		if (lt.started < lt.count) {
+			int due = (int)((now - last_connect) * lt.rate / 1000000);
+
+			if (due > 0) {
+				while (due-- > 0 && lt.started < lt.count) {
+					lt.clients[lt.started].fd = -1;
+					client_start(&lt.clients[lt.started++]);
+				}
+				last_connect = now;
+			}
+		}
+
+		n = epoll_wait(lt.efd, events, sizeof(events) / sizeof(events[0]), 10);
+
+		for (i = 0; i < n; i++) {
+			client_t *c = (client_t *)events[i].data.ptr;
+
+			if (c->state == CS_DEAD) {
+				continue;
+			}
+
+			if (events[i].events & EPOLLOUT) {
+				client_writable(c);
+			}
+
+			if (c->state != CS_DEAD && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+				client_readable(c);
+			}
+		}
+
+		now = now_us();
+		send_due(now);
+
+		if (now - last_report >= 1000000) {
+			printf("%7ds %8d %8d %12llu %12llu %10.2f %10.2f\n", (int)((now - start) / 1000000), lt.open, lt.failed,
+				   (unsigned long long)lt.sent, (unsigned long long)lt.received,
+				   lt.lat_count ? (double)lt.lat_sum / lt.lat_count / 1000.0 : 0.0, (double)lt.lat_max / 1000.0);
+			fflush(stdout);
+			lt.lat_sum = lt.lat_count = 0;
+			lt.lat_max = 0;
+			last_report = now;
+		}
+
+		if (now - start >= (int64_t)lt.duration * 1000000) {
+			break;
+		}
+	}
+
+	return lt.failed ? 2 : 0;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4 noet
+ */
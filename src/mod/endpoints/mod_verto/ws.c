@@ -26,6 +26,7 @@
 
 #define WS_INIT_SANITY 5000
 #define WS_WRITE_SANITY 200
+#define WS_MAX_MESSAGE_LEN (16 * 1024 * 1024)
 
 #define SHA1_HASH_SIZE 20
 static struct ws_globals_s ws_globals;
@@ -265,13 +266,18 @@ int ws_handshake(wsh_t *wsh)
 		return -3;
 	}
 
-	while((bytes = ws_raw_read(wsh, wsh->buffer + wsh->datalen, wsh->buflen - wsh->datalen, WS_BLOCK)) > 0) {
+	while((bytes = ws_raw_read(wsh, wsh->buffer + wsh->datalen, wsh->buflen - wsh->datalen, wsh->block ? WS_BLOCK : WS_NOBLOCK)) > 0) {
 		wsh->datalen += bytes;
 		if (strstr(wsh->buffer, "\r\n\r\n") || strstr(wsh->buffer, "\n\n")) {
 			break;
 		}
 	}
 
+	if (bytes == -2 && !wsh->block) {
+		/* request headers are not complete yet, come back when there is more to read */
+		return -2;
+	}
+
 	if (bytes < 0 || bytes > wsh->buflen -1) {
 		goto err;
 	}
@@ -421,7 +427,7 @@ ssize_t ws_raw_read(wsh_t *wsh, void *data, size_t bytes, int block)
 ssize_t ws_raw_write(wsh_t *wsh, void *data, size_t bytes)
 {
 	ssize_t r;
-	int sanity = WS_WRITE_SANITY;
+	int sanity = wsh->nb_write ? 1 : WS_WRITE_SANITY;
 	int ssl_err = 0;
 	size_t wrote = 0;
 
@@ -438,7 +444,7 @@ ssize_t ws_raw_write(wsh_t *wsh, void *data, size_t bytes)
 				wrote += r;
 			}
 
-			if (sanity < WS_WRITE_SANITY) {
+			if (sanity < WS_WRITE_SANITY && !wsh->nb_write) {
 				int ms = 1;
 
 				if (wsh->block) {
@@ -462,7 +468,7 @@ ssize_t ws_raw_write(wsh_t *wsh, void *data, size_t bytes)
 
 		} while (--sanity > 0 && wrote < bytes);
 
-		if (!sanity) ssl_err = 56;
+		if (!sanity && wrote < bytes) ssl_err = 56;
 		
 		if (ssl_err) {
 			r = ssl_err * -1;
@@ -478,7 +484,7 @@ ssize_t ws_raw_write(wsh_t *wsh, void *data, size_t bytes)
 			wrote += r;
 		}
 
-		if (sanity < WS_WRITE_SANITY) {
+		if (sanity < WS_WRITE_SANITY && !wsh->nb_write) {
 			int ms = 1;
 
 			if (wsh->block) {
@@ -592,18 +598,14 @@ int establish_logical_layer(wsh_t *wsh)
 				}
 			}
 
-			if (wsh->block) {
-				ms_sleep(10);
-			} else {
-				ms_sleep(1);
-			}
-
 			wsh->sanity--;
 
 			if (!wsh->block) {
 				return -2;
 			}
 
+			ms_sleep(10);
+
 		} while (wsh->sanity > 0);
 
 		if (!wsh->sanity) {
@@ -615,6 +617,15 @@ int establish_logical_layer(wsh_t *wsh)
 	while (!wsh->down && !wsh->handshake) {
 		int r = ws_handshake(wsh);
 
+		if (r == -2) {
+			/* every partial request costs sanity so a client trickling headers can not hold the socket forever */
+			if (--wsh->sanity <= 0) {
+				wsh->down = 1;
+				return -1;
+			}
+			return -2;
+		}
+
 		if (r < 0) {
 			wsh->down = 1;
 			return -1;
@@ -997,6 +1008,202 @@ ssize_t ws_read_frame(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data)
 	}
 }
 
+/* Non-blocking variant of ws_read_frame() for event driven callers.
+   Whatever the socket has is appended to wsh->buffer and complete frames are parsed out of it,
+   so a header or payload split across several reads never blocks the calling thread.
+   Returns the length of a complete message (in *data, NUL terminated), -2 when more input is needed
+   or a negative close code.  Callers must keep calling until -2 since input may already be buffered
+   here or inside the SSL layer where poll() can not see it. */
+ssize_t ws_read_frame_nb(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data)
+{
+	int ll;
+
+	*data = NULL;
+
+	if ((ll = establish_logical_layer(wsh)) < 0) {
+		return ll;
+	}
+
+	if (wsh->down) {
+		return -1;
+	}
+
+	if (!wsh->handshake) {
+		return ws_close(wsh, WS_NONE);
+	}
+
+	if (!wsh->nb_ready) {
+		/* the handshake request is done with, the buffer now holds raw frames */
+		wsh->nb_ready = 1;
+		wsh->ipos = wsh->ilen = wsh->mlen = 0;
+	}
+
+	for (;;) {
+		uint8_t *p = (uint8_t *) wsh->buffer + wsh->ipos;
+		size_t avail = wsh->ilen - wsh->ipos;
+		size_t need = 2, hlen;
+		uint64_t plen;
+		ssize_t r;
+
+		if (avail >= 2) {
+			int fin = (p[0] >> 7) & 1;
+			int mask = (p[1] >> 7) & 1;
+			ws_opcode_t op = (ws_opcode_t)(p[0] & 0xf);
+
+			plen = p[1] & 0x7f;
+
+			if (plen == 126) {
+				need += 2;
+			} else if (plen == 127) {
+				need += 8;
+			}
+
+			if (mask) {
+				need += 4;
+			}
+
+			if (avail >= need) {
+				hlen = need;
+
+				if (plen == 126) {
+					uint16_t u16;
+					memcpy(&u16, p + 2, 2);
+					plen = ntohs(u16);
+				} else if (plen == 127) {
+					uint64_t u64;
+					memcpy(&u64, p + 2, 8);
+					plen = ntoh64(u64);
+				}
+
+				if (plen > WS_MAX_MESSAGE_LEN || wsh->mlen + plen > WS_MAX_MESSAGE_LEN) {
+					*oc = WSOC_CLOSE;
+					return ws_close(wsh, WS_DATA_TOO_BIG);
+				}
+
+				need = hlen + (size_t)plen;
+
+				if (avail >= need) {
+					uint8_t *payload = p + hlen;
+
+					wsh->ipos += need;
+
+					if (mask) {
+						uint8_t *maskp = p + hlen - 4;
+						size_t i;
+
+						for (i = 0; i < plen; i++) {
+							payload[i] ^= maskp[i % 4];
+						}
+					}
+
+					switch(op) {
+					case WSOC_CLOSE:
+						*oc = WSOC_CLOSE;
+						return ws_close(wsh, WS_RECV_CLOSE);
+					case WSOC_PING:
+						/* answered later by ws_flush_pong() so this never waits on a slow peer */
+						if (plen > sizeof(wsh->pong)) {
+							*oc = WSOC_CLOSE;
+							return ws_close(wsh, WS_PROTO_ERR);
+						}
+						memcpy(wsh->pong, payload, (size_t)plen);
+						wsh->pong_len = (size_t)plen;
+						wsh->pong_pending = 1;
+						continue;
+					case WSOC_PONG:
+						continue;
+					case WSOC_TEXT:
+					case WSOC_BINARY:
+					case WSOC_CONTINUATION:
+						{
+							if (op != WSOC_CONTINUATION) {
+								wsh->moc = op;
+								wsh->mlen = 0;
+							}
+
+							if (wsh->mlen + plen + 1 > wsh->bbuflen) {
+								void *tmp;
+
+								wsh->bbuflen = wsh->mlen + (size_t)plen + 1;
+
+								if ((tmp = realloc(wsh->bbuffer, wsh->bbuflen))) {
+									wsh->bbuffer = tmp;
+								} else {
+									abort();
+								}
+							}
+
+							memcpy(wsh->bbuffer + wsh->mlen, payload, (size_t)plen);
+							wsh->mlen += (size_t)plen;
+
+							if (!fin) {
+								continue;
+							}
+
+							*(wsh->bbuffer + wsh->mlen) = '\0';
+							*oc = (ws_opcode_t)wsh->moc;
+							*data = (uint8_t *)wsh->bbuffer;
+							wsh->packetlen = wsh->mlen;
+							wsh->mlen = 0;
+
+							return wsh->packetlen;
+						}
+					default:
+						*oc = WSOC_CLOSE;
+						return ws_close(wsh, WS_PROTO_ERR);
+					}
+				}
+			}
+		}
+
+		/* not a whole frame yet, make room and read some more */
+		if (wsh->ipos) {
+			if (wsh->ilen > wsh->ipos) {
+				memmove(wsh->buffer, wsh->buffer + wsh->ipos, wsh->ilen - wsh->ipos);
+			}
+			wsh->ilen -= wsh->ipos;
+			wsh->ipos = 0;
+		}
+
+		if (need + 1 > wsh->buflen) {
+			void *tmp;
+
+			wsh->buflen = need + 1;
+
+			if ((tmp = realloc(wsh->buffer, wsh->buflen))) {
+				wsh->buffer = tmp;
+			} else {
+				abort();
+			}
+		}
+
+		r = ws_raw_read(wsh, wsh->buffer + wsh->ilen, wsh->buflen - wsh->ilen - 1, WS_NOBLOCK);
+
+		if (r == -2) {
+			wsh->x = 0;
+			return -2;
+		}
+
+		if (r <= 0) {
+			*oc = WSOC_CLOSE;
+			return ws_close(wsh, WS_NONE);
+		}
+
+		wsh->ilen += r;
+	}
+}
+
+ssize_t ws_flush_pong(wsh_t *wsh)
+{
+	if (!wsh->pong_pending) {
+		return 0;
+	}
+
+	wsh->pong_pending = 0;
+
+	return ws_write_frame(wsh, WSOC_PONG, wsh->pong, wsh->pong_len);
+}
+
 ssize_t ws_write_frame(wsh_t *wsh, ws_opcode_t oc, void *data, size_t bytes)
 {
 	uint8_t hdr[14] = { 0 };
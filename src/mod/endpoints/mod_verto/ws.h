@@ -112,6 +112,17 @@ typedef struct wsh_s {
 	int x;
 	void *write_buffer;
 	size_t write_buffer_len;
+	int nb_ready;
+	size_t ipos;
+	size_t ilen;
+	size_t mlen;
+	int moc;
+	/* single write attempt, no retry or sleep, for callers that must never block */
+	int nb_write;
+	/* PONG owed for the last PING seen by ws_read_frame_nb, sent with ws_flush_pong */
+	uint8_t pong[125];
+	size_t pong_len;
+	int pong_pending;
 } wsh_t;
 
 ssize_t ws_send_buf(wsh_t *wsh, ws_opcode_t oc);
@@ -121,6 +132,8 @@ ssize_t ws_feed_buf(wsh_t *wsh, void *data, size_t bytes);
 ssize_t ws_raw_read(wsh_t *wsh, void *data, size_t bytes, int block);
 ssize_t ws_raw_write(wsh_t *wsh, void *data, size_t bytes);
 ssize_t ws_read_frame(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data);
+ssize_t ws_read_frame_nb(wsh_t *wsh, ws_opcode_t *oc, uint8_t **data);
+ssize_t ws_flush_pong(wsh_t *wsh);
 ssize_t ws_write_frame(wsh_t *wsh, ws_opcode_t oc, void *data, size_t bytes);
 int ws_init(wsh_t *wsh, ws_socket_t sock, SSL_CTX *ssl_ctx, int close_sock, int block, int stay_open);
 ssize_t ws_close(wsh_t *wsh, int16_t reason);
@@ -28,17 +28,48 @@
  */
 #include <switch.h>
 #include <sys/stat.h>
+#ifndef _MSC_VER
+#include <sys/uio.h>
+#else
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+#endif
+
+#define CDR_IOV_BATCH 256
 
 typedef enum {
 	CDR_LEG_A = (1 << 0),
 	CDR_LEG_B = (1 << 1)
 } cdr_leg_t;
 
+typedef enum {
+	CDR_FSYNC_NEVER,
+	CDR_FSYNC_ROTATE,
+	CDR_FSYNC_FLUSH
+} cdr_fsync_t;
+
+/* CDR lines waiting to be written, one iovec per line */
+struct cdr_spool {
+	struct iovec *iov;
+	int count;
+	int alloc;
+	switch_size_t bytes;
+};
+typedef struct cdr_spool cdr_spool_t;
+
 struct cdr_fd {
 	int fd;
 	char *path;
 	int64_t bytes;
+	/* serializes use of the descriptor: write, flush, rotate and reopen */
 	switch_mutex_t *mutex;
+	/* guards spool only so the hangup path never waits on the disk */
+	switch_mutex_t *spool_mutex;
+	cdr_spool_t spool;
+	cdr_spool_t flushing;
+	struct cdr_fd *next;
 };
 typedef struct cdr_fd cdr_fd_t;
 
@@ -58,6 +89,16 @@ static struct {
 	int rotate;
 	int debug;
 	cdr_leg_t legs;
+	int buffered;
+	switch_size_t flush_size;
+	uint32_t flush_interval;
+	switch_size_t max_spool;
+	cdr_fsync_t fsync_policy;
+	cdr_fd_t *fd_list;
+	switch_thread_t *flush_thread;
+	switch_mutex_t *flush_mutex;
+	switch_thread_cond_t *flush_cond;
+	int flush_pending;
 } globals;
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_csv_load);
@@ -71,6 +112,42 @@ static off_t fd_size(int fd)
 	return s.st_size;
 }
 
+static void do_fsync(cdr_fd_t *fd)
+{
+	if (fd->fd > -1) {
+#ifdef _MSC_VER
+		_commit(fd->fd);
+#else
+		fsync(fd->fd);
+#endif
+	}
+}
+
+static int do_writev(int fd, const struct iovec *iov, int count)
+{
+#ifdef _MSC_VER
+	int x, total = 0;
+
+	for (x = 0; x < count; x++) {
+		int w = write(fd, iov[x].iov_base, (unsigned int) iov[x].iov_len);
+
+		if (w < 0) {
+			return total ? total : w;
+		}
+
+		total += w;
+
+		if ((size_t) w < iov[x].iov_len) {
+			break;
+		}
+	}
+
+	return total;
+#else
+	return (int) writev(fd, iov, count);
+#endif
+}
+
 static void do_reopen(cdr_fd_t *fd)
 {
 	int x = 0;
@@ -100,6 +177,10 @@ static void do_rotate(cdr_fd_t *fd)
 	switch_size_t retsize;
 	char *p;
 
+	if (globals.fsync_policy != CDR_FSYNC_NEVER) {
+		do_fsync(fd);
+	}
+
 	close(fd->fd);
 	fd->fd = -1;
 
@@ -129,6 +210,176 @@ static void do_rotate(cdr_fd_t *fd)
 
 }
 
+static void free_spool(cdr_spool_t *spool)
+{
+	int x;
+
+	for (x = 0; x < spool->count; x++) {
+		free(spool->iov[x].iov_base);
+	}
+
+	spool->count = 0;
+	spool->bytes = 0;
+}
+
+/* must be called with fd->mutex held */
+static void write_spool(cdr_fd_t *fd, cdr_spool_t *spool)
+{
+	struct iovec vec[CDR_IOV_BATCH];
+	size_t off = 0;
+	int x = 0, loops = 0;
+
+	if (fd->fd < 0) {
+		do_reopen(fd);
+		if (fd->fd < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s, dropping %d CDR(s)\n", fd->path, spool->count);
+			goto end;
+		}
+	}
+
+	if (fd->bytes + (int64_t) spool->bytes > UINT_MAX) {
+		do_rotate(fd);
+	}
+
+	while (x < spool->count && fd->fd > -1) {
+		int count = spool->count - x, bytes_in;
+
+		if (count > CDR_IOV_BATCH) {
+			count = CDR_IOV_BATCH;
+		}
+
+		memcpy(vec, spool->iov + x, count * sizeof(vec[0]));
+		vec[0].iov_base = (char *) vec[0].iov_base + off;
+		vec[0].iov_len -= off;
+
+		if ((bytes_in = do_writev(fd->fd, vec, count)) <= 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Write error to file %s %d/%d\n", fd->path, bytes_in, (int) spool->bytes);
+			if (++loops >= 10) {
+				break;
+			}
+			do_rotate(fd);
+			switch_yield(250000);
+			continue;
+		}
+
+		fd->bytes += bytes_in;
+
+		while (bytes_in > 0) {
+			size_t left = spool->iov[x].iov_len - off;
+
+			if ((size_t) bytes_in >= left) {
+				bytes_in -= (int) left;
+				off = 0;
+				x++;
+			} else {
+				off += bytes_in;
+				bytes_in = 0;
+			}
+		}
+	}
+
+	if (globals.fsync_policy == CDR_FSYNC_FLUSH) {
+		do_fsync(fd);
+	}
+
+  end:
+
+	free_spool(spool);
+}
+
+/* Hand the pending lines over to the descriptor side and write them out */
+static void flush_cdr(cdr_fd_t *fd)
+{
+	cdr_spool_t tmp;
+
+	switch_mutex_lock(fd->mutex);
+
+	switch_mutex_lock(fd->spool_mutex);
+	tmp = fd->spool;
+	fd->spool = fd->flushing;
+	fd->flushing = tmp;
+	switch_mutex_unlock(fd->spool_mutex);
+
+	if (fd->flushing.count) {
+		write_spool(fd, &fd->flushing);
+	}
+
+	switch_mutex_unlock(fd->mutex);
+}
+
+static void flush_all(void)
+{
+	cdr_fd_t *fd;
+
+	/* entries are never unlinked before shutdown so the walk itself needs no lock */
+	switch_mutex_lock(globals.mutex);
+	fd = globals.fd_list;
+	switch_mutex_unlock(globals.mutex);
+
+	for (; fd; fd = fd->next) {
+		flush_cdr(fd);
+	}
+}
+
+static void *SWITCH_THREAD_FUNC flush_thread_run(switch_thread_t *thread, void *obj)
+{
+	switch_mutex_lock(globals.flush_mutex);
+
+	while (!globals.shutdown) {
+		if (!globals.flush_pending) {
+			switch_thread_cond_timedwait(globals.flush_cond, globals.flush_mutex, (switch_interval_time_t) globals.flush_interval * 1000);
+		}
+
+		globals.flush_pending = 0;
+		switch_mutex_unlock(globals.flush_mutex);
+		flush_all();
+		switch_mutex_lock(globals.flush_mutex);
+	}
+
+	switch_mutex_unlock(globals.flush_mutex);
+
+	return NULL;
+}
+
+static void spool_cdr(cdr_fd_t *fd, const char *log_line)
+{
+	switch_size_t len = strlen(log_line);
+	int kick = 0;
+
+	switch_mutex_lock(fd->spool_mutex);
+
+	if (fd->spool.count && fd->spool.bytes + len > globals.max_spool) {
+		/* spool is full, push back on the caller rather than grow without bound */
+		switch_mutex_unlock(fd->spool_mutex);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "CDR spool for %s is full, flushing inline\n", fd->path);
+		flush_cdr(fd);
+		switch_mutex_lock(fd->spool_mutex);
+	}
+
+	if (fd->spool.count == fd->spool.alloc) {
+		fd->spool.alloc = fd->spool.alloc ? fd->spool.alloc * 2 : 64;
+		fd->spool.iov = realloc(fd->spool.iov, fd->spool.alloc * sizeof(*fd->spool.iov));
+		switch_assert(fd->spool.iov);
+	}
+
+	fd->spool.iov[fd->spool.count].iov_base = strdup(log_line);
+	switch_assert(fd->spool.iov[fd->spool.count].iov_base);
+	fd->spool.iov[fd->spool.count].iov_len = len;
+	fd->spool.count++;
+	fd->spool.bytes += len;
+
+	kick = fd->spool.bytes >= globals.flush_size;
+
+	switch_mutex_unlock(fd->spool_mutex);
+
+	if (kick) {
+		switch_mutex_lock(globals.flush_mutex);
+		globals.flush_pending = 1;
+		switch_thread_cond_signal(globals.flush_cond);
+		switch_mutex_unlock(globals.flush_mutex);
+	}
+}
+
 static void write_cdr(const char *path, const char *log_line)
 {
 	cdr_fd_t *fd = NULL;
@@ -142,11 +393,19 @@ static void write_cdr(const char *path, const char *log_line)
 		memset(fd, 0, sizeof(*fd));
 		fd->fd = -1;
 		switch_mutex_init(&fd->mutex, SWITCH_MUTEX_NESTED, globals.pool);
+		switch_mutex_init(&fd->spool_mutex, SWITCH_MUTEX_NESTED, globals.pool);
 		fd->path = switch_core_strdup(globals.pool, path);
 		switch_core_hash_insert(globals.fd_hash, path, fd);
+		fd->next = globals.fd_list;
+		globals.fd_list = fd;
 	}
 	switch_mutex_unlock(globals.mutex);
 
+	if (globals.buffered) {
+		spool_cdr(fd, log_line);
+		return;
+	}
+
 	switch_mutex_lock(fd->mutex);
 	bytes_out = (unsigned) strlen(log_line);
 
@@ -287,6 +546,9 @@ static void do_rotate_all()
 		switch_core_hash_this(hi, NULL, NULL, &val);
 		fd = (cdr_fd_t *) val;
 		switch_mutex_lock(fd->mutex);
+		if (globals.buffered) {
+			flush_cdr(fd);
+		}
 		do_rotate(fd);
 		switch_mutex_unlock(fd->mutex);
 	}
@@ -304,10 +566,16 @@ static void do_teardown()
 		switch_core_hash_this(hi, NULL, NULL, &val);
 		fd = (cdr_fd_t *) val;
 		switch_mutex_lock(fd->mutex);
+		flush_cdr(fd);
 		if (fd->fd > -1) {
+			if (globals.fsync_policy != CDR_FSYNC_NEVER) {
+				do_fsync(fd);
+			}
 			close(fd->fd);
 			fd->fd = -1;
 		}
+		switch_safe_free(fd->spool.iov);
+		switch_safe_free(fd->flushing.iov);
 		switch_mutex_unlock(fd->mutex);
 	}
 	switch_mutex_unlock(globals.mutex);
@@ -367,6 +635,9 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 	switch_core_hash_insert(globals.template_hash, "default", default_template);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Adding default template.\n");
 	globals.legs = CDR_LEG_A;
+	globals.flush_size = 65536;
+	globals.flush_interval = 1000;
+	globals.max_spool = 16 * 1024 * 1024;
 
 	if ((xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 
@@ -394,6 +665,31 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 					globals.default_template = switch_core_strdup(pool, val);
 				} else if (!strcasecmp(var, "master-file-only")) {
 					globals.masterfileonly = switch_true(val);
+				} else if (!strcasecmp(var, "buffered-writes")) {
+					globals.buffered = switch_true(val);
+				} else if (!strcasecmp(var, "flush-size")) {
+					int tmp = atoi(val);
+					if (tmp > 0) {
+						globals.flush_size = tmp;
+					}
+				} else if (!strcasecmp(var, "flush-interval")) {
+					int tmp = atoi(val);
+					if (tmp > 0) {
+						globals.flush_interval = tmp;
+					}
+				} else if (!strcasecmp(var, "max-spool-size")) {
+					int tmp = atoi(val);
+					if (tmp > 0) {
+						globals.max_spool = tmp;
+					}
+				} else if (!strcasecmp(var, "fsync")) {
+					if (!strcasecmp(val, "flush")) {
+						globals.fsync_policy = CDR_FSYNC_FLUSH;
+					} else if (!strcasecmp(val, "rotate")) {
+						globals.fsync_policy = CDR_FSYNC_ROTATE;
+					} else {
+						globals.fsync_policy = CDR_FSYNC_NEVER;
+					}
 				}
 			}
 		}
@@ -428,6 +724,10 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 		globals.log_dir = switch_core_sprintf(pool, "%s%scdr-csv", SWITCH_GLOBAL_dirs.log_dir, SWITCH_PATH_SEPARATOR);
 	}
 
+	if (globals.max_spool < globals.flush_size) {
+		globals.max_spool = globals.flush_size;
+	}
+
 	return status;
 }
 
@@ -451,6 +751,16 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_csv_load)
 		return status;
 	}
 
+	if (globals.buffered) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		switch_mutex_init(&globals.flush_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+		switch_thread_cond_create(&globals.flush_cond, globals.pool);
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.flush_thread, thd_attr, flush_thread_run, NULL, globals.pool);
+	}
+
 	switch_core_add_state_handler(&state_handlers);
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
@@ -469,6 +779,15 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_cdr_csv_shutdown)
 	switch_event_unbind_callback(event_handler);
 	switch_core_remove_state_handler(&state_handlers);
 
+	if (globals.flush_thread) {
+		switch_status_t st;
+
+		switch_mutex_lock(globals.flush_mutex);
+		switch_thread_cond_signal(globals.flush_cond);
+		switch_mutex_unlock(globals.flush_mutex);
+		switch_thread_join(&st, globals.flush_thread);
+	}
+
 	do_teardown();
 	switch_core_hash_destroy(&globals.fd_hash);
 	switch_core_hash_destroy(&globals.template_hash);
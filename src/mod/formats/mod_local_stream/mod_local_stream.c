@@ -34,6 +34,9 @@
 #include <switch.h>
 /* for apr_pstrcat */
 #define DEFAULT_PREBUFFER_SIZE 1024 * 64
+/* decoded frames kept in the shared ring, and how close to the writer a lagging reader may get before it is skipped ahead */
+#define LOCAL_STREAM_RING_FRAMES 128
+#define LOCAL_STREAM_RING_GUARD 4
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_local_stream_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_local_stream_shutdown);
@@ -46,6 +49,11 @@ static const char *global_cf = "local_stream.conf";
 
 struct local_stream_source;
 
+typedef struct local_stream_frame_s {
+	switch_byte_t *data;
+	uint32_t datalen;
+} local_stream_frame_t;
+
 static struct {
 	switch_mutex_t *mutex;
 	switch_hash_t *source_hash;
@@ -57,7 +65,8 @@ static int THREADS = 0;
 struct local_stream_context {
 	struct local_stream_source *source;
 	switch_mutex_t *audio_mutex;
-	switch_buffer_t *audio_buffer;
+	uint32_t read_seq;
+	uint32_t frame_pos;
 	int err;
 	const char *file;
 	const char *func;
@@ -125,6 +134,9 @@ struct local_stream_source {
 	int serno;
 	switch_size_t abuflen;
 	switch_byte_t *abuf;
+	local_stream_frame_t *ring;
+	uint32_t ring_size;
+	uint32_t write_seq;
 	switch_timer_t timer;
 	int logo_always;
 	switch_img_position_t logo_pos;
@@ -226,8 +238,9 @@ static void *SWITCH_THREAD_FUNC read_stream_thread(switch_thread_t *thread, void
 	char file_buf[128] = "", path_buf[512] = "", last_path[512] = "", png_buf[512] = "", tmp_buf[512] = "";
 	int fd = -1;
 	switch_buffer_t *audio_buffer;
-	switch_byte_t *dist_buf;
+	switch_byte_t *ring_data;
 	switch_size_t used;
+	uint32_t i;
 	int skip = 0;
 	switch_memory_pool_t *temp_pool = NULL;
 	uint32_t dir_count = 0, do_shuffle = 0;
@@ -251,7 +264,13 @@ static void *SWITCH_THREAD_FUNC read_stream_thread(switch_thread_t *thread, void
 
 	switch_queue_create(&source->video_q, 500, source->pool);
 	switch_buffer_create_dynamic(&audio_buffer, 1024, source->prebuf + 10, 0);
-	dist_buf = switch_core_alloc(source->pool, source->prebuf + 10);
+
+	source->ring_size = LOCAL_STREAM_RING_FRAMES;
+	source->ring = switch_core_alloc(source->pool, sizeof(*source->ring) * source->ring_size);
+	ring_data = switch_core_alloc(source->pool, source->abuflen * source->ring_size);
+	for (i = 0; i < source->ring_size; i++) {
+		source->ring[i].data = ring_data + (i * source->abuflen);
+	}
 
 	switch_thread_rwlock_create(&source->rwlock, source->pool);
 
@@ -601,42 +620,26 @@ static void *SWITCH_THREAD_FUNC read_stream_thread(switch_thread_t *thread, void
 					switch_buffer_zero(audio_buffer);
 				} else if (used && (!is_open || used >= source->abuflen)) {
 					void *pop;
-					uint32_t bused = 0;
+					local_stream_frame_t *frame = &source->ring[source->write_seq % source->ring_size];
 					local_stream_context_t *cp = NULL;
 
+					/* decode once into the shared ring; every listener pulls from it with its own cursor */
 					switch_assert(source->abuflen <= source->prebuf);
-					used = switch_buffer_read(audio_buffer, dist_buf, source->abuflen);
+					frame->datalen = (uint32_t)switch_buffer_read(audio_buffer, frame->data, source->abuflen);
+					__atomic_store_n(&source->write_seq, source->write_seq + 1, __ATOMIC_RELEASE);
 
+					/* listeners that are not consuming right now stay at the live edge so they never replay stale audio */
 					switch_mutex_lock(source->mutex);
 					for (cp = source->context_list; cp && RUNNING; cp = cp->next) {
-
-						if (!cp->ready) {
-							continue;
-						}
-
-						switch_mutex_lock(cp->audio_mutex);
-
-						if (switch_test_flag(cp->handle, SWITCH_FILE_OPEN)) {
-							if (switch_test_flag(cp->handle, SWITCH_FILE_CALLBACK)) {
-								switch_mutex_unlock(cp->audio_mutex);
-								continue;
-							}
-						}
-
-						bused = (uint32_t)switch_buffer_inuse(cp->audio_buffer);
-
-						if (bused > source->samples * 768) {
-							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "Flushing Stream Handle Buffer [%s() %s:%d] size: %u samples: %ld\n",
-											  cp->func, cp->file, cp->line, bused, (long)source->samples);
-							switch_buffer_zero(cp->audio_buffer);
-						} else {
-							switch_buffer_write(cp->audio_buffer, dist_buf, used);
+						if (!cp->ready || (switch_test_flag(cp->handle, SWITCH_FILE_OPEN) && switch_test_flag(cp->handle, SWITCH_FILE_CALLBACK))) {
+							switch_mutex_lock(cp->audio_mutex);
+							cp->read_seq = source->write_seq;
+							cp->frame_pos = 0;
+							switch_mutex_unlock(cp->audio_mutex);
 						}
-						switch_mutex_unlock(cp->audio_mutex);
 					}
 					switch_mutex_unlock(source->mutex);
 
-
 					while (switch_queue_trypop(source->video_q, &pop) == SWITCH_STATUS_SUCCESS) {
 						switch_image_t *img;
 						switch_image_t *imgcp = NULL;
@@ -909,11 +912,6 @@ static switch_status_t local_stream_file_open(switch_file_handle_t *handle, cons
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Opening Stream [%s] %dhz\n", path, handle->samplerate);
 
 	switch_mutex_init(&context->audio_mutex, SWITCH_MUTEX_NESTED, context->pool);
-	if (switch_buffer_create_dynamic(&context->audio_buffer, 512, 1024, 0) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Memory Error!\n");
-		status = SWITCH_STATUS_MEMERR;
-		goto end;
-	}
 
 	if (!switch_core_has_video() || !source->has_video ||
 		(switch_test_flag(handle, SWITCH_FILE_FLAG_VIDEO) && !source->has_video && !source->blank_img && !source->cover_art && !source->banner_txt)) {
@@ -927,6 +925,8 @@ static switch_status_t local_stream_file_open(switch_file_handle_t *handle, cons
 	context->handle = handle;
 	context->ready = 1;
 	switch_mutex_lock(source->mutex);
+	context->read_seq = __atomic_load_n(&source->write_seq, __ATOMIC_ACQUIRE);
+	context->frame_pos = 0;
 	context->next = source->context_list;
 	source->context_list = context;
 	source->total++;
@@ -980,7 +980,6 @@ static switch_status_t local_stream_file_close(switch_file_handle_t *handle)
 	source->total--;
 
 	switch_img_free(&context->banner_img);
-	switch_buffer_destroy(&context->audio_buffer);
 	switch_mutex_unlock(context->audio_mutex);
 	//switch_core_destroy_memory_pool(&pool);
 
@@ -1148,6 +1147,62 @@ static switch_status_t local_stream_file_read_video(switch_file_handle_t *handle
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* Copy up to need bytes out of the source's shared ring starting at this listener's cursor.
+   The ring lives in the source pool, which the listener pins through its read lock on source->rwlock;
+   a listener that falls too far behind the writer is moved up to the live edge instead. */
+static switch_size_t local_stream_ring_read(local_stream_context_t *context, switch_byte_t *data, switch_size_t need)
+{
+	local_stream_source_t *source = context->source;
+	switch_size_t bytes = 0;
+
+	while (bytes < need) {
+		uint32_t write_seq = __atomic_load_n(&source->write_seq, __ATOMIC_ACQUIRE);
+		local_stream_frame_t *frame;
+		uint32_t chunk;
+
+		if (write_seq == context->read_seq) {
+			break;
+		}
+
+		if (write_seq - context->read_seq > source->ring_size - LOCAL_STREAM_RING_GUARD) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "Flushing Stream Handle Buffer [%s() %s:%d] behind: %u frames\n",
+							  context->func, context->file, context->line, write_seq - context->read_seq);
+			context->read_seq = write_seq;
+			context->frame_pos = 0;
+			break;
+		}
+
+		frame = &source->ring[context->read_seq % source->ring_size];
+		chunk = frame->datalen > context->frame_pos ? frame->datalen - context->frame_pos : 0;
+
+		if (chunk > need - bytes) {
+			chunk = (uint32_t)(need - bytes);
+		}
+
+		memcpy(data + bytes, frame->data + context->frame_pos, chunk);
+
+		/* the writer may have lapped us while copying; drop the chunk if so */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		write_seq = __atomic_load_n(&source->write_seq, __ATOMIC_ACQUIRE);
+
+		if (write_seq - context->read_seq > source->ring_size - LOCAL_STREAM_RING_GUARD) {
+			context->read_seq = write_seq;
+			context->frame_pos = 0;
+			break;
+		}
+
+		bytes += chunk;
+		context->frame_pos += chunk;
+
+		if (context->frame_pos >= frame->datalen) {
+			context->read_seq++;
+			context->frame_pos = 0;
+		}
+	}
+
+	return bytes;
+}
+
 static switch_status_t local_stream_file_read(switch_file_handle_t *handle, void *data, size_t *len)
 {
 	local_stream_context_t *context = handle->private_info;
@@ -1167,8 +1222,9 @@ static switch_status_t local_stream_file_read(switch_file_handle_t *handle, void
 
 	switch_mutex_lock(context->audio_mutex);
 	need = *len * 2 * context->source->channels;
+	bytes = local_stream_ring_read(context, (switch_byte_t *) data, need);
 
-	if ((bytes = switch_buffer_read(context->audio_buffer, data, need))) {
+	if (bytes) {
 		*len = bytes / 2 / context->source->channels;
 	} else {
 		size_t blank;
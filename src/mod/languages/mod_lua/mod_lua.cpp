@@ -42,9 +42,40 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lua_shutdown);
 
 SWITCH_MODULE_DEFINITION_EX(mod_lua, mod_lua_load, mod_lua_shutdown, NULL, SMODF_GLOBAL_SYMBOLS);
+
+#ifndef lua_pushglobaltable
+#define lua_pushglobaltable(L) lua_pushvalue(L, LUA_GLOBALSINDEX)
+#endif
+
+#define LUA_PRISTINE_TABLES "mod_lua_pristine_tables"
+#define LUA_PRISTINE_METATABLES "mod_lua_pristine_metatables"
+
+typedef struct {
+	char *name;
+	char *bytecode;
+	size_t len;
+	time_t mtime;
+	off_t size;
+} lua_chunk_t;
+
 static struct {
 	switch_memory_pool_t *pool;
 	char *xml_handler;
+	switch_mutex_t *mutex;
+	lua_State **states;
+	uint32_t nstates;
+	uint32_t state_pool_size;
+	switch_bool_t chunk_cache;
+	switch_hash_t *chunks;
+	switch_thread_rwlock_t *chunk_rwlock;
+	uint64_t states_created;
+	uint64_t pool_hits;
+	uint64_t pool_misses;
+	uint64_t states_discarded;
+	uint64_t chunk_hits;
+	uint64_t chunk_misses;
+	uint64_t compiles;
+	switch_time_t compile_time;
 } globals;
 
 int luaopen_freeswitch(lua_State * L);
@@ -132,6 +163,286 @@ static lua_State *lua_init(void)
 }
 
 
+/* Record a copy of the table at absolute index t and its metatable, keyed by the table itself.
+   tables and metas are the absolute indexes of the two pristine sets. */
+static void lua_snapshot_table(lua_State * L, int tables, int metas, int t)
+{
+	lua_pushvalue(L, t);
+	lua_rawget(L, tables);
+	if (!lua_isnil(L, -1)) {
+		lua_pop(L, 1);
+		return;
+	}
+	lua_pop(L, 1);
+
+	lua_pushvalue(L, t);
+	lua_newtable(L);
+	lua_pushnil(L);
+	while (lua_next(L, t)) {
+		lua_pushvalue(L, -2);
+		lua_insert(L, -2);
+		lua_rawset(L, -4);
+	}
+	lua_rawset(L, tables);
+
+	lua_pushvalue(L, t);
+	if (!lua_getmetatable(L, t)) {
+		lua_pushboolean(L, 0);
+	}
+	lua_rawset(L, metas);
+}
+
+/* Snapshot every table value of the table at absolute index t */
+static void lua_snapshot_fields(lua_State * L, int tables, int metas, int t)
+{
+	lua_pushnil(L);
+	while (lua_next(L, t)) {
+		if (lua_istable(L, -1)) {
+			lua_snapshot_table(L, tables, metas, lua_gettop(L));
+		}
+		lua_pop(L, 1);
+	}
+}
+
+/* Put the table at absolute index t back to the copy at absolute index snap */
+static void lua_restore_table(lua_State * L, int t, int snap)
+{
+	/* clearing or changing existing fields is allowed while traversing */
+	lua_pushnil(L);
+	while (lua_next(L, t)) {
+		lua_pushvalue(L, -2);
+		lua_rawget(L, snap);
+		if (!lua_rawequal(L, -1, -2)) {
+			lua_pushvalue(L, -3);
+			lua_insert(L, -2);
+			lua_rawset(L, t);
+		} else {
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+	}
+
+	lua_pushnil(L);
+	while (lua_next(L, snap)) {
+		lua_pushvalue(L, -2);
+		lua_insert(L, -2);
+		lua_rawset(L, t);
+	}
+}
+
+/* The globals, every library table (string, table, math, io, os, coroutine, debug, utf8, package, freeswitch ...)
+   one level down from the globals and package.loaded, and the string metatable are recorded with their metatables. */
+static void lua_snapshot_state(lua_State * L)
+{
+	int tables, metas, top = lua_gettop(L);
+
+	lua_newtable(L);
+	tables = lua_gettop(L);
+	lua_newtable(L);
+	metas = lua_gettop(L);
+
+	lua_pushglobaltable(L);
+	lua_snapshot_table(L, tables, metas, lua_gettop(L));
+	lua_snapshot_fields(L, tables, metas, lua_gettop(L));
+	lua_pop(L, 1);
+
+	lua_getglobal(L, "package");
+	if (lua_istable(L, -1)) {
+		lua_getfield(L, -1, "loaded");
+		if (lua_istable(L, -1)) {
+			lua_snapshot_table(L, tables, metas, lua_gettop(L));
+			lua_snapshot_fields(L, tables, metas, lua_gettop(L));
+		}
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+
+	lua_pushliteral(L, "");
+	if (lua_getmetatable(L, -1)) {
+		lua_snapshot_table(L, tables, metas, lua_gettop(L));
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+
+	lua_pushvalue(L, metas);
+	lua_setfield(L, LUA_REGISTRYINDEX, LUA_PRISTINE_METATABLES);
+	lua_pushvalue(L, tables);
+	lua_setfield(L, LUA_REGISTRYINDEX, LUA_PRISTINE_TABLES);
+
+	lua_settop(L, top);
+}
+
+/* Undo what a script did to the globals, the library tables, their metatables and the loaded packages so the state
+   can be handed to the next one.  Objects only reachable from the script (sessions, events, streams) are collected
+   here, like lua_close would. */
+static void lua_reset_state(lua_State * L)
+{
+	int tables, metas;
+
+	lua_settop(L, 0);
+	lua_sethook(L, NULL, 0, 0);
+
+	lua_getfield(L, LUA_REGISTRYINDEX, LUA_PRISTINE_TABLES);
+	tables = lua_gettop(L);
+	lua_getfield(L, LUA_REGISTRYINDEX, LUA_PRISTINE_METATABLES);
+	metas = lua_gettop(L);
+
+	if (lua_istable(L, tables) && lua_istable(L, metas)) {
+		lua_pushnil(L);
+		while (lua_next(L, tables)) {
+			lua_restore_table(L, lua_gettop(L) - 1, lua_gettop(L));
+			lua_pop(L, 1);
+		}
+
+		lua_pushnil(L);
+		while (lua_next(L, metas)) {
+			if (!lua_istable(L, -1)) {
+				lua_pop(L, 1);
+				lua_pushnil(L);
+			}
+			lua_setmetatable(L, -2);
+		}
+	}
+
+	lua_settop(L, 0);
+	lua_gc(L, LUA_GCCOLLECT, 0);
+}
+
+static lua_State *lua_acquire(void)
+{
+	lua_State *L = NULL;
+
+	if (globals.state_pool_size) {
+		switch_mutex_lock(globals.mutex);
+		if (globals.nstates) {
+			L = globals.states[--globals.nstates];
+			globals.pool_hits++;
+		} else {
+			globals.pool_misses++;
+		}
+		switch_mutex_unlock(globals.mutex);
+
+		if (L) {
+			return L;
+		}
+	}
+
+	if ((L = lua_init())) {
+		if (globals.state_pool_size) {
+			lua_snapshot_state(L);
+		}
+
+		switch_mutex_lock(globals.mutex);
+		globals.states_created++;
+		switch_mutex_unlock(globals.mutex);
+	}
+
+	return L;
+}
+
+static void lua_release(lua_State * L)
+{
+	if (!L) {
+		return;
+	}
+
+	if (globals.state_pool_size) {
+		lua_reset_state(L);
+
+		switch_mutex_lock(globals.mutex);
+		if (globals.nstates < globals.state_pool_size) {
+			globals.states[globals.nstates++] = L;
+			L = NULL;
+		} else {
+			globals.states_discarded++;
+		}
+		switch_mutex_unlock(globals.mutex);
+	}
+
+	if (L) {
+		lua_uninit(L);
+	}
+}
+
+static void lua_chunk_destroy(void *ptr)
+{
+	lua_chunk_t *chunk = (lua_chunk_t *) ptr;
+
+	switch_safe_free(chunk->name);
+	switch_safe_free(chunk->bytecode);
+	free(chunk);
+}
+
+static int lua_chunk_writer(lua_State * L, const void *p, size_t sz, void *ud)
+{
+	switch_stream_handle_t *stream = (switch_stream_handle_t *) ud;
+
+	return stream->raw_write_function(stream, (uint8_t *) p, sz) == SWITCH_STATUS_SUCCESS ? 0 : 1;
+}
+
+/* luaL_loadfile with the compiled chunk kept in memory until the file's mtime or size changes */
+static int lua_load_file(lua_State * L, const char *file)
+{
+	struct stat st;
+	lua_chunk_t *chunk;
+	switch_stream_handle_t stream = { 0 };
+	switch_time_t start;
+	int error = -1;
+
+	if (!globals.chunk_cache || stat(file, &st)) {
+		return luaL_loadfile(L, file);
+	}
+
+	switch_thread_rwlock_rdlock(globals.chunk_rwlock);
+	if ((chunk = (lua_chunk_t *) switch_core_hash_find(globals.chunks, file)) && chunk->mtime == st.st_mtime && chunk->size == st.st_size) {
+		error = luaL_loadbuffer(L, chunk->bytecode, chunk->len, chunk->name);
+	}
+	switch_thread_rwlock_unlock(globals.chunk_rwlock);
+
+	if (error != -1) {
+		switch_mutex_lock(globals.mutex);
+		globals.chunk_hits++;
+		switch_mutex_unlock(globals.mutex);
+		return error;
+	}
+
+	start = switch_time_now();
+	if ((error = luaL_loadfile(L, file))) {
+		return error;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	globals.chunk_misses++;
+	globals.compiles++;
+	globals.compile_time += switch_time_now() - start;
+	switch_mutex_unlock(globals.mutex);
+
+	SWITCH_STANDARD_STREAM(stream);
+
+#if LUA_VERSION_NUM >= 503
+	if (!lua_dump(L, lua_chunk_writer, &stream, 0) && stream.data_len) {
+#else
+	if (!lua_dump(L, lua_chunk_writer, &stream) && stream.data_len) {
+#endif
+		chunk = (lua_chunk_t *) calloc(1, sizeof(*chunk));
+		switch_assert(chunk);
+		chunk->name = switch_mprintf("@%s", file);
+		chunk->bytecode = (char *) stream.data;
+		chunk->len = stream.data_len;
+		chunk->mtime = st.st_mtime;
+		chunk->size = st.st_size;
+		stream.data = NULL;
+
+		switch_thread_rwlock_wrlock(globals.chunk_rwlock);
+		switch_core_hash_insert_destructor(globals.chunks, file, chunk, lua_chunk_destroy);
+		switch_thread_rwlock_unlock(globals.chunk_rwlock);
+	}
+
+	switch_safe_free(stream.data);
+
+	return 0;
+}
+
 static int lua_parse_and_execute(lua_State * L, char *input_code, switch_core_session_t *session)
 {
 	int error = 0;
@@ -191,7 +502,7 @@ static int lua_parse_and_execute(lua_State * L, char *input_code, switch_core_se
 				switch_assert(fdup);
 				file = fdup;
 			}
-			error = luaL_loadfile(L, file) || docall(L, 0, 0, 0, 1);
+			error = lua_load_file(L, file) || docall(L, 0, 0, 0, 1);
 			switch_safe_free(fdup);
 		}
 	}
@@ -216,7 +527,7 @@ static void *SWITCH_THREAD_FUNC lua_thread_run(switch_thread_t *thread, void *ob
 {
 	struct lua_thread_helper *lth = (struct lua_thread_helper *) obj;
 	switch_memory_pool_t *pool = lth->pool;
-	lua_State *L = lua_init();	/* opens Lua */
+	lua_State *L = lua_acquire();	/* opens Lua */
 
 	lua_parse_and_execute(L, lth->input_code, NULL);
 
@@ -224,7 +535,7 @@ static void *SWITCH_THREAD_FUNC lua_thread_run(switch_thread_t *thread, void *ob
 
 	switch_core_destroy_memory_pool(&pool);
 
-	lua_uninit(L);
+	lua_release(L);
 
 	return NULL;
 }
@@ -239,7 +550,7 @@ static switch_xml_t lua_fetch(const char *section,
 	lua_State *L = NULL;
 
 	if (!zstr(globals.xml_handler)) {
-		L = lua_init();
+		L = lua_acquire();
 		const char *str;
 		int error;
 
@@ -291,9 +602,7 @@ static switch_xml_t lua_fetch(const char *section,
 
 	switch_safe_free(mycmd);
 
-	if (L) {
-		lua_uninit(L);
-	}
+	lua_release(L);
 
 	return xml;
 }
@@ -322,6 +631,16 @@ static switch_status_t do_config(void)
 
 			if (!strcmp(var, "xml-handler-script")) {
 				globals.xml_handler = switch_core_strdup(globals.pool, val);
+			} else if (!strcmp(var, "state-pool-size")) {
+				int tmp = atoi(val);
+
+				if (tmp >= 0 && tmp <= 1024) {
+					globals.state_pool_size = (uint32_t) tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "state-pool-size must be between 0 and 1024\n");
+				}
+			} else if (!strcmp(var, "chunk-cache")) {
+				globals.chunk_cache = switch_true(val);
 			} else if (!strcmp(var, "xml-handler-bindings")) {
 				if (!zstr(globals.xml_handler)) {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "binding '%s' to '%s'\n", globals.xml_handler, val);
@@ -372,6 +691,11 @@ static switch_status_t do_config(void)
 		}
 	}
 
+	if (globals.state_pool_size) {
+		globals.states = (lua_State **) switch_core_alloc(globals.pool, globals.state_pool_size * sizeof(lua_State *));
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "lua: keeping up to %u idle lua states\n", globals.state_pool_size);
+	}
+
 	if (cpath_stream.data_len) {
 		char *lua_cpath = NULL;
 		if ((lua_cpath = getenv("LUA_CPATH"))) {
@@ -450,7 +774,7 @@ int lua_thread(const char *text)
 
 static void lua_event_handler(switch_event_t *event)
 {
-	lua_State *L = lua_init();
+	lua_State *L = lua_acquire();
 	char *script = NULL;
 
 	if (event->bind_user_data) {
@@ -460,14 +784,14 @@ static void lua_event_handler(switch_event_t *event)
 	mod_lua_conjure_event(L, event, "event", 1);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, "lua event hook: execute '%s'\n", (char *)script);
 	lua_parse_and_execute(L, (char *)script, NULL);
-	lua_uninit(L);
+	lua_release(L);
 
 	switch_safe_free(script);
 }
 
 SWITCH_STANDARD_APP(lua_function)
 {
-	lua_State *L = lua_init();
+	lua_State *L;
 	char *mycmd;
 
 	if (zstr(data)) {
@@ -475,13 +799,15 @@ SWITCH_STANDARD_APP(lua_function)
 		return;
 	}
 
+	L = lua_acquire();
+
 	mod_lua_conjure_session(L, session, "session", 1);
 
 	mycmd = strdup((char *) data);
 	switch_assert(mycmd);
 
 	lua_parse_and_execute(L, mycmd, session);
-	lua_uninit(L);
+	lua_release(L);
 	free(mycmd);
 
 }
@@ -501,7 +827,7 @@ SWITCH_STANDARD_API(luarun_api_function)
 
 SWITCH_STANDARD_CHAT_APP(lua_chat_function)
 {
-	lua_State *L = lua_init();
+	lua_State *L = lua_acquire();
 	char *dup = NULL;
 
 	if (data) {
@@ -510,7 +836,7 @@ SWITCH_STANDARD_CHAT_APP(lua_chat_function)
 
 	mod_lua_conjure_event(L, message, "message", 1);
 	lua_parse_and_execute(L, (char *)dup, NULL);
-	lua_uninit(L);
+	lua_release(L);
 
 	switch_safe_free(dup);
 
@@ -527,7 +853,7 @@ SWITCH_STANDARD_API(lua_api_function)
 	if (zstr(cmd)) {
 		stream->write_function(stream, "");
 	} else {
-		lua_State *L = lua_init();
+		lua_State *L = lua_acquire();
 		mycmd = strdup(cmd);
 		switch_assert(mycmd);
 
@@ -552,15 +878,44 @@ SWITCH_STANDARD_API(lua_api_function)
 				stream->write_function(stream, "-ERR Cannot execute script\n");
 			}
 		}
-		lua_uninit(L);
+		lua_release(L);
 		free(mycmd);
 	}
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_STANDARD_API(luastats_api_function)
+{
+	uint32_t chunks = 0;
+	switch_hash_index_t *hi;
+
+	switch_thread_rwlock_rdlock(globals.chunk_rwlock);
+	for (hi = switch_core_hash_first(globals.chunks); hi; hi = switch_core_hash_next(&hi)) {
+		chunks++;
+	}
+	switch_thread_rwlock_unlock(globals.chunk_rwlock);
+
+	switch_mutex_lock(globals.mutex);
+	stream->write_function(stream, "state-pool-size: %u\n", globals.state_pool_size);
+	stream->write_function(stream, "states-idle: %u\n", globals.nstates);
+	stream->write_function(stream, "states-created: %" SWITCH_UINT64_T_FMT "\n", globals.states_created);
+	stream->write_function(stream, "states-discarded: %" SWITCH_UINT64_T_FMT "\n", globals.states_discarded);
+	stream->write_function(stream, "pool-hits: %" SWITCH_UINT64_T_FMT "\n", globals.pool_hits);
+	stream->write_function(stream, "pool-misses: %" SWITCH_UINT64_T_FMT "\n", globals.pool_misses);
+	stream->write_function(stream, "chunk-cache: %s\n", globals.chunk_cache ? "true" : "false");
+	stream->write_function(stream, "chunks-cached: %u\n", chunks);
+	stream->write_function(stream, "chunk-hits: %" SWITCH_UINT64_T_FMT "\n", globals.chunk_hits);
+	stream->write_function(stream, "chunk-misses: %" SWITCH_UINT64_T_FMT "\n", globals.chunk_misses);
+	stream->write_function(stream, "compiles: %" SWITCH_UINT64_T_FMT "\n", globals.compiles);
+	stream->write_function(stream, "compile-time-ms: %0.3f\n", (double) globals.compile_time / 1000);
+	switch_mutex_unlock(globals.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_DIALPLAN(lua_dialplan_hunt)
 {
-	lua_State *L = lua_init();
+	lua_State *L = lua_acquire();
 	switch_caller_extension_t *extension = NULL;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	char *cmd = NULL;
@@ -672,7 +1027,7 @@ SWITCH_STANDARD_DIALPLAN(lua_dialplan_hunt)
 
  done:
 	switch_safe_free(cmd);
-	lua_uninit(L);
+	lua_release(L);
 	return extension;
 }
 
@@ -688,6 +1043,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load)
 
 	SWITCH_ADD_API(api_interface, "luarun", "run a script", luarun_api_function, "<script>");
 	SWITCH_ADD_API(api_interface, "lua", "run a script as an api function", lua_api_function, "<script>");
+	SWITCH_ADD_API(api_interface, "luastats", "lua state pool and chunk cache statistics", luastats_api_function, "");
 	SWITCH_ADD_APP(app_interface, "lua", "Launch LUA ivr", "Run a lua ivr on a channel", lua_function, "<script>",
 				   SAF_SUPPORT_NOMEDIA | SAF_ROUTING_EXEC | SAF_ZOMBIE_EXEC | SAF_SUPPORT_TEXT_ONLY);
 	SWITCH_ADD_DIALPLAN(dp_interface, "LUA", lua_dialplan_hunt);
@@ -696,6 +1052,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load)
 
 
 	globals.pool = pool;
+	globals.chunk_cache = SWITCH_TRUE;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_thread_rwlock_create(&globals.chunk_rwlock, globals.pool);
+	switch_core_hash_init(&globals.chunks);
 	do_config();
 
 	/* indicate that the module should continue to be loaded */
@@ -706,6 +1066,17 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lua_shutdown)
 {
 	switch_event_unbind_callback(lua_event_handler);
 
+	switch_mutex_lock(globals.mutex);
+	while (globals.nstates) {
+		lua_uninit(globals.states[--globals.nstates]);
+	}
+	globals.state_pool_size = 0;
+	switch_mutex_unlock(globals.mutex);
+
+	switch_thread_rwlock_wrlock(globals.chunk_rwlock);
+	switch_core_hash_destroy(&globals.chunks);
+	switch_thread_rwlock_unlock(globals.chunk_rwlock);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -56,6 +56,32 @@ FST_CORE_BEGIN("conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(state_pool_test)
+		{
+			switch_stream_handle_t stream = { 0 };
+			const char *hits;
+			int i;
+
+			for (i = 0; i < 2; i++) {
+				SWITCH_STANDARD_STREAM(stream);
+				switch_api_execute("lua", "test_state_pool.lua", NULL, &stream);
+				fst_check_string_starts_with((char *)stream.data, "+OK");
+				switch_safe_free(stream.data);
+			}
+
+			SWITCH_STANDARD_STREAM(stream);
+			switch_api_execute("luastats", NULL, NULL, &stream);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "LUA STATS:\n%s\n", (char *)stream.data);
+			hits = strstr((char *)stream.data, "pool-hits: ");
+			fst_requires(hits);
+			fst_check(atoi(hits + strlen("pool-hits: ")) >= 1);
+			hits = strstr((char *)stream.data, "chunk-hits: ");
+			fst_requires(hits);
+			fst_check(atoi(hits + strlen("chunk-hits: ")) >= 1);
+			switch_safe_free(stream.data);
+		}
+		FST_TEST_END()
+
 		FST_TEARDOWN_BEGIN()
 		{
 		}
@@ -0,0 +1,17 @@
+-- run twice by test_mod_lua: a pooled state must not keep globals, library tables or metatables from the previous run
+if state_pool_marker ~= nil or package.loaded["state_pool_marker"] ~= nil then
+	stream:write("-ERR state leaked from a previous run\n")
+elseif string.state_pool_marker ~= nil or math.state_pool_marker ~= nil or ("").state_pool_marker ~= nil then
+	stream:write("-ERR library table leaked from a previous run\n")
+elseif getmetatable(_G) ~= nil or string.upper("x") ~= "X" then
+	stream:write("-ERR metatable leaked from a previous run\n")
+else
+	state_pool_marker = true
+	package.loaded["state_pool_marker"] = true
+	string.state_pool_marker = true
+	math.state_pool_marker = true
+	getmetatable("").__index = setmetatable({ state_pool_marker = true }, { __index = string })
+	string.upper = function(s) return s end
+	setmetatable(_G, { __index = function() return true end })
+	stream:write("+OK\n")
+end
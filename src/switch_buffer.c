@@ -402,6 +402,179 @@ SWITCH_DECLARE(void) switch_buffer_destroy(switch_buffer_t **buffer)
 	}
 }
 
+/* Single-producer / single-consumer lock free ring.
+ * head is only ever advanced by the writer and tail only by the reader,
+ * so the only synchronization needed is publishing the indices. */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ring_load(_p) __atomic_load_n((_p), __ATOMIC_ACQUIRE)
+#define ring_store(_p, _v) __atomic_store_n((_p), (_v), __ATOMIC_RELEASE)
+#elif defined(_MSC_VER)
+#define ring_load(_p) ring_load_msvc(_p)
+#define ring_store(_p, _v) do { _ReadWriteBarrier(); *(_p) = (_v); MemoryBarrier(); } while(0)
+static __inline switch_size_t ring_load_msvc(volatile switch_size_t *p)
+{
+	switch_size_t v = *p;
+	_ReadWriteBarrier();
+	return v;
+}
+#else
+#define ring_load(_p) (*(_p))
+#define ring_store(_p, _v) (*(_p) = (_v))
+#endif
+
+struct switch_ring_buffer {
+	switch_byte_t *data;
+	switch_size_t size;
+	switch_size_t mask;
+	volatile switch_size_t head;
+	volatile switch_size_t tail;
+	uint8_t dynamic;
+};
+
+SWITCH_DECLARE(switch_status_t) switch_ring_buffer_create(switch_memory_pool_t *pool, switch_ring_buffer_t **ring, switch_size_t size)
+{
+	switch_ring_buffer_t *new_ring;
+	switch_size_t real_size = 1;
+
+	if (!size) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	while (real_size < size) {
+		real_size <<= 1;
+	}
+
+	if (pool) {
+		if (!(new_ring = switch_core_alloc(pool, sizeof(*new_ring))) || !(new_ring->data = switch_core_alloc(pool, real_size))) {
+			return SWITCH_STATUS_MEMERR;
+		}
+	} else {
+		switch_zmalloc(new_ring, sizeof(*new_ring));
+		switch_malloc(new_ring->data, real_size);
+		new_ring->dynamic = 1;
+	}
+
+	new_ring->size = real_size;
+	new_ring->mask = real_size - 1;
+	*ring = new_ring;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_inuse(switch_ring_buffer_t *ring)
+{
+	return ring_load(&ring->head) - ring_load(&ring->tail);
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_freespace(switch_ring_buffer_t *ring)
+{
+	return ring->size - switch_ring_buffer_inuse(ring);
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_write(switch_ring_buffer_t *ring, const void *data, switch_size_t datalen)
+{
+	switch_size_t head = ring->head, tail = ring_load(&ring->tail), pos, first;
+
+	if (!datalen || ring->size - (head - tail) < datalen) {
+		return 0;
+	}
+
+	pos = head & ring->mask;
+	first = ring->size - pos;
+
+	if (first > datalen) {
+		first = datalen;
+	}
+
+	memcpy(ring->data + pos, data, first);
+
+	if (first < datalen) {
+		memcpy(ring->data, (const switch_byte_t *) data + first, datalen - first);
+	}
+
+	ring_store(&ring->head, head + datalen);
+
+	return datalen;
+}
+
+static switch_size_t ring_copy_out(switch_ring_buffer_t *ring, void *data, switch_size_t datalen, switch_size_t *tailp)
+{
+	switch_size_t tail = ring->tail, head = ring_load(&ring->head), pos, first, avail = head - tail;
+
+	if (datalen > avail) {
+		datalen = avail;
+	}
+
+	if (!datalen) {
+		return 0;
+	}
+
+	pos = tail & ring->mask;
+	first = ring->size - pos;
+
+	if (first > datalen) {
+		first = datalen;
+	}
+
+	memcpy(data, ring->data + pos, first);
+
+	if (first < datalen) {
+		memcpy((switch_byte_t *) data + first, ring->data, datalen - first);
+	}
+
+	*tailp = tail + datalen;
+
+	return datalen;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_peek(switch_ring_buffer_t *ring, void *data, switch_size_t datalen)
+{
+	switch_size_t tail;
+
+	return ring_copy_out(ring, data, datalen, &tail);
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_read(switch_ring_buffer_t *ring, void *data, switch_size_t datalen)
+{
+	switch_size_t tail, r;
+
+	if ((r = ring_copy_out(ring, data, datalen, &tail))) {
+		ring_store(&ring->tail, tail);
+	}
+
+	return r;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ring_buffer_toss(switch_ring_buffer_t *ring, switch_size_t datalen)
+{
+	switch_size_t tail = ring->tail, avail = ring_load(&ring->head) - tail;
+
+	if (datalen > avail) {
+		datalen = avail;
+	}
+
+	ring_store(&ring->tail, tail + datalen);
+
+	return datalen;
+}
+
+SWITCH_DECLARE(void) switch_ring_buffer_zero(switch_ring_buffer_t *ring)
+{
+	ring_store(&ring->tail, ring_load(&ring->head));
+}
+
+SWITCH_DECLARE(void) switch_ring_buffer_destroy(switch_ring_buffer_t **ring)
+{
+	if (ring && *ring) {
+		if ((*ring)->dynamic) {
+			switch_safe_free((*ring)->data);
+			free(*ring);
+		}
+		*ring = NULL;
+	}
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
@@ -51,6 +51,9 @@ static struct {
 	switch_hash_t *device_hash;
 	switch_mutex_t *device_mutex;
 	switch_device_state_binding_t *device_bindings;
+	switch_hash_t *expand_hash;
+	switch_thread_rwlock_t *expand_rwlock;
+	uint32_t expand_count;
 } globals;
 
 static struct switch_cause_table CAUSE_CHART[] = {
@@ -167,6 +170,7 @@ struct switch_channel {
 	int state_handler_index;
 	switch_event_t *variables;
 	switch_event_t *scope_variables;
+	switch_event_snapshot_t *var_snapshot;
 	switch_hash_t *private_hash;
 	switch_hash_t *app_flag_hash;
 	switch_call_cause_t hangup_cause;
@@ -188,6 +192,15 @@ struct switch_channel {
 static void process_device_hup(switch_channel_t *channel);
 static void switch_channel_check_device_state(switch_channel_t *channel, switch_channel_callstate_t callstate);
 
+/* call with profile_mutex held whenever variables or scope_variables change,
+   events already holding the old snapshot keep it */
+static inline void channel_variables_changed(switch_channel_t *channel)
+{
+	if (channel->var_snapshot) {
+		switch_event_snapshot_release(&channel->var_snapshot);
+	}
+}
+
 SWITCH_DECLARE(switch_hold_record_t *) switch_channel_get_hold_record(switch_channel_t *channel)
 {
 	return channel->hold_record;
@@ -748,6 +761,7 @@ SWITCH_DECLARE(void) switch_channel_uninit(switch_channel_t *channel)
 	}
 
 	switch_mutex_lock(channel->profile_mutex);
+	channel_variables_changed(channel);
 	switch_event_destroy(&channel->variables);
 	switch_event_destroy(&channel->api_list);
 	switch_event_destroy(&channel->var_list);
@@ -922,6 +936,7 @@ SWITCH_DECLARE(const char *) switch_channel_get_hold_music_partner(switch_channe
 SWITCH_DECLARE(void) switch_channel_set_scope_variables(switch_channel_t *channel, switch_event_t **event)
 {
 	switch_mutex_lock(channel->profile_mutex);
+	channel_variables_changed(channel);
 
 	if (event && *event) { /* push */
 		(*event)->next = channel->scope_variables;
@@ -1058,6 +1073,8 @@ SWITCH_DECLARE(switch_event_header_t *) switch_channel_variable_first(switch_cha
 	switch_assert(channel != NULL);
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && (hi = channel->variables->headers)) {
+		/* the caller gets writable headers */
+		channel_variables_changed(channel);
 		channel->vi = 1;
 	} else {
 		switch_mutex_unlock(channel->profile_mutex);
@@ -1470,6 +1487,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_set_variable_var_check(switch_cha
 
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && !zstr(varname)) {
+		channel_variables_changed(channel);
 		if (zstr(value)) {
 			switch_event_del_header(channel->variables, varname);
 		} else {
@@ -1501,6 +1519,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_add_variable_var_check(switch_cha
 
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && !zstr(varname)) {
+		channel_variables_changed(channel);
 		if (zstr(value)) {
 			switch_event_del_header(channel->variables, varname);
 		} else {
@@ -1536,6 +1555,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_set_variable_printf(switch_channe
 
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && !zstr(varname)) {
+		channel_variables_changed(channel);
 		switch_event_del_header(channel->variables, varname);
 
 		va_start(ap, fmt);
@@ -2689,7 +2709,6 @@ SWITCH_DECLARE(void) switch_channel_event_set_basic_data(switch_channel_t *chann
 
 SWITCH_DECLARE(void) switch_channel_event_set_extended_data(switch_channel_t *channel, switch_event_t *event)
 {
-	switch_event_header_t *hi;
 	int global_verbose_events = -1;
 
 	switch_mutex_lock(channel->profile_mutex);
@@ -2730,41 +2749,14 @@ SWITCH_DECLARE(void) switch_channel_event_set_extended_data(switch_channel_t *ch
 		event->event_id == SWITCH_EVENT_TEXT || 
 		event->event_id == SWITCH_EVENT_CUSTOM) {
 
-		/* Index Variables */
-
-		if (channel->scope_variables) {
-			switch_event_t *ep;
-
-			for (ep = channel->scope_variables; ep; ep = ep->next) {
-				for (hi = ep->headers; hi; hi = hi->next) {
-					char buf[1024];
-					char *vvar = NULL, *vval = NULL;
-
-					vvar = (char *) hi->name;
-					vval = (char *) hi->value;
-
-					switch_assert(vvar && vval);
-					switch_snprintf(buf, sizeof(buf), "scope_variable_%s", vvar);
+		/* Index Variables, copied into the event only once something reads them */
 
-					if (!switch_event_get_header(event, buf)) {
-						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, buf, vval);
-					}
-				}
-			}
+		if (!channel->var_snapshot && (channel->variables || channel->scope_variables)) {
+			channel->var_snapshot = switch_event_snapshot_create(channel->variables, channel->scope_variables);
 		}
 
-		if (channel->variables) {
-			for (hi = channel->variables->headers; hi; hi = hi->next) {
-				char buf[1024];
-				char *vvar = NULL, *vval = NULL;
-
-				vvar = (char *) hi->name;
-				vval = (char *) hi->value;
-
-				switch_assert(vvar && vval);
-				switch_snprintf(buf, sizeof(buf), "variable_%s", vvar);
-				switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, buf, vval);
-			}
+		if (channel->var_snapshot) {
+			switch_event_set_snapshot(event, channel->var_snapshot);
 		}
 	}
 
@@ -3936,7 +3928,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_perform_answer(switch_channel_t *
 	memset(c, 0, olen - cpos);\
 	}}                           \
 
-SWITCH_DECLARE(char *) switch_channel_expand_variables_check(switch_channel_t *channel, const char *in, switch_event_t *var_list, switch_event_t *api_list, uint32_t recur)
+SWITCH_DECLARE(char *) switch_channel_expand_variables_uncompiled(switch_channel_t *channel, const char *in, switch_event_t *var_list, switch_event_t *api_list, uint32_t recur)
 {
 	char *p, *c = NULL;
 	char *data, *indup, *endof_indup;
@@ -4096,7 +4088,7 @@ SWITCH_DECLARE(char *) switch_channel_expand_variables_check(switch_channel_t *c
 					char *ptr;
 					int idx = -1;
 
-					if ((expanded = switch_channel_expand_variables_check(channel, (char *) vname, var_list, api_list, recur+1)) == vname) {
+					if ((expanded = switch_channel_expand_variables_uncompiled(channel, (char *) vname, var_list, api_list, recur+1)) == vname) {
 						expanded = NULL;
 					} else {
 						vname = expanded;
@@ -4121,7 +4113,7 @@ SWITCH_DECLARE(char *) switch_channel_expand_variables_check(switch_channel_t *c
 							sub_val = "<Variable Expansion Permission Denied>";
 						}
 
-						if ((expanded_sub_val = switch_channel_expand_variables_check(channel, sub_val, var_list, api_list, recur+1)) == sub_val) {
+						if ((expanded_sub_val = switch_channel_expand_variables_uncompiled(channel, sub_val, var_list, api_list, recur+1)) == sub_val) {
 							expanded_sub_val = NULL;
 						} else {
 							sub_val = expanded_sub_val;
@@ -4160,13 +4152,13 @@ SWITCH_DECLARE(char *) switch_channel_expand_variables_check(switch_channel_t *c
 					if (stream.data) {
 						char *expanded_vname = NULL;
 
-						if ((expanded_vname = switch_channel_expand_variables_check(channel, (char *) vname, var_list, api_list, recur+1)) == vname) {
+						if ((expanded_vname = switch_channel_expand_variables_uncompiled(channel, (char *) vname, var_list, api_list, recur+1)) == vname) {
 							expanded_vname = NULL;
 						} else {
 							vname = expanded_vname;
 						}
 
-						if ((expanded = switch_channel_expand_variables_check(channel, vval, var_list, api_list, recur+1)) == vval) {
+						if ((expanded = switch_channel_expand_variables_uncompiled(channel, vval, var_list, api_list, recur+1)) == vval) {
 							expanded = NULL;
 						} else {
 							vval = expanded;
@@ -4239,6 +4231,569 @@ SWITCH_DECLARE(char *) switch_channel_expand_variables_check(switch_channel_t *c
 	return data;
 }
 
+/* Compiled expansion templates.
+ *
+ * An input string is scanned once into a program of literal spans, variable
+ * references and api calls.  Programs are cached by their source text, so
+ * dialplan and config strings that are expanded on every call only pay for
+ * the lookups and the final copy.  The scanner below mirrors the one in
+ * switch_channel_expand_variables_uncompiled() character for character.
+ *
+ * Only top level strings are cached, the values they pull in are expanded
+ * directly.  A full cache evicts one entry at a time with a clock sweep: a
+ * hit marks the entry, the sweep clears marks and evicts the first entry
+ * that was not used since it last went by.
+ */
+
+#define EXPAND_CACHE_MAX 2048
+#define EXPAND_CACHE_MAX_KEY 8192
+
+typedef enum {
+	EXPAND_OP_LITERAL,
+	EXPAND_OP_VAR,
+	EXPAND_OP_API
+} expand_op_type_t;
+
+typedef struct {
+	expand_op_type_t type;
+	char *text;
+	size_t len;
+	char *args;
+	switch_bool_t expand_text;
+	switch_bool_t expand_args;
+	int offset;
+	int ooffset;
+	int idx;
+} expand_op_t;
+
+struct expand_program {
+	switch_atomic_t refs;
+	switch_atomic_t used;
+	char *key;
+	uint32_t nops;
+	uint32_t aops;
+	expand_op_t *ops;
+};
+
+typedef struct expand_program expand_program_t;
+
+/* cached programs in insertion order for the clock sweep, guarded by the write side of expand_rwlock */
+static expand_program_t *expand_clock[EXPAND_CACHE_MAX];
+static uint32_t expand_hand;
+
+typedef struct {
+	const char *data;
+	size_t len;
+	char *free_me;
+} expand_piece_t;
+
+static switch_bool_t expand_needed(const char *in)
+{
+	return (!zstr(in) && (switch_string_var_check_const(in) || switch_string_has_escaped_data(in))) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+static void expand_parse_name(char *vname, int *offset, int *ooffset, int *idx)
+{
+	char *ptr;
+
+	if ((ptr = strchr(vname, ':'))) {
+		*ptr++ = '\0';
+		*offset = atoi(ptr);
+		if ((ptr = strchr(ptr, ':'))) {
+			ptr++;
+			*ooffset = atoi(ptr);
+		}
+	}
+
+	if ((ptr = strchr(vname, '[')) && strchr(ptr, ']')) {
+		*ptr++ = '\0';
+		*idx = atoi(ptr);
+	}
+}
+
+static void expand_program_destroy(expand_program_t *prog)
+{
+	uint32_t i;
+
+	for (i = 0; i < prog->nops; i++) {
+		switch_safe_free(prog->ops[i].text);
+		switch_safe_free(prog->ops[i].args);
+	}
+
+	switch_safe_free(prog->ops);
+	switch_safe_free(prog->key);
+	free(prog);
+}
+
+static void expand_program_release(void *ptr)
+{
+	expand_program_t *prog = (expand_program_t *) ptr;
+
+	if (!switch_atomic_dec(&prog->refs)) {
+		expand_program_destroy(prog);
+	}
+}
+
+static expand_op_t *expand_program_add(expand_program_t *prog, expand_op_type_t type)
+{
+	expand_op_t *op;
+
+	if (prog->nops == prog->aops) {
+		uint32_t aops = prog->aops ? prog->aops * 2 : 8;
+		expand_op_t *ops;
+
+		if (!(ops = realloc(prog->ops, aops * sizeof(*ops)))) {
+			return NULL;
+		}
+
+		prog->ops = ops;
+		prog->aops = aops;
+	}
+
+	op = &prog->ops[prog->nops++];
+	memset(op, 0, sizeof(*op));
+	op->type = type;
+	op->idx = -1;
+
+	return op;
+}
+
+static switch_bool_t expand_program_flush(expand_program_t *prog, char *lit, char **l)
+{
+	expand_op_t *op;
+	size_t len = *l - lit;
+
+	if (!len) {
+		return SWITCH_TRUE;
+	}
+
+	if (!(op = expand_program_add(prog, EXPAND_OP_LITERAL)) || !(op->text = malloc(len + 1))) {
+		return SWITCH_FALSE;
+	}
+
+	memcpy(op->text, lit, len);
+	op->text[len] = '\0';
+	op->len = len;
+	*l = lit;
+
+	return SWITCH_TRUE;
+}
+
+static expand_program_t *expand_program_compile(const char *in)
+{
+	expand_program_t *prog = NULL;
+	char *p, *indup, *endof_indup, *lit, *l, *sb;
+	size_t vtype = 0, br = 0;
+	int nv = 0, ok = 1;
+
+	switch_zmalloc(prog, sizeof(*prog));
+	prog->refs = 1;
+
+	indup = strdup(in);
+	switch_assert(indup);
+	endof_indup = end_of_p(indup) + 1;
+	switch_zmalloc(lit, strlen(in) + 1);
+	l = lit;
+
+	for (p = indup; ok && p && p < endof_indup && *p; p++) {
+		int global = 0;
+		vtype = 0;
+
+		if (*p == '\\') {
+			if (*(p + 1) == '$') {
+				nv = 1;
+				p++;
+				if (*(p + 1) == '$') {
+					p++;
+				}
+			} else if (*(p + 1) == '\'') {
+				p++;
+				continue;
+			} else if (*(p + 1) == '\\') {
+				*l++ = *p++;
+				continue;
+			}
+		}
+
+		if (*p == '$' && !nv) {
+
+			if (*(p + 1) == '$') {
+				p++;
+				global++;
+			}
+
+			if (*(p + 1)) {
+				if (*(p + 1) == '{') {
+					vtype = global ? 3 : 1;
+				} else {
+					nv = 1;
+				}
+			} else {
+				nv = 1;
+			}
+		}
+
+		if (nv) {
+			*l++ = *p;
+			nv = 0;
+			continue;
+		}
+
+		if (vtype) {
+			char *s = p, *e, *vname, *vval = NULL;
+			expand_op_t *op;
+
+			s++;
+
+			if ((vtype == 1 || vtype == 3) && *s == '{') {
+				br = 1;
+				s++;
+			}
+
+			e = s;
+			vname = s;
+			while (*e) {
+				if (br == 1 && *e == '}') {
+					br = 0;
+					*e++ = '\0';
+					break;
+				}
+
+				if (br > 0) {
+					if (e != s && *e == '{') {
+						br++;
+					} else if (br > 1 && *e == '}') {
+						br--;
+					}
+				}
+
+				e++;
+			}
+			p = e > endof_indup ? endof_indup : e;
+
+			for (sb = vname; sb && *sb; sb++) {
+				if (*sb == ' ') {
+					vval = sb;
+					break;
+				} else if (*sb == '(') {
+					vval = sb;
+					br = 1;
+					break;
+				}
+			}
+
+			if (vval) {
+				e = vval - 1;
+				*vval++ = '\0';
+				while (*e == ' ') {
+					*e-- = '\0';
+				}
+				e = vval;
+
+				while (e && *e) {
+					if (*e == '(') {
+						br++;
+					} else if (br > 1 && *e == ')') {
+						br--;
+					} else if (br == 1 && *e == ')') {
+						*e = '\0';
+						break;
+					}
+					e++;
+				}
+
+				vtype = 2;
+			}
+
+			if (!expand_program_flush(prog, lit, &l) || !(op = expand_program_add(prog, vtype == 2 ? EXPAND_OP_API : EXPAND_OP_VAR))) {
+				ok = 0;
+				break;
+			}
+
+			op->text = strdup(vname);
+			switch_assert(op->text);
+			op->expand_text = expand_needed(op->text);
+
+			if (vtype == 2) {
+				op->args = strdup(vval);
+				switch_assert(op->args);
+				op->expand_args = expand_needed(op->args);
+			} else if (!op->expand_text) {
+				expand_parse_name(op->text, &op->offset, &op->ooffset, &op->idx);
+			}
+
+			br = 0;
+		}
+
+		if (*p == '$') {
+			p--;
+		} else if (*p) {
+			*l++ = *p;
+		}
+	}
+
+	if (ok) {
+		ok = expand_program_flush(prog, lit, &l);
+	}
+
+	free(lit);
+	free(indup);
+
+	if (!ok) {
+		expand_program_destroy(prog);
+		prog = NULL;
+	}
+
+	return prog;
+}
+
+static expand_program_t *expand_program_get(const char *in)
+{
+	expand_program_t *prog = NULL, *existing = NULL;
+	int cache = globals.expand_hash && strlen(in) <= EXPAND_CACHE_MAX_KEY;
+
+	if (cache) {
+		switch_thread_rwlock_rdlock(globals.expand_rwlock);
+		if (globals.expand_hash && (prog = switch_core_hash_find(globals.expand_hash, in))) {
+			switch_atomic_inc(&prog->refs);
+			if (!switch_atomic_read(&prog->used)) {
+				switch_atomic_set(&prog->used, 1);
+			}
+		}
+		switch_thread_rwlock_unlock(globals.expand_rwlock);
+
+		if (prog) {
+			return prog;
+		}
+	}
+
+	if (!(prog = expand_program_compile(in)) || !cache) {
+		return prog;
+	}
+
+	switch_thread_rwlock_wrlock(globals.expand_rwlock);
+	if (globals.expand_hash) {
+		if ((existing = switch_core_hash_find(globals.expand_hash, in))) {
+			switch_atomic_inc(&existing->refs);
+		} else {
+			expand_program_t *victim;
+			uint32_t slot;
+
+			if (globals.expand_count < EXPAND_CACHE_MAX) {
+				slot = globals.expand_count++;
+			} else {
+				/* second chance: skip entries hit since the hand last passed, evict the first one that was not.
+				   A slot left empty by a failed insert is taken as it is. */
+				while ((victim = expand_clock[expand_hand]) && switch_atomic_read(&victim->used)) {
+					switch_atomic_set(&victim->used, 0);
+					expand_hand = (expand_hand + 1) % EXPAND_CACHE_MAX;
+				}
+
+				slot = expand_hand;
+				expand_hand = (expand_hand + 1) % EXPAND_CACHE_MAX;
+
+				if (victim) {
+					expand_clock[slot] = NULL;
+					switch_core_hash_delete(globals.expand_hash, victim->key);
+				}
+			}
+
+			switch_atomic_inc(&prog->refs);
+			if ((prog->key = strdup(in)) &&
+				switch_core_hash_insert_destructor(globals.expand_hash, in, prog, expand_program_release) == SWITCH_STATUS_SUCCESS) {
+				expand_clock[slot] = prog;
+			} else {
+				switch_atomic_dec(&prog->refs);
+			}
+		}
+	}
+	switch_thread_rwlock_unlock(globals.expand_rwlock);
+
+	if (existing) {
+		expand_program_release(prog);
+		prog = existing;
+	}
+
+	return prog;
+}
+
+static void expand_pieces_free(expand_piece_t *pieces, uint32_t n)
+{
+	uint32_t i;
+
+	for (i = 0; i < n; i++) {
+		switch_safe_free(pieces[i].free_me);
+	}
+}
+
+static char *expand_program_run(expand_program_t *prog, switch_channel_t *channel, const char *in,
+								switch_event_t *var_list, switch_event_t *api_list, uint32_t recur)
+{
+	expand_piece_t stack_pieces[32], *pieces = stack_pieces;
+	size_t total = 0;
+	uint32_t i;
+	char *data = NULL, *c;
+
+	if (prog->nops > sizeof(stack_pieces) / sizeof(stack_pieces[0])) {
+		switch_zmalloc(pieces, prog->nops * sizeof(*pieces));
+	} else {
+		memset(stack_pieces, 0, sizeof(stack_pieces));
+	}
+
+	for (i = 0; i < prog->nops; i++) {
+		expand_op_t *op = &prog->ops[i];
+		expand_piece_t *piece = &pieces[i];
+
+		if (op->type == EXPAND_OP_LITERAL) {
+			piece->data = op->text;
+			piece->len = op->len;
+		} else if (op->type == EXPAND_OP_VAR) {
+			char *expanded = NULL, *expanded_sub_val = NULL;
+			const char *vname = op->text, *sub_val;
+			int offset = op->offset, ooffset = op->ooffset, idx = op->idx;
+
+			if (op->expand_text) {
+				if ((expanded = switch_channel_expand_variables_check(channel, op->text, var_list, api_list, recur+1)) == op->text) {
+					expanded = strdup(op->text);
+					switch_assert(expanded);
+				}
+				expand_parse_name(expanded, &offset, &ooffset, &idx);
+				vname = expanded;
+			}
+
+			if ((sub_val = switch_channel_get_variable_dup(channel, vname, SWITCH_TRUE, idx))) {
+				size_t slen;
+
+				if (var_list && !switch_event_check_permission_list(var_list, vname)) {
+					sub_val = "<Variable Expansion Permission Denied>";
+				}
+
+				if ((expanded_sub_val = switch_channel_expand_variables_check(channel, sub_val, var_list, api_list, recur+1)) == sub_val) {
+					expanded_sub_val = NULL;
+				} else {
+					sub_val = expanded_sub_val;
+				}
+
+				slen = strlen(sub_val);
+
+				if (offset >= 0) {
+					if ((size_t) offset > slen) {
+						slen = 0;
+					} else {
+						sub_val += offset;
+						slen -= offset;
+					}
+				} else if ((size_t) abs(offset) <= slen) {
+					sub_val += slen + offset;
+					slen = abs(offset);
+				}
+
+				if (ooffset > 0 && (size_t) ooffset < slen) {
+					slen = ooffset;
+				}
+
+				piece->data = sub_val;
+				piece->len = slen;
+				piece->free_me = expanded_sub_val;
+			}
+
+			switch_safe_free(expanded);
+		} else {
+			switch_stream_handle_t stream = { 0 };
+			char *expanded_vname = NULL, *expanded = NULL;
+			const char *vname = op->text, *vval = op->args;
+
+			SWITCH_STANDARD_STREAM(stream);
+
+			if (!stream.data) {
+				switch_log_printf(SWITCH_CHANNEL_CHANNEL_LOG(channel), SWITCH_LOG_CRIT, "Memory Error!\n");
+				expand_pieces_free(pieces, i);
+				if (pieces != stack_pieces) {
+					free(pieces);
+				}
+				return (char *) in;
+			}
+
+			if (op->expand_text) {
+				if ((expanded_vname = switch_channel_expand_variables_check(channel, vname, var_list, api_list, recur+1)) == vname) {
+					expanded_vname = NULL;
+				} else {
+					vname = expanded_vname;
+				}
+			}
+
+			if (op->expand_args) {
+				if ((expanded = switch_channel_expand_variables_check(channel, vval, var_list, api_list, recur+1)) == vval) {
+					expanded = NULL;
+				} else {
+					vval = expanded;
+				}
+			}
+
+			if (!switch_core_test_flag(SCF_API_EXPANSION) || (api_list && !switch_event_check_permission_list(api_list, vname))) {
+				piece->data = "<API Execute Permission Denied>";
+				piece->len = strlen(piece->data);
+				free(stream.data);
+			} else if (switch_api_execute(vname, vval, channel->session, &stream) == SWITCH_STATUS_SUCCESS) {
+				piece->data = stream.data;
+				piece->len = strlen(stream.data);
+				piece->free_me = stream.data;
+			} else {
+				free(stream.data);
+			}
+
+			switch_safe_free(expanded);
+			switch_safe_free(expanded_vname);
+		}
+
+		total += piece->len;
+	}
+
+	data = malloc(total + 1);
+	switch_assert(data);
+	c = data;
+
+	for (i = 0; i < prog->nops; i++) {
+		if (pieces[i].len) {
+			memcpy(c, pieces[i].data, pieces[i].len);
+			c += pieces[i].len;
+		}
+	}
+	*c = '\0';
+
+	expand_pieces_free(pieces, prog->nops);
+
+	if (pieces != stack_pieces) {
+		free(pieces);
+	}
+
+	return data;
+}
+
+SWITCH_DECLARE(char *) switch_channel_expand_variables_check(switch_channel_t *channel, const char *in, switch_event_t *var_list, switch_event_t *api_list, uint32_t recur)
+{
+	expand_program_t *prog;
+	char *data;
+
+	if (recur > 100) {
+		return (char *) in;
+	}
+
+	if (!expand_needed(in)) {
+		return (char *) in;
+	}
+
+	/* nested values change from call to call, only the top level string is worth a compiled program */
+	if (recur || !(prog = expand_program_get(in))) {
+		return switch_channel_expand_variables_uncompiled(channel, in, var_list, api_list, recur);
+	}
+
+	data = expand_program_run(prog, channel, in, var_list, api_list, recur);
+	expand_program_release(prog);
+
+	return data;
+}
+
 SWITCH_DECLARE(char *) switch_channel_build_param_string(switch_channel_t *channel, switch_caller_profile_t *caller_profile, const char *prefix)
 {
 	switch_stream_handle_t stream = { 0 };
@@ -4949,11 +5504,20 @@ SWITCH_DECLARE(void) switch_channel_global_init(switch_memory_pool_t *pool)
 
 	switch_mutex_init(&globals.device_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_core_hash_init(&globals.device_hash);
+	switch_thread_rwlock_create(&globals.expand_rwlock, pool);
+	switch_core_hash_init_case(&globals.expand_hash, SWITCH_TRUE);
 }
 
 SWITCH_DECLARE(void) switch_channel_global_uninit(void)
 {
 	switch_core_hash_destroy(&globals.device_hash);
+
+	switch_thread_rwlock_wrlock(globals.expand_rwlock);
+	switch_core_hash_destroy(&globals.expand_hash);
+	globals.expand_count = 0;
+	memset(expand_clock, 0, sizeof(expand_clock));
+	expand_hand = 0;
+	switch_thread_rwlock_unlock(globals.expand_rwlock);
 }
 
 
@@ -1856,6 +1856,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	runtime.max_db_handles = 50;
 	runtime.db_handle_timeout = 5000000;
 	runtime.event_heartbeat_interval = 20;
+	runtime.rtp_bridge_relay = 1;
 
 	runtime.runlevel++;
 	runtime.dummy_cng_frame.data = runtime.dummy_data;
@@ -1912,6 +1913,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 		return SWITCH_STATUS_MEMERR;
 	}
 	switch_assert(runtime.memory_pool != NULL);
+	switch_resample_cache_init(runtime.memory_pool);
 
 	switch_dir_make_recursive(SWITCH_GLOBAL_dirs.base_dir, SWITCH_DEFAULT_DIR_PERMS, runtime.memory_pool);
 	switch_dir_make_recursive(SWITCH_GLOBAL_dirs.mod_dir, SWITCH_DEFAULT_DIR_PERMS, runtime.memory_pool);
@@ -1939,6 +1941,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	switch_thread_rwlock_create(&runtime.global_var_rwlock, runtime.memory_pool);
 	switch_core_set_globals();
 	switch_core_session_init(runtime.memory_pool);
+	switch_core_file_init(runtime.memory_pool);
 	switch_event_create_plain(&runtime.global_vars, SWITCH_EVENT_CHANNEL_DATA);
 	switch_core_hash_init_case(&runtime.mime_types, SWITCH_FALSE);
 	switch_core_hash_init_case(&runtime.mime_type_exts, SWITCH_FALSE);
@@ -2129,6 +2132,10 @@ static void switch_load_core_config(const char *file)
 		}
 
 		if ((settings = switch_xml_child(cfg, "settings"))) {
+			int pool_cache_size = -1;
+			switch_size_t pool_cache_prealloc = 0;
+			switch_bool_t pool_cache_huge_pages = SWITCH_FALSE;
+
 			// add by zz
 			runtime.max_reg_count = 15;
 			runtime.reg_count = 0;
@@ -2204,6 +2211,38 @@ static void switch_load_core_config(const char *file)
 						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "db-handle-timeout must be between 1 and 5000\n");
 					}
 
+				} else if (!strcasecmp(var, "file-write-behind-threads")) {
+					int tmp = atoi(val);
+
+					if (tmp > 0 && tmp < 17) {
+						runtime.file_write_behind_threads = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "file-write-behind-threads must be between 1 and 16\n");
+					}
+				} else if (!strcasecmp(var, "module-load-threads")) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0 && tmp < 65) {
+						runtime.module_load_threads = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "module-load-threads must be between 0 and 64\n");
+					}
+				} else if (!strcasecmp(var, "rtp-bridge-relay")) {
+					runtime.rtp_bridge_relay = switch_true(val);
+				} else if (!strcasecmp(var, "xml-stream-parse")) {
+					switch_xml_set_stream_parse(switch_true(val));
+				} else if (!strcasecmp(var, "xml-user-cache-negative-ms") && !zstr(val)) {
+					int tmp = atoi(val);
+
+					switch_xml_set_user_cache_negative_ms(tmp > 0 ? (uint32_t) tmp : 0);
+				} else if (!strcasecmp(var, "xml-user-cache-refresh-ahead") && !zstr(val)) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0 && tmp <= 90) {
+						switch_xml_set_user_cache_refresh_ahead((uint32_t) tmp);
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "xml-user-cache-refresh-ahead must be between 0 and 90\n");
+					}
 				} else if (!strcasecmp(var, "event-heartbeat-interval")) {
 					long tmp = atol(val);
 
@@ -2366,6 +2405,8 @@ static void switch_load_core_config(const char *file)
 					switch_rtp_set_start_port((switch_port_t) atoi(val));
 				} else if (!strcasecmp(var, "rtp-end-port") && !zstr(val)) {
 					switch_rtp_set_end_port((switch_port_t) atoi(val));
+				} else if (!strcasecmp(var, "dtls-handshake-threads") && !zstr(val)) {
+					switch_rtp_set_dtls_handshake_threads(atoi(val));
 				} else if (!strcasecmp(var, "rtp-port-usage-robustness") && switch_true(val)) {
 					runtime.port_alloc_flags |= SPF_ROBUST_UDP;
 				} else if (!strcasecmp(var, "core-db-name") && !zstr(val)) {
@@ -2432,8 +2473,38 @@ static void switch_load_core_config(const char *file)
 					}
 				} else if (!strcasecmp(var, "max-audio-channels") && !zstr(val)) {
 					switch_core_max_audio_channels(atoi(val));
+				} else if (!strcasecmp(var, "pool-cache-size") && !zstr(val)) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0 && tmp <= 64) {
+						pool_cache_size = tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "pool-cache-size must be between 0 and 64\n");
+					}
+				} else if (!strcasecmp(var, "pool-cache-prealloc") && !zstr(val)) {
+					long tmp = atol(val);
+
+					if (tmp >= 0 && tmp <= 64 * 1024 * 1024) {
+						pool_cache_prealloc = (switch_size_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "pool-cache-prealloc must be between 0 and 67108864\n");
+					}
+				} else if (!strcasecmp(var, "pool-cache-huge-pages")) {
+					pool_cache_huge_pages = switch_true(val);
+				} else if (!strcasecmp(var, "resampler-cache-size") && !zstr(val)) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0 && tmp <= 4096) {
+						switch_resample_cache_set((uint32_t) tmp);
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "resampler-cache-size must be between 0 and 4096\n");
+					}
 				}
 			}
+
+			if (pool_cache_size >= 0) {
+				switch_core_memory_pool_cache_set((uint32_t) pool_cache_size, pool_cache_prealloc, pool_cache_huge_pages);
+			}
 		}
 
 		if (runtime.event_channel_key_separator == NULL) {
@@ -3072,6 +3143,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 	switch_core_session_hupall(SWITCH_CAUSE_SYSTEM_SHUTDOWN);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Clean up modules.\n");
 
+	switch_core_file_shutdown();
 	switch_loadable_module_shutdown();
 
 	switch_curl_destroy();
@@ -3098,6 +3170,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 
 	switch_core_session_uninit();
 	switch_core_unset_variables();
+	switch_resample_cache_shutdown();
 	switch_core_memory_stop();
 
 	if (runtime.console && runtime.console != stdout && runtime.console != stderr) {
@@ -121,6 +121,11 @@ SWITCH_DECLARE(int) switch_core_db_prepare(switch_core_db_t *db, const char *zSq
 	return sqlite3_prepare(db, zSql, nBytes, ppStmt, pzTail);
 }
 
+SWITCH_DECLARE(int) switch_core_db_prepare_v2(switch_core_db_t *db, const char *zSql, int nBytes, switch_core_db_stmt_t **ppStmt, const char **pzTail)
+{
+	return sqlite3_prepare_v2(db, zSql, nBytes, ppStmt, pzTail);
+}
+
 SWITCH_DECLARE(int) switch_core_db_step(switch_core_db_stmt_t *stmt)
 {
 	return sqlite3_step(stmt);
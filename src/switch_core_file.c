@@ -36,6 +36,284 @@
 #include <switch.h>
 #include "private/switch_core_pvt.h"
 
+#define WRITE_BEHIND_BATCH_LEN (64 * 1024)
+#define WRITE_BEHIND_RING_LEN (1024 * 1024)
+#define WRITE_BEHIND_ALIGN 4096
+#define WRITE_BEHIND_MAX_THREADS 16
+
+struct switch_file_write_behind {
+	switch_ring_buffer_t *ring;
+	switch_byte_t *batch;
+	switch_size_t batch_len;
+	switch_size_t frame_bytes;
+	switch_mutex_t *mutex;
+	volatile switch_atomic_t queued;
+	switch_queue_t *queue;
+	switch_status_t status;
+	switch_file_write_behind_stats_t stats;
+};
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_thread_t *threads[WRITE_BEHIND_MAX_THREADS];
+	switch_queue_t *queues[WRITE_BEHIND_MAX_THREADS];
+	uint32_t thread_count;
+	uint32_t next;
+	int running;
+} write_behind_globals;
+
+/* caller must hold wb->mutex, it is the only consumer of the ring while it does */
+static void write_behind_drain(switch_file_handle_t *fh, switch_bool_t all)
+{
+	switch_file_write_behind_t *wb = fh->write_behind;
+	switch_size_t inuse, blen, samples;
+	switch_status_t status;
+
+	while ((inuse = switch_ring_buffer_inuse(wb->ring)) && (all || inuse >= wb->batch_len)) {
+		if (!(blen = switch_ring_buffer_read(wb->ring, wb->batch, wb->batch_len))) {
+			break;
+		}
+
+		if (wb->status != SWITCH_STATUS_SUCCESS) {
+			continue;
+		}
+
+		samples = blen / wb->frame_bytes;
+
+		if ((status = fh->file_interface->file_write(fh, wb->batch, &samples)) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Write behind to [%s] failed\n", fh->file_path);
+			wb->status = status;
+			continue;
+		}
+
+		wb->stats.batches++;
+		wb->stats.bytes_written += blen;
+	}
+}
+
+static void *SWITCH_THREAD_FUNC write_behind_thread(switch_thread_t *thread, void *obj)
+{
+	switch_queue_t *queue = (switch_queue_t *) obj;
+	void *pop = NULL;
+
+	for (;;) {
+		switch_file_handle_t *fh;
+
+		if (switch_queue_pop(queue, &pop) != SWITCH_STATUS_SUCCESS) {
+			if (!write_behind_globals.running) {
+				break;
+			}
+			continue;
+		}
+
+		if (!pop) {
+			if (!write_behind_globals.running && switch_queue_size(queue) == 0) {
+				break;
+			}
+			continue;
+		}
+
+		fh = (switch_file_handle_t *) pop;
+
+		switch_mutex_lock(fh->write_behind->mutex);
+		switch_atomic_cas(&fh->write_behind->queued, 0, 1);
+		write_behind_drain(fh, SWITCH_FALSE);
+		switch_mutex_unlock(fh->write_behind->mutex);
+	}
+
+	return NULL;
+}
+
+static switch_queue_t *write_behind_get_queue(void)
+{
+	switch_queue_t *queue = NULL;
+
+	switch_mutex_lock(write_behind_globals.mutex);
+
+	if (!write_behind_globals.thread_count && write_behind_globals.pool) {
+		switch_threadattr_t *thd_attr = NULL;
+		uint32_t i, count = runtime.file_write_behind_threads;
+
+		if (!count) {
+			count = 2;
+		}
+
+		if (count > WRITE_BEHIND_MAX_THREADS) {
+			count = WRITE_BEHIND_MAX_THREADS;
+		}
+
+		write_behind_globals.running = 1;
+		switch_threadattr_create(&thd_attr, write_behind_globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+		for (i = 0; i < count; i++) {
+			switch_queue_create(&write_behind_globals.queues[i], SWITCH_CORE_QUEUE_LEN, write_behind_globals.pool);
+			switch_thread_create(&write_behind_globals.threads[i], thd_attr, write_behind_thread, write_behind_globals.queues[i], write_behind_globals.pool);
+		}
+
+		write_behind_globals.thread_count = count;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Started %u file write behind thread%s\n", count, count == 1 ? "" : "s");
+	}
+
+	if (write_behind_globals.running && write_behind_globals.thread_count) {
+		queue = write_behind_globals.queues[write_behind_globals.next++ % write_behind_globals.thread_count];
+	}
+
+	switch_mutex_unlock(write_behind_globals.mutex);
+
+	return queue;
+}
+
+static switch_status_t write_behind_setup(switch_file_handle_t *fh)
+{
+	switch_file_write_behind_t *wb;
+	switch_size_t ring_len = WRITE_BEHIND_RING_LEN, batch_len = WRITE_BEHIND_BATCH_LEN;
+	const char *val;
+	switch_queue_t *queue;
+
+	if (!(queue = write_behind_get_queue())) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (fh->params && (val = switch_event_get_header(fh->params, "write_behind_buffer"))) {
+		int tmp = atoi(val);
+
+		if (strrchr(val, 'k')) {
+			tmp *= 1024;
+		} else if (strrchr(val, 'm')) {
+			tmp *= 1048576;
+		}
+
+		if (tmp >= WRITE_BEHIND_ALIGN * 4 && tmp <= 104857600 /*100mb*/) {
+			ring_len = tmp;
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid write behind buffer size: %d\n", tmp);
+		}
+	}
+
+	wb = switch_core_alloc(fh->memory_pool, sizeof(*wb));
+	wb->frame_bytes = (switch_test_flag(fh, SWITCH_FILE_NATIVE) ? 1 : 2) * (fh->channels ? fh->channels : 1);
+
+	if (switch_ring_buffer_create(fh->memory_pool, &wb->ring, ring_len) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	/* never let a batch take more than a quarter of the ring and keep it whole frames */
+	if (batch_len > switch_ring_buffer_freespace(wb->ring) / 4) {
+		batch_len = switch_ring_buffer_freespace(wb->ring) / 4;
+	}
+	batch_len -= batch_len % wb->frame_bytes;
+
+	wb->batch = switch_core_alloc(fh->memory_pool, batch_len + WRITE_BEHIND_ALIGN);
+	wb->batch = (switch_byte_t *) (((uintptr_t) wb->batch + (WRITE_BEHIND_ALIGN - 1)) & ~((uintptr_t) WRITE_BEHIND_ALIGN - 1));
+	wb->batch_len = batch_len;
+	wb->queue = queue;
+	wb->status = SWITCH_STATUS_SUCCESS;
+	switch_mutex_init(&wb->mutex, SWITCH_MUTEX_NESTED, fh->memory_pool);
+
+	fh->write_behind = wb;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t write_behind_push(switch_file_handle_t *fh, void *data, switch_size_t *len, switch_size_t orig_len)
+{
+	switch_file_write_behind_t *wb = fh->write_behind;
+	switch_size_t inuse;
+
+	if (wb->status != SWITCH_STATUS_SUCCESS) {
+		*len = 0;
+		return wb->status;
+	}
+
+	if (switch_ring_buffer_write(wb->ring, data, *len * wb->frame_bytes)) {
+		fh->samples_out += orig_len;
+	} else {
+		if (!wb->stats.dropped_frames) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Write behind backlog full for [%s], dropping audio\n", fh->file_path);
+		}
+		wb->stats.dropped_frames++;
+		wb->stats.dropped_samples += *len;
+	}
+
+	inuse = switch_ring_buffer_inuse(wb->ring);
+
+	if (inuse > wb->stats.max_backlog_bytes) {
+		wb->stats.max_backlog_bytes = inuse;
+	}
+
+	if (inuse >= wb->batch_len && switch_atomic_cas(&wb->queued, 1, 0) == 0) {
+		if (!write_behind_globals.running || switch_queue_trypush(wb->queue, fh) != SWITCH_STATUS_SUCCESS) {
+			switch_atomic_set(&wb->queued, 0);
+
+			if (!write_behind_globals.running) {
+				switch_mutex_lock(wb->mutex);
+				write_behind_drain(fh, SWITCH_FALSE);
+				switch_mutex_unlock(wb->mutex);
+			}
+		}
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* wait for the worker to let go of the handle, returns with wb->mutex held */
+static void write_behind_lock(switch_file_handle_t *fh)
+{
+	while (switch_atomic_read(&fh->write_behind->queued) && write_behind_globals.thread_count) {
+		switch_cond_next();
+	}
+
+	switch_mutex_lock(fh->write_behind->mutex);
+}
+
+void switch_core_file_init(switch_memory_pool_t *pool)
+{
+	memset(&write_behind_globals, 0, sizeof(write_behind_globals));
+	write_behind_globals.pool = pool;
+	switch_mutex_init(&write_behind_globals.mutex, SWITCH_MUTEX_NESTED, pool);
+}
+
+void switch_core_file_shutdown(void)
+{
+	uint32_t i;
+	switch_status_t st;
+
+	if (!write_behind_globals.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(write_behind_globals.mutex);
+	write_behind_globals.running = 0;
+
+	for (i = 0; i < write_behind_globals.thread_count; i++) {
+		switch_queue_push(write_behind_globals.queues[i], NULL);
+	}
+
+	for (i = 0; i < write_behind_globals.thread_count; i++) {
+		switch_thread_join(&st, write_behind_globals.threads[i]);
+	}
+
+	write_behind_globals.thread_count = 0;
+	write_behind_globals.pool = NULL;
+	switch_mutex_unlock(write_behind_globals.mutex);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_file_get_write_behind_stats(switch_file_handle_t *fh, switch_file_write_behind_stats_t *stats)
+{
+	switch_assert(fh != NULL);
+
+	if (!fh->write_behind) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	*stats = fh->write_behind->stats;
+	stats->backlog_bytes = switch_ring_buffer_inuse(fh->write_behind->ring);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 
 static switch_status_t get_file_size(switch_file_handle_t *fh, const char **string)
 {
@@ -177,6 +455,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 			}
 		}
 
+		if ((val = switch_event_get_header(fh->params, "write_behind"))) {
+			if (switch_true(val)) {
+				switch_set_flag(fh, SWITCH_FILE_WRITE_BEHIND);
+			} else {
+				switch_clear_flag(fh, SWITCH_FILE_WRITE_BEHIND);
+			}
+		}
+
 		if ((val = switch_event_get_header(fh->params, "cbr"))) {
 			tmp = switch_true(val);
 			fh->mm.cbr = tmp;
@@ -410,6 +696,19 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 
 	if (switch_test_flag(fh, SWITCH_FILE_FLAG_VIDEO)) {
 		fh->pre_buffer_datalen = 0;
+		switch_clear_flag(fh, SWITCH_FILE_WRITE_BEHIND);
+	}
+
+	fh->write_behind = NULL;
+
+	if ((flags & SWITCH_FILE_FLAG_WRITE) && switch_test_flag(fh, SWITCH_FILE_WRITE_BEHIND)) {
+		if (write_behind_setup(fh) == SWITCH_STATUS_SUCCESS) {
+			/* the write behind batch replaces the pre buffer */
+			fh->pre_buffer_datalen = 0;
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Write behind unavailable for [%s], writing inline\n", file_path);
+			switch_clear_flag(fh, SWITCH_FILE_WRITE_BEHIND);
+		}
 	}
 
 	if (fh->pre_buffer_datalen) {
@@ -655,6 +954,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_write(switch_file_handle_t *fh,
 		return SWITCH_STATUS_SUCCESS;
 	}
 
+	if (fh->write_behind) {
+		return write_behind_push(fh, data, len, orig_len);
+	}
 
 	if (fh->pre_buffer) {
 		switch_size_t rlen, blen;
@@ -766,6 +1068,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_seek(switch_file_handle_t *fh,
 		switch_buffer_zero(fh->pre_buffer);
 	}
 
+	if (fh->write_behind) {
+		write_behind_lock(fh);
+		write_behind_drain(fh, SWITCH_TRUE);
+	}
+
 	if (whence == SWITCH_SEEK_CUR) {
 		unsigned int cur = 0;
 
@@ -785,6 +1092,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_seek(switch_file_handle_t *fh,
 		fh->samples_out = *cur_pos;
 	}
 
+	if (fh->write_behind) {
+		switch_mutex_unlock(fh->write_behind->mutex);
+	}
+
 	return status;
 }
 
@@ -801,6 +1112,16 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_set_string(switch_file_handle_t
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (fh->write_behind) {
+		switch_status_t status;
+
+		switch_mutex_lock(fh->write_behind->mutex);
+		status = fh->file_interface->file_set_string(fh, col, string);
+		switch_mutex_unlock(fh->write_behind->mutex);
+
+		return status;
+	}
+
 	return fh->file_interface->file_set_string(fh, col, string);
 }
 
@@ -849,6 +1170,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_truncate(switch_file_handle_t *
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (fh->write_behind) {
+		write_behind_lock(fh);
+	}
+
 	if ((status = fh->file_interface->file_truncate(fh, offset)) == SWITCH_STATUS_SUCCESS) {
 		if (fh->buffer) {
 			switch_buffer_zero(fh->buffer);
@@ -856,10 +1181,17 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_truncate(switch_file_handle_t *
 		if (fh->pre_buffer) {
 			switch_buffer_zero(fh->pre_buffer);
 		}
+		if (fh->write_behind) {
+			switch_ring_buffer_zero(fh->write_behind->ring);
+		}
 		fh->samples_out = 0;
 		fh->pos = 0;
 	}
 
+	if (fh->write_behind) {
+		switch_mutex_unlock(fh->write_behind->mutex);
+	}
+
 	return status;
 
 }
@@ -880,15 +1212,26 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_command(switch_file_handle_t *f
 		if (fh->pre_buffer) {
 			switch_buffer_zero(fh->pre_buffer);
 		}
+		if (fh->write_behind) {
+			write_behind_lock(fh);
+			switch_ring_buffer_zero(fh->write_behind->ring);
+			switch_mutex_unlock(fh->write_behind->mutex);
+		}
 		break;
 	default:
 		break;
 	}
 
 	if (fh->file_interface->file_command) {
+		if (fh->write_behind) {
+			switch_mutex_lock(fh->write_behind->mutex);
+		}
 		switch_mutex_lock(fh->flag_mutex);
 		status = fh->file_interface->file_command(fh, command);
 		switch_mutex_unlock(fh->flag_mutex);
+		if (fh->write_behind) {
+			switch_mutex_unlock(fh->write_behind->mutex);
+		}
 	}
 
 	return status;
@@ -908,6 +1251,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_pre_close(switch_file_handle_t
 		return SWITCH_STATUS_SUCCESS;
 	}
 
+	if (fh->write_behind) {
+		write_behind_lock(fh);
+		write_behind_drain(fh, SWITCH_TRUE);
+		switch_mutex_unlock(fh->write_behind->mutex);
+	}
+
 	if (fh->pre_buffer) {
 		if (switch_test_flag(fh, SWITCH_FILE_FLAG_WRITE)) {
 			switch_size_t rlen, blen;
@@ -967,6 +1316,15 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_close(switch_file_handle_t *fh)
 
 	switch_resample_destroy(&fh->resampler);
 
+	if (fh->write_behind) {
+		switch_file_write_behind_t *wb = fh->write_behind;
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG,
+						  "Write behind [%s]: %u batches, %" SWITCH_SIZE_T_FMT " bytes, max backlog %" SWITCH_SIZE_T_FMT " bytes, %u frames dropped\n",
+						  fh->file_path, wb->stats.batches, wb->stats.bytes_written, wb->stats.max_backlog_bytes, wb->stats.dropped_frames);
+		fh->write_behind = NULL;
+	}
+
 	if (switch_test_flag(fh, SWITCH_FILE_FLAG_FREE_POOL)) {
 		switch_core_destroy_memory_pool(&fh->memory_pool);
 	}
@@ -721,7 +721,6 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 				}
 
 				if (bp->ready && switch_test_flag(bp, SMBF_READ_STREAM)) {
-					switch_mutex_lock(bp->read_mutex);
 					if (bp->read_demux_frame) {
 						uint8_t data[SWITCH_RECOMMENDED_BUFFER_SIZE];
 						int bytes = read_frame->datalen;
@@ -733,15 +732,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 													 bp->read_demux_frame->data, samples,
 													 bp->read_demux_frame->channels) * 2 * bp->read_demux_frame->channels;
 
-						switch_buffer_write(bp->raw_read_buffer, data, datalen);
+						switch_ring_buffer_write(bp->raw_read_buffer, data, datalen);
 					} else {
-						switch_buffer_write(bp->raw_read_buffer, read_frame->data, read_frame->datalen);
+						switch_ring_buffer_write(bp->raw_read_buffer, read_frame->data, read_frame->datalen);
 					}
 
 					if (bp->callback) {
 						ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_READ);
 					}
-					switch_mutex_unlock(bp->read_mutex);
 				}
 
 				if ((bp->stop_time && bp->stop_time <= switch_epoch_time_now(NULL)) || ok == SWITCH_FALSE) {
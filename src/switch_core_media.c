@@ -220,8 +220,6 @@ struct switch_media_handle_s {
 	switch_msrp_session_t *msrp_session;
 	switch_mutex_t *read_mutex[SWITCH_MEDIA_TYPE_TOTAL];
 	switch_mutex_t *write_mutex[SWITCH_MEDIA_TYPE_TOTAL];
-	char *codec_order[SWITCH_MAX_CODECS];
-	int codec_order_last;
 	const switch_codec_implementation_t *codecs[SWITCH_MAX_CODECS];
 	char fmtp[SWITCH_MAX_CODECS][MAX_FMTP_LEN];
 	int payload_space;
@@ -2336,7 +2334,6 @@ SWITCH_DECLARE(void) switch_core_media_prepare_codecs(switch_core_session_t *ses
 	const char *abs, *codec_string = NULL;
 	const char *ocodec = NULL, *val;
 	switch_media_handle_t *smh;
-	char *tmp_codec_string;
 
 	switch_assert(session);
 
@@ -2393,10 +2390,8 @@ SWITCH_DECLARE(void) switch_core_media_prepare_codecs(switch_core_session_t *ses
 		codec_string = "PCMU@20i,PCMA@20i,speex@20i";
 	}
 
-	tmp_codec_string = switch_core_session_strdup(smh->session, codec_string);
 	switch_channel_set_variable(session->channel, "rtp_use_codec_string", codec_string);
-	smh->codec_order_last = switch_separate_string(tmp_codec_string, ',', smh->codec_order, SWITCH_MAX_CODECS);
-	smh->mparams->num_codecs = switch_loadable_module_get_codecs_sorted(smh->codecs, smh->fmtp, SWITCH_MAX_CODECS, smh->codec_order, smh->codec_order_last);
+	smh->mparams->num_codecs = switch_loadable_module_get_codecs_by_string(smh->codecs, smh->fmtp, SWITCH_MAX_CODECS, codec_string);
 }
 
 static void check_jb(switch_core_session_t *session, const char *input, int32_t jb_msec, int32_t maxlen, switch_bool_t silent)
@@ -13100,6 +13095,7 @@ SWITCH_DECLARE(void) switch_core_media_kill_socket(switch_core_session_t *sessio
 	}
 
 	if (switch_rtp_ready(smh->engines[type].rtp_session)) {
+		switch_rtp_relay_stop(smh->engines[type].rtp_session);
 		switch_rtp_kill_socket(smh->engines[type].rtp_session);
 	}
 }
@@ -13406,7 +13402,6 @@ static void switch_core_media_set_r_sdp_codec_string(switch_core_session_t *sess
 	int i;
 	int already_did[128] = { 0 };
 	int num_codecs = 0;
-	char *codec_order[SWITCH_MAX_CODECS];
 	const switch_codec_implementation_t *codecs[SWITCH_MAX_CODECS] = { 0 };
 	char fmtp[SWITCH_MAX_CODECS][MAX_FMTP_LEN];
 
@@ -13428,15 +13423,9 @@ static void switch_core_media_set_r_sdp_codec_string(switch_core_session_t *sess
 
 
 	if (!zstr(codec_string)) {
-		char *tmp_codec_string;
-
 		if (*codec_string == '=') codec_string++;
 
-		if ((tmp_codec_string = strdup(codec_string))) {
-			num_codecs = switch_separate_string(tmp_codec_string, ',', codec_order, SWITCH_MAX_CODECS);
-			num_codecs = switch_loadable_module_get_codecs_sorted(codecs, fmtp, SWITCH_MAX_CODECS, codec_order, num_codecs);
-			switch_safe_free(tmp_codec_string);
-		}
+		num_codecs = switch_loadable_module_get_codecs_by_string(codecs, fmtp, SWITCH_MAX_CODECS, codec_string);
 	} else {
 		num_codecs = switch_loadable_module_get_codecs(codecs, SWITCH_MAX_CODECS);
 	}
@@ -13919,9 +13908,7 @@ SWITCH_DECLARE (void) switch_core_media_recover_session(switch_core_session_t *s
 	}
 
 	if ((tmp = switch_channel_get_variable(session->channel, "rtp_use_codec_string"))) {
-		char *tmp_codec_string = switch_core_session_strdup(smh->session, tmp);
-		smh->codec_order_last = switch_separate_string(tmp_codec_string, ',', smh->codec_order, SWITCH_MAX_CODECS);
-		smh->mparams->num_codecs = switch_loadable_module_get_codecs_sorted(smh->codecs, smh->fmtp, SWITCH_MAX_CODECS, smh->codec_order, smh->codec_order_last);
+		smh->mparams->num_codecs = switch_loadable_module_get_codecs_by_string(smh->codecs, smh->fmtp, SWITCH_MAX_CODECS, tmp);
 	}
 
 	if ((tmp = switch_channel_get_variable(session->channel, "rtp_2833_send_payload"))) {
@@ -14864,6 +14851,65 @@ SWITCH_DECLARE(void) switch_core_session_passthru(switch_core_session_t *session
 
 }
 
+static switch_bool_t rtp_relay_allowed(switch_core_session_t *session)
+{
+	switch_channel_t *channel = session->channel;
+
+	return !(session->bugs || switch_channel_test_flag(channel, CF_HOLD) || switch_channel_test_flag(channel, CF_LEG_HOLDING) ||
+			 switch_channel_test_flag(channel, CF_SUSPEND) || switch_channel_test_flag(channel, CF_BRIDGE_NOWRITE) ||
+			 switch_channel_test_flag(channel, CF_AUDIO_PAUSE_READ) || switch_channel_test_flag(channel, CF_AUDIO_PAUSE_WRITE) ||
+			 switch_channel_var_false(channel, "rtp_bridge_relay"));
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_session_rtp_relay_start(switch_core_session_t *session_a, switch_core_session_t *session_b)
+{
+	switch_rtp_t *rtp_a, *rtp_b;
+
+	if (!session_a->media_handle || !session_b->media_handle) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	rtp_a = session_a->media_handle->engines[SWITCH_MEDIA_TYPE_AUDIO].rtp_session;
+	rtp_b = session_b->media_handle->engines[SWITCH_MEDIA_TYPE_AUDIO].rtp_session;
+
+	if (!runtime.rtp_bridge_relay || !rtp_relay_allowed(session_a) || !rtp_relay_allowed(session_b) ||
+		switch_core_session_transcoding(session_a, session_b, SWITCH_MEDIA_TYPE_AUDIO)) {
+		if (switch_rtp_relay_active(rtp_a)) {
+			switch_rtp_relay_stop(rtp_a);
+		}
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (switch_rtp_relay_active(rtp_a)) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (switch_rtp_relay_start(rtp_a, rtp_b) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session_a), SWITCH_LOG_DEBUG1, "Relaying audio to %s\n",
+					  switch_channel_get_name(session_b->channel));
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_core_session_rtp_relay_stop(switch_core_session_t *session)
+{
+	if (session->media_handle) {
+		switch_rtp_relay_stop(session->media_handle->engines[SWITCH_MEDIA_TYPE_AUDIO].rtp_session);
+	}
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_session_rtp_relay_wait(switch_core_session_t *session, uint32_t ms)
+{
+	if (!session->media_handle) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return switch_rtp_relay_wait(session->media_handle->engines[SWITCH_MEDIA_TYPE_AUDIO].rtp_session, ms);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_session_read_video_frame(switch_core_session_t *session, switch_frame_t **frame, switch_io_flag_t flags,
 																	 int stream_id)
 {
@@ -15968,9 +16014,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 			}
 
 			if (switch_test_flag(bp, SMBF_WRITE_STREAM)) {
-				switch_mutex_lock(bp->write_mutex);
-				switch_buffer_write(bp->raw_write_buffer, write_frame->data, write_frame->datalen);
-				switch_mutex_unlock(bp->write_mutex);
+				switch_ring_buffer_write(bp->raw_write_buffer, write_frame->data, write_frame->datalen);
 
 				if (bp->callback) {
 					ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_WRITE);
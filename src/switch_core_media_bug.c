@@ -74,11 +74,11 @@ static void switch_core_media_bug_destroy(switch_media_bug_t **bug)
 	}
 
 	if (bp->raw_read_buffer) {
-		switch_buffer_destroy(&bp->raw_read_buffer);
+		switch_ring_buffer_destroy(&bp->raw_read_buffer);
 	}
 
 	if (bp->raw_write_buffer) {
-		switch_buffer_destroy(&bp->raw_write_buffer);
+		switch_ring_buffer_destroy(&bp->raw_write_buffer);
 	}
 
 	if (switch_event_create(&event, SWITCH_EVENT_MEDIA_BUG_STOP) == SWITCH_STATUS_SUCCESS) {
@@ -182,41 +182,43 @@ SWITCH_DECLARE(void *) switch_core_media_bug_get_user_data(switch_media_bug_t *b
 	return bug->user_data;
 }
 
-SWITCH_DECLARE(void) switch_core_media_bug_flush(switch_media_bug_t *bug)
+/* reader side only: the rings may only be reset by their consumer */
+static void media_bug_flush_rings(switch_media_bug_t *bug)
 {
-
-	bug->record_pre_buffer_count = 0;
+	switch_atomic_set(&bug->flush_req, 0);
 
 	if (bug->raw_read_buffer) {
-		switch_mutex_lock(bug->read_mutex);
-		switch_buffer_zero(bug->raw_read_buffer);
-		switch_mutex_unlock(bug->read_mutex);
+		switch_ring_buffer_zero(bug->raw_read_buffer);
 	}
 
 	if (bug->raw_write_buffer) {
-		switch_mutex_lock(bug->write_mutex);
-		switch_buffer_zero(bug->raw_write_buffer);
-		switch_mutex_unlock(bug->write_mutex);
+		switch_ring_buffer_zero(bug->raw_write_buffer);
 	}
 
 	bug->record_frame_size = 0;
 	bug->record_pre_buffer_count = 0;
 }
 
+SWITCH_DECLARE(void) switch_core_media_bug_flush(switch_media_bug_t *bug)
+{
+	switch_atomic_set(&bug->flush_req, 1);
+}
+
 SWITCH_DECLARE(void) switch_core_media_bug_inuse(switch_media_bug_t *bug, switch_size_t *readp, switch_size_t *writep)
 {
+	if (switch_atomic_read(&bug->flush_req)) {
+		*readp = *writep = 0;
+		return;
+	}
+
 	if (switch_test_flag(bug, SMBF_READ_STREAM)) {
-		switch_mutex_lock(bug->read_mutex);
-		*readp = bug->raw_read_buffer ? switch_buffer_inuse(bug->raw_read_buffer) : 0;
-		switch_mutex_unlock(bug->read_mutex);
+		*readp = bug->raw_read_buffer ? switch_ring_buffer_inuse(bug->raw_read_buffer) : 0;
 	} else {
 		*readp = 0;
 	}
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_mutex_lock(bug->write_mutex);
-		*writep = bug->raw_write_buffer ? switch_buffer_inuse(bug->raw_write_buffer) : 0;
-		switch_mutex_unlock(bug->write_mutex);
+		*writep = bug->raw_write_buffer ? switch_ring_buffer_inuse(bug->raw_write_buffer) : 0;
 	} else {
 		*writep = 0;
 	}
@@ -264,18 +266,18 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	frame->flags = 0;
 	frame->datalen = 0;
 
+	if (switch_atomic_read(&bug->flush_req)) {
+		media_bug_flush_rings(bug);
+	}
+
 	if (switch_test_flag(bug, SMBF_READ_STREAM)) {
 		has_read = 1;
-		switch_mutex_lock(bug->read_mutex);
-		do_read = switch_buffer_inuse(bug->raw_read_buffer);
-		switch_mutex_unlock(bug->read_mutex);
+		do_read = switch_ring_buffer_inuse(bug->raw_read_buffer);
 	}
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
 		has_write = 1;
-		switch_mutex_lock(bug->write_mutex);
-		do_write = switch_buffer_inuse(bug->raw_write_buffer);
-		switch_mutex_unlock(bug->write_mutex);
+		do_write = switch_ring_buffer_inuse(bug->raw_write_buffer);
 	}
 
 
@@ -292,10 +294,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	}
 
 	if (bug->record_frame_size && do_write > do_read && do_write > (bug->record_frame_size * 2)) {
-		switch_mutex_lock(bug->write_mutex);
-		switch_buffer_toss(bug->raw_write_buffer, bug->record_frame_size);
-		do_write = switch_buffer_inuse(bug->raw_write_buffer);
-		switch_mutex_unlock(bug->write_mutex);
+		switch_ring_buffer_toss(bug->raw_write_buffer, bug->record_frame_size);
+		do_write = switch_ring_buffer_inuse(bug->raw_write_buffer);
 	}
 
 
@@ -336,15 +336,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	}
 
 	if (do_read) {
-		switch_mutex_lock(bug->read_mutex);
-		frame->datalen = (uint32_t) switch_buffer_read(bug->raw_read_buffer, frame->data, do_read);
+		frame->datalen = (uint32_t) switch_ring_buffer_read(bug->raw_read_buffer, frame->data, do_read);
 		if (frame->datalen != do_read) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(switch_core_media_bug_get_session(bug)), SWITCH_LOG_ERROR, "Framing Error Reading!\n");
-			switch_core_media_bug_flush(bug);
-			switch_mutex_unlock(bug->read_mutex);
+			media_bug_flush_rings(bug);
 			return SWITCH_STATUS_FALSE;
 		}
-		switch_mutex_unlock(bug->read_mutex);
 	} else if (fill_read) {
 		frame->datalen = (uint32_t)bytes;
 		memset(frame->data, 255, frame->datalen);
@@ -352,15 +349,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 
 	if (do_write) {
 		switch_assert(bug->raw_write_buffer);
-		switch_mutex_lock(bug->write_mutex);
-		datalen = (uint32_t) switch_buffer_read(bug->raw_write_buffer, bug->data, do_write);
+		datalen = (uint32_t) switch_ring_buffer_read(bug->raw_write_buffer, bug->data, do_write);
 		if (datalen != do_write) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(switch_core_media_bug_get_session(bug)), SWITCH_LOG_ERROR, "Framing Error Writing!\n");
-			switch_core_media_bug_flush(bug);
-			switch_mutex_unlock(bug->write_mutex);
+			media_bug_flush_rings(bug);
 			return SWITCH_STATUS_FALSE;
 		}
-		switch_mutex_unlock(bug->write_mutex);
 	} else if (fill_write) {
 		datalen = bytes;
 		memset(bug->data, 255, datalen);
@@ -793,6 +787,16 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_push_spy_frame(switch_medi
 }
 
 #define MAX_BUG_BUFFER 1024 * 512
+#define BUG_RING_FRAMES 128
+
+/* room for BUG_RING_FRAMES frames of the given size, never more than MAX_BUG_BUFFER */
+static switch_size_t bug_ring_size(switch_size_t bytes)
+{
+	switch_size_t size = (bytes ? bytes : 320) * BUG_RING_FRAMES;
+
+	return size > MAX_BUG_BUFFER ? MAX_BUG_BUFFER : size;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t *session,
 														  const char *function,
 														  const char *target,
@@ -901,15 +905,21 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t
 	}
 
 	if (switch_test_flag(bug, SMBF_READ_STREAM) || switch_test_flag(bug, SMBF_READ_PING)) {
-		switch_buffer_create_dynamic(&bug->raw_read_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
+		if (switch_ring_buffer_create(NULL, &bug->raw_read_buffer, bug_ring_size(bytes)) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Cannot allocate media bug read buffer\n");
+			return SWITCH_STATUS_MEMERR;
+		}
 		switch_mutex_init(&bug->read_mutex, SWITCH_MUTEX_NESTED, session->pool);
 	}
 
 	bytes = bug->write_impl.decoded_bytes_per_packet;
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_buffer_create_dynamic(&bug->raw_write_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
-		switch_mutex_init(&bug->write_mutex, SWITCH_MUTEX_NESTED, session->pool);
+		if (switch_ring_buffer_create(NULL, &bug->raw_write_buffer, bug_ring_size(bytes)) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Cannot allocate media bug write buffer\n");
+			switch_ring_buffer_destroy(&bug->raw_read_buffer);
+			return SWITCH_STATUS_MEMERR;
+		}
 	}
 
 	if ((bug->flags & SMBF_THREAD_LOCK)) {
@@ -995,6 +1005,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t
 	switch_thread_rwlock_unlock(session->bug_rwlock);
 	*new_bug = bug;
 
+	/* the bug needs to see every frame, hand the media back to the session thread */
+	switch_core_session_rtp_relay_stop(session);
+
 	if (tap_only) {
 		switch_set_flag(session, SSF_MEDIA_BUG_TAP_ONLY);
 	} else {
@@ -1117,7 +1130,7 @@ SWITCH_DECLARE(uint32_t) switch_core_media_bug_count(switch_core_session_t *orig
 	if (orig_session->bugs) {
 		switch_thread_rwlock_rdlock(orig_session->bug_rwlock);
 		for (bp = orig_session->bugs; bp; bp = bp->next) {
-			if (!switch_test_flag(bp, SMBF_PRUNE) && !switch_test_flag(bp, SMBF_LOCK) && !strcmp(bp->function, function)) {
+			if (!switch_test_flag(bp, SMBF_PRUNE) && !switch_test_flag(bp, SMBF_LOCK) && (!function || !strcmp(bp->function, function))) {
 				x++;
 			}
 		}
@@ -50,6 +50,36 @@
 #define DEBUG_ALLOC_CUTOFF 500
 #endif
 
+#if defined(PER_POOL_LOCK) && !defined(INSTANTLY_DESTROY_POOLS) && !APR_POOL_DEBUG
+#define POOL_CACHE 1
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#define POOL_CACHE_MAX_SLOTS 64
+#define POOL_CACHE_MAX_DEPTH 64
+#define POOL_CACHE_MAX_FREE (256 * 1024)
+#define POOL_CACHE_HUGE_PAGE (2 * 1024 * 1024)
+
+/* One per core: a destroyed pool is cleared on the destroying thread and parked in the slot
+   of the core it runs on, so the next pool created there skips apr_allocator_create/apr_pool_create.
+   Pools that do not fit go through pool_queue as before. */
+typedef struct {
+	switch_mutex_t *mutex;
+	switch_memory_pool_t *pools[POOL_CACHE_MAX_DEPTH];
+	switch_size_t bytes[POOL_CACHE_MAX_DEPTH];
+	uint32_t count;
+	switch_size_t cached_bytes;
+	uint64_t requests;
+	uint64_t hits;
+	uint64_t released;
+	uint64_t dropped;
+	switch_size_t released_bytes;
+} pool_cache_slot_t;
+
 static struct {
 #ifdef USE_MEM_LOCK
 	switch_mutex_t *mem_lock;
@@ -58,6 +88,12 @@ static struct {
 	switch_queue_t *pool_recycle_queue;
 	switch_memory_pool_t *memory_pool;
 	int pool_thread_running;
+	pool_cache_slot_t *cache;
+	uint32_t cache_slots;
+	uint32_t cache_next;
+	uint32_t cache_depth;
+	switch_size_t cache_prealloc;
+	switch_bool_t cache_huge_pages;
 } memory_manager;
 
 SWITCH_DECLARE(switch_memory_pool_t *) switch_core_session_get_pool(switch_core_session_t *session)
@@ -387,9 +423,232 @@ SWITCH_DECLARE(void) switch_core_pool_stats(switch_stream_handle_t *stream)
 #endif
 }
 
+#ifdef POOL_CACHE
+static pool_cache_slot_t *pool_cache_slot(void)
+{
+	uint32_t idx;
+
+	if (!memory_manager.cache) {
+		return NULL;
+	}
+
+#ifdef __linux__
+	{
+		int cpu = sched_getcpu();
+		idx = cpu < 0 ? 0 : (uint32_t) cpu;
+	}
+#else
+	idx = (uint32_t) ((uintptr_t) switch_thread_self() >> 4);
+#endif
+
+	return &memory_manager.cache[idx % memory_manager.cache_slots];
+}
+
+static void pool_cache_attach_mutex(switch_memory_pool_t *pool, apr_allocator_t *allocator)
+{
+	apr_thread_mutex_t *my_mutex;
+
+	if ((apr_thread_mutex_create(&my_mutex, APR_THREAD_MUTEX_NESTED, pool)) != APR_SUCCESS) {
+		abort();
+	}
+
+	apr_allocator_mutex_set(allocator, my_mutex);
+	apr_pool_mutex_set(pool, my_mutex);
+}
+
+static void pool_cache_max_free_set(apr_allocator_t *allocator)
+{
+	switch_size_t len = memory_manager.cache_prealloc;
+
+	apr_allocator_max_free_set(allocator, len > POOL_CACHE_MAX_FREE ? len : POOL_CACHE_MAX_FREE);
+}
+
+static void pool_cache_presize(switch_memory_pool_t *pool)
+{
+	switch_size_t len = memory_manager.cache_prealloc;
+	char *block;
+
+	if (!len) {
+		return;
+	}
+
+	/* Touch one block of the requested size and hand it back to the pool's own allocator,
+	   later allocations are carved out of it instead of going back to malloc. */
+	block = apr_palloc(pool, len);
+
+#if defined(MADV_HUGEPAGE)
+	if (block && memory_manager.cache_huge_pages && len >= POOL_CACHE_HUGE_PAGE) {
+		uintptr_t start = ((uintptr_t) block + POOL_CACHE_HUGE_PAGE - 1) & ~((uintptr_t) POOL_CACHE_HUGE_PAGE - 1);
+		uintptr_t end = ((uintptr_t) block + len) & ~((uintptr_t) POOL_CACHE_HUGE_PAGE - 1);
+
+		if (end > start) {
+			madvise((void *) start, end - start, MADV_HUGEPAGE);
+		}
+	}
+#else
+	(void) block;
+#endif
+
+	apr_pool_clear(pool);
+}
+
+static switch_memory_pool_t *pool_cache_acquire(pool_cache_slot_t *slot)
+{
+	switch_memory_pool_t *pool = NULL;
+
+	switch_mutex_lock(slot->mutex);
+	slot->requests++;
+	if (slot->count) {
+		slot->count--;
+		pool = slot->pools[slot->count];
+		slot->cached_bytes -= slot->bytes[slot->count];
+		slot->hits++;
+	}
+	switch_mutex_unlock(slot->mutex);
+
+	return pool;
+}
+
+/* Only called from pool_thread, so the slot cursor needs no lock. */
+static pool_cache_slot_t *pool_cache_next_slot(void)
+{
+	return &memory_manager.cache[memory_manager.cache_next++ % memory_manager.cache_slots];
+}
+
+/* Accounts for a pool that overflowed to pool_queue, called from pool_thread just before it goes away. */
+static void pool_cache_dropped(switch_memory_pool_t *pool)
+{
+	pool_cache_slot_t *slot = pool_cache_next_slot();
+	switch_size_t bytes = apr_pool_bytes_reserved(pool);
+
+	switch_mutex_lock(slot->mutex);
+	slot->released++;
+	slot->released_bytes += bytes;
+	if (memory_manager.cache_depth) {
+		slot->dropped++;
+	}
+	switch_mutex_unlock(slot->mutex);
+}
+
+static switch_bool_t pool_cache_release(pool_cache_slot_t *slot, switch_memory_pool_t *pool)
+{
+	apr_allocator_t *allocator = apr_pool_allocator_get(pool);
+	switch_size_t bytes;
+	switch_bool_t cached = SWITCH_FALSE;
+
+	/* Only pools built by switch_core_perform_new_memory_pool own their allocator and lock.
+	   The unlocked count is a hint, the slot is checked again before the pool is parked,
+	   anything that does not fit overflows to pool_queue without taking the slot lock. */
+	if (slot->count >= memory_manager.cache_depth ||
+		!allocator || apr_allocator_owner_get(allocator) != pool || !apr_allocator_mutex_get(allocator)) {
+		return SWITCH_FALSE;
+	}
+
+	bytes = apr_pool_bytes_reserved(pool);
+
+	/* The pool mutex lives in the pool, detach it before clear runs its cleanup. */
+	apr_pool_mutex_set(pool, NULL);
+	apr_allocator_mutex_set(allocator, NULL);
+	pool_cache_max_free_set(allocator);
+	apr_pool_clear(pool);
+	pool_cache_attach_mutex(pool, allocator);
+
+	switch_mutex_lock(slot->mutex);
+	slot->released++;
+	slot->released_bytes += bytes;
+	if (slot->count < memory_manager.cache_depth) {
+		slot->pools[slot->count] = pool;
+		slot->bytes[slot->count] = bytes;
+		slot->count++;
+		slot->cached_bytes += bytes;
+		cached = SWITCH_TRUE;
+	} else {
+		slot->dropped++;
+	}
+	switch_mutex_unlock(slot->mutex);
+
+	/* Lost the race for the last place: the pool is already cleared, nothing is left to wait out. */
+	if (!cached) {
+		apr_pool_destroy(pool);
+	}
+
+	return SWITCH_TRUE;
+}
+
+static void pool_cache_drain(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < memory_manager.cache_slots; i++) {
+		pool_cache_slot_t *slot = &memory_manager.cache[i];
+
+		switch_mutex_lock(slot->mutex);
+		while (slot->count) {
+			slot->count--;
+			apr_pool_destroy(slot->pools[slot->count]);
+		}
+		slot->cached_bytes = 0;
+		switch_mutex_unlock(slot->mutex);
+	}
+}
+#endif
+
+SWITCH_DECLARE(void) switch_core_memory_pool_cache_set(uint32_t depth, switch_size_t prealloc, switch_bool_t huge_pages)
+{
+	if (depth > POOL_CACHE_MAX_DEPTH) {
+		depth = POOL_CACHE_MAX_DEPTH;
+	}
+
+#ifdef POOL_CACHE
+	memory_manager.cache_prealloc = prealloc;
+	memory_manager.cache_huge_pages = huge_pages;
+	memory_manager.cache_depth = depth;
+#else
+	if (depth) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Memory pool cache is not available in this build\n");
+	}
+#endif
+}
+
+SWITCH_DECLARE(void) switch_core_memory_pool_stats(switch_memory_pool_stats_t *stats)
+{
+	uint32_t i;
+	uint64_t released = 0;
+
+	switch_assert(stats);
+	memset(stats, 0, sizeof(*stats));
+
+	stats->depth = memory_manager.cache_depth;
+	stats->slots = memory_manager.cache_slots;
+
+	for (i = 0; i < memory_manager.cache_slots; i++) {
+		pool_cache_slot_t *slot = &memory_manager.cache[i];
+
+		switch_mutex_lock(slot->mutex);
+		stats->cached += slot->count;
+		stats->cached_bytes += slot->cached_bytes;
+		stats->requests += slot->requests;
+		stats->hits += slot->hits;
+		stats->dropped += slot->dropped;
+		stats->released_bytes += slot->released_bytes;
+		released += slot->released;
+		switch_mutex_unlock(slot->mutex);
+	}
+
+	stats->released = released;
+	stats->live = stats->requests > released ? stats->requests - released : 0;
+
+	if (released) {
+		stats->live_bytes = (switch_size_t) (stats->live * (stats->released_bytes / released));
+	}
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memory_pool_t **pool, const char *file, const char *func, int line)
 {
 	char *tmp;
+#ifdef POOL_CACHE
+	pool_cache_slot_t *slot = pool_cache_slot();
+#endif
 #ifdef INSTANTLY_DESTROY_POOLS
 	apr_pool_create(pool, NULL);
 	switch_assert(*pool != NULL);
@@ -414,6 +673,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memor
 #endif
 
 #ifdef PER_POOL_LOCK
+#ifdef POOL_CACHE
+	if (!slot || !(*pool = pool_cache_acquire(slot))) {
+#endif
 		if ((apr_allocator_create(&my_allocator)) != APR_SUCCESS) {
 			abort();
 		}
@@ -426,6 +688,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memor
 			abort();
 		}
 
+#ifdef POOL_CACHE
+		if (memory_manager.cache_depth) {
+			pool_cache_max_free_set(my_allocator);
+			pool_cache_presize(*pool);
+		}
+#endif
+
 		if ((apr_thread_mutex_create(&my_mutex, APR_THREAD_MUTEX_NESTED, *pool)) != APR_SUCCESS) {
 			abort();
 		}
@@ -434,6 +703,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memor
 		apr_allocator_owner_set(my_allocator, *pool);
 
 		apr_pool_mutex_set(*pool, my_mutex);
+#ifdef POOL_CACHE
+	}
+#endif
 
 #else
 		apr_pool_create(pool, NULL);
@@ -465,6 +737,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_destroy_memory_pool(switch_m
 {
 	char *tmp;
 	const char *tag;
+#ifdef POOL_CACHE
+	pool_cache_slot_t *slot;
+#endif
 	switch_assert(pool != NULL);
 	
 	/* In tag we store who calls the pool creation.
@@ -489,6 +764,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_destroy_memory_pool(switch_m
 	switch_mutex_unlock(memory_manager.mem_lock);
 #endif
 #else
+#ifdef POOL_CACHE
+	if (*pool && (slot = pool_cache_slot()) && pool_cache_release(slot, *pool)) {
+		*pool = NULL;
+		return SWITCH_STATUS_SUCCESS;
+	}
+#endif
+
 	if ((memory_manager.pool_thread_running != 1) || (switch_queue_push(memory_manager.pool_queue, *pool) != SWITCH_STATUS_SUCCESS)) {
 #ifdef USE_MEM_LOCK
 		switch_mutex_lock(memory_manager.mem_lock);
@@ -566,6 +848,9 @@ SWITCH_DECLARE(void) switch_core_memory_reclaim(void)
 		switch_mutex_unlock(memory_manager.mem_lock);
 #endif
 	}
+#endif
+#ifdef POOL_CACHE
+	pool_cache_drain();
 #endif
 	return;
 }
@@ -591,6 +876,11 @@ static void *SWITCH_THREAD_FUNC pool_thread(switch_thread_t *thread, void *obj)
 					break;
 				}
 #if defined(PER_POOL_LOCK) || defined(DESTROY_POOLS)
+#ifdef POOL_CACHE
+				if (memory_manager.cache) {
+					pool_cache_dropped(pop);
+				}
+#endif
 #ifdef USE_MEM_LOCK
 				switch_mutex_lock(memory_manager.mem_lock);
 #endif
@@ -673,6 +963,11 @@ void switch_core_memory_stop(void)
 	memory_manager.pool_thread_running = 0;
 	switch_thread_join(&st, pool_thread_p);
 
+#ifdef POOL_CACHE
+	memory_manager.cache_depth = 0;
+	pool_cache_drain();
+#endif
+
 
 	while (switch_queue_trypop(memory_manager.pool_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
 		apr_pool_destroy(pop);
@@ -720,6 +1015,25 @@ switch_memory_pool_t *switch_core_memory_init(void)
 	switch_mutex_init(&memory_manager.mem_lock, SWITCH_MUTEX_NESTED, memory_manager.memory_pool);
 #endif
 
+#ifdef POOL_CACHE
+	{
+		uint32_t i;
+
+		memory_manager.cache_slots = switch_core_cpu_count();
+		if (!memory_manager.cache_slots) {
+			memory_manager.cache_slots = 1;
+		} else if (memory_manager.cache_slots > POOL_CACHE_MAX_SLOTS) {
+			memory_manager.cache_slots = POOL_CACHE_MAX_SLOTS;
+		}
+
+		memory_manager.cache = apr_pcalloc(memory_manager.memory_pool, sizeof(pool_cache_slot_t) * memory_manager.cache_slots);
+
+		for (i = 0; i < memory_manager.cache_slots; i++) {
+			switch_mutex_init(&memory_manager.cache[i].mutex, SWITCH_MUTEX_NESTED, memory_manager.memory_pool);
+		}
+	}
+#endif
+
 #ifdef INSTANTLY_DESTROY_POOLS
 	{
 		void *foo;
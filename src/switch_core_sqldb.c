@@ -39,6 +39,8 @@
 
 #define SWITCH_SQL_QUEUE_LEN 100000
 #define SWITCH_SQL_QUEUE_PAUSE_LEN 90000
+#define SWITCH_SQL_QUEUE_MAX_BATCH 64
+#define SWITCH_SQL_QUEUE_MAX_STMTS 16
 
 struct switch_cache_db_handle {
 	char name[CACHE_DB_LEN];
@@ -71,6 +73,8 @@ static struct {
 	uint32_t total_used_handles;
 	switch_cache_db_handle_t *dbh;
 	switch_sql_queue_manager_t *qm;
+	switch_sql_queue_manager_t *qm_list;
+	switch_mutex_t *qm_mutex;
 	int paused;
 } sql_manager;
 
@@ -1607,6 +1611,21 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_db_thread(switch_thread_t *threa
 
 static void *SWITCH_THREAD_FUNC switch_user_sql_thread(switch_thread_t *thread, void *obj);
 
+typedef struct {
+	uint64_t pushed;
+	uint64_t written;
+	uint64_t rows;
+	uint64_t statements;
+	uint64_t errors;
+	switch_time_t row_wait;
+	switch_time_t row_wait_max;
+} qm_queue_stats_t;
+
+typedef struct {
+	char *sig;
+	switch_core_db_stmt_t *stmt;
+} qm_stmt_t;
+
 struct switch_sql_queue_manager {
 	const char *name;
 	switch_cache_db_handle_t *event_db;
@@ -1630,8 +1649,32 @@ struct switch_sql_queue_manager {
 	uint32_t max_trans;
 	uint32_t confirm;
 	uint8_t paused;
+	void *held;
+	uint32_t held_pos;
+	qm_queue_stats_t *stats;
+	uint64_t trans_count;
+	switch_time_t trans_usec;
+	switch_time_t trans_usec_max;
+	qm_stmt_t stmts[SWITCH_SQL_QUEUE_MAX_STMTS];
+	uint32_t next_stmt;
+	struct switch_sql_queue_manager *next;
 };
 
+/* A row queued by switch_sql_queue_manager_push_row().  Rows share the queues with plain sql strings,
+   which can never start with a NUL byte, so the leading zero is what tells them apart. */
+typedef struct {
+	char nul;
+	uint32_t nvalues;
+	int key_idx;
+	switch_time_t queued;
+	char *table;
+	char *columns;
+	char *key;
+	char **values;
+} qm_row_t;
+
+#define qm_is_row(_p) (*(char *)(_p) == '\0')
+
 static int qm_wake(switch_sql_queue_manager_t *qm)
 {
 	switch_status_t status;
@@ -1668,6 +1711,10 @@ static uint32_t qm_ttl(switch_sql_queue_manager_t *qm)
 		ttl += switch_queue_size(qm->sql_queue[i]);
 	}
 
+	if (qm->held) {
+		ttl++;
+	}
+
 	return ttl;
 }
 
@@ -1800,18 +1847,285 @@ SWITCH_DECLARE(void) switch_sql_queue_manager_execute_sql_event_callback_err(swi
 }
 
 
+static switch_core_db_stmt_t *qm_get_stmt(switch_sql_queue_manager_t *qm, const char *sql)
+{
+	switch_core_db_t *db = qm->event_db->native_handle.core_db_dbh->handle;
+	qm_stmt_t *slot;
+	uint32_t i;
+
+	for (i = 0; i < SWITCH_SQL_QUEUE_MAX_STMTS; i++) {
+		if (qm->stmts[i].sig && !strcmp(qm->stmts[i].sig, sql)) {
+			return qm->stmts[i].stmt;
+		}
+	}
+
+	slot = &qm->stmts[qm->next_stmt++ % SWITCH_SQL_QUEUE_MAX_STMTS];
+
+	if (slot->stmt) {
+		switch_core_db_finalize(slot->stmt);
+		slot->stmt = NULL;
+	}
+	switch_safe_free(slot->sig);
+
+	if (switch_core_db_prepare_v2(db, sql, -1, &slot->stmt, NULL) != SWITCH_CORE_DB_OK || !slot->stmt) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s cannot prepare [%s] %s\n", qm->name, sql, switch_core_db_errmsg(db));
+		slot->stmt = NULL;
+		return NULL;
+	}
+
+	slot->sig = strdup(sql);
+
+	return slot->stmt;
+}
+
+/* a statement that failed is not trusted again, the next qm_get_stmt prepares it from scratch */
+static void qm_drop_stmt(switch_sql_queue_manager_t *qm, switch_core_db_stmt_t *stmt)
+{
+	uint32_t i;
+
+	if (!stmt) {
+		return;
+	}
+
+	for (i = 0; i < SWITCH_SQL_QUEUE_MAX_STMTS; i++) {
+		if (qm->stmts[i].stmt == stmt) {
+			switch_core_db_finalize(stmt);
+			qm->stmts[i].stmt = NULL;
+			switch_safe_free(qm->stmts[i].sig);
+			break;
+		}
+	}
+}
+
+static int qm_step_stmt(switch_core_db_stmt_t *stmt)
+{
+	int r = switch_core_db_step(stmt);
+
+	if (switch_core_db_reset(stmt) != SWITCH_CORE_DB_OK && r == SWITCH_CORE_DB_DONE) {
+		r = SWITCH_CORE_DB_ERROR;
+	}
+
+	return r;
+}
+
+static void qm_free_stmts(switch_sql_queue_manager_t *qm)
+{
+	uint32_t i;
+
+	for (i = 0; i < SWITCH_SQL_QUEUE_MAX_STMTS; i++) {
+		if (qm->stmts[i].stmt) {
+			switch_core_db_finalize(qm->stmts[i].stmt);
+			qm->stmts[i].stmt = NULL;
+		}
+		switch_safe_free(qm->stmts[i].sig);
+	}
+}
+
+/* core db: a prepared insert (and delete for keyed rows) per table, bound and stepped once per row.
+   A row that still fails on freshly prepared statements is logged and skipped, *failed counts those. */
+static switch_status_t qm_write_rows_prepared(switch_sql_queue_manager_t *qm, qm_row_t **rows, uint32_t n, uint32_t *failed)
+{
+	switch_core_db_t *db = qm->event_db->native_handle.core_db_dbh->handle;
+	switch_core_db_stmt_t *ins, *del = NULL;
+	qm_row_t *row = rows[0];
+	char del_sql[1024] = "", sql[2048];
+	switch_size_t len;
+	uint32_t i = 0, v;
+	int retried = 0;
+
+	*failed = 0;
+
+	len = strlen(row->table) + strlen(row->columns) + 2 * row->nvalues + sizeof("insert into  () values (");
+
+	if (len > sizeof(sql) || (row->key && strlen(row->table) + strlen(row->key) + sizeof("delete from  where =?") > sizeof(del_sql))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s %u rows for %s rejected, statement too long\n", qm->name, n, row->table);
+		*failed = n;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (row->key) {
+		switch_snprintf(del_sql, sizeof(del_sql), "delete from %s where %s=?", row->table, row->key);
+	}
+
+	switch_snprintf(sql, sizeof(sql), "insert into %s (%s) values (", row->table, row->columns);
+	len = strlen(sql);
+
+	for (v = 0; v < row->nvalues; v++) {
+		sql[len++] = '?';
+		sql[len++] = v == row->nvalues - 1 ? ')' : ',';
+	}
+	sql[len] = '\0';
+
+ prepare:
+
+	if ((*del_sql && !(del = qm_get_stmt(qm, del_sql))) || !(ins = qm_get_stmt(qm, sql))) {
+		/* nothing left can be written without the statements */
+		*failed += n - i;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* after a failure, resume at the row that failed */
+	for (; i < n; i++) {
+		row = rows[i];
+
+		if (del) {
+			switch_core_db_bind_text(del, 1, row->values[row->key_idx], -1, SWITCH_CORE_DB_STATIC);
+
+			if (qm_step_stmt(del) != SWITCH_CORE_DB_DONE) {
+				goto error;
+			}
+		}
+
+		for (v = 0; v < row->nvalues; v++) {
+			/* a NULL pointer binds SQL NULL */
+			switch_core_db_bind_text(ins, v + 1, row->values[v], -1, SWITCH_CORE_DB_STATIC);
+		}
+
+		if (qm_step_stmt(ins) != SWITCH_CORE_DB_DONE) {
+			goto error;
+		}
+
+		retried = 0;
+	}
+
+	return *failed ? SWITCH_STATUS_FALSE : SWITCH_STATUS_SUCCESS;
+
+ error:
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, retried ? SWITCH_LOG_ERROR : SWITCH_LOG_WARNING, "%s write to %s failed%s: %s\n",
+					  qm->name, row->table, retried ? ", row skipped" : "", switch_core_db_errmsg(db));
+
+	qm_drop_stmt(qm, del);
+	qm_drop_stmt(qm, ins);
+	del = NULL;
+
+	/* the first failure retries the row on fresh statements, a second one is the row itself, the rest of the batch still goes in */
+	if (retried) {
+		(*failed)++;
+		i++;
+		retried = 0;
+	} else {
+		retried = 1;
+	}
+
+	goto prepare;
+}
+
+static void qm_write_value(switch_stream_handle_t *stream, const char *value)
+{
+	if (value) {
+		stream->write_function(stream, "'%q'", value);
+	} else {
+		stream->write_function(stream, "NULL");
+	}
+}
+
+/* everything else: one delete for the keys of the whole batch and one multi-row insert,
+   falling back to a row at a time when the batch fails so one bad row does not take the others with it */
+static switch_status_t qm_write_rows(switch_sql_queue_manager_t *qm, switch_cache_db_handle_t *dbh, qm_row_t **rows, uint32_t n, uint32_t *failed)
+{
+	switch_stream_handle_t stream = { 0 };
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	qm_row_t *row = rows[0];
+	uint32_t i, v;
+
+	if (dbh == qm->event_db && dbh->type == SCDB_TYPE_CORE_DB) {
+		return qm_write_rows_prepared(qm, rows, n, failed);
+	}
+
+	*failed = 0;
+
+	if (row->key) {
+		SWITCH_STANDARD_STREAM(stream);
+		stream.write_function(&stream, "delete from %s where %s in (", row->table, row->key);
+		for (i = 0; i < n; i++) {
+			qm_write_value(&stream, rows[i]->values[row->key_idx]);
+			stream.write_function(&stream, i == n - 1 ? ")" : ",");
+		}
+		status = switch_cache_db_execute_sql(dbh, (char *) stream.data, NULL);
+		switch_safe_free(stream.data);
+
+		if (status != SWITCH_STATUS_SUCCESS) {
+			goto single;
+		}
+	}
+
+	SWITCH_STANDARD_STREAM(stream);
+	stream.write_function(&stream, "insert into %s (%s) values ", row->table, row->columns);
+
+	for (i = 0; i < n; i++) {
+		stream.write_function(&stream, "(");
+		for (v = 0; v < rows[i]->nvalues; v++) {
+			qm_write_value(&stream, rows[i]->values[v]);
+			if (v < rows[i]->nvalues - 1) {
+				stream.write_function(&stream, ",");
+			}
+		}
+		stream.write_function(&stream, i == n - 1 ? ")" : "),");
+	}
+
+	status = switch_cache_db_execute_sql(dbh, (char *) stream.data, NULL);
+	switch_safe_free(stream.data);
+
+	if (status == SWITCH_STATUS_SUCCESS) {
+		return status;
+	}
+
+ single:
+
+	if (n == 1) {
+		*failed = 1;
+		return status;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s batch of %u rows for %s failed, writing them one at a time\n", qm->name, n, row->table);
+
+	for (i = 0; i < n; i++) {
+		uint32_t f;
+
+		qm_write_rows(qm, dbh, &rows[i], 1, &f);
+		*failed += f;
+	}
+
+	return *failed ? SWITCH_STATUS_FALSE : SWITCH_STATUS_SUCCESS;
+}
+
+static switch_bool_t qm_row_batches_with(qm_row_t *a, qm_row_t *b)
+{
+	return (a->nvalues == b->nvalues && !strcmp(a->table, b->table) && !strcmp(a->columns, b->columns) &&
+			((!a->key && !b->key) || (a->key && b->key && !strcmp(a->key, b->key)))) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+static void qm_flush_item(switch_sql_queue_manager_t *qm, switch_cache_db_handle_t *dbh, void *item)
+{
+	if (dbh) {
+		if (qm_is_row(item)) {
+			qm_row_t *row = (qm_row_t *) item;
+			uint32_t failed;
+
+			qm_write_rows(qm, dbh, &row, 1, &failed);
+		} else {
+			switch_cache_db_execute_sql(dbh, (char *) item, NULL);
+		}
+	}
+
+	free(item);
+}
+
 static void do_flush(switch_sql_queue_manager_t *qm, int i, switch_cache_db_handle_t *dbh)
 {
 	void *pop = NULL;
 	switch_queue_t *q = qm->sql_queue[i];
 
 	switch_mutex_lock(qm->mutex);
+	if (qm->held && qm->held_pos == (uint32_t) i) {
+		qm_flush_item(qm, dbh, qm->held);
+		qm->held = NULL;
+	}
+
 	while (switch_queue_trypop(q, &pop) == SWITCH_STATUS_SUCCESS) {
 		if (pop) {
-			if (dbh) {
-				switch_cache_db_execute_sql(dbh, (char *) pop, NULL);
-			}
-			switch_safe_free(pop);
+			qm_flush_item(qm, dbh, pop);
 		}
 	}
 	switch_mutex_unlock(qm->mutex);
@@ -1852,12 +2166,52 @@ SWITCH_DECLARE(int) switch_sql_queue_manager_size(switch_sql_queue_manager_t *qm
 	switch_mutex_lock(qm->mutex);
 	if (index < qm->numq) {
 		size = switch_queue_size(qm->sql_queue[index]);
+		if (qm->held && qm->held_pos == index) {
+			size++;
+		}
 	}
 	switch_mutex_unlock(qm->mutex);
 
 	return size;
 }
 
+SWITCH_DECLARE(void) switch_sql_queue_manager_stats(switch_sql_queue_manager_t *qm, switch_stream_handle_t *stream)
+{
+	uint32_t i;
+
+	switch_mutex_lock(qm->mutex);
+
+	stream->write_function(stream, "%s: %" SWITCH_UINT64_T_FMT " transactions, avg %" SWITCH_TIME_T_FMT "us, max %" SWITCH_TIME_T_FMT "us\n",
+						   qm->name, qm->trans_count, qm->trans_count ? qm->trans_usec / (switch_time_t) qm->trans_count : 0, qm->trans_usec_max);
+
+	for (i = 0; i < qm->numq; i++) {
+		qm_queue_stats_t *st = &qm->stats[i];
+
+		stream->write_function(stream, "  queue %u: depth %d, pushed %" SWITCH_UINT64_T_FMT ", written %" SWITCH_UINT64_T_FMT
+							   " in %" SWITCH_UINT64_T_FMT " statements, errors %" SWITCH_UINT64_T_FMT
+							   ", rows %" SWITCH_UINT64_T_FMT " waited avg %" SWITCH_TIME_T_FMT "us, max %" SWITCH_TIME_T_FMT "us\n",
+							   i, switch_queue_size(qm->sql_queue[i]), st->pushed, st->written, st->statements, st->errors,
+							   st->rows, st->rows ? st->row_wait / (switch_time_t) st->rows : 0, st->row_wait_max);
+	}
+
+	switch_mutex_unlock(qm->mutex);
+}
+
+SWITCH_DECLARE(void) switch_core_sqldb_queue_stats(switch_stream_handle_t *stream)
+{
+	switch_sql_queue_manager_t *qm;
+
+	if (!sql_manager.qm_mutex) {
+		return;
+	}
+
+	switch_mutex_lock(sql_manager.qm_mutex);
+	for (qm = sql_manager.qm_list; qm; qm = qm->next) {
+		switch_sql_queue_manager_stats(qm, stream);
+	}
+	switch_mutex_unlock(sql_manager.qm_mutex);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_stop(switch_sql_queue_manager_t *qm)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
@@ -1934,7 +2288,23 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_destroy(switch_sql_queu
 
 	switch_sql_queue_manager_stop(qm);
 
+	if (sql_manager.qm_mutex) {
+		switch_sql_queue_manager_t *qp, *last = NULL;
 
+		switch_mutex_lock(sql_manager.qm_mutex);
+		for (qp = sql_manager.qm_list; qp; qp = qp->next) {
+			if (qp == qm) {
+				if (last) {
+					last->next = qp->next;
+				} else {
+					sql_manager.qm_list = qp->next;
+				}
+				break;
+			}
+			last = qp;
+		}
+		switch_mutex_unlock(sql_manager.qm_mutex);
+	}
 
 	for(i = 0; i < qm->numq; i++) {
 		do_flush(qm, i, NULL);
@@ -1946,12 +2316,49 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_destroy(switch_sql_queu
 	return status;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push(switch_sql_queue_manager_t *qm, const char *sql, uint32_t pos, switch_bool_t dup)
+static char *qm_row_copy(char **data, const char *src)
+{
+	char *r = *data;
+	switch_size_t len = strlen(src) + 1;
+
+	memcpy(r, src, len);
+	*data += len;
+
+	return r;
+}
+
+static switch_status_t qm_push_item(switch_sql_queue_manager_t *qm, void *item, uint32_t pos)
 {
-	char *sqlptr = NULL;
 	switch_status_t status;
 	int x = 0;
 
+	if (pos > qm->numq - 1) {
+		pos = 0;
+	}
+
+	do {
+		switch_mutex_lock(qm->mutex);
+		if ((status = switch_queue_trypush(qm->sql_queue[pos], item)) == SWITCH_STATUS_SUCCESS) {
+			qm->stats[pos].pushed++;
+		}
+		switch_mutex_unlock(qm->mutex);
+		if (status != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "Delay %d sending sql\n", x);
+			if (x++) {
+				switch_yield(1000000 * x);
+			}
+		}
+	} while(status != SWITCH_STATUS_SUCCESS);
+
+	qm_wake(qm);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push(switch_sql_queue_manager_t *qm, const char *sql, uint32_t pos, switch_bool_t dup)
+{
+	char *sqlptr = NULL;
+
 	if (sql_manager.paused || qm->thread_running != 1) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "DROP [%s]\n", sql);
 		if (!dup) free((char *)sql);
@@ -1964,27 +2371,105 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push(switch_sql_queue_m
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if (pos > qm->numq - 1) {
-		pos = 0;
+	if (zstr(sql)) {
+		if (!dup && sql) free((char *)sql);
+		return SWITCH_STATUS_SUCCESS;
 	}
 
 	sqlptr = dup ? strdup(sql) : (char *)sql;
 
-	do {
-		switch_mutex_lock(qm->mutex);
-		status = switch_queue_trypush(qm->sql_queue[pos], sqlptr);
-		switch_mutex_unlock(qm->mutex);
-		if (status != SWITCH_STATUS_SUCCESS) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "Delay %d sending sql\n", x);
-			if (x++) {
-				switch_yield(1000000 * x);
+	return qm_push_item(qm, sqlptr, pos);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_push_row(switch_sql_queue_manager_t *qm, uint32_t pos, const char *table,
+																  const char *columns, const char *key, const char *const *values, uint32_t nvalues)
+{
+	qm_row_t *row;
+	switch_size_t len;
+	uint32_t i, ncols = 1;
+	int key_idx = -1;
+	const char *p;
+	char *data;
+
+	if (zstr(table) || zstr(columns) || !values || !nvalues) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	for (p = columns; *p; p++) {
+		if (*p == ',') ncols++;
+	}
+
+	if (ncols != nvalues) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s row for %s has %u values for %u columns\n", qm->name, table, nvalues, ncols);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (key) {
+		const char *c = columns;
+
+		for (i = 0; i < ncols; i++) {
+			const char *e = strchr(c, ',');
+			switch_size_t l = e ? (switch_size_t) (e - c) : strlen(c);
+
+			while (l && *c == ' ') {
+				c++;
+				l--;
+			}
+
+			while (l && c[l - 1] == ' ') {
+				l--;
 			}
+
+			if (l == strlen(key) && !strncasecmp(c, key, l)) {
+				key_idx = (int) i;
+				break;
+			}
+
+			if (!e) break;
+			c = e + 1;
 		}
-	} while(status != SWITCH_STATUS_SUCCESS);
 
-	qm_wake(qm);
+		if (key_idx < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s key %s is not one of the columns for %s\n", qm->name, key, table);
+			return SWITCH_STATUS_FALSE;
+		}
+	}
 
-	return SWITCH_STATUS_SUCCESS;
+	if (sql_manager.paused || qm->thread_running != 1) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG1, "DROP row for [%s]\n", table);
+		qm_wake(qm);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	len = sizeof(*row) + nvalues * sizeof(char *) + strlen(table) + strlen(columns) + 2 + (key ? strlen(key) + 1 : 0);
+
+	for (i = 0; i < nvalues; i++) {
+		if (values[i]) {
+			len += strlen(values[i]) + 1;
+		}
+	}
+
+	switch_zmalloc(row, len);
+	row->nvalues = nvalues;
+	row->key_idx = key_idx;
+	row->queued = switch_micro_time_now();
+	row->values = (char **) (row + 1);
+	data = (char *) (row->values + nvalues);
+
+	row->table = qm_row_copy(&data, table);
+	row->columns = qm_row_copy(&data, columns);
+
+	if (key) {
+		row->key = qm_row_copy(&data, key);
+	}
+
+	for (i = 0; i < nvalues; i++) {
+		if (values[i]) {
+			row->values[i] = qm_row_copy(&data, values[i]);
+		}
+	}
+
+	return qm_push_item(qm, row, pos);
 }
 
 
@@ -2093,6 +2578,7 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_init_name(const char *n
 	qm->sql_queue = switch_core_alloc(qm->pool, sizeof(switch_queue_t *) * numq);
 	qm->written = switch_core_alloc(qm->pool, sizeof(uint32_t) * numq);
 	qm->pre_written = switch_core_alloc(qm->pool, sizeof(uint32_t) * numq);
+	qm->stats = switch_core_alloc(qm->pool, sizeof(qm_queue_stats_t) * numq);
 
 	for (i = 0; i < qm->numq; i++) {
 		switch_queue_create(&qm->sql_queue[i], SWITCH_SQL_QUEUE_LEN, qm->pool);
@@ -2111,6 +2597,13 @@ SWITCH_DECLARE(switch_status_t) switch_sql_queue_manager_init_name(const char *n
 		qm->inner_post_trans_execute = switch_core_strdup(qm->pool, inner_post_trans_execute);
 	}
 
+	if (sql_manager.qm_mutex) {
+		switch_mutex_lock(sql_manager.qm_mutex);
+		qm->next = sql_manager.qm_list;
+		sql_manager.qm_list = qm;
+		switch_mutex_unlock(sql_manager.qm_mutex);
+	}
+
 	*qmp = qm;
 
 	return SWITCH_STATUS_SUCCESS;
@@ -2124,6 +2617,7 @@ static uint32_t do_trans(switch_sql_queue_manager_t *qm)
 	switch_status_t status;
 	uint32_t ttl = 0;
 	switch_mutex_t *io_mutex = qm->event_db->io_mutex;
+	switch_time_t started = switch_micro_time_now(), elapsed;
 	uint32_t i;
 
 	if (io_mutex) switch_mutex_lock(io_mutex);
@@ -2186,20 +2680,110 @@ static uint32_t do_trans(switch_sql_queue_manager_t *qm)
 	while(qm->max_trans == 0 || ttl <= qm->max_trans) {
 		pop = NULL;
 
-		for (i = 0; (qm->max_trans == 0 || ttl <= qm->max_trans) && (i < qm->numq); i++) {
-			switch_mutex_lock(qm->mutex);
-			switch_queue_trypop(qm->sql_queue[i], &pop);
-			switch_mutex_unlock(qm->mutex);
-			if (pop) break;
+		switch_mutex_lock(qm->mutex);
+		if ((pop = qm->held)) {
+			i = qm->held_pos;
+			qm->held = NULL;
 		}
+		switch_mutex_unlock(qm->mutex);
 
-		if (pop) {
-			if ((status = switch_cache_db_execute_sql(qm->event_db, (char *) pop, NULL)) == SWITCH_STATUS_SUCCESS) {
+		if (!pop) {
+			for (i = 0; (qm->max_trans == 0 || ttl <= qm->max_trans) && (i < qm->numq); i++) {
 				switch_mutex_lock(qm->mutex);
-				qm->pre_written[i]++;
+				switch_queue_trypop(qm->sql_queue[i], &pop);
 				switch_mutex_unlock(qm->mutex);
+				if (pop) break;
+			}
+		}
+
+		if (pop && qm_is_row(pop)) {
+			qm_row_t *batch[SWITCH_SQL_QUEUE_MAX_BATCH];
+			uint32_t n = 0, x, replaced = 0, failed = 0;
+			switch_time_t now;
+
+			batch[n++] = (qm_row_t *) pop;
+
+			/* pull the rows queued behind this one into the same statement until something else shows up */
+			while (n < SWITCH_SQL_QUEUE_MAX_BATCH && (qm->max_trans == 0 || ttl + n <= qm->max_trans)) {
+				void *next = NULL;
+				qm_row_t *row;
+
+				switch_mutex_lock(qm->mutex);
+				switch_queue_trypop(qm->sql_queue[i], &next);
+				switch_mutex_unlock(qm->mutex);
+
+				if (!next) break;
+
+				if (!qm_is_row(next) || !qm_row_batches_with(batch[0], (row = (qm_row_t *) next))) {
+					switch_mutex_lock(qm->mutex);
+					qm->held = next;
+					qm->held_pos = i;
+					switch_mutex_unlock(qm->mutex);
+					break;
+				}
+
+				if (row->key) {
+					/* a later row for the same key replaces the earlier one */
+					for (x = 0; x < n; x++) {
+						const char *a = batch[x]->values[batch[x]->key_idx], *b = row->values[row->key_idx];
+						if (a && b && !strcmp(a, b)) {
+							break;
+						}
+					}
+
+					if (x < n) {
+						free(batch[x]);
+						memmove(&batch[x], &batch[x + 1], (n - x - 1) * sizeof(batch[0]));
+						n--;
+						replaced++;
+					}
+				}
+
+				batch[n++] = row;
+			}
+
+			status = qm_write_rows(qm, qm->event_db, batch, n, &failed);
+			now = switch_micro_time_now();
+
+			switch_mutex_lock(qm->mutex);
+			for (x = 0; x < n; x++) {
+				switch_time_t wait = now - batch[x]->queued;
+
+				qm->stats[i].row_wait += wait;
+				if (wait > qm->stats[i].row_wait_max) {
+					qm->stats[i].row_wait_max = wait;
+				}
+				free(batch[x]);
+			}
+
+			/* rows that failed on their own were skipped, the rest of the batch is written */
+			if (failed < n) {
+				qm->pre_written[i] += n + replaced - failed;
+				qm->stats[i].written += n + replaced - failed;
+				qm->stats[i].rows += n + replaced - failed;
+				qm->stats[i].statements++;
+				ttl += n + replaced - failed;
+				qm->stats[i].errors += failed;
+			} else {
+				qm->stats[i].errors += n + replaced;
+			}
+			switch_mutex_unlock(qm->mutex);
+
+			if (failed == n) break;
+		} else if (pop) {
+			status = switch_cache_db_execute_sql(qm->event_db, (char *) pop, NULL);
+
+			switch_mutex_lock(qm->mutex);
+			if (status == SWITCH_STATUS_SUCCESS) {
+				qm->pre_written[i]++;
+				qm->stats[i].written++;
+				qm->stats[i].statements++;
 				ttl++;
+			} else {
+				qm->stats[i].errors++;
 			}
+			switch_mutex_unlock(qm->mutex);
+
 			switch_safe_free(pop);
 			if (status != SWITCH_STATUS_SUCCESS) break;
 		} else {
@@ -2253,10 +2837,20 @@ static uint32_t do_trans(switch_sql_queue_manager_t *qm)
 	}
 
 
+	elapsed = switch_micro_time_now() - started;
+
 	switch_mutex_lock(qm->mutex);
 	for (i = 0; i < qm->numq; i++) {
 		qm->written[i] = qm->pre_written[i];
 	}
+
+	if (ttl) {
+		qm->trans_count++;
+		qm->trans_usec += elapsed;
+		if (elapsed > qm->trans_usec_max) {
+			qm->trans_usec_max = elapsed;
+		}
+	}
 	switch_mutex_unlock(qm->mutex);
 
 
@@ -2370,6 +2964,7 @@ static void *SWITCH_THREAD_FUNC switch_user_sql_thread(switch_thread_t *thread,
 		do_flush(qm, i, qm->event_db);
 	}
 
+	qm_free_stmts(qm);
 	switch_cache_db_release_db_handle(&qm->event_db);
 
 	qm->thread_running = 0;
@@ -2532,24 +3127,33 @@ static void core_event_handler(switch_event_t *event)
 			break;
 		}
 	case SWITCH_EVENT_CHANNEL_CREATE:
-		new_sql() = switch_mprintf("insert into channels (uuid,direction,created,created_epoch, name,state,callstate,dialplan,context,hostname,initial_cid_name,initial_cid_num,initial_ip_addr,initial_dest,initial_dialplan,initial_context) "
-								   "values('%q','%q','%q','%ld','%q','%q','%q','%q','%q','%q','%q','%q','%q','%q','%q','%q')",
-								   switch_event_get_header_nil(event, "unique-id"),
-								   switch_event_get_header_nil(event, "call-direction"),
-								   switch_event_get_header_nil(event, "event-date-local"),
-								   (long) switch_epoch_time_now(NULL),
-								   switch_event_get_header_nil(event, "channel-name"),
-								   switch_event_get_header_nil(event, "channel-state"),
-								   switch_event_get_header_nil(event, "channel-call-state"),
-								   switch_event_get_header_nil(event, "caller-dialplan"),
-								   switch_event_get_header_nil(event, "caller-context"), switch_core_get_switchname(),
-								   switch_event_get_header_nil(event, "caller-caller-id-name"),
-								   switch_event_get_header_nil(event, "caller-caller-id-number"),
-								   switch_event_get_header_nil(event, "caller-network-addr"),
-								   switch_event_get_header_nil(event, "caller-destination-number"),
-								   switch_event_get_header_nil(event, "caller-dialplan"),
-								   switch_event_get_header_nil(event, "caller-context")
-								   );
+		if (exists) {
+			char epoch[32];
+			const char *values[16];
+
+			switch_snprintf(epoch, sizeof(epoch), "%ld", (long) switch_epoch_time_now(NULL));
+			values[0] = switch_event_get_header_nil(event, "unique-id");
+			values[1] = switch_event_get_header_nil(event, "call-direction");
+			values[2] = switch_event_get_header_nil(event, "event-date-local");
+			values[3] = epoch;
+			values[4] = switch_event_get_header_nil(event, "channel-name");
+			values[5] = switch_event_get_header_nil(event, "channel-state");
+			values[6] = switch_event_get_header_nil(event, "channel-call-state");
+			values[7] = switch_event_get_header_nil(event, "caller-dialplan");
+			values[8] = switch_event_get_header_nil(event, "caller-context");
+			values[9] = switch_core_get_switchname();
+			values[10] = switch_event_get_header_nil(event, "caller-caller-id-name");
+			values[11] = switch_event_get_header_nil(event, "caller-caller-id-number");
+			values[12] = switch_event_get_header_nil(event, "caller-network-addr");
+			values[13] = switch_event_get_header_nil(event, "caller-destination-number");
+			values[14] = switch_event_get_header_nil(event, "caller-dialplan");
+			values[15] = switch_event_get_header_nil(event, "caller-context");
+
+			switch_sql_queue_manager_push_row(sql_manager.qm, 0, "channels",
+											  "uuid,direction,created,created_epoch,name,state,callstate,dialplan,context,hostname,"
+											  "initial_cid_name,initial_cid_num,initial_ip_addr,initial_dest,initial_dialplan,initial_context",
+											  NULL, values, 16);
+		}
 		break;
 	case SWITCH_EVENT_CHANNEL_ANSWER:
 	case SWITCH_EVENT_CHANNEL_PROGRESS_MEDIA:
@@ -2764,16 +3368,22 @@ static void core_event_handler(switch_event_t *event)
 									   switch_event_get_header_nil(event, "channel-call-uuid"), a_uuid, b_uuid);
 
 
-			new_sql() = switch_mprintf("insert into calls (call_uuid,call_created,call_created_epoch,"
-									   "caller_uuid,callee_uuid,hostname) "
-									   "values ('%q','%q','%ld','%q','%q','%q')",
-									   switch_event_get_header_nil(event, "channel-call-uuid"),
-									   switch_event_get_header_nil(event, "event-date-local"),
-									   (long) switch_epoch_time_now(NULL),
-									   a_uuid,
-									   b_uuid,
-									   switch_core_get_switchname()
-									   );
+			if (exists) {
+				char epoch[32];
+				const char *values[6];
+
+				switch_snprintf(epoch, sizeof(epoch), "%ld", (long) switch_epoch_time_now(NULL));
+				values[0] = switch_event_get_header_nil(event, "channel-call-uuid");
+				values[1] = switch_event_get_header_nil(event, "event-date-local");
+				values[2] = epoch;
+				values[3] = a_uuid;
+				values[4] = b_uuid;
+				values[5] = switch_core_get_switchname();
+
+				switch_sql_queue_manager_push_row(sql_manager.qm, 0, "calls",
+												  "call_uuid,call_created,call_created_epoch,caller_uuid,callee_uuid,hostname",
+												  NULL, values, 6);
+			}
 		}
 		break;
 	case SWITCH_EVENT_CHANNEL_UNBRIDGE:
@@ -3627,6 +4237,7 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 	switch_mutex_init(&sql_manager.dbh_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
 	switch_mutex_init(&sql_manager.io_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
 	switch_mutex_init(&sql_manager.ctl_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
+	switch_mutex_init(&sql_manager.qm_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
 
 	if (!sql_manager.manage) goto skip;
 
@@ -3872,33 +4483,33 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 
 		/* switch_sql_queue_manager initiated, now we can bind to core_event_handler */
 #ifdef SWITCH_SQL_BIND_EVERY_EVENT
-		switch_event_bind("core_db", SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
 #else
-		switch_event_bind("core_db", SWITCH_EVENT_ADD_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_DEL_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_EXE_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_RE_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_DESTROY, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_UUID, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_CREATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_ANSWER, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_PROGRESS_MEDIA, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_HOLD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_UNHOLD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_EXECUTE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_ORIGINATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CALL_UPDATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_CALLSTATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_STATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_BRIDGE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CHANNEL_UNBRIDGE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_SHUTDOWN, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_LOG, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_MODULE_LOAD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_MODULE_UNLOAD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CALL_SECURE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_NAT, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
-		switch_event_bind("core_db", SWITCH_EVENT_CODEC, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_ADD_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_DEL_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_EXE_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_RE_SCHEDULE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_DESTROY, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_UUID, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_CREATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_ANSWER, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_PROGRESS_MEDIA, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_HOLD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_UNHOLD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_EXECUTE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_ORIGINATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CALL_UPDATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_CALLSTATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_STATE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_BRIDGE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CHANNEL_UNBRIDGE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_SHUTDOWN, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_LOG, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_MODULE_LOAD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_MODULE_UNLOAD, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CALL_SECURE, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_NAT, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
+		switch_event_bind_lazy("core_db", SWITCH_EVENT_CODEC, SWITCH_EVENT_SUBCLASS_ANY, core_event_handler, NULL);
 #endif
 	}
 
@@ -316,6 +316,363 @@ SWITCH_DECLARE(void) switch_img_free(switch_image_t **img)
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #endif
 
+/* Row kernels used when compositing on canvases. The scalar, SSE2 and AVX2
+ * versions share the same integer math so every path produces the same bytes.
+ *
+ * blend(dst, src, a) = (dst * (256 - a') + src * a') >> 8 with a' = a + (a >> 7),
+ * which keeps alpha 0 a no-op and alpha 255 a plain copy. */
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && SWITCH_BYTE_ORDER != __BIG_ENDIAN
+#define SWITCH_VIDEO_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(SWITCH_VIDEO_SSE2) && (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define SWITCH_VIDEO_AVX2 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#if SWITCH_BYTE_ORDER == __BIG_ENDIAN
+#define PX_A 0
+#define PX_R 1
+#define PX_G 2
+#define PX_B 3
+#else
+#define PX_B 0
+#define PX_G 1
+#define PX_R 2
+#define PX_A 3
+#endif
+
+#define BLEND_ALPHA(_a) ((_a) + ((_a) >> 7))
+#define BLEND(_dst, _src, _a) (uint8_t)(((_dst) * (256 - (_a)) + (_src) * (_a)) >> 8)
+#define PX_Y(_p) (((66 * (_p)[PX_R] + 129 * (_p)[PX_G] + 25 * (_p)[PX_B] + 128) >> 8) + 16)
+#define PX_U(_p) (((-38 * (_p)[PX_R] - 74 * (_p)[PX_G] + 112 * (_p)[PX_B] + 128) >> 8) + 128)
+#define PX_V(_p) (((112 * (_p)[PX_R] - 94 * (_p)[PX_G] - 18 * (_p)[PX_B] + 128) >> 8) + 128)
+
+typedef struct video_kernels_s {
+	const char *name;
+	void (*argb_blend_y)(const uint8_t *argb, uint8_t *y, int width);
+	void (*argb_blend_uv)(const uint8_t *argb, uint8_t *u, uint8_t *v, int uv_width);
+	void (*plane_blend)(const uint8_t *src, uint8_t *dst, int width, int alpha);
+	void (*color_match)(const uint8_t *argb0, const uint8_t *argb1, uint8_t *hits, int width);
+} video_kernels_t;
+
+/* y[i] = blend(y[i], Y(argb[i]), alpha(argb[i])) */
+static void argb_blend_y_c(const uint8_t *argb, uint8_t *y, int width)
+{
+	int i;
+
+	for (i = 0; i < width; i++, argb += 4) {
+		int a = BLEND_ALPHA(argb[PX_A]);
+
+		y[i] = BLEND(y[i], PX_Y(argb), a);
+	}
+}
+
+/* u[i], v[i] blended with the chroma of every even pixel, matching the point sampling of switch_img_draw_pixel */
+static void argb_blend_uv_c(const uint8_t *argb, uint8_t *u, uint8_t *v, int uv_width)
+{
+	int i;
+
+	for (i = 0; i < uv_width; i++, argb += 8) {
+		int a = BLEND_ALPHA(argb[PX_A]);
+
+		u[i] = BLEND(u[i], PX_U(argb), a);
+		v[i] = BLEND(v[i], PX_V(argb), a);
+	}
+}
+
+static void plane_blend_c(const uint8_t *src, uint8_t *dst, int width, int alpha)
+{
+	int i, a = BLEND_ALPHA(alpha);
+
+	for (i = 0; i < width; i++) {
+		dst[i] = BLEND(dst[i], src[i], a);
+	}
+}
+
+/* hits[i] is set when r, g and b of both pixels are less than 5 apart (alpha ignored) */
+static void color_match_c(const uint8_t *argb0, const uint8_t *argb1, uint8_t *hits, int width)
+{
+	int i;
+
+	for (i = 0; i < width; i++, argb0 += 4, argb1 += 4) {
+		hits[i] = abs(argb0[PX_R] - argb1[PX_R]) < 5 && abs(argb0[PX_G] - argb1[PX_G]) < 5 && abs(argb0[PX_B] - argb1[PX_B]) < 5;
+	}
+}
+
+#ifdef SWITCH_VIDEO_SSE2
+/* split 8 packed pixels into 16 bit r, g, b and blend alpha lanes */
+static inline void sse2_unpack_argb(__m128i p0, __m128i p1, __m128i *r, __m128i *g, __m128i *b, __m128i *a)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	__m128i alpha;
+
+	*b = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+	*g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+	*r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+	alpha = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+	*a = _mm_add_epi16(alpha, _mm_srli_epi16(alpha, 7));
+}
+
+static inline __m128i sse2_blend16(__m128i dst, __m128i src, __m128i a)
+{
+	const __m128i k256 = _mm_set1_epi16(256);
+
+	return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(dst, _mm_sub_epi16(k256, a)), _mm_mullo_epi16(src, a)), 8);
+}
+
+static inline __m128i sse2_y16(__m128i r, __m128i g, __m128i b)
+{
+	__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129))),
+								_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+
+	return _mm_add_epi16(_mm_srli_epi16(sum, 8), _mm_set1_epi16(16));
+}
+
+static inline __m128i sse2_uv16(__m128i r, __m128i g, __m128i b, short kr, short kg, short kb)
+{
+	__m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(kr)), _mm_mullo_epi16(g, _mm_set1_epi16(kg))),
+								_mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(kb)), _mm_set1_epi16(128)));
+
+	return _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+}
+
+static void argb_blend_y_sse2(const uint8_t *argb, uint8_t *y, int width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+
+	for (; i + 8 <= width; i += 8, argb += 32) {
+		__m128i r, g, b, a, dst;
+
+		sse2_unpack_argb(_mm_loadu_si128((const __m128i *) argb), _mm_loadu_si128((const __m128i *) (argb + 16)), &r, &g, &b, &a);
+		dst = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (y + i)), zero);
+		dst = sse2_blend16(dst, sse2_y16(r, g, b), a);
+		_mm_storel_epi64((__m128i *) (y + i), _mm_packus_epi16(dst, dst));
+	}
+
+	argb_blend_y_c(argb, y + i, width - i);
+}
+
+static void argb_blend_uv_sse2(const uint8_t *argb, uint8_t *u, uint8_t *v, int uv_width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+
+	for (; i + 8 < uv_width; i += 8, argb += 64) {
+		__m128i e0, e1, r, g, b, a, du, dv;
+
+		/* keep pixels 0, 2, 4 ..., the strict loop bound keeps the odd pixel read at the end inside the row */
+		e0 = _mm_unpacklo_epi64(_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) argb), _MM_SHUFFLE(2, 0, 2, 0)),
+								_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (argb + 16)), _MM_SHUFFLE(2, 0, 2, 0)));
+		e1 = _mm_unpacklo_epi64(_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (argb + 32)), _MM_SHUFFLE(2, 0, 2, 0)),
+								_mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (argb + 48)), _MM_SHUFFLE(2, 0, 2, 0)));
+		sse2_unpack_argb(e0, e1, &r, &g, &b, &a);
+
+		du = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (u + i)), zero);
+		dv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (v + i)), zero);
+		du = sse2_blend16(du, sse2_uv16(r, g, b, -38, -74, 112), a);
+		dv = sse2_blend16(dv, sse2_uv16(r, g, b, 112, -94, -18), a);
+		_mm_storel_epi64((__m128i *) (u + i), _mm_packus_epi16(du, du));
+		_mm_storel_epi64((__m128i *) (v + i), _mm_packus_epi16(dv, dv));
+	}
+
+	argb_blend_uv_c(argb, u + i, v + i, uv_width - i);
+}
+
+static void plane_blend_sse2(const uint8_t *src, uint8_t *dst, int width, int alpha)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i a = _mm_set1_epi16((short) BLEND_ALPHA(alpha));
+	int i = 0;
+
+	for (; i + 16 <= width; i += 16) {
+		__m128i s = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i d = _mm_loadu_si128((const __m128i *) (dst + i));
+		__m128i lo = sse2_blend16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), a);
+		__m128i hi = sse2_blend16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), a);
+
+		_mm_storeu_si128((__m128i *) (dst + i), _mm_packus_epi16(lo, hi));
+	}
+
+	plane_blend_c(src + i, dst + i, width - i, alpha);
+}
+
+static void color_match_sse2(const uint8_t *argb0, const uint8_t *argb1, uint8_t *hits, int width)
+{
+	const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+	const __m128i four = _mm_set1_epi8(4);
+	const __m128i zero = _mm_setzero_si128();
+	int i = 0;
+
+	for (; i + 4 <= width; i += 4, argb0 += 16, argb1 += 16) {
+		__m128i p0 = _mm_loadu_si128((const __m128i *) argb0);
+		__m128i p1 = _mm_loadu_si128((const __m128i *) argb1);
+		__m128i diff = _mm_or_si128(_mm_subs_epu8(p0, p1), _mm_subs_epu8(p1, p0));
+		int m = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_subs_epu8(diff, four), rgb_mask), zero)));
+
+		hits[i] = m & 1;
+		hits[i + 1] = (m >> 1) & 1;
+		hits[i + 2] = (m >> 2) & 1;
+		hits[i + 3] = (m >> 3) & 1;
+	}
+
+	color_match_c(argb0, argb1, hits + i, width - i);
+}
+#endif
+
+#ifdef SWITCH_VIDEO_AVX2
+/* same as sse2_unpack_argb on 16 pixels, lanes come back in pixel order */
+static inline AVX2_TARGET void avx2_unpack_argb(__m256i p0, __m256i p1, __m256i *r, __m256i *g, __m256i *b, __m256i *a)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	__m256i alpha;
+
+	*b = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask)), _MM_SHUFFLE(3, 1, 2, 0));
+	*g = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask),
+													 _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask)), _MM_SHUFFLE(3, 1, 2, 0));
+	*r = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask),
+													 _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask)), _MM_SHUFFLE(3, 1, 2, 0));
+	alpha = _mm256_permute4x64_epi64(_mm256_packs_epi32(_mm256_srli_epi32(p0, 24), _mm256_srli_epi32(p1, 24)), _MM_SHUFFLE(3, 1, 2, 0));
+	*a = _mm256_add_epi16(alpha, _mm256_srli_epi16(alpha, 7));
+}
+
+static inline AVX2_TARGET __m256i avx2_blend16(__m256i dst, __m256i src, __m256i a)
+{
+	const __m256i k256 = _mm256_set1_epi16(256);
+
+	return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(dst, _mm256_sub_epi16(k256, a)), _mm256_mullo_epi16(src, a)), 8);
+}
+
+static inline AVX2_TARGET __m256i avx2_mix16(__m256i r, __m256i g, __m256i b, short kr, short kg, short kb)
+{
+	return _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(kr)), _mm256_mullo_epi16(g, _mm256_set1_epi16(kg))),
+							_mm256_add_epi16(_mm256_mullo_epi16(b, _mm256_set1_epi16(kb)), _mm256_set1_epi16(128)));
+}
+
+/* 16 x 16 bit lanes back to 16 bytes in order */
+static inline AVX2_TARGET __m128i avx2_pack16(__m256i v)
+{
+	return _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+static AVX2_TARGET void argb_blend_y_avx2(const uint8_t *argb, uint8_t *y, int width)
+{
+	int i = 0;
+
+	for (; i + 16 <= width; i += 16, argb += 64) {
+		__m256i r, g, b, a, dst, ys;
+
+		avx2_unpack_argb(_mm256_loadu_si256((const __m256i *) argb), _mm256_loadu_si256((const __m256i *) (argb + 32)), &r, &g, &b, &a);
+		ys = _mm256_add_epi16(_mm256_srli_epi16(avx2_mix16(r, g, b, 66, 129, 25), 8), _mm256_set1_epi16(16));
+		dst = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (y + i)));
+		_mm_storeu_si128((__m128i *) (y + i), avx2_pack16(avx2_blend16(dst, ys, a)));
+	}
+
+	argb_blend_y_sse2(argb, y + i, width - i);
+}
+
+static AVX2_TARGET void argb_blend_uv_avx2(const uint8_t *argb, uint8_t *u, uint8_t *v, int uv_width)
+{
+	const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	int i = 0;
+
+	for (; i + 16 < uv_width; i += 16, argb += 128) {
+		__m256i e0, e1, r, g, b, a, us, vs, du, dv;
+
+		e0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *) argb), even))),
+									 _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *) (argb + 32)), even)), 1);
+		e1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *) (argb + 64)), even))),
+									 _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *) (argb + 96)), even)), 1);
+		avx2_unpack_argb(e0, e1, &r, &g, &b, &a);
+
+		us = _mm256_add_epi16(_mm256_srai_epi16(avx2_mix16(r, g, b, -38, -74, 112), 8), _mm256_set1_epi16(128));
+		vs = _mm256_add_epi16(_mm256_srai_epi16(avx2_mix16(r, g, b, 112, -94, -18), 8), _mm256_set1_epi16(128));
+		du = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (u + i)));
+		dv = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (v + i)));
+		_mm_storeu_si128((__m128i *) (u + i), avx2_pack16(avx2_blend16(du, us, a)));
+		_mm_storeu_si128((__m128i *) (v + i), avx2_pack16(avx2_blend16(dv, vs, a)));
+	}
+
+	argb_blend_uv_sse2(argb, u + i, v + i, uv_width - i);
+}
+
+static AVX2_TARGET void plane_blend_avx2(const uint8_t *src, uint8_t *dst, int width, int alpha)
+{
+	const __m256i a = _mm256_set1_epi16((short) BLEND_ALPHA(alpha));
+	int i = 0;
+
+	for (; i + 16 <= width; i += 16) {
+		__m256i s = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (src + i)));
+		__m256i d = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (dst + i)));
+
+		_mm_storeu_si128((__m128i *) (dst + i), avx2_pack16(avx2_blend16(d, s, a)));
+	}
+
+	plane_blend_sse2(src + i, dst + i, width - i, alpha);
+}
+#endif
+
+/* Every kernel set is a constant table, only the choice between them changes at runtime. */
+static const video_kernels_t video_kernel_sets[] = {
+	{ "scalar", argb_blend_y_c, argb_blend_uv_c, plane_blend_c, color_match_c },
+#ifdef SWITCH_VIDEO_SSE2
+	{ "sse2", argb_blend_y_sse2, argb_blend_uv_sse2, plane_blend_sse2, color_match_sse2 },
+#endif
+#ifdef SWITCH_VIDEO_AVX2
+	{ "avx2", argb_blend_y_avx2, argb_blend_uv_avx2, plane_blend_avx2, color_match_sse2 },
+#endif
+};
+
+/* 1 + index of the set in use, published with a single atomic store, 0 until first use */
+static switch_atomic_t video_kernels_sel = 0;
+
+static uint32_t video_kernels_pick(const char *level)
+{
+	uint32_t sel = 0;
+
+#ifdef SWITCH_VIDEO_SSE2
+	if (!level || strcasecmp(level, "scalar")) {
+		sel = 1;
+	}
+#endif
+
+#ifdef SWITCH_VIDEO_AVX2
+	if ((!level || !strcasecmp(level, "avx2")) && __builtin_cpu_supports("avx2")) {
+		sel = 2;
+	}
+#endif
+
+	return sel + 1;
+}
+
+static const video_kernels_t *video_kernels_get(void)
+{
+	uint32_t sel = switch_atomic_read(&video_kernels_sel);
+
+	if (!sel) {
+		/* first use: whoever gets here first publishes the detected set, everyone else reads it */
+		switch_atomic_cas(&video_kernels_sel, video_kernels_pick(NULL), 0);
+		sel = switch_atomic_read(&video_kernels_sel);
+	}
+
+	return &video_kernel_sets[sel - 1];
+}
+
+#define VIDEO_KERNELS() video_kernels_get()
+
+SWITCH_DECLARE(const char *) switch_core_video_simd(const char *level)
+{
+	if (level) {
+		switch_atomic_set(&video_kernels_sel, video_kernels_pick(!strcasecmp(level, "auto") ? NULL : level));
+	}
+
+	return VIDEO_KERNELS()->name;
+}
+
 #ifdef SWITCH_HAVE_YUV
 static void switch_img_patch_rgb_noalpha(switch_image_t *IMG, switch_image_t *img, int x, int y)
 {
@@ -437,30 +794,26 @@ SWITCH_DECLARE(void) switch_img_patch(switch_image_t *IMG, switch_image_t *img,
 	switch_assert(IMG->fmt == SWITCH_IMG_FMT_I420);
 
 	if (img->fmt == SWITCH_IMG_FMT_ARGB) {
-		int max_w = MIN(img->d_w, IMG->d_w - abs(x));
-		int max_h = MIN(img->d_h, IMG->d_h - abs(y));
-		int j;
-		uint8_t alpha;
-		switch_rgb_color_t *rgb;
-
-		for (i = 0; i < max_h; i++) {
-			for (j = 0; j < max_w; j++) {
-				rgb = (switch_rgb_color_t *)(img->planes[SWITCH_PLANE_PACKED] + i * img->stride[SWITCH_PLANE_PACKED] + j * 4);
-				alpha = rgb->a;
-
-				if (alpha == 255) {
-					switch_img_draw_pixel(IMG, x + j, y + i, rgb);
-				} else if (alpha != 0) {
-					switch_rgb_color_t RGB = { 0 };
-					
-					switch_img_get_rgb_pixel(IMG, &RGB, x + j, y + i);
-					RGB.a = 255;
-					RGB.r = ((RGB.r * (255 - alpha)) >> 8) + ((rgb->r * alpha) >> 8);
-					RGB.g = ((RGB.g * (255 - alpha)) >> 8) + ((rgb->g * alpha) >> 8);
-					RGB.b = ((RGB.b * (255 - alpha)) >> 8) + ((rgb->b * alpha) >> 8);
-					
-					switch_img_draw_pixel(IMG, x + j, y + i, &RGB);
-				}
+		const video_kernels_t *k = VIDEO_KERNELS();
+		int sx = x < 0 ? -x : 0, sy = y < 0 ? -y : 0;
+		int dx = x < 0 ? 0 : x, dy = y < 0 ? 0 : y;
+		int w = MIN((int)img->d_w - sx, (int)IMG->d_w - dx);
+		int h = MIN((int)img->d_h - sy, (int)IMG->d_h - dy);
+		int uv_start = dx & 1, uv_w = (w - uv_start + 1) / 2;
+
+		if (w <= 0 || h <= 0) return;
+
+		/* blend straight into the planes, chroma is sampled from the pixels landing on even canvas positions */
+		for (i = 0; i < h; i++) {
+			const uint8_t *src = img->planes[SWITCH_PLANE_PACKED] + (sy + i) * img->stride[SWITCH_PLANE_PACKED] + sx * 4;
+			int row = dy + i;
+
+			k->argb_blend_y(src, IMG->planes[SWITCH_PLANE_Y] + row * IMG->stride[SWITCH_PLANE_Y] + dx, w);
+
+			if (!(row & 1) && uv_w > 0) {
+				k->argb_blend_uv(src + uv_start * 4,
+								 IMG->planes[SWITCH_PLANE_U] + row / 2 * IMG->stride[SWITCH_PLANE_U] + (dx + uv_start) / 2,
+								 IMG->planes[SWITCH_PLANE_V] + row / 2 * IMG->stride[SWITCH_PLANE_V] + (dx + uv_start) / 2, uv_w);
 			}
 		}
 
@@ -1127,17 +1480,6 @@ static inline int switch_color_distance_literal(switch_rgb_color_t *c1, switch_r
 	return 0;
 }
 
-static inline int switch_color_distance_cheap(switch_rgb_color_t *c1, switch_rgb_color_t *c2)
-{
-	int r = abs(c1->r - c2->r);
-	int g = abs(c1->g - c2->g);
-	int b = abs(c1->b - c2->b);
-
-	if (r < 5 && g < 5 && b < 5) return 0;
-
-	return (3*r) + (4*g) + (3*b);
-}
-
 static inline void get_dom(switch_shade_t autocolor, switch_rgb_color_t *color, int *domP, int *aP, int *bP)
 {
 	int dom, a, b;
@@ -1178,6 +1520,9 @@ SWITCH_DECLARE(void) switch_chromakey_process(switch_chromakey_t *ck, switch_ima
 	switch_image_t *cache_img;
 	int same = 0;
 	int same_same = 0;
+	const video_kernels_t *k = VIDEO_KERNELS();
+	uint8_t cache_hits[256], same_hits[256];
+	int idx = 256;
 
 #ifdef DEBUG_CHROMA
 	int other_img_cached = 0, color_cached = 0, checked = 0, hit_total = 0, total_pixel = 0, delta_hits = 0;
@@ -1219,7 +1564,23 @@ SWITCH_DECLARE(void) switch_chromakey_process(switch_chromakey_t *ck, switch_ima
 		switch_rgb_color_t *last_color = (switch_rgb_color_t *)last_pixel;
 		int hits = 0;
 
+		/* match the next block against the cached frame and the previous pixel in one pass */
+		if (idx == 256) {
+			int n = MIN(256, (int)((end_pixel - pixel) / 4));
 
+			if (cache_pixel) {
+				k->color_match(pixel, cache_pixel, cache_hits, n);
+			}
+
+			if (last_pixel) {
+				k->color_match(pixel, last_pixel, same_hits, n);
+			} else {
+				same_hits[0] = 0;
+				k->color_match(pixel + 4, pixel, same_hits + 1, n - 1);
+			}
+
+			idx = 0;
+		}
 
 #ifdef DEBUG_CHROMA
 		total_pixel++;
@@ -1228,7 +1589,7 @@ SWITCH_DECLARE(void) switch_chromakey_process(switch_chromakey_t *ck, switch_ima
 		if (!ck->no_cache && cache_img && cache_pixel) {
 			switch_rgb_color_t *cache_color = (switch_rgb_color_t *)cache_pixel;
 				
-			if (switch_color_distance_cheap(color, cache_color) < 5) {
+			if (cache_hits[idx]) {
 #ifdef DEBUG_CHROMA
 				other_img_cached++;
 #endif
@@ -1239,7 +1600,7 @@ SWITCH_DECLARE(void) switch_chromakey_process(switch_chromakey_t *ck, switch_ima
 
 
 		if (last_color) {
-			if (switch_color_distance_cheap(color, last_color) < 5) {
+			if (same_hits[idx]) {
 
 				hits = last_hits;
 #ifdef DEBUG_CHROMA
@@ -1312,6 +1673,7 @@ SWITCH_DECLARE(void) switch_chromakey_process(switch_chromakey_t *ck, switch_ima
 	
 		last_pixel = pixel;
 		last_hits = hits;
+		idx++;
 	}
 
 	if (ck->color_count > 1000) {
@@ -1651,6 +2013,27 @@ SWITCH_DECLARE(void) switch_img_overlay(switch_image_t *IMG, switch_image_t *img
 	if (y & 1) y++;
 	if (len <= 0) return;
 
+	if (img->fmt == SWITCH_IMG_FMT_I420) {
+		const video_kernels_t *k = VIDEO_KERNELS();
+
+		/* same format, blend plane by plane without going through rgb */
+		for (i = y; i < max_h; i++) {
+			int src_row = i - y + yoff;
+
+			k->plane_blend(img->planes[SWITCH_PLANE_Y] + src_row * img->stride[SWITCH_PLANE_Y] + xoff,
+						   IMG->planes[SWITCH_PLANE_Y] + i * IMG->stride[SWITCH_PLANE_Y] + x, len, alpha);
+
+			if (!(i & 1)) {
+				k->plane_blend(img->planes[SWITCH_PLANE_U] + src_row / 2 * img->stride[SWITCH_PLANE_U] + xoff / 2,
+							   IMG->planes[SWITCH_PLANE_U] + i / 2 * IMG->stride[SWITCH_PLANE_U] + x / 2, (len + 1) / 2, alpha);
+				k->plane_blend(img->planes[SWITCH_PLANE_V] + src_row / 2 * img->stride[SWITCH_PLANE_V] + xoff / 2,
+							   IMG->planes[SWITCH_PLANE_V] + i / 2 * IMG->stride[SWITCH_PLANE_V] + x / 2, (len + 1) / 2, alpha);
+			}
+		}
+
+		return;
+	}
+
 	for (i = y; i < max_h; i++) {
 		for (j = 0; j < len; j++) {
 			switch_img_get_rgb_pixel(IMG, &RGB, x + j, i);
@@ -56,6 +56,8 @@ struct switch_event_node {
 	switch_event_callback_t callback;
 	/*! private data */
 	void *user_data;
+	/*! the callback only reads headers through the accessors, variables may stay in the snapshot */
+	switch_bool_t lazy;
 	struct switch_event_node *next;
 };
 
@@ -129,6 +131,20 @@ static char *my_dup(const char *s)
 #define FREE(ptr) switch_safe_free(ptr)
 #endif
 
+struct switch_event_snapshot {
+	switch_atomic_t refs;
+	switch_event_t *scope;
+	switch_event_t *vars;
+};
+
+/* copy in an attached snapshot before anything walks the headers or looks up one it could hold */
+static inline void materialize_for(switch_event_t *event, const char *header_name)
+{
+	if (event->snapshot && (!header_name || !strncasecmp(header_name, "variable_", 9) || !strncasecmp(header_name, "scope_variable_", 15))) {
+		switch_event_materialize(event);
+	}
+}
+
 /* make sure this is synced with the switch_event_types_t enum in switch_types.h
    also never put any new ones before EVENT_ALL
 */
@@ -404,6 +420,10 @@ SWITCH_DECLARE(void) switch_event_deliver(switch_event_t **event)
 		for (e = (*event)->event_id;; e = SWITCH_EVENT_ALL) {
 			for (node = EVENT_NODES[e]; node; node = node->next) {
 				if (switch_events_match(*event, node)) {
+					/* variables are only copied in for listeners that walk the raw headers */
+					if (!node->lazy) {
+						materialize_for(*event, NULL);
+					}
 					(*event)->bind_user_data = node->user_data;
 					node->callback(*event);
 				}
@@ -802,6 +822,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_rename_header(switch_event_t *event
 		return SWITCH_STATUS_FALSE;
 	}
 
+	materialize_for(event, header_name);
+
 	hash = switch_ci_hashfunc_default(header_name, &hlen);
 
 	for (hp = event->headers; hp; hp = hp->next) {
@@ -836,6 +858,18 @@ SWITCH_DECLARE(switch_event_header_t *) switch_event_get_header_ptr(switch_event
 			return hp;
 		}
 	}
+
+	/* reads are served from the shared snapshot without copying it in */
+	if (event->snapshot && (!strncasecmp(header_name, "scope_variable_", 15) || !strncasecmp(header_name, "variable_", 9))) {
+		switch_event_t *from = *header_name == 's' || *header_name == 'S' ? event->snapshot->scope : event->snapshot->vars;
+
+		for (hp = from->headers; hp; hp = hp->next) {
+			if ((!hp->hash || hash == hp->hash) && !strcasecmp(hp->name, header_name)) {
+				return hp;
+			}
+		}
+	}
+
 	return NULL;
 }
 
@@ -873,6 +907,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_del_header_val(switch_event_t *even
 	switch_ssize_t hlen = -1;
 	unsigned long hash = 0;
 
+	materialize_for(event, header_name);
+
 	tp = event->headers;
 	hash = switch_ci_hashfunc_default(header_name, &hlen);
 	while (tp) {
@@ -1001,6 +1037,8 @@ static switch_status_t switch_event_base_add_header(switch_event_t *event, switc
 		switch_event_set_body(event, data);
 	}
 
+	materialize_for(event, header_name);
+
 	if ((index_ptr = strchr(header_name, '['))) {
 		index_ptr++;
 		index = atoi(index_ptr);
@@ -1263,6 +1301,10 @@ SWITCH_DECLARE(void) switch_event_destroy(switch_event_t **event)
 	switch_event_header_t *hp, *this;
 
 	if (ep) {
+		if (ep->snapshot) {
+			switch_event_snapshot_release(&ep->snapshot);
+		}
+
 		for (hp = ep->headers; hp;) {
 			this = hp;
 			hp = hp->next;
@@ -1309,12 +1351,102 @@ SWITCH_DECLARE(void) switch_event_destroy(switch_event_t **event)
 }
 
 
+SWITCH_DECLARE(switch_event_snapshot_t *) switch_event_snapshot_create(switch_event_t *variables, switch_event_t *scope_variables)
+{
+	switch_event_snapshot_t *snapshot;
+	switch_event_header_t *hp;
+	switch_event_t *ep;
+	char buf[1024];
+
+	snapshot = ALLOC(sizeof(*snapshot));
+	switch_assert(snapshot);
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->refs = 1;
+
+	switch_event_create_plain(&snapshot->scope, SWITCH_EVENT_CLONE);
+	switch_event_create_plain(&snapshot->vars, SWITCH_EVENT_CLONE);
+
+	for (ep = scope_variables; ep; ep = ep->next) {
+		for (hp = ep->headers; hp; hp = hp->next) {
+			switch_assert(hp->name && hp->value);
+			switch_snprintf(buf, sizeof(buf), "scope_variable_%s", hp->name);
+
+			/* the innermost scope wins */
+			if (!switch_event_get_header(snapshot->scope, buf)) {
+				switch_event_add_header_string(snapshot->scope, SWITCH_STACK_BOTTOM, buf, hp->value);
+			}
+		}
+	}
+
+	if (variables) {
+		for (hp = variables->headers; hp; hp = hp->next) {
+			switch_assert(hp->name && hp->value);
+			switch_snprintf(buf, sizeof(buf), "variable_%s", hp->name);
+			switch_event_add_header_string(snapshot->vars, SWITCH_STACK_BOTTOM, buf, hp->value);
+		}
+	}
+
+	return snapshot;
+}
+
+SWITCH_DECLARE(void) switch_event_snapshot_release(switch_event_snapshot_t **snapshot)
+{
+	switch_event_snapshot_t *sp = *snapshot;
+
+	*snapshot = NULL;
+
+	if (sp && !switch_atomic_dec(&sp->refs)) {
+		switch_event_destroy(&sp->scope);
+		switch_event_destroy(&sp->vars);
+		FREE(sp);
+	}
+}
+
+SWITCH_DECLARE(void) switch_event_set_snapshot(switch_event_t *event, switch_event_snapshot_t *snapshot)
+{
+	switch_assert(event);
+
+	/* an earlier snapshot keeps its place ahead of the new one */
+	switch_event_materialize(event);
+
+	if (snapshot) {
+		switch_atomic_inc(&snapshot->refs);
+		event->snapshot = snapshot;
+	}
+}
+
+SWITCH_DECLARE(void) switch_event_materialize(switch_event_t *event)
+{
+	switch_event_snapshot_t *snapshot;
+	switch_event_header_t *hp;
+
+	if (!event || !(snapshot = event->snapshot)) {
+		return;
+	}
+
+	event->snapshot = NULL;
+
+	for (hp = snapshot->scope->headers; hp; hp = hp->next) {
+		if (!switch_event_get_header(event, hp->name)) {
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, hp->name, hp->value);
+		}
+	}
+
+	for (hp = snapshot->vars->headers; hp; hp = hp->next) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, hp->name, hp->value);
+	}
+
+	switch_event_snapshot_release(&snapshot);
+}
+
 SWITCH_DECLARE(void) switch_event_merge(switch_event_t *event, switch_event_t *tomerge)
 {
 	switch_event_header_t *hp;
 
 	switch_assert(tomerge && event);
 
+	materialize_for(tomerge, NULL);
+
 	for (hp = tomerge->headers; hp; hp = hp->next) {
 		if (hp->idx) {
 			int i;
@@ -1361,6 +1493,11 @@ SWITCH_DECLARE(switch_status_t) switch_event_dup(switch_event_t **event, switch_
 
 	(*event)->key = todup->key;
 
+	/* the copy shares the variables until one of them needs them */
+	if (todup->snapshot) {
+		switch_event_set_snapshot(*event, todup->snapshot);
+	}
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -1380,6 +1517,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_dup_reply(switch_event_t **event, s
 	(*event)->bind_user_data = todup->bind_user_data;
 	(*event)->flags = todup->flags;
 
+	materialize_for(todup, NULL);
+
 	for (hp = todup->headers; hp; hp = hp->next) {
 		char *name = hp->name, *value = hp->value;
 
@@ -1497,6 +1636,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_binary_serialize(switch_event_t *ev
 
 	tpl_pack(tn, 0);
 
+	materialize_for(event, NULL);
+
 	for (eh = event->headers; eh; eh = eh->next) {
 		if (eh->idx) continue;  // no arrays yet
 
@@ -1542,6 +1683,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_serialize(switch_event_t *event, ch
 		abort();
 	}
 
+	materialize_for(event, NULL);
+
 	/* switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "hit serialized!.\n"); */
 	for (hp = event->headers; hp; hp = hp->next) {
 		/*
@@ -1821,6 +1964,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_serialize_json_obj(switch_event_t *
 
 	cj = cJSON_CreateObject();
 
+	materialize_for(event, NULL);
+
 	for (hp = event->headers; hp; hp = hp->next) {
 		if (hp->idx) {
 			cJSON *a = cJSON_CreateArray();
@@ -1922,6 +2067,8 @@ SWITCH_DECLARE(switch_xml_t) switch_event_xmlize(switch_event_t *event, const ch
 		}
 	}
 
+	materialize_for(event, NULL);
+
 	if ((xheaders = switch_xml_add_child_d(xml, "headers", off++))) {
 		int hoff = 0;
 		for (hp = event->headers; hp; hp = hp->next) {
@@ -2052,8 +2199,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_get_custom_events(switch_console_ca
 	return x ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_event_bind_removable(const char *id, switch_event_types_t event, const char *subclass_name,
-															switch_event_callback_t callback, void *user_data, switch_event_node_t **node)
+static switch_status_t event_bind(const char *id, switch_event_types_t event, const char *subclass_name,
+								  switch_event_callback_t callback, void *user_data, switch_bool_t lazy, switch_event_node_t **node)
 {
 	switch_event_node_t *event_node;
 	switch_event_subclass_t *subclass = NULL;
@@ -2094,6 +2241,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_bind_removable(const char *id, swit
 		}
 		event_node->callback = callback;
 		event_node->user_data = user_data;
+		event_node->lazy = lazy;
 
 		if (EVENT_NODES[event]) {
 			event_node->next = EVENT_NODES[event];
@@ -2114,6 +2262,18 @@ SWITCH_DECLARE(switch_status_t) switch_event_bind_removable(const char *id, swit
 	return SWITCH_STATUS_MEMERR;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_event_bind_removable(const char *id, switch_event_types_t event, const char *subclass_name,
+															switch_event_callback_t callback, void *user_data, switch_event_node_t **node)
+{
+	return event_bind(id, event, subclass_name, callback, user_data, SWITCH_FALSE, node);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_event_bind_lazy(const char *id, switch_event_types_t event, const char *subclass_name,
+													   switch_event_callback_t callback, void *user_data)
+{
+	return event_bind(id, event, subclass_name, callback, user_data, SWITCH_TRUE, NULL);
+}
+
 
 SWITCH_DECLARE(switch_status_t) switch_event_bind(const char *id, switch_event_types_t event, const char *subclass_name,
 												  switch_event_callback_t callback, void *user_data)
@@ -2583,6 +2743,8 @@ SWITCH_DECLARE(char *) switch_event_build_param_string(switch_event_t *event, co
 	}
 
 	if (event) {
+		materialize_for(event, NULL);
+
 		if ((hi = event->headers)) {
 
 			for (; hi; hi = hi->next) {
@@ -1455,6 +1455,7 @@ static switch_bool_t record_callback(switch_media_bug_t *bug, void *user_data, s
 				const char *file_trimmed_ms = NULL;
 				const char *file_size = NULL;
 				const char *file_trimmed = NULL;
+				switch_file_write_behind_stats_t wb_stats = { 0 };
 
 				if (rh->thread_ready) {
 					switch_status_t st;
@@ -1495,6 +1496,12 @@ static switch_bool_t record_callback(switch_media_bug_t *bug, void *user_data, s
 
 
 				switch_core_file_pre_close(rh->fh);
+
+				if (switch_core_file_get_write_behind_stats(rh->fh, &wb_stats) == SWITCH_STATUS_SUCCESS) {
+					switch_channel_set_variable_printf(channel, "record_write_behind_max_backlog", "%" SWITCH_SIZE_T_FMT, wb_stats.max_backlog_bytes);
+					switch_channel_set_variable_printf(channel, "record_write_behind_dropped_samples", "%" SWITCH_SIZE_T_FMT, wb_stats.dropped_samples);
+				}
+
 				switch_core_file_get_string(rh->fh, SWITCH_AUDIO_COL_STR_FILE_SIZE, &file_size);
 				switch_core_file_get_string(rh->fh, SWITCH_AUDIO_COL_STR_FILE_TRIMMED, &file_trimmed);
 				switch_core_file_get_string(rh->fh, SWITCH_AUDIO_COL_STR_FILE_TRIMMED_MS, &file_trimmed_ms);
@@ -2754,6 +2761,10 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_record_session_event(switch_core_sess
 		fh->pre_buffer_datalen = SWITCH_DEFAULT_FILE_BUFFER_LEN;
 	}
 
+	if ((vval = switch_channel_get_variable(channel, "enable_file_write_behind")) && switch_true(vval)) {
+		file_flags |= SWITCH_FILE_WRITE_BEHIND;
+	}
+
 
 	if (!switch_is_file_path(file)) {
 		char *tfile = NULL;
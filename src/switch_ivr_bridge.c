@@ -31,6 +31,8 @@
 
 #include <switch.h>
 #define DEFAULT_LEAD_FRAMES 10
+#define RTP_RELAY_HOLDOFF_FRAMES 50
+#define RTP_RELAY_WAIT_MS 200
 
 static const switch_state_handler_table_t audio_bridge_peer_state_handlers;
 static void cleanup_proxy_mode_a(switch_core_session_t *session);
@@ -382,6 +384,7 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 	const char *banner_file = NULL;
 	int played_banner = 0, banner_counter = 0;
 	int pass_val = 0, last_pass_val = 0;
+	int relay_holdoff = RTP_RELAY_HOLDOFF_FRAMES;
 
 #ifdef SWITCH_VIDEO_IN_THREADS
 	struct vid_helper vh = { 0 };
@@ -796,6 +799,19 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 		}
 
 
+		if (relay_holdoff) {
+			relay_holdoff--;
+		} else if (pass_val == 2 && switch_channel_test_flag(chan_a, CF_ANSWERED) && switch_channel_test_flag(chan_b, CF_ANSWERED) &&
+				   switch_core_session_rtp_relay_start(session_a, session_b) == SWITCH_STATUS_SUCCESS) {
+			/* the rtp layer is moving the audio, only come back for signalling or when the relay gives up */
+			if (switch_core_session_rtp_relay_wait(session_a, RTP_RELAY_WAIT_MS) != SWITCH_STATUS_SUCCESS) {
+				relay_holdoff = RTP_RELAY_HOLDOFF_FRAMES;
+			}
+			continue;
+		} else {
+			relay_holdoff = RTP_RELAY_HOLDOFF_FRAMES;
+		}
+
 		/* read audio from 1 channel and write it to the other */
 		status = switch_core_session_read_frame(session_a, &read_frame, SWITCH_IO_FLAG_NONE, stream_id);
 
@@ -830,6 +846,7 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 
   end_of_bridge_loop:
 
+	switch_core_session_rtp_relay_stop(session_a);
 	switch_core_session_passthru(session_a, SWITCH_MEDIA_TYPE_AUDIO, SWITCH_FALSE);
 
 
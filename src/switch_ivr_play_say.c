@@ -481,6 +481,10 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_record_file(switch_core_session_t *se
 		fh->pre_buffer_datalen = SWITCH_DEFAULT_FILE_BUFFER_LEN;
 	}
 
+	if ((vval = switch_channel_get_variable(channel, "enable_file_write_behind")) && switch_true(vval)) {
+		file_flags |= SWITCH_FILE_WRITE_BEHIND;
+	}
+
 	if (switch_test_flag(fh, SWITCH_FILE_WRITE_APPEND) || ((p = switch_channel_get_variable(channel, "RECORD_APPEND")) && switch_true(p))) {
 		file_flags |= SWITCH_FILE_WRITE_APPEND;
 	}
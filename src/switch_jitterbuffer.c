@@ -37,6 +37,7 @@
 #define RENACK_TIME 100000
 #define MAX_FRAME_PADDING 2
 #define MAX_MISSING_SEQ 20
+#define JB_RING_MIN 128
 #define jb_debug(_jb, _level, _format, ...) if (_jb->debug_level >= _level) switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(_jb->session), SWITCH_LOG_ALERT, "JB:%p:%s:%d/%d lv:%d ln:%.4d sz:%.3u/%.3u/%.3u/%.3u c:%.3u %.3u/%.3u/%.3u/%.3u %.2f%% ->" _format, (void *) _jb, (jb->type == SJB_TEXT ? "txt" : (jb->type == SJB_AUDIO ? "aud" : "vid")), _jb->allocated_nodes, _jb->visible_nodes, _level, __LINE__,  _jb->min_frame_len, _jb->max_frame_len, _jb->frame_len, _jb->complete_frames, _jb->period_count, _jb->consec_good_count, _jb->period_good_count, _jb->consec_miss_count, _jb->period_miss_count, _jb->period_miss_pct, __VA_ARGS__)
 
 //const char *TOKEN_1 = "ONE";
@@ -50,14 +51,25 @@ typedef struct switch_jb_node_s {
 	uint32_t len;
 	uint8_t visible;
 	uint8_t bad_hits;
+	/* visible nodes in seq order, or the free list when hidden */
 	struct switch_jb_node_s *prev;
 	struct switch_jb_node_s *next;
+	/* visible nodes in ts order */
+	struct switch_jb_node_s *ts_prev;
+	struct switch_jb_node_s *ts_next;
 	/* used for counting the number of partial or complete frames currently in the JB */
 	switch_bool_t complete_frame_mark;
 } switch_jb_node_t;
 
 struct switch_jb_s {
 	struct switch_jb_node_s *node_list;
+	struct switch_jb_node_s *node_tail;
+	struct switch_jb_node_s *ts_list;
+	struct switch_jb_node_s *ts_tail;
+	struct switch_jb_node_s *free_list;
+	/* visible nodes indexed by seq & ring_mask, grown on collision */
+	struct switch_jb_node_s **ring;
+	uint32_t ring_mask;
 	uint32_t last_target_seq;
 	uint32_t highest_read_ts;
 	uint32_t highest_dropped_ts;
@@ -94,7 +106,6 @@ struct switch_jb_s {
 	uint16_t next_seq;
 	switch_size_t last_len;
 	switch_inthash_t *missing_seq_hash;
-	switch_inthash_t *node_hash;
 	switch_inthash_t *node_hash_ts;
 	switch_mutex_t *mutex;
 	switch_mutex_t *list_mutex;
@@ -115,96 +126,151 @@ struct switch_jb_s {
 };
 
 
-static int node_cmp(const void *l, const void *r)
+/* The ring holds one visible node per slot. Entries left behind by a node that
+ * was hidden or renumbered are ignored, a slot only counts when it holds a
+ * visible node carrying the seq that maps to it. */
+static inline int jb_ring_live(switch_jb_t *jb, switch_jb_node_t *np, uint32_t slot)
 {
-	switch_jb_node_t *a = (switch_jb_node_t *) l;
-	switch_jb_node_t *b = (switch_jb_node_t *) r;
-
-	if (!a->visible) return 0;
-	if (!b->visible) return 1;
-
-	return ntohs(a->packet.header.seq) - ntohs(b->packet.header.seq);
+	return np && np->visible && (ntohs(np->packet.header.seq) & jb->ring_mask) == slot;
 }
 
-//http://www.chiark.greenend.org.uk/~sgtatham/algorithms/listsort.c
-switch_jb_node_t *sort_nodes(switch_jb_node_t *list, int (*cmp)(const void *, const void *)) {
-	switch_jb_node_t *p, *q, *e, *tail;
-	int insize, nmerges, psize, qsize, i;
+static inline switch_jb_node_t *jb_find_seq(switch_jb_t *jb, uint16_t seq)
+{
+	switch_jb_node_t *np = jb->ring[ntohs(seq) & jb->ring_mask];
 
-	if (!list) {
-		return NULL;
+	if (np && np->visible && np->packet.header.seq == seq) {
+		return np;
 	}
 
-	insize = 1;
+	return NULL;
+}
+
+static void jb_ring_grow(switch_jb_t *jb)
+{
+	uint32_t size = jb->ring_mask + 1;
+	switch_jb_node_t **ring = NULL, **slot, *np;
 
-	while (1) {
-		p = list;
-		list = NULL;
-		tail = NULL;
+	/* keep doubling until every visible seq has a slot of its own */
+	do {
+		switch_safe_free(ring);
+		size *= 2;
+		switch_zmalloc(ring, size * sizeof(*ring));
 
-		nmerges = 0;  /* count number of merges we do in this pass */
+		for (np = jb->node_list; np; np = np->next) {
+			slot = &ring[ntohs(np->packet.header.seq) & (size - 1)];
 
-		while (p) {
-			nmerges++;  /* there exists a merge to be done */
-			            /* step `insize' places along from p */
-			q = p;
-			psize = 0;
-			for (i = 0; i < insize; i++) {
-				psize++;
-				q = q->next;
-				if (!q) break;
+			if (*slot && (*slot)->packet.header.seq != np->packet.header.seq) {
+				break;
 			}
 
-			/* if q hasn't fallen off end, we have two lists to merge */
-			qsize = insize;
-
-			/* now we have two lists; merge them */
-			while (psize > 0 || (qsize > 0 && q)) {
-
-				/* decide whether next switch_jb_node_t of merge comes from p or q */
-				if (psize == 0) {
-					/* p is empty; e must come from q. */
-					e = q; q = q->next; qsize--;
-				} else if (qsize == 0 || !q) {
-					/* q is empty; e must come from p. */
-					e = p; p = p->next; psize--;
-				} else if (cmp(p,q) <= 0) {
-					/* First switch_jb_node_t of p is lower (or same);
-					 * e must come from p. */
-					e = p; p = p->next; psize--;
-				} else {
-					/* First switch_jb_node_t of q is lower; e must come from q. */
-					e = q; q = q->next; qsize--;
-				}
+			*slot = np;
+		}
+	} while (np);
 
-				/* add the next switch_jb_node_t to the merged list */
-				if (tail) {
-					tail->next = e;
-				} else {
-					list = e;
-				}
+	free(jb->ring);
+	jb->ring = ring;
+	jb->ring_mask = size - 1;
 
-				/* Maintain reverse pointers in a doubly linked list. */
-				e->prev = tail;
+	jb_debug(jb, 2, "Seq ring grown to %u slots\n", size);
+}
 
-				tail = e;
-			}
+static inline void jb_ring_insert(switch_jb_t *jb, switch_jb_node_t *node)
+{
+	uint32_t slot = ntohs(node->packet.header.seq) & jb->ring_mask;
+	switch_jb_node_t *np;
 
-			/* now p has stepped `insize' places along, and q has too */
-			p = q;
-		}
+	/* two visible seqs sharing a slot, 65536 slots can hold every seq */
+	while ((np = jb->ring[slot]) && np != node && np->packet.header.seq != node->packet.header.seq && jb_ring_live(jb, np, slot)) {
+		jb_ring_grow(jb);
+		slot = ntohs(node->packet.header.seq) & jb->ring_mask;
+	}
+
+	jb->ring[slot] = node;
+}
 
-		tail->next = NULL;
+/* twin is a visible duplicate of the seq being removed, it takes over the slot */
+static inline switch_bool_t jb_ring_delete(switch_jb_t *jb, switch_jb_node_t *node, switch_jb_node_t *twin)
+{
+	uint32_t slot = ntohs(node->packet.header.seq) & jb->ring_mask;
+	switch_jb_node_t *np = jb->ring[slot];
+
+	if (np && np->packet.header.seq == node->packet.header.seq && (np == node || jb_ring_live(jb, np, slot))) {
+		jb->ring[slot] = twin;
+		return SWITCH_TRUE;
+	}
+
+	return SWITCH_FALSE;
+}
 
-		/* If we have done only one merge, we're finished. */
-		if (nmerges <= 1)   /* allow for nmerges==0, the empty list case */
-			return list;
+/* Packets mostly arrive in order so both lists are appended to at the tail,
+ * a late packet walks back from the tail to its place. */
+static inline void link_node(switch_jb_t *jb, switch_jb_node_t *node)
+{
+	uint16_t seq = ntohs(node->packet.header.seq);
+	uint32_t ts = ntohl(node->packet.header.ts);
+	switch_jb_node_t *np;
+
+	for (np = jb->node_tail; np && ntohs(np->packet.header.seq) > seq; np = np->prev);
 
-		/* Otherwise repeat, merging lists twice the size */
-		insize *= 2;
+	node->prev = np;
+	node->next = np ? np->next : jb->node_list;
+	if (node->next) {
+		node->next->prev = node;
+	} else {
+		jb->node_tail = node;
+	}
+	if (np) {
+		np->next = node;
+	} else {
+		jb->node_list = node;
+	}
+
+	for (np = jb->ts_tail; np && ntohl(np->packet.header.ts) > ts; np = np->ts_prev);
+
+	node->ts_prev = np;
+	node->ts_next = np ? np->ts_next : jb->ts_list;
+	if (node->ts_next) {
+		node->ts_next->ts_prev = node;
+	} else {
+		jb->ts_tail = node;
+	}
+	if (np) {
+		np->ts_next = node;
+	} else {
+		jb->ts_list = node;
 	}
 }
 
+static inline void unlink_node(switch_jb_t *jb, switch_jb_node_t *node)
+{
+	if (node->prev) {
+		node->prev->next = node->next;
+	} else {
+		jb->node_list = node->next;
+	}
+	if (node->next) {
+		node->next->prev = node->prev;
+	} else {
+		jb->node_tail = node->prev;
+	}
+
+	if (node->ts_prev) {
+		node->ts_prev->ts_next = node->ts_next;
+	} else {
+		jb->ts_list = node->ts_next;
+	}
+	if (node->ts_next) {
+		node->ts_next->ts_prev = node->ts_prev;
+	} else {
+		jb->ts_tail = node->ts_prev;
+	}
+
+	node->ts_prev = node->ts_next = NULL;
+	node->prev = NULL;
+	node->next = jb->free_list;
+	jb->free_list = node;
+}
+
 // static inline void thin_frames(switch_jb_t *jb, int freq, int max);
 
 
@@ -214,13 +280,9 @@ static inline switch_jb_node_t *new_node(switch_jb_t *jb)
 
 	switch_mutex_lock(jb->list_mutex);
 
-	for (np = jb->node_list; np; np = np->next) {
-		if (!np->visible) {
-			break;
-		}
-	}
-
-	if (!np) {
+	if ((np = jb->free_list)) {
+		jb->free_list = np->next;
+	} else {
 		int mult = 2;
 
 		if (jb->type != SJB_VIDEO) {
@@ -240,15 +302,10 @@ static inline switch_jb_node_t *new_node(switch_jb_t *jb)
 		
 		np = switch_core_alloc(jb->pool, sizeof(*np));
 		jb->allocated_nodes++;
-		np->next = jb->node_list;
-		if (np->next) {
-			np->next->prev = np;
-		}
-		jb->node_list = np;
-
 	}
 
 	switch_assert(np);
+	np->prev = np->next = NULL;
 	np->bad_hits = 0;
 	np->visible = 1;
 	jb->visible_nodes++;
@@ -259,52 +316,31 @@ static inline switch_jb_node_t *new_node(switch_jb_t *jb)
 	return np;
 }
 
-static inline void push_to_top(switch_jb_t *jb, switch_jb_node_t *node)
-{
-	if (node == jb->node_list) {
-		jb->node_list = node->next;
-	} else if (node->prev) {
-		node->prev->next = node->next;
-	}
-
-	if (node->next) {
-		node->next->prev = node->prev;
-	}
-
-	node->next = jb->node_list;
-	node->prev = NULL;
-
-	if (node->next) {
-		node->next->prev = node;
-	}
-
-	jb->node_list = node;
-
-	switch_assert(node->next != node);
-	switch_assert(node->prev != node);
-}
-
 static inline void hide_node(switch_jb_node_t *node, switch_bool_t pop)
 {
 	switch_jb_t *jb = node->parent;
+	switch_jb_node_t *twin = NULL;
 
 	switch_mutex_lock(jb->list_mutex);
 
 	if (node->visible) {
+		if (node->prev && node->prev->packet.header.seq == node->packet.header.seq) {
+			twin = node->prev;
+		} else if (node->next && node->next->packet.header.seq == node->packet.header.seq) {
+			twin = node->next;
+		}
+
 		node->visible = 0;
 		node->bad_hits = 0;
 		jb->visible_nodes--;
-
-		if (pop) {
-			push_to_top(jb, node);
-		}
+		unlink_node(jb, node);
 	}
 
 	if (jb->node_hash_ts) {
 		switch_core_inthash_delete(jb->node_hash_ts, node->packet.header.ts);
 	}
 
-	if (switch_core_inthash_delete(jb->node_hash, node->packet.header.seq)) {
+	if (jb_ring_delete(jb, node, twin)) {
 		if (node->complete_frame_mark && jb->type == SJB_VIDEO) {
 			jb->complete_frames--;
 			node->complete_frame_mark = FALSE;
@@ -314,87 +350,45 @@ static inline void hide_node(switch_jb_node_t *node, switch_bool_t pop)
 	switch_mutex_unlock(jb->list_mutex);
 }
 
-static inline void sort_free_nodes(switch_jb_t *jb)
-{
-	switch_mutex_lock(jb->list_mutex);
-	jb->node_list = sort_nodes(jb->node_list, node_cmp);
-	switch_mutex_unlock(jb->list_mutex);
-}
-
 static inline void hide_nodes(switch_jb_t *jb)
 {
-	switch_jb_node_t *np;
-
 	switch_mutex_lock(jb->list_mutex);
-	for (np = jb->node_list; np; np = np->next) {
-		hide_node(np, SWITCH_FALSE);
+	while (jb->node_list) {
+		hide_node(jb->node_list, SWITCH_FALSE);
 	}
 	switch_mutex_unlock(jb->list_mutex);
 }
 
-static inline void drop_ts(switch_jb_t *jb, uint32_t ts)
+/* hide every node sharing the ts of node, they are neighbours in the ts list */
+static inline void drop_ts(switch_jb_t *jb, switch_jb_node_t *node)
 {
-	switch_jb_node_t *np;
-	int x = 0;
+	switch_jb_node_t *np, *next;
+	uint32_t ts = node->packet.header.ts;
 
 	switch_mutex_lock(jb->list_mutex);
-	for (np = jb->node_list; np; np = np->next) {
-		if (!np->visible) continue;
+	for (np = node; np->ts_prev && np->ts_prev->packet.header.ts == ts; np = np->ts_prev);
 
-		if (ts == np->packet.header.ts) {
-			hide_node(np, SWITCH_FALSE);
-			x++;
-		}
-	}
-
-	if (x) {
-		sort_free_nodes(jb);
+	for (; np && np->packet.header.ts == ts; np = next) {
+		next = np->ts_next;
+		hide_node(np, SWITCH_FALSE);
 	}
-
 	switch_mutex_unlock(jb->list_mutex);
 }
 
 static inline switch_jb_node_t *jb_find_lowest_seq(switch_jb_t *jb, uint32_t ts)
 {
-	switch_jb_node_t *np, *lowest = NULL;
+	switch_jb_node_t *np;
 
 	switch_mutex_lock(jb->list_mutex);
-	for (np = jb->node_list; np; np = np->next) {
-		if (!np->visible) continue;
-
-		if (ts && ts != np->packet.header.ts) continue;
-
-		if (!lowest || ntohs(lowest->packet.header.seq) > ntohs(np->packet.header.seq)) {
-			lowest = np;
-		}
-	}
+	for (np = jb->node_list; np && ts && ts != np->packet.header.ts; np = np->next);
 	switch_mutex_unlock(jb->list_mutex);
 
-	return lowest;
+	return np;
 }
 
 static inline switch_jb_node_t *jb_find_lowest_node(switch_jb_t *jb)
 {
-	switch_jb_node_t *np, *lowest = NULL;
-
-	switch_mutex_lock(jb->list_mutex);
-	for (np = jb->node_list; np; np = np->next) {
-		if (!np->visible) continue;
-
-		if (!lowest || ntohl(lowest->packet.header.ts) > ntohl(np->packet.header.ts)) {
-			lowest = np;
-		}
-	}
-	switch_mutex_unlock(jb->list_mutex);
-
-	return lowest ? lowest : NULL;
-}
-
-static inline uint32_t jb_find_lowest_ts(switch_jb_t *jb)
-{
-	switch_jb_node_t *lowest = jb_find_lowest_node(jb);
-
-	return lowest ? lowest->packet.header.ts : 0;
+	return jb->ts_list;
 }
 
 #if 0
@@ -410,75 +404,46 @@ static inline void thin_frames(switch_jb_t *jb, int freq, int max)
 	while (node && dropped <= max) {
 		this_node = node;
 		node = node->next;
-		
-		if (this_node->visible) {
-			i++;
-		} else {
-			continue;
-		}
+		i++;
 
 		if ((i % freq) == 0) {
-			drop_ts(jb, this_node->packet.header.ts);
+			drop_ts(jb, this_node);
 			dropped++;
+			node = jb->node_list;
 		}
 	}
 
-	sort_free_nodes(jb);
 	switch_mutex_unlock(jb->list_mutex);
 }
 
 static inline switch_jb_node_t *jb_find_highest_node(switch_jb_t *jb)
 {
-	switch_jb_node_t *np, *highest = NULL;
-
-	switch_mutex_lock(jb->list_mutex);
-	for (np = jb->node_list; np; np = np->next) {
-		if (!np->visible) continue;
-
-		if (!highest || ntohl(highest->packet.header.ts) < ntohl(np->packet.header.ts)) {
-			highest = np;
-		}
-	}
-	switch_mutex_unlock(jb->list_mutex);
-
-	return highest ? highest : NULL;
-}
-
-
-static inline uint32_t jb_find_highest_ts(switch_jb_t *jb)
-{
-	switch_jb_node_t *highest = jb_find_highest_node(jb);
-
-	return highest ? highest->packet.header.ts : 0;
+	return jb->ts_tail;
 }
 
 static inline void drop_newest_frame(switch_jb_t *jb)
 {
-	uint32_t ts = jb_find_highest_ts(jb);
+	switch_jb_node_t *highest = jb_find_highest_node(jb);
 
-	drop_ts(jb, ts);
-	jb_debug(jb, 1, "Dropping highest frame ts:%u\n", ntohl(ts));
+	if (highest) {
+		jb_debug(jb, 1, "Dropping highest frame ts:%u\n", ntohl(highest->packet.header.ts));
+		drop_ts(jb, highest);
+	}
 }
 
-
-
-
 static inline switch_jb_node_t *jb_find_penultimate_node(switch_jb_t *jb)
 {
-	switch_jb_node_t *np, *highest = NULL, *second_highest = NULL;
+	switch_jb_node_t *np = jb->ts_tail;
 
-	switch_mutex_lock(jb->list_mutex);
-	for (np = jb->node_list; np; np = np->next) {
-		if (!np->visible) continue;
+	if (np) {
+		uint32_t ts = np->packet.header.ts;
 
-		if (!highest || ntohl(highest->packet.header.ts) < ntohl(np->packet.header.ts)) {
-			if (highest) second_highest = highest;
-			highest = np;
+		while (np->ts_prev && np->packet.header.ts == ts) {
+			np = np->ts_prev;
 		}
 	}
-	switch_mutex_unlock(jb->list_mutex);
 
-	return second_highest ? second_highest : highest;
+	return np;
 }
 #endif
 
@@ -555,12 +520,8 @@ static inline int verify_oldest_frame(switch_jb_t *jb)
 
 	switch_mutex_lock(jb->mutex);
 
-	jb->node_list = sort_nodes(jb->node_list, node_cmp);
-
 	for (np = lowest->next; np; np = np->next) {
 
-		if (!np->visible) continue;
-
 		if (ntohs(np->packet.header.seq) != ntohs(np->prev->packet.header.seq) + 1) {
 			uint32_t val = (uint32_t)htons(ntohs(np->prev->packet.header.seq) + 1);
 
@@ -585,10 +546,12 @@ static inline int verify_oldest_frame(switch_jb_t *jb)
 
 static inline void drop_oldest_frame(switch_jb_t *jb)
 {
-	uint32_t ts = jb_find_lowest_ts(jb);
+	switch_jb_node_t *lowest = jb_find_lowest_node(jb);
 
-	drop_ts(jb, ts);
-	jb_debug(jb, 1, "Dropping oldest frame ts:%u\n", ntohl(ts));
+	if (lowest) {
+		jb_debug(jb, 1, "Dropping oldest frame ts:%u\n", ntohl(lowest->packet.header.ts));
+		drop_ts(jb, lowest);
+	}
 }
 
 
@@ -599,8 +562,8 @@ static inline void drop_second_newest_frame(switch_jb_t *jb)
 	switch_jb_node_t *second_newest = jb_find_penultimate_node(jb);
 
 	if (second_newest) {
-		drop_ts(jb, second_newest->packet.header.ts);
 		jb_debug(jb, 1, "Dropping second highest frame ts:%u\n", ntohl(second_newest->packet.header.ts));
+		drop_ts(jb, second_newest);
 	}
 }
 #endif
@@ -642,7 +605,10 @@ static inline void add_node(switch_jb_t *jb, switch_rtp_packet_t *packet, switch
 	node->len = len;
 	memcpy(node->packet.body, packet->body, len);
 
-	switch_core_inthash_insert(jb->node_hash, node->packet.header.seq, node);
+	switch_mutex_lock(jb->list_mutex);
+	link_node(jb, node);
+	jb_ring_insert(jb, node);
+	switch_mutex_unlock(jb->list_mutex);
 
 	if (jb->node_hash_ts) {
 		switch_core_inthash_insert(jb->node_hash_ts, node->packet.header.ts, node);
@@ -758,7 +724,7 @@ static inline switch_status_t jb_next_packet_by_seq(switch_jb_t *jb, switch_jb_n
 	}
 
 	if (!jb->target_seq) {
-		if ((node = switch_core_inthash_find(jb->node_hash, jb->target_seq))) {
+		if ((node = jb_find_seq(jb, jb->target_seq))) {
 			jb_debug(jb, 2, "FOUND rollover seq: %u\n", ntohs(jb->target_seq));
 		} else if ((node = jb_find_lowest_seq(jb, 0))) {
 			jb_debug(jb, 2, "No target seq using seq: %u as a starting point\n", ntohs(node->packet.header.seq));
@@ -766,7 +732,7 @@ static inline switch_status_t jb_next_packet_by_seq(switch_jb_t *jb, switch_jb_n
 			jb_debug(jb, 1, "%s", "No nodes available....\n");
 		}
 		jb_hit(jb);
-	} else if ((node = switch_core_inthash_find(jb->node_hash, jb->target_seq))) {
+	} else if ((node = jb_find_seq(jb, jb->target_seq))) {
 		jb_debug(jb, 2, "FOUND desired seq: %u\n", ntohs(jb->target_seq));
 		jb_hit(jb);
 	} else {
@@ -782,13 +748,13 @@ static inline switch_status_t jb_next_packet_by_seq(switch_jb_t *jb, switch_jb_n
 
 			for (x = 0; x < 10; x++) {
 				increment_seq(jb);
-				if ((node = switch_core_inthash_find(jb->node_hash, jb->target_seq))) {
+				if ((node = jb_find_seq(jb, jb->target_seq))) {
 					jb_debug(jb, 2, "FOUND incremental seq: %u\n", ntohs(jb->target_seq));
 
 					if (node->packet.header.m ||  node->packet.header.ts == jb->highest_read_ts) {
 						jb_debug(jb, 2, "%s", "SAME FRAME DROPPING\n");
 						jb->dropped++;
-						drop_ts(jb, node->packet.header.ts);
+						drop_ts(jb, node);
 						jb->highest_dropped_ts = ntohl(node->packet.header.ts);
 
 
@@ -867,7 +833,10 @@ static inline switch_status_t jb_next_packet(switch_jb_t *jb, switch_jb_node_t *
 static inline void free_nodes(switch_jb_t *jb)
 {
 	switch_mutex_lock(jb->list_mutex);
-	jb->node_list = NULL;
+	jb->node_list = jb->node_tail = NULL;
+	jb->ts_list = jb->ts_tail = NULL;
+	jb->free_list = NULL;
+	switch_safe_free(jb->ring);
 	switch_mutex_unlock(jb->list_mutex);
 }
 
@@ -996,7 +965,7 @@ SWITCH_DECLARE(switch_status_t) switch_jb_peek_frame(switch_jb_t *jb, uint32_t t
 	switch_jb_node_t *node = NULL;
 	if (seq) {
 		uint16_t want_seq = seq + peek;
-		node = switch_core_inthash_find(jb->node_hash, htons(want_seq));
+		node = jb_find_seq(jb, htons(want_seq));
 	} else if (ts && jb->samples_per_frame) {
 		uint32_t want_ts = ts + (peek * jb->samples_per_frame);
 		node = switch_core_inthash_find(jb->node_hash_ts, htonl(want_ts));
@@ -1097,7 +1066,8 @@ SWITCH_DECLARE(switch_status_t) switch_jb_create(switch_jb_t **jbp, switch_jb_ty
 		jb->period_len = 250;
 	}
 	
-	switch_core_inthash_init(&jb->node_hash);
+	switch_zmalloc(jb->ring, JB_RING_MIN * sizeof(*jb->ring));
+	jb->ring_mask = JB_RING_MIN - 1;
 	switch_mutex_init(&jb->mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&jb->list_mutex, SWITCH_MUTEX_NESTED, pool);
 
@@ -1115,11 +1085,11 @@ SWITCH_DECLARE(switch_status_t) switch_jb_destroy(switch_jb_t **jbp)
 		jb_debug(jb, 3, "Stats: NACK saved the day: %u\n", jb->nack_saved_the_day);
 		jb_debug(jb, 3, "Stats: NACK was late: %u\n", jb->nack_didnt_save_the_day);
 		jb_debug(jb, 3, "Stats: Hash entrycount: missing_seq_hash %u\n", switch_hashtable_count(jb->missing_seq_hash));
+		jb_debug(jb, 3, "Stats: Seq ring slots: %u\n", jb->ring_mask + 1);
 	}
 	if (jb->type == SJB_VIDEO) {
 		switch_core_inthash_destroy(&jb->missing_seq_hash);
 	}
-	switch_core_inthash_destroy(&jb->node_hash);
 
 	if (jb->node_hash_ts) {
 		switch_core_inthash_destroy(&jb->node_hash_ts);
@@ -1303,7 +1273,7 @@ SWITCH_DECLARE(switch_status_t) switch_jb_get_packet_by_seq(switch_jb_t *jb, uin
 	switch_status_t status = SWITCH_STATUS_NOTFOUND;
 
 	switch_mutex_lock(jb->mutex);
-	if ((node = switch_core_inthash_find(jb->node_hash, seq))) {
+	if ((node = jb_find_seq(jb, seq))) {
 		jb_debug(jb, 2, "Found buffered seq: %u\n", ntohs(seq));
 		*packet = node->packet;
 		*len = node->len;
@@ -76,6 +76,7 @@ struct switch_loadable_module {
 	switch_thread_t *thread;
 	switch_bool_t shutting_down;
 	switch_loadable_module_type_t type;
+	switch_interval_time_t load_time;
 };
 
 struct switch_loadable_module_container {
@@ -98,6 +99,10 @@ struct switch_loadable_module_container {
 	switch_hash_t *limit_hash;
 	switch_hash_t *database_hash;
 	switch_hash_t *secondary_recover_hash;
+	switch_hash_t *codec_pref_hash;
+	switch_thread_rwlock_t *codec_pref_rwlock;
+	uint32_t codec_pref_generation;
+	uint32_t codec_pref_count;
 	switch_mutex_t *mutex;
 	switch_memory_pool_t *pool;
 };
@@ -106,6 +111,7 @@ static struct switch_loadable_module_container loadable_modules;
 static switch_status_t do_shutdown(switch_loadable_module_t *module, switch_bool_t shutdown, switch_bool_t unload, switch_bool_t fail_if_busy,
 								   const char **err);
 static switch_status_t switch_loadable_module_load_module_ex(const char *dir, const char *fname, switch_bool_t runtime, switch_bool_t global, const char **err, switch_loadable_module_type_t type, switch_hash_t *event_hash);
+static void codec_pref_cache_flush(void);
 
 static void *SWITCH_THREAD_FUNC switch_loadable_module_exec(switch_thread_t *thread, void *obj)
 {
@@ -260,6 +266,8 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 						switch_core_hash_insert(loadable_modules.codec_hash, impl->iananame, (const void *) node);
 					}
 
+					codec_pref_cache_flush();
+
 					if (switch_event_create(&event, SWITCH_EVENT_MODULE_LOAD) == SWITCH_STATUS_SUCCESS) {
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "type", "codec");
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
@@ -1210,6 +1218,8 @@ static switch_status_t switch_loadable_module_unprocess(switch_loadable_module_t
 							}
 						}
 					}
+
+					codec_pref_cache_flush();
 					if (switch_event_create(&event, SWITCH_EVENT_MODULE_UNLOAD) == SWITCH_STATUS_SUCCESS) {
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "type", "codec");
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
@@ -1819,6 +1829,7 @@ static switch_status_t switch_loadable_module_load_module_ex(const char *dir, co
 	char *file, *dot;
 	switch_loadable_module_t *new_module = NULL;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	switch_time_t started = switch_time_now();
 
 #ifdef WIN32
 	const char *ext = ".dll";
@@ -1857,6 +1868,7 @@ static switch_status_t switch_loadable_module_load_module_ex(const char *dir, co
 		status = SWITCH_STATUS_FALSE;
 	} else if ((status = switch_loadable_module_load_file(path, file, global, &new_module)) == SWITCH_STATUS_SUCCESS) {
 		new_module->type = type;
+		new_module->load_time = switch_time_now() - started;
 
 		if ((status = switch_loadable_module_process(file, new_module, event_hash)) == SWITCH_STATUS_SUCCESS && runtime) {
 			if (new_module->switch_module_runtime) {
@@ -2108,6 +2120,379 @@ static void switch_loadable_module_path_init()
 }
 #endif
 
+/* Load time dependencies between modules that are commonly listed in either order in modules.conf */
+static const char *module_load_deps[][2] = {
+	{"mod_limit", "mod_hash"},
+	{"mod_limit", "mod_db"},
+	{"mod_verto", "mod_rtc"},
+	{"mod_signalwire", "mod_sofia"},
+	{"mod_directory", "mod_voicemail"},
+	{NULL, NULL}
+};
+
+/* Modules everything listed after them must wait for: loggers and config providers */
+static const char *module_load_barriers[] = {
+	"mod_console",
+	"mod_logfile",
+	"mod_syslog",
+	"mod_graylog2",
+	NULL
+};
+
+typedef struct {
+	const char *module;
+	const char *path;
+	char key[128];
+	char file_path[1024];
+	switch_bool_t global;
+	switch_bool_t critical;
+	switch_bool_t barrier;
+	const char *depends;
+	switch_loadable_module_t *new_module;
+	switch_status_t status;
+	int started;
+	int loaded;
+	int done;
+} module_load_job_t;
+
+typedef struct {
+	module_load_job_t *jobs;
+	uint8_t *needs;
+	int njobs;
+	int started;
+	int running;
+	int registered;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+} module_loader_t;
+
+static int module_load_find(module_loader_t *loader, const char *key)
+{
+	int x;
+
+	for (x = 0; x < loader->njobs; x++) {
+		if (!strcmp(loader->jobs[x].key, key)) {
+			return x;
+		}
+	}
+
+	return -1;
+}
+
+static void module_load_depend(module_loader_t *loader, int x, const char *key)
+{
+	int j;
+
+	if ((j = module_load_find(loader, key)) >= 0 && j != x) {
+		loader->needs[x * loader->njobs + j] = 1;
+	}
+}
+
+static void module_load_build_graph(module_loader_t *loader)
+{
+	int x, j, barrier = -1;
+
+	for (x = 0; x < loader->njobs; x++) {
+		module_load_job_t *job = &loader->jobs[x];
+
+		if (barrier >= 0) {
+			loader->needs[x * loader->njobs + barrier] = 1;
+		}
+
+		if (job->barrier) {
+			for (j = 0; j < x; j++) {
+				loader->needs[x * loader->njobs + j] = 1;
+			}
+			barrier = x;
+		}
+
+		/* a module listed twice must not race its own first load */
+		for (j = 0; j < x; j++) {
+			if (!strcmp(loader->jobs[j].key, job->key)) {
+				loader->needs[x * loader->njobs + j] = 1;
+			}
+		}
+
+		for (j = 0; module_load_deps[j][0]; j++) {
+			if (!strcmp(module_load_deps[j][0], job->key)) {
+				module_load_depend(loader, x, module_load_deps[j][1]);
+			}
+		}
+
+		if (!zstr(job->depends)) {
+			char *dup = strdup(job->depends), *argv[64] = { 0 };
+			int argc, i;
+
+			switch_assert(dup);
+			argc = switch_separate_string(dup, ',', argv, (sizeof(argv) / sizeof(argv[0])));
+
+			for (i = 0; i < argc; i++) {
+				if (module_load_find(loader, argv[i]) < 0) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s depends on %s which is not in modules.conf\n", job->key, argv[i]);
+				} else {
+					module_load_depend(loader, x, argv[i]);
+				}
+			}
+
+			free(dup);
+		}
+	}
+}
+
+static int module_load_runnable(module_loader_t *loader, int x)
+{
+	int j;
+
+	for (j = 0; j < loader->njobs; j++) {
+		if (loader->needs[x * loader->njobs + j] && !loader->jobs[j].done) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static void *SWITCH_THREAD_FUNC module_load_worker(switch_thread_t *thread, void *obj)
+{
+	module_loader_t *loader = (module_loader_t *) obj;
+
+	for (;;) {
+		module_load_job_t *job = NULL;
+		int x;
+
+		switch_mutex_lock(loader->mutex);
+		while (loader->started < loader->njobs) {
+			for (x = 0; x < loader->njobs; x++) {
+				if (!loader->jobs[x].started && module_load_runnable(loader, x)) {
+					job = &loader->jobs[x];
+					break;
+				}
+			}
+
+			if (!job && !loader->running && loader->registered < loader->njobs && !loader->jobs[loader->registered].started) {
+				/* nothing is loading and registration is stuck behind a job that cannot start: a dependency cycle, load it anyway */
+				job = &loader->jobs[loader->registered];
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Dependency cycle involving %s, loading it anyway\n", job->key);
+			}
+
+			if (job) {
+				job->started = 1;
+				loader->started++;
+				loader->running++;
+				break;
+			}
+
+			switch_thread_cond_wait(loader->cond, loader->mutex);
+		}
+		switch_mutex_unlock(loader->mutex);
+
+		if (!job) {
+			break;
+		}
+
+		/* only the module's own pool is touched here, registration happens on the loading thread in config order */
+		if (switch_core_hash_find_locked(loadable_modules.module_hash, job->key, loadable_modules.mutex)) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Module %s Already Loaded!\n", job->key);
+			job->status = SWITCH_STATUS_FALSE;
+		} else {
+			switch_time_t started = switch_time_now();
+
+			if ((job->status = switch_loadable_module_load_file(job->file_path, job->key, job->global, &job->new_module)) == SWITCH_STATUS_SUCCESS) {
+				job->new_module->type = SWITCH_LOADABLE_MODULE_TYPE_COMMON;
+				job->new_module->load_time = switch_time_now() - started;
+			}
+		}
+
+		switch_mutex_lock(loader->mutex);
+		job->loaded = 1;
+		loader->running--;
+		switch_thread_cond_broadcast(loader->cond);
+		switch_mutex_unlock(loader->mutex);
+	}
+
+	return NULL;
+}
+
+static unsigned int switch_loadable_module_load_parallel(switch_xml_t mods, const char *ext, const char *EXT, uint32_t threads)
+{
+	module_loader_t loader = { 0 };
+	switch_thread_t *thread[64] = { 0 };
+	switch_threadattr_t *thd_attr = NULL;
+	switch_xml_t ld;
+	uint32_t i;
+	int x = 0;
+
+	for (ld = switch_xml_child(mods, "load"); ld; ld = ld->next) {
+		loader.njobs++;
+	}
+
+	if (!loader.njobs) {
+		return 0;
+	}
+
+	switch_zmalloc(loader.jobs, loader.njobs * sizeof(*loader.jobs));
+	switch_zmalloc(loader.needs, loader.njobs * loader.njobs);
+
+	for (ld = switch_xml_child(mods, "load"); ld; ld = ld->next) {
+		module_load_job_t *job = &loader.jobs[x];
+		const char *val = switch_xml_attr_soft(ld, "module");
+		const char *path = switch_xml_attr_soft(ld, "path");
+		char *p;
+
+		if (zstr(val) || (strchr(val, '.') && !strstr(val, ext) && !strstr(val, EXT))) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Invalid extension for %s\n", val);
+			continue;
+		}
+
+		if (path && zstr(path)) {
+			path = SWITCH_GLOBAL_dirs.mod_dir;
+		}
+
+		job->module = val;
+		job->path = path;
+
+		if (switch_is_file_path(val)) {
+			switch_copy_string(job->file_path, val, sizeof(job->file_path));
+		}
+		job->global = switch_true(switch_xml_attr_soft(ld, "global"));
+		job->critical = switch_true(switch_xml_attr_soft(ld, "critical"));
+		job->depends = switch_xml_attr(ld, "depends");
+
+		switch_copy_string(job->key, switch_cut_path(val), sizeof(job->key));
+		if ((p = strchr(job->key, '.'))) {
+			*p = '\0';
+		}
+
+		if (zstr(job->file_path)) {
+			switch_snprintf(job->file_path, sizeof(job->file_path), "%s%s%s%s", path, SWITCH_PATH_SEPARATOR, job->key, ext);
+		}
+
+		job->barrier = switch_true(switch_xml_attr_soft(ld, "barrier")) || !strncmp(job->key, "mod_xml_", 8);
+		for (i = 0; !job->barrier && module_load_barriers[i]; i++) {
+			job->barrier = !strcmp(job->key, module_load_barriers[i]);
+		}
+
+		x++;
+	}
+
+	loader.njobs = x;
+	module_load_build_graph(&loader);
+
+	if (threads > (uint32_t) loader.njobs) {
+		threads = loader.njobs;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Loading %d modules on %u threads\n", loader.njobs, threads);
+
+	switch_mutex_init(&loader.mutex, SWITCH_MUTEX_NESTED, loadable_modules.pool);
+	switch_thread_cond_create(&loader.cond, loadable_modules.pool);
+	switch_threadattr_create(&thd_attr, loadable_modules.pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	/* hold the loader until every worker exists so nothing else touches loadable_modules.pool meanwhile */
+	switch_mutex_lock(loader.mutex);
+
+	for (i = 0; i < threads; i++) {
+		switch_thread_create(&thread[i], thd_attr, module_load_worker, &loader, loadable_modules.pool);
+	}
+
+	/* register in modules.conf order so interface name collisions resolve the same way as a sequential load */
+	while (loader.registered < loader.njobs) {
+		module_load_job_t *job = &loader.jobs[loader.registered];
+
+		if (!job->loaded) {
+			switch_thread_cond_wait(loader.cond, loader.mutex);
+			continue;
+		}
+
+		switch_mutex_unlock(loader.mutex);
+
+		if (job->status == SWITCH_STATUS_SUCCESS) {
+			job->status = switch_loadable_module_process(job->key, job->new_module, NULL);
+		}
+
+		if (job->status == SWITCH_STATUS_GENERR && job->critical) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failed to load critical module '%s', abort()\n", job->module);
+			abort();
+		}
+
+		switch_mutex_lock(loader.mutex);
+		job->done = 1;
+		loader.registered++;
+		switch_thread_cond_broadcast(loader.cond);
+	}
+
+	switch_mutex_unlock(loader.mutex);
+
+	for (i = 0; i < threads; i++) {
+		if (thread[i]) {
+			switch_status_t st;
+			switch_thread_join(&st, thread[i]);
+		}
+	}
+
+	free(loader.needs);
+	free(loader.jobs);
+
+	return (unsigned int) x;
+}
+
+static int module_load_time_cmp(const void *a, const void *b)
+{
+	const switch_loadable_module_t *ma = *(switch_loadable_module_t * const *) a;
+	const switch_loadable_module_t *mb = *(switch_loadable_module_t * const *) b;
+
+	if (ma->load_time == mb->load_time) {
+		return 0;
+	}
+
+	return ma->load_time < mb->load_time ? 1 : -1;
+}
+
+static void switch_loadable_module_report_load_times(switch_time_t started)
+{
+	switch_hash_index_t *hi;
+	switch_loadable_module_t **list = NULL;
+	switch_interval_time_t total = 0;
+	void *val;
+	int count = 0, x;
+
+	switch_mutex_lock(loadable_modules.mutex);
+	for (hi = switch_core_hash_first(loadable_modules.module_hash); hi; hi = switch_core_hash_next(&hi)) {
+		count++;
+	}
+
+	if (count) {
+		switch_zmalloc(list, count * sizeof(*list));
+		x = 0;
+		for (hi = switch_core_hash_first(loadable_modules.module_hash); hi && x < count; hi = switch_core_hash_next(&hi)) {
+			switch_core_hash_this(hi, NULL, NULL, &val);
+			list[x++] = (switch_loadable_module_t *) val;
+		}
+		count = x;
+	}
+	switch_mutex_unlock(loadable_modules.mutex);
+
+	if (!list) {
+		return;
+	}
+
+	qsort(list, count, sizeof(*list), module_load_time_cmp);
+
+	for (x = 0; x < count; x++) {
+		total += list[x]->load_time;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Loaded %d modules in %0.3fs (%0.3fs spent in module load functions)\n",
+					  count, (double) (switch_time_now() - started) / 1000000, (double) total / 1000000);
+
+	for (x = 0; x < count; x++) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "  %-32s %10.3fms\n", list[x]->key, (double) list[x]->load_time / 1000);
+	}
+
+	free(list);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autoload)
 {
 
@@ -2125,6 +2510,7 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 	switch_hash_index_t *hi;
 	void *hash_val;
 	switch_event_t *event;
+	switch_time_t started = switch_time_now();
 
 
 #ifdef WIN32
@@ -2165,6 +2551,8 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 	switch_core_hash_init_nocase(&loadable_modules.database_hash);
 	switch_core_hash_init_nocase(&loadable_modules.dialplan_hash);
 	switch_core_hash_init(&loadable_modules.secondary_recover_hash);
+	switch_core_hash_init(&loadable_modules.codec_pref_hash);
+	switch_thread_rwlock_create(&loadable_modules.codec_pref_rwlock, loadable_modules.pool);
 	switch_mutex_init(&loadable_modules.mutex, SWITCH_MUTEX_NESTED, loadable_modules.pool);
 
 	if (!autoload) return SWITCH_STATUS_SUCCESS;
@@ -2268,7 +2656,9 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 	/* Loading common modules */
 	if ((xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_xml_t mods, ld;
-		if ((mods = switch_xml_child(cfg, "modules"))) {
+		if ((mods = switch_xml_child(cfg, "modules")) && runtime.module_load_threads > 1) {
+			count += switch_loadable_module_load_parallel(mods, ext, EXT, runtime.module_load_threads);
+		} else if (mods) {
 			for (ld = switch_xml_child(mods, "load"); ld; ld = ld->next) {
 				switch_bool_t global = SWITCH_FALSE;
 				const char *val = switch_xml_attr_soft(ld, "module");
@@ -2364,6 +2754,8 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 
 	switch_loadable_module_runtime();
 
+	switch_loadable_module_report_load_times(started);
+
 	memset(&chat_globals, 0, sizeof(chat_globals));
 	chat_globals.running = 1;
 	chat_globals.pool = loadable_modules.pool;
@@ -2495,6 +2887,10 @@ SWITCH_DECLARE(void) switch_loadable_module_shutdown(void)
 		}
 	}
 
+	switch_thread_rwlock_wrlock(loadable_modules.codec_pref_rwlock);
+	switch_core_hash_destroy(&loadable_modules.codec_pref_hash);
+	switch_thread_rwlock_unlock(loadable_modules.codec_pref_rwlock);
+
 	switch_core_hash_destroy(&loadable_modules.module_hash);
 	switch_core_hash_destroy(&loadable_modules.endpoint_hash);
 	switch_core_hash_destroy(&loadable_modules.codec_hash);
@@ -2835,60 +3231,55 @@ SWITCH_DECLARE(char *) switch_parse_codec_buf(char *buf, uint32_t *interval, uin
 	return name;
 }
 
-SWITCH_DECLARE(int) switch_loadable_module_get_codecs_sorted(const switch_codec_implementation_t **array, char fmtp_array[SWITCH_MAX_CODECS][MAX_FMTP_LEN], int arraylen, char **prefs, int preflen)
+typedef struct {
+	char buf[256];
+	char *name;
+	char *modname;
+	char *fmtp;
+	uint32_t interval;
+	uint32_t rate;
+	uint32_t bit;
+	uint32_t channels;
+} codec_pref_t;
+
+/* Resolve preference strings against the codec interfaces.  Each string is parsed once, duplicates are
+   dropped by comparing the parsed values.  fmtp_array receives pointers into parsed[].buf.  Caller holds
+   loadable_modules.mutex. */
+static int resolve_codec_prefs(codec_pref_t *parsed, const switch_codec_implementation_t **array, const char **fmtp_array, int arraylen, char **prefs, int preflen)
 {
 	int x, i = 0, j = 0;
 	switch_codec_interface_t *codec_interface;
 	const switch_codec_implementation_t *imp;
 
-	switch_mutex_lock(loadable_modules.mutex);
-
-	for (x = 0; x < preflen; x++) {
-		char *name, buf[256], jbuf[256], *modname = NULL, *fmtp = NULL;
-		uint32_t interval = 0, rate = 0, bit = 0, channels = 1;
-
-		switch_copy_string(buf, prefs[x], sizeof(buf));
-		name = switch_parse_codec_buf(buf, &interval, &rate, &bit, &channels, &modname, &fmtp);
-
-		for(j = 0; j < x; j++) {
-			char *jname, *jmodname = NULL, *jfmtp = NULL;
-			uint32_t jinterval = 0, jrate = 0, jbit = 0, jchannels = 1;
-			uint32_t ointerval = interval, orate = rate, ochannels = channels;
-
-			if (ointerval == 0) {
-				ointerval = switch_default_ptime(name, 0);
-			}
-
-			if (orate == 0) {
-				orate = switch_default_rate(name, 0);
-			}
-
-			if (ochannels == 0) {
-				ochannels = 1;
-			}
+	for (x = 0; x < preflen && i < arraylen; x++) {
+		codec_pref_t *pref = &parsed[x];
+		uint32_t interval, rate, bit;
 
-			switch_copy_string(jbuf, prefs[j], sizeof(jbuf));
-			jname = switch_parse_codec_buf(jbuf, &jinterval, &jrate, &jbit, &jchannels, &jmodname, &jfmtp);
+		memset(pref, 0, sizeof(*pref));
+		switch_copy_string(pref->buf, prefs[x], sizeof(pref->buf));
+		pref->name = switch_parse_codec_buf(pref->buf, &pref->interval, &pref->rate, &pref->bit, &pref->channels, &pref->modname, &pref->fmtp);
+		interval = pref->interval;
+		rate = pref->rate;
+		bit = pref->bit;
 
-			if (jinterval == 0) {
-				jinterval = switch_default_ptime(jname, 0);
-			}
-
-			if (jrate == 0) {
-				jrate = switch_default_rate(jname, 0);
-			}
+		/* normalized copies used for duplicate detection */
+		if (!pref->interval) {
+			pref->interval = switch_default_ptime(pref->name, 0);
+		}
 
-			if (jchannels == 0) {
-				jchannels = 1;
-			}
+		if (!pref->rate) {
+			pref->rate = switch_default_rate(pref->name, 0);
+		}
 
-			if (!strcasecmp(name, jname) && ointerval == jinterval && orate == jrate && ochannels == jchannels &&
-				!strcasecmp(switch_str_nil(fmtp), switch_str_nil(jfmtp))) {
+		for(j = 0; j < x; j++) {
+			if (!strcasecmp(pref->name, parsed[j].name) && pref->interval == parsed[j].interval && pref->rate == parsed[j].rate &&
+				(pref->channels ? pref->channels : 1) == (parsed[j].channels ? parsed[j].channels : 1) &&
+				!strcasecmp(switch_str_nil(pref->fmtp), switch_str_nil(parsed[j].fmtp))) {
 				goto next_x;
 			}
 		}
 
-		if ((codec_interface = switch_loadable_module_get_codec_interface(name, modname)) != 0) {
+		if ((codec_interface = switch_loadable_module_get_codec_interface(pref->name, pref->modname)) != 0) {
 			/* If no specific codec interval is requested opt for the default above all else because lots of stuff assumes it */
 			for (imp = codec_interface->implementations; imp; imp = imp->next) {
 				uint32_t default_ptime = switch_default_ptime(imp->iananame, imp->ianacode);
@@ -2910,14 +3301,12 @@ SWITCH_DECLARE(int) switch_loadable_module_get_codecs_sorted(const switch_codec_
 						continue;
 					}
 
-					if (channels && imp->number_of_channels != channels) {
+					if (pref->channels && imp->number_of_channels != pref->channels) {
 						continue;
 					}
 				}
 
-				if (!zstr(fmtp)) {
-					switch_set_string(fmtp_array[i], fmtp);
-				}
+				fmtp_array[i] = zstr(pref->fmtp) ? NULL : pref->fmtp;
 				array[i++] = imp;
 				goto found;
 
@@ -2940,11 +3329,12 @@ SWITCH_DECLARE(int) switch_loadable_module_get_codecs_sorted(const switch_codec_
 						continue;
 					}
 
-					if (channels && imp->number_of_channels != channels) {
+					if (pref->channels && imp->number_of_channels != pref->channels) {
 						continue;
 					}
 				}
 
+				fmtp_array[i] = NULL;
 				array[i++] = imp;
 				goto found;
 
@@ -2953,11 +3343,6 @@ SWITCH_DECLARE(int) switch_loadable_module_get_codecs_sorted(const switch_codec_
 		  found:
 
 			UNPROTECT_INTERFACE(codec_interface);
-
-			if (i > arraylen) {
-				break;
-			}
-
 		}
 
 	next_x:
@@ -2965,13 +3350,198 @@ SWITCH_DECLARE(int) switch_loadable_module_get_codecs_sorted(const switch_codec_
 		continue;
 	}
 
+	return i;
+}
+
+SWITCH_DECLARE(int) switch_loadable_module_get_codecs_sorted(const switch_codec_implementation_t **array, char fmtp_array[SWITCH_MAX_CODECS][MAX_FMTP_LEN], int arraylen, char **prefs, int preflen)
+{
+	codec_pref_t *parsed;
+	const char *fmtp[SWITCH_MAX_CODECS] = { 0 };
+	int x, i;
+
+	if (preflen <= 0 || arraylen <= 0) {
+		return 0;
+	}
+
+	if (arraylen > SWITCH_MAX_CODECS) {
+		arraylen = SWITCH_MAX_CODECS;
+	}
+
+	switch_malloc(parsed, preflen * sizeof(*parsed));
+
+	switch_mutex_lock(loadable_modules.mutex);
+	i = resolve_codec_prefs(parsed, array, fmtp, arraylen, prefs, preflen);
 	switch_mutex_unlock(loadable_modules.mutex);
 
+	for (x = 0; fmtp_array && x < i; x++) {
+		if (fmtp[x]) {
+			switch_set_string(fmtp_array[x], fmtp[x]);
+		}
+	}
+
+	free(parsed);
+
 	switch_loadable_module_sort_codecs(array, i);
 
 	return i;
 }
 
+#define CODEC_PREF_CACHE_MAX 256
+
+struct codec_pref_set {
+	switch_atomic_t refs;
+	int num;
+	const switch_codec_implementation_t *codecs[SWITCH_MAX_CODECS];
+	char *fmtp[SWITCH_MAX_CODECS];
+};
+
+typedef struct codec_pref_set codec_pref_set_t;
+
+static void codec_pref_set_release(void *ptr)
+{
+	codec_pref_set_t *set = (codec_pref_set_t *) ptr;
+	int x;
+
+	if (switch_atomic_dec(&set->refs)) {
+		return;
+	}
+
+	for (x = 0; x < set->num; x++) {
+		switch_safe_free(set->fmtp[x]);
+	}
+
+	free(set);
+}
+
+static void codec_pref_cache_flush(void)
+{
+	if (!loadable_modules.codec_pref_rwlock) {
+		return;
+	}
+
+	switch_thread_rwlock_wrlock(loadable_modules.codec_pref_rwlock);
+	loadable_modules.codec_pref_generation++;
+	if (loadable_modules.codec_pref_count) {
+		switch_core_hash_destroy(&loadable_modules.codec_pref_hash);
+		switch_core_hash_init(&loadable_modules.codec_pref_hash);
+		loadable_modules.codec_pref_count = 0;
+	}
+	switch_thread_rwlock_unlock(loadable_modules.codec_pref_rwlock);
+}
+
+static codec_pref_set_t *codec_pref_set_build(const char *codec_string)
+{
+	codec_pref_set_t *set;
+	codec_pref_t *parsed;
+	const char *fmtp[SWITCH_MAX_CODECS] = { 0 };
+	char *prefs[SWITCH_MAX_CODECS];
+	char *dup;
+	int x, preflen;
+
+	dup = strdup(codec_string);
+	switch_assert(dup);
+	preflen = switch_separate_string(dup, ',', prefs, SWITCH_MAX_CODECS);
+
+	switch_zmalloc(set, sizeof(*set));
+	set->refs = 1;
+
+	if (preflen > 0) {
+		switch_malloc(parsed, preflen * sizeof(*parsed));
+
+		switch_mutex_lock(loadable_modules.mutex);
+		set->num = resolve_codec_prefs(parsed, set->codecs, fmtp, SWITCH_MAX_CODECS, prefs, preflen);
+		switch_mutex_unlock(loadable_modules.mutex);
+
+		/* fmtp stays indexed by resolve order, the implementations are sorted like switch_loadable_module_get_codecs_sorted() */
+		for (x = 0; x < set->num; x++) {
+			if (fmtp[x]) {
+				set->fmtp[x] = strdup(fmtp[x]);
+			}
+		}
+
+		switch_loadable_module_sort_codecs(set->codecs, set->num);
+
+		free(parsed);
+	}
+
+	free(dup);
+
+	return set;
+}
+
+static codec_pref_set_t *codec_pref_set_get(const char *codec_string)
+{
+	codec_pref_set_t *set = NULL, *existing = NULL;
+	uint32_t generation;
+
+	switch_thread_rwlock_rdlock(loadable_modules.codec_pref_rwlock);
+	if ((set = switch_core_hash_find(loadable_modules.codec_pref_hash, codec_string))) {
+		switch_atomic_inc(&set->refs);
+	}
+	generation = loadable_modules.codec_pref_generation;
+	switch_thread_rwlock_unlock(loadable_modules.codec_pref_rwlock);
+
+	if (set) {
+		return set;
+	}
+
+	set = codec_pref_set_build(codec_string);
+
+	switch_thread_rwlock_wrlock(loadable_modules.codec_pref_rwlock);
+	/* a module came or went while we were resolving, hand out the result but don't keep it */
+	if (generation == loadable_modules.codec_pref_generation) {
+		if ((existing = switch_core_hash_find(loadable_modules.codec_pref_hash, codec_string))) {
+			switch_atomic_inc(&existing->refs);
+		} else {
+			if (loadable_modules.codec_pref_count >= CODEC_PREF_CACHE_MAX) {
+				switch_core_hash_destroy(&loadable_modules.codec_pref_hash);
+				switch_core_hash_init(&loadable_modules.codec_pref_hash);
+				loadable_modules.codec_pref_count = 0;
+			}
+
+			switch_atomic_inc(&set->refs);
+			if (switch_core_hash_insert_destructor(loadable_modules.codec_pref_hash, codec_string, set, codec_pref_set_release) == SWITCH_STATUS_SUCCESS) {
+				loadable_modules.codec_pref_count++;
+			} else {
+				switch_atomic_dec(&set->refs);
+			}
+		}
+	}
+	switch_thread_rwlock_unlock(loadable_modules.codec_pref_rwlock);
+
+	if (existing) {
+		codec_pref_set_release(set);
+		set = existing;
+	}
+
+	return set;
+}
+
+SWITCH_DECLARE(int) switch_loadable_module_get_codecs_by_string(const switch_codec_implementation_t **array, char fmtp_array[SWITCH_MAX_CODECS][MAX_FMTP_LEN], int arraylen, const char *codec_string)
+{
+	codec_pref_set_t *set;
+	int x, i;
+
+	if (zstr(codec_string) || arraylen <= 0) {
+		return 0;
+	}
+
+	set = codec_pref_set_get(codec_string);
+
+	i = set->num < arraylen ? set->num : arraylen;
+
+	for (x = 0; x < i; x++) {
+		array[x] = set->codecs[x];
+		if (fmtp_array && set->fmtp[x]) {
+			switch_set_string(fmtp_array[x], set->fmtp[x]);
+		}
+	}
+
+	codec_pref_set_release(set);
+
+	return i;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_api_execute(const char *cmd, const char *arg, switch_core_session_t *session, switch_stream_handle_t *stream)
 {
 	switch_api_interface_t *api;
@@ -52,6 +52,162 @@
 
 #define resample_buffer(a, b, c) a > b ? ((a / 1000) / 2) * c : ((b / 1000) / 2) * c
 
+/* Sample format kernels. The SSE2 and NEON paths produce exactly the same samples as
+ * the scalar loops, which also handle the tails. */
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)) && SWITCH_BYTE_ORDER != __BIG_ENDIAN
+#define SWITCH_RESAMPLE_SSE2 1
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && SWITCH_BYTE_ORDER != __BIG_ENDIAN
+#define SWITCH_RESAMPLE_NEON 1
+#include <arm_neon.h>
+#endif
+
+/* Anything past +-65536 clips the same way, limiting the input first keeps the int conversion defined. */
+#define F2S_LIMIT 65536.0f
+
+/* Idle resamplers are parked here by switch_resample_destroy and handed back out by
+ * switch_resample_perform_create for the same rates, channels and quality, so calls
+ * that come and go do not pay for speex_resampler_init every time. */
+#define RESAMPLE_CACHE_BUCKETS 64
+#define RESAMPLE_CACHE_DEFAULT 128
+
+typedef struct resample_cache_node_s {
+	switch_audio_resampler_t resampler;
+	int quality;
+	struct resample_cache_node_s *next;
+} resample_cache_node_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	uint32_t max;
+	uint32_t idle;
+	resample_cache_node_t *buckets[RESAMPLE_CACHE_BUCKETS];
+} resample_cache;
+
+static inline uint32_t resample_cache_bucket(uint32_t from_rate, uint32_t to_rate, uint32_t channels, int quality)
+{
+	return (((from_rate * 31) + to_rate) * 31 + channels * 7 + (uint32_t) quality) % RESAMPLE_CACHE_BUCKETS;
+}
+
+static void resample_cache_free_node(resample_cache_node_t *node)
+{
+	if (node->resampler.resampler) {
+		speex_resampler_destroy(node->resampler.resampler);
+	}
+	switch_safe_free(node->resampler.to);
+	free(node);
+}
+
+static resample_cache_node_t *resample_cache_take(uint32_t from_rate, uint32_t to_rate, uint32_t channels, int quality)
+{
+	resample_cache_node_t *node = NULL, *last = NULL;
+	uint32_t bucket;
+
+	if (!resample_cache.mutex || !resample_cache.idle) {
+		return NULL;
+	}
+
+	bucket = resample_cache_bucket(from_rate, to_rate, channels, quality);
+
+	switch_mutex_lock(resample_cache.mutex);
+	for (node = resample_cache.buckets[bucket]; node; last = node, node = node->next) {
+		if ((uint32_t) node->resampler.from_rate == from_rate && (uint32_t) node->resampler.to_rate == to_rate &&
+			(uint32_t) node->resampler.channels == channels && node->quality == quality) {
+			if (last) {
+				last->next = node->next;
+			} else {
+				resample_cache.buckets[bucket] = node->next;
+			}
+			node->next = NULL;
+			resample_cache.idle--;
+			break;
+		}
+	}
+	switch_mutex_unlock(resample_cache.mutex);
+
+	return node;
+}
+
+static switch_bool_t resample_cache_put(resample_cache_node_t *node)
+{
+	uint32_t bucket;
+	switch_bool_t r = SWITCH_FALSE;
+
+	if (!resample_cache.mutex || !resample_cache.max) {
+		return SWITCH_FALSE;
+	}
+
+	speex_resampler_reset_mem(node->resampler.resampler);
+	node->resampler.to_len = 0;
+	bucket = resample_cache_bucket(node->resampler.from_rate, node->resampler.to_rate, node->resampler.channels, node->quality);
+
+	switch_mutex_lock(resample_cache.mutex);
+	if (resample_cache.idle < resample_cache.max) {
+		node->next = resample_cache.buckets[bucket];
+		resample_cache.buckets[bucket] = node;
+		resample_cache.idle++;
+		r = SWITCH_TRUE;
+	}
+	switch_mutex_unlock(resample_cache.mutex);
+
+	return r;
+}
+
+/* drop idle resamplers until at most keep are left */
+static void resample_cache_trim(uint32_t keep)
+{
+	resample_cache_node_t *node, *free_list = NULL;
+	int i;
+
+	switch_mutex_lock(resample_cache.mutex);
+	for (i = 0; i < RESAMPLE_CACHE_BUCKETS && resample_cache.idle > keep; i++) {
+		while ((node = resample_cache.buckets[i]) && resample_cache.idle > keep) {
+			resample_cache.buckets[i] = node->next;
+			node->next = free_list;
+			free_list = node;
+			resample_cache.idle--;
+		}
+	}
+	switch_mutex_unlock(resample_cache.mutex);
+
+	while ((node = free_list)) {
+		free_list = node->next;
+		resample_cache_free_node(node);
+	}
+}
+
+SWITCH_DECLARE(void) switch_resample_cache_init(switch_memory_pool_t *pool)
+{
+	switch_mutex_init(&resample_cache.mutex, SWITCH_MUTEX_NESTED, pool);
+	resample_cache.max = RESAMPLE_CACHE_DEFAULT;
+}
+
+SWITCH_DECLARE(void) switch_resample_cache_set(uint32_t size)
+{
+	if (!resample_cache.mutex) {
+		return;
+	}
+
+	resample_cache.max = size;
+	resample_cache_trim(size);
+}
+
+SWITCH_DECLARE(uint32_t) switch_resample_cache_idle(void)
+{
+	return resample_cache.idle;
+}
+
+SWITCH_DECLARE(void) switch_resample_cache_shutdown(void)
+{
+	if (!resample_cache.mutex) {
+		return;
+	}
+
+	resample_cache.max = 0;
+	resample_cache_trim(0);
+	resample_cache.mutex = NULL;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resampler_t **new_resampler,
 															   uint32_t from_rate, uint32_t to_rate,
 															   uint32_t to_size,
@@ -59,32 +215,45 @@ SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resa
 {
 	int err = 0;
 	switch_audio_resampler_t *resampler;
+	resample_cache_node_t *node;
 	double lto_rate, lfrom_rate;
-
-	switch_zmalloc(resampler, sizeof(*resampler));
+	uint32_t need;
 
 	if (!channels) channels = 1;
 
-	resampler->resampler = speex_resampler_init(channels, from_rate, to_rate, quality, &err);
+	if ((node = resample_cache_take(from_rate, to_rate, channels, quality))) {
+		resampler = &node->resampler;
+	} else {
+		switch_zmalloc(node, sizeof(*node));
+		resampler = &node->resampler;
+
+		resampler->resampler = speex_resampler_init(channels, from_rate, to_rate, quality, &err);
+
+		if (!resampler->resampler) {
+			free(node);
+			return SWITCH_STATUS_GENERR;
+		}
 
-	if (!resampler->resampler) {
-		free(resampler);
-		return SWITCH_STATUS_GENERR;
+		node->quality = quality;
 	}
 
 	*new_resampler = resampler;
-	lto_rate = (double) resampler->to_rate;
-	lfrom_rate = (double) resampler->from_rate;
 	resampler->from_rate = from_rate;
 	resampler->to_rate = to_rate;
+	lto_rate = (double) resampler->to_rate;
+	lfrom_rate = (double) resampler->from_rate;
 	resampler->factor = (lto_rate / lfrom_rate);
 	resampler->rfactor = (lfrom_rate / lto_rate);
 	resampler->channels = channels;
 
 	//resampler->to_size = resample_buffer(to_rate, from_rate, (uint32_t) to_size);
 
-	resampler->to_size = switch_resample_calc_buffer_size(resampler->to_rate, resampler->from_rate, to_size) / 2;
-	resampler->to = malloc(resampler->to_size * sizeof(int16_t) * resampler->channels);
+	need = switch_resample_calc_buffer_size(resampler->to_rate, resampler->from_rate, to_size) / 2;
+
+	if (!resampler->to || need > resampler->to_size) {
+		resampler->to_size = need;
+		resampler->to = realloc(resampler->to, resampler->to_size * sizeof(int16_t) * resampler->channels);
+	}
 	switch_assert(resampler->to);
 
 	return SWITCH_STATUS_SUCCESS;
@@ -109,30 +278,114 @@ SWITCH_DECLARE(void) switch_resample_destroy(switch_audio_resampler_t **resample
 {
 
 	if (resampler && *resampler) {
-		if ((*resampler)->resampler) {
-			speex_resampler_destroy((*resampler)->resampler);
+		resample_cache_node_t *node = (resample_cache_node_t *) *resampler;
+
+		if (!resample_cache_put(node)) {
+			resample_cache_free_node(node);
 		}
-		free((*resampler)->to);
-		free(*resampler);
 		*resampler = NULL;
 	}
 }
 
+/* round half away from zero, then fold clipped samples to half scale */
+static inline short float_to_short_sample(float f)
+{
+	float ft = f * NORMFACT, frac;
+	int32_t l;
+
+	if (!(ft <= F2S_LIMIT)) {
+		ft = F2S_LIMIT;
+	} else if (ft < -F2S_LIMIT) {
+		ft = -F2S_LIMIT;
+	}
+
+	l = (int32_t) ft;
+	frac = ft - (float) l;
+
+	if (frac >= 0.5f) {
+		l++;
+	} else if (frac <= -0.5f) {
+		l--;
+	}
+
+	if (l > (int32_t) MAXSAMPLE) {
+		return (short) MAXSAMPLE / 2;
+	}
+
+	if (l < (int32_t) -MAXSAMPLE) {
+		return (short) -MAXSAMPLE / 2;
+	}
+
+	return (short) l;
+}
+
+#if defined(SWITCH_RESAMPLE_SSE2)
+static inline __m128i float_to_short_sse2(__m128 x)
+{
+	__m128i l, up, down, hi, lo;
+	__m128 frac;
+
+	x = _mm_mul_ps(x, _mm_set1_ps(NORMFACT));
+	x = _mm_max_ps(_mm_min_ps(x, _mm_set1_ps(F2S_LIMIT)), _mm_set1_ps(-F2S_LIMIT));
+
+	l = _mm_cvttps_epi32(x);
+	frac = _mm_sub_ps(x, _mm_cvtepi32_ps(l));
+	up = _mm_castps_si128(_mm_cmpge_ps(frac, _mm_set1_ps(0.5f)));
+	down = _mm_castps_si128(_mm_cmple_ps(frac, _mm_set1_ps(-0.5f)));
+	l = _mm_add_epi32(_mm_sub_epi32(l, up), down);
+
+	hi = _mm_cmpgt_epi32(l, _mm_set1_epi32((int32_t) MAXSAMPLE));
+	lo = _mm_cmplt_epi32(l, _mm_set1_epi32((int32_t) -MAXSAMPLE));
+	l = _mm_or_si128(_mm_andnot_si128(hi, l), _mm_and_si128(hi, _mm_set1_epi32((short) MAXSAMPLE / 2)));
+	l = _mm_or_si128(_mm_andnot_si128(lo, l), _mm_and_si128(lo, _mm_set1_epi32((short) -MAXSAMPLE / 2)));
+
+	return l;
+}
+#elif defined(SWITCH_RESAMPLE_NEON)
+static inline int32x4_t float_to_short_neon(float32x4_t x)
+{
+	float32x4_t frac;
+	int32x4_t l;
+	uint32x4_t hi, lo;
+
+	x = vmulq_n_f32(x, NORMFACT);
+	x = vbslq_f32(vceqq_f32(x, x), x, vdupq_n_f32(F2S_LIMIT));
+	x = vmaxq_f32(vminq_f32(x, vdupq_n_f32(F2S_LIMIT)), vdupq_n_f32(-F2S_LIMIT));
+
+	l = vcvtq_s32_f32(x);
+	frac = vsubq_f32(x, vcvtq_f32_s32(l));
+	l = vsubq_s32(l, vreinterpretq_s32_u32(vcgeq_f32(frac, vdupq_n_f32(0.5f))));
+	l = vaddq_s32(l, vreinterpretq_s32_u32(vcleq_f32(frac, vdupq_n_f32(-0.5f))));
+
+	hi = vcgtq_s32(l, vdupq_n_s32((int32_t) MAXSAMPLE));
+	lo = vcltq_s32(l, vdupq_n_s32((int32_t) -MAXSAMPLE));
+	l = vbslq_s32(hi, vdupq_n_s32((short) MAXSAMPLE / 2), l);
+	l = vbslq_s32(lo, vdupq_n_s32((short) -MAXSAMPLE / 2), l);
+
+	return l;
+}
+#endif
+
 SWITCH_DECLARE(switch_size_t) switch_float_to_short(float *f, short *s, switch_size_t len)
 {
-	switch_size_t i;
-	float ft;
-	for (i = 0; i < len; i++) {
-		ft = f[i] * NORMFACT;
-		if (ft >= 0) {
-			s[i] = (short) (ft + 0.5);
-		} else {
-			s[i] = (short) (ft - 0.5);
-		}
-		if ((float) s[i] > MAXSAMPLE)
-			s[i] = (short) MAXSAMPLE / 2;
-		if (s[i] < (short) -MAXSAMPLE)
-			s[i] = (short) -MAXSAMPLE / 2;
+	switch_size_t i = 0;
+
+#if defined(SWITCH_RESAMPLE_SSE2)
+	for (; i + 8 <= len; i += 8) {
+		__m128i a = float_to_short_sse2(_mm_loadu_ps(f + i));
+		__m128i b = float_to_short_sse2(_mm_loadu_ps(f + i + 4));
+		_mm_storeu_si128((__m128i *) (s + i), _mm_packs_epi32(a, b));
+	}
+#elif defined(SWITCH_RESAMPLE_NEON)
+	for (; i + 8 <= len; i += 8) {
+		int32x4_t a = float_to_short_neon(vld1q_f32(f + i));
+		int32x4_t b = float_to_short_neon(vld1q_f32(f + i + 4));
+		vst1q_s16(s + i, vcombine_s16(vmovn_s32(a), vmovn_s32(b)));
+	}
+#endif
+
+	for (; i < len; i++) {
+		s[i] = float_to_short_sample(f[i]);
 	}
 	return len;
 }
@@ -176,9 +429,27 @@ SWITCH_DECLARE(int) switch_float_to_char(float *f, char *c, int len)
 
 SWITCH_DECLARE(int) switch_short_to_float(short *s, float *f, int len)
 {
-	int i;
+	int i = 0;
 
-	for (i = 0; i < len; i++) {
+#if defined(SWITCH_RESAMPLE_SSE2)
+	const __m128 scale = _mm_set1_ps(1.0f / NORMFACT);
+
+	for (; i + 8 <= len; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_ps(f + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(f + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+#elif defined(SWITCH_RESAMPLE_NEON)
+	for (; i + 8 <= len; i += 8) {
+		int16x8_t v = vld1q_s16(s + i);
+		vst1q_f32(f + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), 1.0f / NORMFACT));
+		vst1q_f32(f + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), 1.0f / NORMFACT));
+	}
+#endif
+
+	for (; i < len; i++) {
 		f[i] = (float) (s[i]) / NORMFACT;
 		/* f[i] = (float) s[i]; */
 	}
@@ -241,7 +512,21 @@ SWITCH_DECLARE(uint32_t) switch_merge_sln(int16_t *data, uint32_t samples, int16
 		x = samples;
 	}
 
-	for (i = 0; i < x * channels; i++) {
+	i = 0;
+
+#if defined(SWITCH_RESAMPLE_SSE2)
+	for (; i + 8 <= x * channels; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (data + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (other_data + i));
+		_mm_storeu_si128((__m128i *) (data + i), _mm_adds_epi16(a, b));
+	}
+#elif defined(SWITCH_RESAMPLE_NEON)
+	for (; i + 8 <= x * channels; i += 8) {
+		vst1q_s16(data + i, vqaddq_s16(vld1q_s16(data + i), vld1q_s16(other_data + i)));
+	}
+#endif
+
+	for (; i < x * channels; i++) {
 		z = data[i] + other_data[i];
 		switch_normalize_to_16bit(z);
 		data[i] = (int16_t) z;
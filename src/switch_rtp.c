@@ -91,6 +91,8 @@ static switch_port_t START_PORT = RTP_START_PORT;
 static switch_port_t END_PORT = RTP_END_PORT;
 static switch_mutex_t *port_lock = NULL;
 static switch_size_t do_flush(switch_rtp_t *rtp_session, int force, switch_size_t bytes_in);
+static void rtp_relay_init(switch_memory_pool_t *pool);
+static void rtp_relay_shutdown(void);
 
 typedef srtp_hdr_t rtp_hdr_t;
 
@@ -274,6 +276,14 @@ static void switch_rtp_dtls_init();
 static void switch_rtp_dtls_destroy();
 
 #define MAX_DTLS_MTU 4096
+#define DTLS_WORKERS_MAX 64
+#define DTLS_PENDING_MAX 16
+
+typedef struct dtls_packet_s {
+	struct dtls_packet_s *next;
+	switch_size_t bytes;
+	unsigned char data[1];
+} dtls_packet_t;
 
 typedef struct switch_dtls_s {
 	/* DTLS */
@@ -298,6 +308,15 @@ typedef struct switch_dtls_s {
 	char *pem;
 	struct switch_rtp *rtp_session;
 	int mtu;
+	/* handshake offload, the fields below are guarded by mutex while a worker owns the ssl */
+	switch_mutex_t *mutex;
+	dtls_packet_t *pending;
+	dtls_packet_t *pending_tail;
+	int pending_count;
+	uint8_t queued;
+	uint8_t keyed;
+	uint8_t dead;
+	switch_secure_settings_t ssec;
 } switch_dtls_t;
 
 typedef int (*dtls_state_handler_t)(switch_rtp_t *, switch_dtls_t *);
@@ -319,6 +338,21 @@ typedef struct ts_normalize_s {
 	int last_external;
 } ts_normalize_t;
 
+typedef struct rtp_relay_s {
+	switch_rtp_t *src;
+	switch_rtp_t *dst;
+	struct rtp_relay_loop_s *loop;
+	switch_pollfd_t pfd;
+	switch_pollfd_t rtcp_pfd;
+	int running;
+	int synced;
+	uint16_t seq_offset;
+	uint32_t ts_offset;
+	uint16_t last_seq;
+	uint32_t packets;
+	struct rtp_relay_s *next;
+} rtp_relay_t;
+
 struct switch_rtp {
 	/*
 	 * Two sockets are needed because we might be transcoding protocol families
@@ -497,7 +531,8 @@ struct switch_rtp {
 	int zrtp_mitm_tries;
 	int zinit;
 #endif
-
+	rtp_relay_t *relay_out;
+	rtp_relay_t *relay_in;
 };
 
 struct switch_rtcp_report_block {
@@ -807,6 +842,20 @@ static handle_rfc2833_result_t handle_rfc2833(switch_rtp_t *rtp_session, switch_
 
 static int rtp_write_ready(switch_rtp_t *rtp_session, uint32_t bytes, int line);
 static int global_init = 0;
+
+static struct {
+	switch_memory_pool_t *pool;
+	/* guards running against the queue push, so nothing is queued after shutdown */
+	switch_mutex_t *mutex;
+	switch_queue_t *queue;
+	switch_thread_t *threads[DTLS_WORKERS_MAX];
+	int nthreads;
+	int want_threads;
+	int running;
+} dtls_workers = { NULL, NULL, NULL, { NULL }, 0, 2, 0 };
+
+static void dtls_workers_init(switch_memory_pool_t *pool);
+static void dtls_workers_shutdown(void);
 static int rtp_common_write(switch_rtp_t *rtp_session,
 							rtp_msg_t *send_msg, void *data, uint32_t datalen, switch_payload_t payload, uint32_t timestamp, switch_frame_flag_t *flags);
 
@@ -1534,6 +1583,8 @@ SWITCH_DECLARE(void) switch_rtp_init(switch_memory_pool_t *pool)
 #endif
 	switch_mutex_init(&port_lock, SWITCH_MUTEX_NESTED, pool);
 	switch_rtp_dtls_init();
+	dtls_workers_init(pool);
+	rtp_relay_init(pool);
 	global_init = 1;
 }
 
@@ -2057,8 +2108,9 @@ static int check_rtcp_and_ice(switch_rtp_t *rtp_session)
 	uint32_t cur_nack[MAX_NACK] = { 0 };
 	uint16_t seq = 0;
 
+	/* a relay feeding this leg owns its sequence numbers, no comfort noise in between */
 	if (!rtp_session->flags[SWITCH_RTP_FLAG_UDPTL] &&
-		rtp_session->flags[SWITCH_RTP_FLAG_AUTO_CNG] &&
+		rtp_session->flags[SWITCH_RTP_FLAG_AUTO_CNG] && !rtp_session->relay_in &&
 		rtp_session->send_msg.header.ts &&
 		rtp_session->cng_pt != INVALID_PT &&
 		(rtp_session->write_timer.samplecount - rtp_session->last_write_samplecount >= rtp_session->samples_per_interval * 60)) {
@@ -2498,6 +2550,9 @@ SWITCH_DECLARE(void) switch_rtp_shutdown(void)
 		return;
 	}
 
+	rtp_relay_shutdown();
+	dtls_workers_shutdown();
+
 	switch_mutex_lock(port_lock);
 
 	for (hi = switch_core_hash_first(alloc_hash); hi; hi = switch_core_hash_next(&hi)) {
@@ -2526,6 +2581,15 @@ SWITCH_DECLARE(void) switch_rtp_shutdown(void)
 	switch_rtp_dtls_destroy();
 }
 
+SWITCH_DECLARE(int) switch_rtp_set_dtls_handshake_threads(int threads)
+{
+	if (threads >= 0 && threads <= DTLS_WORKERS_MAX && !global_init) {
+		dtls_workers.want_threads = threads;
+	}
+
+	return dtls_workers.want_threads;
+}
+
 SWITCH_DECLARE(switch_port_t) switch_rtp_set_start_port(switch_port_t port)
 {
 	if (port) {
@@ -3156,17 +3220,17 @@ static const char *dtls_state_names(dtls_state_t s)
 #define cr_saltlen 14
 #define cr_kslen 30
 
-static int dtls_state_setup(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
+/* verify the peer and export the SRTP keys into ssec, safe to run off the media thread */
+static int dtls_export_keys(switch_rtp_t *rtp_session, switch_dtls_t *dtls, switch_secure_settings_t *ssec)
 {
 	X509 *cert;
-	switch_secure_settings_t	ssec;	/* Used just to wrap over params in a call to switch_rtp_add_crypto_key. */
 	int r = 0;
 
 	uint8_t raw_key_data[cr_kslen * 2];
 	unsigned char local_key_buf[cr_kslen];
 	unsigned char remote_key_buf[cr_kslen];
 
-	memset(&ssec, 0, sizeof(ssec));
+	memset(ssec, 0, sizeof(*ssec));
 	memset(&raw_key_data, 0, cr_kslen * 2 * sizeof(uint8_t));
 	memset(&local_key_buf, 0, cr_kslen * sizeof(unsigned char));
 	memset(&remote_key_buf, 0, cr_kslen * sizeof(unsigned char));
@@ -3211,24 +3275,41 @@ static int dtls_state_setup(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 			local_salt = remote_salt + cr_saltlen;
 		}
 
-		memcpy(ssec.local_raw_key, local_key, cr_keylen);
-		memcpy(ssec.local_raw_key + cr_keylen, local_salt, cr_saltlen);
+		memcpy(ssec->local_raw_key, local_key, cr_keylen);
+		memcpy(ssec->local_raw_key + cr_keylen, local_salt, cr_saltlen);
 
-		memcpy(ssec.remote_raw_key, remote_key, cr_keylen);
-		memcpy(ssec.remote_raw_key + cr_keylen, remote_salt, cr_saltlen);
+		memcpy(ssec->remote_raw_key, remote_key, cr_keylen);
+		memcpy(ssec->remote_raw_key + cr_keylen, remote_salt, cr_saltlen);
 
-		ssec.crypto_type = AES_CM_128_HMAC_SHA1_80;
+		ssec->crypto_type = AES_CM_128_HMAC_SHA1_80;
+	}
 
-		if (dtls == rtp_session->rtcp_dtls && rtp_session->rtcp_dtls != rtp_session->dtls) {
-			switch_rtp_add_crypto_key(rtp_session, SWITCH_RTP_CRYPTO_SEND_RTCP, 0, &ssec);
-			switch_rtp_add_crypto_key(rtp_session, SWITCH_RTP_CRYPTO_RECV_RTCP, 0, &ssec);
-		} else {
-			switch_rtp_add_crypto_key(rtp_session, SWITCH_RTP_CRYPTO_SEND, 0, &ssec);
-			switch_rtp_add_crypto_key(rtp_session, SWITCH_RTP_CRYPTO_RECV, 0, &ssec);
-		}
+	return 0;
+}
+
+/* install the exported keys and go ready, this creates the SRTP contexts so it belongs to the media thread */
+static void dtls_install_keys(switch_rtp_t *rtp_session, switch_dtls_t *dtls, switch_secure_settings_t *ssec)
+{
+	if (dtls == rtp_session->rtcp_dtls && rtp_session->rtcp_dtls != rtp_session->dtls) {
+		switch_rtp_add_crypto_key(rtp_session, SWITCH_RTP_CRYPTO_SEND_RTCP, 0, ssec);
+		switch_rtp_add_crypto_key(rtp_session, SWITCH_RTP_CRYPTO_RECV_RTCP, 0, ssec);
+	} else {
+		switch_rtp_add_crypto_key(rtp_session, SWITCH_RTP_CRYPTO_SEND, 0, ssec);
+		switch_rtp_add_crypto_key(rtp_session, SWITCH_RTP_CRYPTO_RECV, 0, ssec);
 	}
 
 	dtls_set_state(dtls, DS_READY);
+}
+
+static int dtls_state_setup(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
+{
+	switch_secure_settings_t ssec;	/* Used just to wrap over params in a call to switch_rtp_add_crypto_key. */
+
+	if (dtls_export_keys(rtp_session, dtls, &ssec)) {
+		return -1;
+	}
+
+	dtls_install_keys(rtp_session, dtls, &ssec);
 
 	return 0;
 }
@@ -3285,6 +3366,19 @@ static int dtls_state_handshake(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 	return 0;
 }
 
+static void dtls_free_pending(switch_dtls_t *dtls)
+{
+	dtls_packet_t *pkt;
+
+	while ((pkt = dtls->pending)) {
+		dtls->pending = pkt->next;
+		free(pkt);
+	}
+
+	dtls->pending_tail = NULL;
+	dtls->pending_count = 0;
+}
+
 static void free_dtls(switch_dtls_t **dtlsp)
 {
 	switch_dtls_t *dtls;
@@ -3296,6 +3390,19 @@ static void free_dtls(switch_dtls_t **dtlsp)
 	dtls = *dtlsp;
 	*dtlsp = NULL;
 
+	if (dtls->mutex) {
+		/* a worker may still hold the ssl, let it finish before tearing it down */
+		switch_mutex_lock(dtls->mutex);
+		dtls->dead = 1;
+		while (dtls->queued) {
+			switch_mutex_unlock(dtls->mutex);
+			switch_yield(1000);
+			switch_mutex_lock(dtls->mutex);
+		}
+		dtls_free_pending(dtls);
+		switch_mutex_unlock(dtls->mutex);
+	}
+
 	if (dtls->ssl) {
 		SSL_free(dtls->ssl);
 	}
@@ -3305,31 +3412,24 @@ static void free_dtls(switch_dtls_t **dtlsp)
 	}
 }
 
-static int do_dtls(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
+static void dtls_feed(switch_rtp_t *rtp_session, switch_dtls_t *dtls, void *data, switch_size_t bytes)
 {
-	int r = 0, ret = 0, len;
-	switch_size_t bytes;
-	unsigned char buf[MAX_DTLS_MTU] = "";
-	int ready = rtp_session->ice.ice_user ? (rtp_session->ice.rready && rtp_session->ice.ready) : 1;
-	int pending;
-
-	if (!dtls->bytes && !ready) {
-		return 0;
-	}
+	int ret = BIO_write(dtls->read_bio, data, (int)bytes);
 
-	if (dtls->bytes > 0 && dtls->data) {
-		ret = BIO_write(dtls->read_bio, dtls->data, (int)dtls->bytes);
-		if (ret <= 0) {
-			ret = SSL_get_error(dtls->ssl, ret);
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet decode err: SSL err %d\n", rtp_type(rtp_session), ret);
-		} else if (ret != (int)dtls->bytes) {
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet decode err: read %d bytes instead of %d\n", rtp_type(rtp_session), ret, (int)dtls->bytes);
-		}
+	if (ret <= 0) {
+		ret = SSL_get_error(dtls->ssl, ret);
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet decode err: SSL err %d\n", rtp_type(rtp_session), ret);
+	} else if (ret != (int)bytes) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet decode err: read %d bytes instead of %d\n", rtp_type(rtp_session), ret, (int)bytes);
 	}
+}
 
-	if (dtls_states[dtls->state]) {
-		r = dtls_states[dtls->state](rtp_session, dtls);
-	}
+static void dtls_flush(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
+{
+	int ret, len;
+	switch_size_t bytes;
+	unsigned char buf[MAX_DTLS_MTU] = "";
+	int pending;
 
 	while ((pending = BIO_ctrl_pending(dtls->filter_bio)) > 0) {
 		switch_assert(pending <= sizeof(buf));
@@ -3349,6 +3449,225 @@ static int do_dtls(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet encode err: SSL err %d\n", rtp_type(rtp_session), ret);
 		}
 	}
+}
+
+/* Runs the handshake and key export for one dtls, on a worker or inline when the queue is full.
+   The caller set dtls->queued so the media thread keeps its hands off the ssl until it is cleared. */
+static void dtls_handshake_run(switch_dtls_t *dtls)
+{
+	switch_rtp_t *rtp_session = dtls->rtp_session;
+	dtls_packet_t *list, *pkt;
+
+	switch_mutex_lock(dtls->mutex);
+
+	while (!dtls->dead) {
+		list = dtls->pending;
+		dtls->pending = dtls->pending_tail = NULL;
+		dtls->pending_count = 0;
+		switch_mutex_unlock(dtls->mutex);
+
+		while ((pkt = list)) {
+			list = pkt->next;
+			dtls_feed(rtp_session, dtls, pkt->data, pkt->bytes);
+			free(pkt);
+		}
+
+		if (dtls->state == DS_HANDSHAKE) {
+			dtls_state_handshake(rtp_session, dtls);
+		}
+
+		if (dtls->state == DS_SETUP) {
+			if (dtls_export_keys(rtp_session, dtls, &dtls->ssec)) {
+				if (dtls->state != DS_FAIL) {
+					dtls_set_state(dtls, DS_FAIL);
+				}
+			} else {
+				dtls->keyed = 1;
+			}
+		}
+
+		dtls_flush(rtp_session, dtls);
+
+		switch_mutex_lock(dtls->mutex);
+
+		if (!dtls->pending || dtls->state != DS_HANDSHAKE) {
+			break;
+		}
+	}
+
+	dtls->queued = 0;
+	switch_mutex_unlock(dtls->mutex);
+}
+
+static void *SWITCH_THREAD_FUNC dtls_worker_thread(switch_thread_t *thread, void *obj)
+{
+	void *pop = NULL;
+
+	while (switch_queue_pop(dtls_workers.queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		dtls_handshake_run((switch_dtls_t *) pop);
+	}
+
+	return NULL;
+}
+
+static void dtls_workers_init(switch_memory_pool_t *pool)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	int i;
+
+	if (!dtls_workers.want_threads) {
+		return;
+	}
+
+	dtls_workers.pool = pool;
+	switch_mutex_init(&dtls_workers.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_queue_create(&dtls_workers.queue, 1024, pool);
+	dtls_workers.running = 1;
+
+	for (i = 0; i < dtls_workers.want_threads; i++) {
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+		if (switch_thread_create(&dtls_workers.threads[i], thd_attr, dtls_worker_thread, NULL, pool) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+
+		dtls_workers.nthreads++;
+	}
+
+	if (!dtls_workers.nthreads) {
+		dtls_workers.running = 0;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Started %d DTLS handshake threads\n", dtls_workers.nthreads);
+}
+
+static void dtls_workers_shutdown(void)
+{
+	switch_status_t st;
+	void *pop = NULL;
+	int i;
+
+	if (!dtls_workers.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(dtls_workers.mutex);
+	if (!dtls_workers.running) {
+		switch_mutex_unlock(dtls_workers.mutex);
+		return;
+	}
+	dtls_workers.running = 0;
+	switch_mutex_unlock(dtls_workers.mutex);
+
+	for (i = 0; i < dtls_workers.nthreads; i++) {
+		switch_queue_push(dtls_workers.queue, NULL);
+	}
+
+	for (i = 0; i < dtls_workers.nthreads; i++) {
+		switch_thread_join(&st, dtls_workers.threads[i]);
+		dtls_workers.threads[i] = NULL;
+	}
+
+	dtls_workers.nthreads = 0;
+
+	/* anything no worker picked up must not stay marked queued or free_dtls waits for it forever */
+	while (switch_queue_trypop(dtls_workers.queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		switch_dtls_t *dtls = (switch_dtls_t *) pop;
+
+		if (dtls) {
+			switch_mutex_lock(dtls->mutex);
+			dtls->queued = 0;
+			switch_mutex_unlock(dtls->mutex);
+		}
+	}
+}
+
+/* Media thread side of an offloaded handshake: stash the record, queue the job,
+   and install the keys once a worker has exported them.
+   Returns 1 when the dtls is past the handshake and do_dtls should carry on inline. */
+static int dtls_offload(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
+{
+	dtls_packet_t *pkt = NULL;
+	int pushed;
+
+	switch_mutex_lock(dtls->mutex);
+
+	if (!dtls->queued) {
+		/* no worker holds the ssl, state is ours to read */
+		if (dtls->keyed) {
+			dtls->keyed = 0;
+			switch_mutex_unlock(dtls->mutex);
+			dtls_install_keys(rtp_session, dtls, &dtls->ssec);
+			memset(&dtls->ssec, 0, sizeof(dtls->ssec));
+			/* do_dtls still feeds the record that brought us here and runs the ready state */
+			return 1;
+		}
+
+		if (dtls->state != DS_HANDSHAKE) {
+			switch_mutex_unlock(dtls->mutex);
+			return 1;
+		}
+	}
+
+	if (dtls->bytes > 0 && dtls->data && dtls->pending_count < DTLS_PENDING_MAX) {
+		if ((pkt = malloc(sizeof(*pkt) + dtls->bytes))) {
+			memcpy(pkt->data, dtls->data, dtls->bytes);
+			pkt->bytes = dtls->bytes;
+			pkt->next = NULL;
+
+			if (dtls->pending_tail) {
+				dtls->pending_tail->next = pkt;
+			} else {
+				dtls->pending = pkt;
+			}
+
+			dtls->pending_tail = pkt;
+			dtls->pending_count++;
+		}
+	}
+
+	if (dtls->queued) {
+		switch_mutex_unlock(dtls->mutex);
+		return 0;
+	}
+
+	dtls->queued = 1;
+	switch_mutex_unlock(dtls->mutex);
+
+	switch_mutex_lock(dtls_workers.mutex);
+	pushed = dtls_workers.running && switch_queue_trypush(dtls_workers.queue, dtls) == SWITCH_STATUS_SUCCESS;
+	switch_mutex_unlock(dtls_workers.mutex);
+
+	if (!pushed) {
+		dtls_handshake_run(dtls);
+	}
+
+	return 0;
+}
+
+static int do_dtls(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
+{
+	int r = 0;
+	int ready = rtp_session->ice.ice_user ? (rtp_session->ice.rready && rtp_session->ice.ready) : 1;
+
+	if (!dtls->bytes && !ready) {
+		return 0;
+	}
+
+	if (dtls->mutex && !dtls_offload(rtp_session, dtls)) {
+		return r;
+	}
+
+	if (dtls->bytes > 0 && dtls->data) {
+		dtls_feed(rtp_session, dtls, dtls->data, dtls->bytes);
+	}
+
+	if (dtls_states[dtls->state]) {
+		r = dtls_states[dtls->state](rtp_session, dtls);
+	}
+
+	dtls_flush(rtp_session, dtls);
 
 	return r;
 }
@@ -3888,6 +4207,10 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_add_dtls(switch_rtp_t *rtp_session, d
 	dtls->rtp_session = rtp_session;
 	dtls->mtu = 1200;
 
+	if (dtls_workers.running) {
+		switch_mutex_init(&dtls->mutex, SWITCH_MUTEX_NESTED, rtp_session->pool);
+	}
+
 	if (rtp_session->session) {
 		switch_channel_t *channel = switch_core_session_get_channel(rtp_session->session);
 		if ((var = switch_channel_get_variable(channel, "rtp_dtls_mtu"))) {
@@ -4976,6 +5299,609 @@ SWITCH_DECLARE(void) switch_rtp_flush(switch_rtp_t *rtp_session)
 	switch_rtp_set_flag(rtp_session, SWITCH_RTP_FLAG_FLUSH);
 }
 
+/* Bridge relay: while two bridged legs carry the same codec, move media straight from one session's
+   socket to the other's on per-core relay threads instead of through both session threads.  The relay
+   also reads and sends the relayed leg's RTCP.  Anything it does not understand (DTMF, CN, STUN, foreign
+   sources, SRTP errors) stops it and is left on the socket for the regular read path. */
+
+#define RTP_RELAY_BURST 8
+#define RTP_RELAY_MAX_LOOPS 32
+/* descriptors per loop, two per relay when RTCP is on */
+#define RTP_RELAY_LOOP_MAX 1024
+
+#ifndef MSG_DONTWAIT
+#define RTP_RELAY_DISABLED
+#define MSG_DONTWAIT 0
+#endif
+
+/* One loop per core, each with its own pollset; relays are added and removed as single descriptors.
+   relay_globals.mutex covers the relay lists and the session relay pointers, a loop's mutex only covers
+   what its thread is pumping, and is always taken after the global one. */
+typedef struct rtp_relay_loop_s {
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_thread_t *thread;
+	switch_pollset_t *pollset;
+	/* the relay being pumped with no lock held */
+	rtp_relay_t *pumping;
+	rtp_relay_t *dead;
+	uint32_t count;
+} rtp_relay_loop_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	rtp_relay_t *list;
+	rtp_relay_loop_t loops[RTP_RELAY_MAX_LOOPS];
+	uint32_t nloops;
+	uint32_t next_loop;
+	int running;
+} relay_globals;
+
+static switch_status_t read_rtcp_packet(switch_rtp_t *rtp_session, switch_size_t *bytes, switch_frame_flag_t *flags);
+static switch_status_t process_rtcp_packet(switch_rtp_t *rtp_session, switch_size_t *bytes);
+
+static void rtp_relay_unlink(rtp_relay_t *relay)
+{
+	rtp_relay_loop_t *loop = relay->loop;
+	rtp_relay_t *rp, *last = NULL;
+
+	for (rp = relay_globals.list; rp; rp = rp->next) {
+		if (rp == relay) {
+			if (last) {
+				last->next = rp->next;
+			} else {
+				relay_globals.list = rp->next;
+			}
+			break;
+		}
+		last = rp;
+	}
+
+	switch_pollset_remove(loop->pollset, &relay->pfd);
+	if (relay->rtcp_pfd.desc.s) {
+		switch_pollset_remove(loop->pollset, &relay->rtcp_pfd);
+	}
+
+	switch_mutex_lock(loop->mutex);
+	relay->running = 0;
+	switch_mutex_unlock(loop->mutex);
+
+	relay->src->relay_out = NULL;
+	relay->dst->relay_in = NULL;
+
+	if (relay->packets) {
+		relay->dst->need_mark = 1;
+	}
+
+	/* freed by the loop thread, an event it already polled may still point here */
+	relay->next = loop->dead;
+	loop->dead = relay;
+	loop->count--;
+
+	switch_thread_cond_broadcast(relay_globals.cond);
+}
+
+static int rtp_relay_busy(rtp_relay_loop_t *loop, switch_rtp_t *rtp_session)
+{
+	rtp_relay_t *relay = loop->pumping;
+
+	return relay && (relay->src == rtp_session || relay->dst == rtp_session);
+}
+
+/* the session thread is parked while its leg is relayed, its inbound RTCP is read here instead */
+static int rtp_relay_rtcp(rtp_relay_t *relay)
+{
+	switch_rtp_t *src = relay->src;
+	switch_frame_flag_t flags = SFF_NONE;
+	switch_size_t bytes = 0;
+
+	if (!switch_rtp_ready(src)) {
+		return -1;
+	}
+
+	if (read_rtcp_packet(src, &bytes, &flags) == SWITCH_STATUS_SUCCESS && bytes) {
+		process_rtcp_packet(src, &bytes);
+	}
+
+	return 0;
+}
+
+static int rtp_relay_pump(rtp_relay_t *relay, rtp_msg_t *msgs, switch_sockaddr_t *from_addr)
+{
+	switch_rtp_t *src = relay->src, *dst = relay->dst;
+	void *hdrs[RTP_RELAY_BURST];
+	int lens[RTP_RELAY_BURST];
+	unsigned int n = 0, kept = 0, x;
+	int r = 0;
+
+	if (!switch_rtp_ready(src) || !switch_rtp_ready(dst) || src->flags[SWITCH_RTP_FLAG_SECURE_RECV_RESET] ||
+		dst->flags[SWITCH_RTP_FLAG_SECURE_SEND_RESET]) {
+		return -1;
+	}
+
+	/* take up to a burst off the socket first, then protect and send it in one pass */
+	while (n < RTP_RELAY_BURST) {
+		rtp_msg_t *msg = &msgs[n];
+		switch_size_t bytes = sizeof(msg->header) + sizeof(msg->body), raw;
+		switch_status_t status;
+
+		status = switch_socket_recvfrom(from_addr, src->sock_input, MSG_PEEK | MSG_DONTWAIT, (void *) msg, &bytes);
+
+		if (status != SWITCH_STATUS_SUCCESS || !bytes) {
+			break;
+		}
+
+		/* only plain media from the negotiated remote is ours, leave everything else to the session */
+		if (bytes <= sizeof(msg->header) || msg->header.version != 2 || msg->header.pt != src->payload ||
+			!switch_cmp_addr(from_addr, src->remote_addr)) {
+			r = -1;
+			break;
+		}
+
+		raw = bytes;
+
+#ifdef ENABLE_SRTP
+		/* unprotect the peeked copy, a packet that fails stays queued for the session's own read path */
+		if (src->flags[SWITCH_RTP_FLAG_SECURE_RECV]) {
+			srtp_err_status_t stat = srtp_err_status_fail;
+			int sbytes = (int) bytes;
+
+			switch_mutex_lock(src->ice_mutex);
+			if (src->recv_ctx[src->srtp_idx_rtp]) {
+				if (src->flags[SWITCH_RTP_FLAG_SECURE_RECV_MKI]) {
+					stat = srtp_unprotect_mki(src->recv_ctx[src->srtp_idx_rtp], &msg->header, &sbytes, 1);
+				} else {
+					stat = srtp_unprotect(src->recv_ctx[src->srtp_idx_rtp], &msg->header, &sbytes);
+				}
+			}
+			switch_mutex_unlock(src->ice_mutex);
+
+			if (stat) {
+				r = -1;
+				break;
+			}
+
+			bytes = sbytes;
+		}
+#endif
+
+		{
+			/* the datagram is handled, consume it; only its header is copied again */
+			rtp_hdr_t discard;
+			switch_size_t dlen = sizeof(discard);
+
+			if (switch_socket_recvfrom(from_addr, src->sock_input, 0, (void *) &discard, &dlen) != SWITCH_STATUS_SUCCESS || !dlen) {
+				r = -1;
+				break;
+			}
+		}
+
+		src->stats.inbound.raw_bytes += raw;
+		src->stats.inbound.packet_count++;
+
+		hdrs[n] = &msg->header;
+		lens[n] = (int) bytes;
+		n++;
+	}
+
+	for (x = 0; x < n; x++) {
+		rtp_msg_t *msg = (rtp_msg_t *) hdrs[x];
+		switch_size_t bytes = lens[x], hlen;
+
+		/* csrc lists and header extensions belong to the inbound leg, drop them */
+		hlen = sizeof(msg->header) + msg->header.cc * 4;
+
+		if (msg->header.x && hlen + 4 <= bytes) {
+			switch_rtp_hdr_ext_t *ext = (switch_rtp_hdr_ext_t *) ((char *) msg + hlen);
+			hlen += 4 + ntohs(ext->length) * 4;
+		}
+
+		if (hlen >= bytes) {
+			continue;
+		}
+
+		if (hlen > sizeof(msg->header)) {
+			memmove(msg->body, (char *) msg + hlen, bytes - hlen);
+			bytes -= hlen - sizeof(msg->header);
+			msg->header.cc = 0;
+			msg->header.x = 0;
+		}
+
+		src->stats.inbound.media_bytes += bytes - sizeof(msg->header);
+		src->stats.inbound.media_packet_count++;
+
+		if (src->flags[SWITCH_RTP_FLAG_ENABLE_RTCP]) {
+			/* keep the receiver report numbers moving while the read path is idle */
+			src->last_rtp_hdr = msg->header;
+			rtcp_stats(src);
+		}
+
+		hdrs[kept] = msg;
+		lens[kept] = (int) bytes;
+		kept++;
+	}
+
+	if (!(n = kept)) {
+		return r;
+	}
+
+	src->last_media = switch_micro_time_now();
+
+	switch_mutex_lock(dst->write_mutex);
+
+	for (x = 0; x < n; x++) {
+		rtp_msg_t *msg = (rtp_msg_t *) hdrs[x];
+		uint16_t seq = ntohs(msg->header.seq);
+		uint32_t ts = ntohl(msg->header.ts);
+
+		if (!relay->synced) {
+			relay->seq_offset = (uint16_t) (dst->seq + 1 - seq);
+			relay->ts_offset = dst->last_write_ts + dst->samples_per_interval - ts;
+			msg->header.m = !(dst->rtp_bugs & RTP_BUG_NEVER_SEND_MARKER);
+			relay->synced = 1;
+		}
+
+		dst->seq = (uint16_t) (seq + relay->seq_offset);
+		dst->last_write_ts = ts + relay->ts_offset;
+
+		msg->header.seq = htons(dst->seq);
+		msg->header.ts = htonl(dst->last_write_ts);
+		msg->header.ssrc = htonl(dst->ssrc);
+		msg->header.pt = dst->payload;
+	}
+
+#ifdef ENABLE_SRTP
+	if (dst->flags[SWITCH_RTP_FLAG_SECURE_SEND] && dst->send_ctx[dst->srtp_idx_rtp]) {
+		srtp_err_status_t stat = srtp_err_status_ok;
+		unsigned int failed = 0;
+
+		for (x = 0; x < n; x++) {
+			srtp_err_status_t st;
+
+			if (!dst->flags[SWITCH_RTP_FLAG_SECURE_SEND_MKI]) {
+				st = srtp_protect(dst->send_ctx[dst->srtp_idx_rtp], hdrs[x], &lens[x]);
+			} else {
+				st = srtp_protect_mki(dst->send_ctx[dst->srtp_idx_rtp], hdrs[x], &lens[x], 1, SWITCH_CRYPTO_MKI_INDEX);
+			}
+
+			/* a packet that fails is not sent, the rest of the burst still goes out */
+			if (st) {
+				lens[x] = 0;
+				failed++;
+				if (!stat) {
+					stat = st;
+				}
+			}
+		}
+
+		if (failed) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(dst->session), SWITCH_LOG_ERROR,
+							  "Error: %s SRTP protection failed with code %d, relay discarded %u of %u packets\n", rtp_type(dst), stat, failed, n);
+			r = -1;
+		}
+	}
+#endif
+
+	for (x = 0; x < n; x++) {
+		switch_size_t bytes = lens[x];
+
+		if (!bytes) {
+			continue;
+		}
+
+		if (switch_socket_sendto(dst->sock_output, dst->remote_addr, 0, hdrs[x], &bytes) == SWITCH_STATUS_SUCCESS) {
+			dst->stats.outbound.raw_bytes += bytes;
+			dst->stats.outbound.media_bytes += bytes - sizeof(rtp_hdr_t);
+			dst->stats.outbound.packet_count++;
+			dst->stats.outbound.media_packet_count++;
+			dst->last_write_timestamp = switch_micro_time_now();
+		}
+	}
+
+	switch_mutex_unlock(dst->write_mutex);
+
+	relay->packets += n;
+
+	/* reports for the relayed leg go out on the same schedule the read path would keep */
+	if (src->flags[SWITCH_RTP_FLAG_ENABLE_RTCP] && check_rtcp_and_ice(src) == -1) {
+		r = -1;
+	}
+
+	return r;
+}
+
+static void *SWITCH_THREAD_FUNC rtp_relay_thread(switch_thread_t *thread, void *obj)
+{
+	rtp_relay_loop_t *loop = (rtp_relay_loop_t *) obj;
+	switch_sockaddr_t *from_addr = NULL;
+	switch_memory_pool_t *pool = NULL;
+	rtp_msg_t *msg;
+
+	switch_zmalloc(msg, sizeof(*msg) * RTP_RELAY_BURST);
+	switch_core_new_memory_pool(&pool);
+	switch_sockaddr_create(&from_addr, pool);
+
+	while (relay_globals.running) {
+		const switch_pollfd_t *fds = NULL;
+		int32_t i, num = 0;
+
+		if (loop->dead) {
+			rtp_relay_t *rp;
+
+			switch_mutex_lock(relay_globals.mutex);
+			while ((rp = loop->dead)) {
+				loop->dead = rp->next;
+				free(rp);
+			}
+			switch_mutex_unlock(relay_globals.mutex);
+		}
+
+		if (switch_pollset_poll(loop->pollset, 20000, &num, &fds) != SWITCH_STATUS_SUCCESS) {
+			continue;
+		}
+
+		for (i = 0; i < num; i++) {
+			rtp_relay_t *relay = (rtp_relay_t *) fds[i].client_data;
+			int r;
+
+			switch_mutex_lock(loop->mutex);
+			if (!relay->running) {
+				switch_mutex_unlock(loop->mutex);
+				continue;
+			}
+			loop->pumping = relay;
+			switch_mutex_unlock(loop->mutex);
+
+			if (fds[i].desc.s == relay->rtcp_pfd.desc.s) {
+				r = rtp_relay_rtcp(relay);
+			} else {
+				r = rtp_relay_pump(relay, msg, from_addr);
+			}
+
+			switch_mutex_lock(loop->mutex);
+			loop->pumping = NULL;
+			switch_thread_cond_broadcast(loop->cond);
+			switch_mutex_unlock(loop->mutex);
+
+			if (r < 0) {
+				switch_mutex_lock(relay_globals.mutex);
+				if (relay->running) {
+					rtp_relay_unlink(relay);
+				}
+				switch_mutex_unlock(relay_globals.mutex);
+			}
+		}
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+	free(msg);
+
+	return NULL;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_rtp_relay_start(switch_rtp_t *src, switch_rtp_t *dst)
+{
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	rtp_relay_t *relay;
+
+	if (!relay_globals.mutex || src == dst || !switch_rtp_ready(src) || !switch_rtp_ready(dst)) {
+		return status;
+	}
+
+#ifdef ENABLE_ZRTP
+	if (zrtp_on) {
+		return status;
+	}
+#endif
+
+	if (src->flags[SWITCH_RTP_FLAG_VIDEO] || src->flags[SWITCH_RTP_FLAG_PROXY_MEDIA] || src->flags[SWITCH_RTP_FLAG_UDPTL] ||
+		src->flags[SWITCH_RTP_FLAG_RTCP_MUX] || src->flags[SWITCH_RTP_FLAG_PAUSE] || src->ice.ice_user || src->dtls ||
+		dst->flags[SWITCH_RTP_FLAG_VIDEO] || dst->flags[SWITCH_RTP_FLAG_PROXY_MEDIA] || dst->flags[SWITCH_RTP_FLAG_UDPTL] ||
+		dst->flags[SWITCH_RTP_FLAG_MUTE] || dst->ice.ice_user || dst->dtls || dst->sending_dtmf || switch_queue_size(dst->dtmf_data.dtmf_queue) ||
+		src->flags[SWITCH_RTP_FLAG_RTCP_PASSTHRU] || !dst->remote_addr ||
+		!src->remote_addr || !src->sock_input || !dst->sock_output) {
+		return status;
+	}
+
+	switch_mutex_lock(relay_globals.mutex);
+
+	if (relay_globals.running > 0 && !src->relay_out && !dst->relay_in) {
+		rtp_relay_loop_t *loop = &relay_globals.loops[relay_globals.next_loop++ % relay_globals.nloops];
+
+		switch_zmalloc(relay, sizeof(*relay));
+		relay->src = src;
+		relay->dst = dst;
+		relay->loop = loop;
+		relay->running = 1;
+
+		relay->pfd.desc_type = SWITCH_POLL_SOCKET;
+		relay->pfd.reqevents = SWITCH_POLLIN | SWITCH_POLLERR;
+		relay->pfd.desc.s = src->sock_input;
+		relay->pfd.client_data = relay;
+
+		if (src->flags[SWITCH_RTP_FLAG_ENABLE_RTCP] && src->rtcp_sock_input && src->rtcp_sock_input != src->sock_input) {
+			relay->rtcp_pfd = relay->pfd;
+			relay->rtcp_pfd.desc.s = src->rtcp_sock_input;
+		}
+
+		if (switch_pollset_add(loop->pollset, &relay->pfd) != SWITCH_STATUS_SUCCESS) {
+			free(relay);
+		} else if (relay->rtcp_pfd.desc.s && switch_pollset_add(loop->pollset, &relay->rtcp_pfd) != SWITCH_STATUS_SUCCESS) {
+			switch_pollset_remove(loop->pollset, &relay->pfd);
+			free(relay);
+		} else {
+			relay->next = relay_globals.list;
+			relay_globals.list = relay;
+			loop->count++;
+			src->relay_out = relay;
+			dst->relay_in = relay;
+			status = SWITCH_STATUS_SUCCESS;
+		}
+	}
+
+	switch_mutex_unlock(relay_globals.mutex);
+
+	return status;
+}
+
+SWITCH_DECLARE(void) switch_rtp_relay_stop(switch_rtp_t *rtp_session)
+{
+	rtp_relay_loop_t *loops[2] = { NULL, NULL };
+	int i;
+
+	if (!rtp_session || !relay_globals.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(relay_globals.mutex);
+
+	if (rtp_session->relay_out) {
+		loops[0] = rtp_session->relay_out->loop;
+		rtp_relay_unlink(rtp_session->relay_out);
+	}
+
+	if (rtp_session->relay_in) {
+		loops[1] = rtp_session->relay_in->loop;
+		rtp_relay_unlink(rtp_session->relay_in);
+	}
+
+	/* still holding the global lock, so relay_wait only returns once the pump is off this session too */
+	for (i = 0; i < 2; i++) {
+		if (!loops[i]) {
+			continue;
+		}
+
+		switch_mutex_lock(loops[i]->mutex);
+		while (rtp_relay_busy(loops[i], rtp_session)) {
+			switch_thread_cond_wait(loops[i]->cond, loops[i]->mutex);
+		}
+		switch_mutex_unlock(loops[i]->mutex);
+	}
+
+	switch_mutex_unlock(relay_globals.mutex);
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_rtp_relay_active(switch_rtp_t *rtp_session)
+{
+	return (rtp_session && rtp_session->relay_out) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_rtp_relay_wait(switch_rtp_t *rtp_session, uint32_t ms)
+{
+	switch_time_t expires = switch_micro_time_now() + (switch_time_t) ms * 1000;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (!rtp_session || !relay_globals.mutex) {
+		return status;
+	}
+
+	switch_mutex_lock(relay_globals.mutex);
+
+	/* relays are only unlinked off the pump, or by relay_stop which waits for the pump under this lock */
+	while (rtp_session->relay_out) {
+		switch_time_t now = switch_micro_time_now();
+
+		if (now >= expires) {
+			status = SWITCH_STATUS_SUCCESS;
+			break;
+		}
+
+		switch_thread_cond_timedwait(relay_globals.cond, relay_globals.mutex, expires - now);
+	}
+
+	switch_mutex_unlock(relay_globals.mutex);
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		/* the session thread owns the read side again, drop what was buffered before the relay took over */
+		switch_rtp_reset_jb(rtp_session);
+		switch_rtp_reset_media_timer(rtp_session);
+	}
+
+	return status;
+}
+
+static void rtp_relay_init(switch_memory_pool_t *pool)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	uint32_t i, want;
+
+	memset(&relay_globals, 0, sizeof(relay_globals));
+
+#ifdef RTP_RELAY_DISABLED
+	return;
+#endif
+	relay_globals.pool = pool;
+	switch_mutex_init(&relay_globals.mutex, SWITCH_MUTEX_UNNESTED, pool);
+	switch_thread_cond_create(&relay_globals.cond, pool);
+	relay_globals.running = 1;
+
+	want = switch_core_cpu_count();
+	if (want < 1) {
+		want = 1;
+	} else if (want > RTP_RELAY_MAX_LOOPS) {
+		want = RTP_RELAY_MAX_LOOPS;
+	}
+
+	for (i = 0; i < want; i++) {
+		rtp_relay_loop_t *loop = &relay_globals.loops[relay_globals.nloops];
+
+		if (switch_pollset_create(&loop->pollset, RTP_RELAY_LOOP_MAX, pool, SWITCH_POLLSET_THREADSAFE) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+
+		switch_mutex_init(&loop->mutex, SWITCH_MUTEX_UNNESTED, pool);
+		switch_thread_cond_create(&loop->cond, pool);
+
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_threadattr_priority_set(thd_attr, SWITCH_PRI_REALTIME);
+
+		if (switch_thread_create(&loop->thread, thd_attr, rtp_relay_thread, loop, pool) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+
+		relay_globals.nloops++;
+	}
+
+	if (!relay_globals.nloops) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot start RTP relay threads\n");
+		relay_globals.running = 0;
+	}
+}
+
+static void rtp_relay_shutdown(void)
+{
+	switch_status_t st;
+	uint32_t i;
+
+	if (!relay_globals.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(relay_globals.mutex);
+	relay_globals.running = 0;
+	while (relay_globals.list) {
+		rtp_relay_unlink(relay_globals.list);
+	}
+	switch_mutex_unlock(relay_globals.mutex);
+
+	for (i = 0; i < relay_globals.nloops; i++) {
+		rtp_relay_loop_t *loop = &relay_globals.loops[i];
+		rtp_relay_t *rp;
+
+		switch_thread_join(&st, loop->thread);
+
+		while ((rp = loop->dead)) {
+			loop->dead = rp->next;
+			free(rp);
+		}
+	}
+
+	relay_globals.nloops = 0;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_rtp_req_bitrate(switch_rtp_t *rtp_session, uint32_t bps)
 {
 	if (!rtp_write_ready(rtp_session, 0, __LINE__) || rtp_session->tmmbr) {
@@ -5047,6 +5973,8 @@ SWITCH_DECLARE(void) switch_rtp_break(switch_rtp_t *rtp_session)
 		switch_rtp_video_refresh(rtp_session);
 	}
 
+	switch_rtp_relay_stop(rtp_session);
+
 	switch_mutex_lock(rtp_session->flag_mutex);
 	rtp_session->flags[SWITCH_RTP_FLAG_BREAK] = 1;
 
@@ -5140,6 +6068,8 @@ SWITCH_DECLARE(void) switch_rtp_destroy(switch_rtp_t **rtp_session)
 		return;
 	}
 
+	switch_rtp_relay_stop(*rtp_session);
+
 	if ((*rtp_session)->vb) {
 		/* retrieve counter for ALL received NACKed packets */
 		uint32_t nack_jb_ok = switch_jb_get_nack_success((*rtp_session)->vb);
@@ -7220,6 +8150,12 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 		return -1;
 	}
 
+	if (rtp_session->relay_out) {
+		/* whoever reads takes the socket back from the relay */
+		switch_rtp_relay_stop(rtp_session);
+		switch_rtp_reset_jb(rtp_session);
+	}
+
 	if (rtp_session->session) {
 		channel = switch_core_session_get_channel(rtp_session->session);
 	}
@@ -8020,6 +8956,8 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_queue_rfc2833(switch_rtp_t *rtp_sessi
 		return SWITCH_STATUS_FALSE;
 	}
 
+	switch_rtp_relay_stop(rtp_session);
+
 	if ((rdigit = malloc(sizeof(*rdigit))) != 0) {
 		*rdigit = *dtmf;
 		if (rdigit->duration < switch_core_min_dtmf_duration(0)) {
@@ -8045,6 +8983,8 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_queue_rfc2833_in(switch_rtp_t *rtp_se
 		return SWITCH_STATUS_FALSE;
 	}
 
+	switch_rtp_relay_stop(rtp_session);
+
 	if ((rdigit = malloc(sizeof(*rdigit))) != 0) {
 		*rdigit = *dtmf;
 		if (rdigit->duration < switch_core_min_dtmf_duration(0)) {
@@ -214,6 +214,8 @@ struct switch_xml_root {		/* additional data for the root tag */
 	char ***pi;					/* processing instructions */
 	short standalone;			/* non-zero if <?xml standalone="yes"?> */
 	char err[SWITCH_XML_ERRL];	/* error string */
+	struct switch_xml_arena_block *arena;	/* tree memory when built by switch_xml_parse_fd_stream() */
+	switch_size_t arena_bytes;	/* size of the arena blocks */
 };
 
 char *SWITCH_XML_NIL[] = { NULL };	/* empty, null terminated array of strings */
@@ -232,7 +234,6 @@ static switch_memory_pool_t *XML_MEMORY_POOL = NULL;
 
 static switch_thread_rwlock_t *B_RWLOCK = NULL;
 static switch_mutex_t *XML_LOCK = NULL;
-static switch_mutex_t *CACHE_MUTEX = NULL;
 static switch_mutex_t *REFLOCK = NULL;
 static switch_mutex_t *FILE_LOCK = NULL;
 
@@ -240,9 +241,8 @@ SWITCH_DECLARE_NONSTD(switch_xml_t) __switch_xml_open_root(uint8_t reload, const
 
 static switch_xml_open_root_function_t XML_OPEN_ROOT_FUNCTION = (switch_xml_open_root_function_t)__switch_xml_open_root;
 static void *XML_OPEN_ROOT_FUNCTION_USER_DATA = NULL;
+static int STREAM_PARSE = 1;
 
-static switch_hash_t *CACHE_HASH = NULL;
-static switch_hash_t *CACHE_EXPIRES_HASH = NULL;
 
 struct xml_section_t {
 	const char *name;
@@ -1241,6 +1241,647 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_fd(int fd)
 	return &root->xml;
 }
 
+/* Streaming parser.  The document is read in chunks instead of being loaded whole, and the tree is
+   built in an arena owned by the root: nodes, attribute lists and strings are carved out of a few
+   large blocks, and tag names, attribute names and short values are interned, so a large expanded
+   configuration costs a fraction of its text.  The result is a regular switch_xml tree for every
+   accessor.  Anything the classic parser would need its whole buffer for (DTDs, processing
+   instructions other than <?xml ?>, UTF-16, unquoted attributes) or any error ends the stream parse
+   and the caller falls back to switch_xml_parse_fd(), which also produces the error message. */
+
+#define XML_ARENA_BLOCK (256 * 1024)
+#define XML_STREAM_CHUNK (64 * 1024)
+#define XML_INTERN_MAX 64
+
+struct switch_xml_arena_block {
+	struct switch_xml_arena_block *next;
+	switch_size_t used;
+	switch_size_t size;
+};
+
+static void *xml_arena_alloc(switch_xml_root_t root, switch_size_t len, switch_size_t align)
+{
+	struct switch_xml_arena_block *b = root->arena, *nb;
+	switch_size_t off;
+
+	if (b) {
+		off = (b->used + align - 1) & ~(align - 1);
+		if (off + len <= b->size) {
+			b->used = off + len;
+			return (char *) (b + 1) + off;
+		}
+	}
+
+	if (len > XML_ARENA_BLOCK / 4) {
+		/* big strings get a block of their own behind the current one */
+		nb = (struct switch_xml_arena_block *) switch_must_malloc(sizeof(*nb) + len);
+		nb->size = nb->used = len;
+		if (b) {
+			nb->next = b->next;
+			b->next = nb;
+		} else {
+			nb->next = NULL;
+			root->arena = nb;
+		}
+	} else {
+		nb = (struct switch_xml_arena_block *) switch_must_malloc(sizeof(*nb) + XML_ARENA_BLOCK);
+		nb->size = XML_ARENA_BLOCK;
+		nb->used = len;
+		nb->next = b;
+		root->arena = nb;
+	}
+
+	root->arena_bytes += sizeof(*nb) + nb->size;
+
+	return nb + 1;
+}
+
+static void xml_arena_free(switch_xml_root_t root)
+{
+	struct switch_xml_arena_block *b;
+
+	while ((b = root->arena)) {
+		root->arena = b->next;
+		free(b);
+	}
+	root->arena_bytes = 0;
+}
+
+static char *xml_arena_strndup(switch_xml_root_t root, const char *s, switch_size_t len)
+{
+	char *r = (char *) xml_arena_alloc(root, len + 1, 1);
+
+	memcpy(r, s, len);
+	r[len] = '\0';
+
+	return r;
+}
+
+/* gives an arena attribute list back to malloc before it is modified, see switch_xml_set_attr */
+static void xml_arena_detach_attr(switch_xml_t xml)
+{
+	char **attr;
+	int l = 0;
+
+	xml->flags &= ~SWITCH_XML_ARENA_ATTR;
+
+	while (xml->attr[l]) {
+		l += 2;
+	}
+
+	attr = (char **) switch_must_malloc((l + 2) * sizeof(char *));
+	memcpy(attr, xml->attr, l * sizeof(char *));
+	attr[l] = NULL;
+	attr[l + 1] = switch_must_strdup(xml->attr[l + 1]);
+	xml->attr = attr;
+}
+
+typedef struct {
+	char *data;
+	switch_size_t len;
+	switch_size_t size;
+} xml_sbuf_t;
+
+static void xml_sbuf_grow(xml_sbuf_t *b, switch_size_t need)
+{
+	while (b->size < need) {
+		b->size = b->size ? b->size * 2 : 256;
+	}
+	b->data = (char *) switch_must_realloc(b->data, b->size);
+}
+
+#define xml_sbuf_putc(_b, _c) do { if ((_b)->len + 2 > (_b)->size) xml_sbuf_grow((_b), (_b)->len + 2); (_b)->data[(_b)->len++] = (char) (_c); } while (0)
+
+typedef struct {
+	switch_xml_t node;
+	xml_sbuf_t txt;
+	switch_xml_t last_child;
+	switch_xml_t last_sibling;
+	/* the last child of every tag name seen so far, names are interned so pointers compare */
+	switch_xml_t *types;
+	uint32_t ntypes;
+	uint32_t types_size;
+} xml_stream_frame_t;
+
+typedef struct {
+	char *name;
+	switch_size_t off;
+	switch_size_t len;
+} xml_stream_attr_t;
+
+typedef struct {
+	int fd;
+	char *buf;
+	switch_size_t pos;
+	switch_size_t len;
+	switch_xml_root_t root;
+	char **intern;
+	uint32_t intern_size;
+	uint32_t intern_count;
+	xml_sbuf_t tok;
+	xml_sbuf_t val;
+	xml_stream_frame_t *stack;
+	uint32_t depth;
+	uint32_t stack_size;
+	xml_stream_attr_t *attrs;
+	uint32_t nattrs;
+	uint32_t attrs_size;
+} xml_stream_t;
+
+static int xml_stream_fill(xml_stream_t *xs)
+{
+	switch_ssize_t r;
+
+	if ((r = read(xs->fd, xs->buf, XML_STREAM_CHUNK)) <= 0) {
+		return EOF;
+	}
+
+	xs->len = (switch_size_t) r;
+	xs->pos = 1;
+
+	return (unsigned char) xs->buf[0];
+}
+
+#define xml_stream_getc(_xs) ((_xs)->pos < (_xs)->len ? (unsigned char) (_xs)->buf[(_xs)->pos++] : xml_stream_fill(_xs))
+#define xml_stream_ws(_c) ((_c) == ' ' || (_c) == '\t' || (_c) == '\r' || (_c) == '\n')
+
+static uint32_t xml_stream_hash(const char *s, switch_size_t len)
+{
+	uint32_t h = 2166136261u;
+	switch_size_t i;
+
+	for (i = 0; i < len; i++) {
+		h = (h ^ (unsigned char) s[i]) * 16777619u;
+	}
+
+	return h;
+}
+
+static const char *xml_stream_intern(xml_stream_t *xs, const char *s, switch_size_t len)
+{
+	uint32_t h;
+	char *r;
+
+	if ((xs->intern_count + 1) * 2 > xs->intern_size) {
+		uint32_t nsize = xs->intern_size ? xs->intern_size * 2 : 1024, x;
+		char **nt = (char **) switch_must_malloc(nsize * sizeof(char *));
+
+		memset(nt, 0, nsize * sizeof(char *));
+		for (x = 0; x < xs->intern_size; x++) {
+			if ((r = xs->intern[x])) {
+				for (h = xml_stream_hash(r, strlen(r)) & (nsize - 1); nt[h]; h = (h + 1) & (nsize - 1));
+				nt[h] = r;
+			}
+		}
+		free(xs->intern);
+		xs->intern = nt;
+		xs->intern_size = nsize;
+	}
+
+	for (h = xml_stream_hash(s, len) & (xs->intern_size - 1); (r = xs->intern[h]); h = (h + 1) & (xs->intern_size - 1)) {
+		if (!strncmp(r, s, len) && r[len] == '\0') {
+			return r;
+		}
+	}
+
+	r = xml_arena_strndup(xs->root, s, len);
+	xs->intern[h] = r;
+	xs->intern_count++;
+
+	return r;
+}
+
+static char *xml_stream_str(xml_stream_t *xs, const char *s, switch_size_t len)
+{
+	if (len <= XML_INTERN_MAX) {
+		return (char *) xml_stream_intern(xs, s, len);
+	}
+
+	return xml_arena_strndup(xs->root, s, len);
+}
+
+/* the same decoding switch_xml_decode() does in place: line endings, character and entity references,
+   t is '&' for character content, ' ' for attribute values and 'c' for cdata */
+static void xml_stream_decode(xml_sbuf_t *dst, const char *s, switch_size_t len, char t)
+{
+	static const char *ent[] = { "lt;", "<", "gt;", ">", "quot;", "\"", "apos;", "'", "amp;", "&", NULL };
+	const char *e = s + len;
+
+	if (dst->len + len + 1 > dst->size) {
+		xml_sbuf_grow(dst, dst->len + len + 1);
+	}
+
+	while (s < e) {
+		char c = *s;
+
+		if (c == '\r') {
+			c = '\n';
+			if (s + 1 < e && s[1] == '\n') {
+				s++;
+			}
+		} else if (c == '&' && t != 'c') {
+			if (s + 2 < e && s[1] == '#') {
+				const char *code = s + 2;
+				char num[16], *end;
+				switch_size_t n;
+				unsigned long v;
+				int base = 10;
+
+				if (*code == 'x') {
+					code++;
+					base = 16;
+				}
+
+				n = (switch_size_t) (e - code) < sizeof(num) - 1 ? (switch_size_t) (e - code) : sizeof(num) - 1;
+				memcpy(num, code, n);
+				num[n] = '\0';
+
+				if (n && isxdigit((int) *num) && (v = strtoul(num, &end, base)) && *end == ';' && v <= 0x7FFFFFFF) {
+					if (v < 0x80) {
+						xml_sbuf_putc(dst, v);
+					} else {
+						unsigned long b, d;
+
+						for (b = 0, d = v; d; d /= 2)
+							b++;
+						b = (b - 2) / 5;
+						xml_sbuf_putc(dst, (0xFF << (7 - b)) | (v >> (6 * b)));
+						while (b) {
+							b--;
+							xml_sbuf_putc(dst, 0x80 | ((v >> (6 * b)) & 0x3F));
+						}
+					}
+					s = code + (end - num) + 1;
+					continue;
+				}
+			} else {
+				int i;
+
+				for (i = 0; ent[i]; i += 2) {
+					switch_size_t l = strlen(ent[i]);
+
+					if ((switch_size_t) (e - s - 1) >= l && !strncmp(s + 1, ent[i], l)) {
+						break;
+					}
+				}
+
+				if (ent[i]) {
+					xml_sbuf_putc(dst, *ent[i + 1]);
+					s += strlen(ent[i]) + 1;
+					continue;
+				}
+			}
+		}
+
+		if (t == ' ' && isspace((unsigned char) c)) {
+			c = ' ';
+		}
+
+		xml_sbuf_putc(dst, c);
+		s++;
+	}
+
+	dst->data[dst->len] = '\0';
+}
+
+static switch_xml_t xml_stream_open(xml_stream_t *xs, const char *name)
+{
+	switch_xml_root_t root = xs->root;
+	xml_stream_frame_t *f;
+	switch_xml_t node;
+	char **attr = SWITCH_XML_NIL;
+	uint32_t i;
+
+	if (xs->nattrs) {
+		char *m;
+
+		attr = (char **) xml_arena_alloc(root, (xs->nattrs * 2 + 2) * sizeof(char *), sizeof(void *));
+		for (i = 0; i < xs->nattrs; i++) {
+			attr[i * 2] = xs->attrs[i].name;
+			attr[i * 2 + 1] = xml_stream_str(xs, xs->val.data + xs->attrs[i].off, xs->attrs[i].len);
+		}
+
+		/* every name and value is in the arena, none of them is malloced */
+		m = (char *) xml_arena_alloc(root, xs->nattrs + 1, 1);
+		memset(m, ' ', xs->nattrs);
+		m[xs->nattrs] = '\0';
+
+		attr[xs->nattrs * 2] = NULL;
+		attr[xs->nattrs * 2 + 1] = m;
+	}
+
+	if (!xs->depth) {
+		node = &root->xml;
+		node->name = (char *) name;
+	} else {
+		switch_xml_t parent;
+
+		f = &xs->stack[xs->depth - 1];
+		parent = f->node;
+
+		node = (switch_xml_t) xml_arena_alloc(root, sizeof(struct switch_xml), sizeof(void *));
+		memset(node, 0, sizeof(*node));
+		node->name = (char *) name;
+		node->txt = (char *) "";
+		node->off = f->txt.len;
+		node->parent = parent;
+		node->flags = SWITCH_XML_ARENA;
+
+		/* children arrive in document order so they are always appended, see switch_xml_insert */
+		if (!parent->child) {
+			parent->child = node;
+			f->last_sibling = node;
+		} else {
+			f->last_child->ordered = node;
+		}
+		f->last_child = node;
+
+		for (i = 0; i < f->ntypes && f->types[i]->name != node->name; i++);
+
+		if (i < f->ntypes) {
+			f->types[i]->next = node;
+		} else {
+			if (f->last_sibling != node) {
+				f->last_sibling->sibling = node;
+				f->last_sibling = node;
+			}
+			if (f->ntypes == f->types_size) {
+				f->types_size = f->types_size ? f->types_size * 2 : 8;
+				f->types = (switch_xml_t *) switch_must_realloc(f->types, f->types_size * sizeof(switch_xml_t));
+			}
+			f->ntypes++;
+		}
+		f->types[i] = node;
+	}
+
+	node->attr = attr;
+	if (attr != SWITCH_XML_NIL) {
+		node->flags |= SWITCH_XML_ARENA_ATTR;
+	}
+
+	if (xs->depth == xs->stack_size) {
+		xs->stack = (xml_stream_frame_t *) switch_must_realloc(xs->stack, (xs->stack_size + 16) * sizeof(xml_stream_frame_t));
+		memset(xs->stack + xs->stack_size, 0, 16 * sizeof(xml_stream_frame_t));
+		xs->stack_size += 16;
+	}
+
+	f = &xs->stack[xs->depth++];
+	f->node = node;
+	f->txt.len = 0;
+	f->last_child = f->last_sibling = NULL;
+	f->ntypes = 0;
+
+	return node;
+}
+
+static void xml_stream_close(xml_stream_t *xs)
+{
+	xml_stream_frame_t *f = &xs->stack[--xs->depth];
+
+	if (f->txt.len) {
+		f->node->txt = xml_stream_str(xs, f->txt.data, f->txt.len);
+	}
+}
+
+/* reads up to and including the terminator, which is not stored, returns 0 at end of input */
+static int xml_stream_until(xml_stream_t *xs, xml_sbuf_t *b, const char *term)
+{
+	switch_size_t tl = strlen(term);
+	int c;
+
+	b->len = 0;
+
+	while ((c = xml_stream_getc(xs)) != EOF) {
+		xml_sbuf_putc(b, c);
+		if (b->len >= tl && (char) c == term[tl - 1] && !memcmp(b->data + b->len - tl, term, tl)) {
+			b->len -= tl;
+			b->data[b->len] = '\0';
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int xml_stream_tag(xml_stream_t *xs, int c)
+{
+	const char *name;
+	int q;
+
+	xs->tok.len = 0;
+	do {
+		xml_sbuf_putc(&xs->tok, c);
+	} while ((c = xml_stream_getc(xs)) != EOF && !xml_stream_ws(c) && c != '/' && c != '>');
+
+	name = xml_stream_intern(xs, xs->tok.data, xs->tok.len);
+	xs->nattrs = 0;
+	xs->val.len = 0;
+
+	for (;;) {
+		while (xml_stream_ws(c)) {
+			c = xml_stream_getc(xs);
+		}
+
+		if (c == EOF) {
+			return 0;
+		}
+
+		if (c == '/') {
+			if (xml_stream_getc(xs) != '>') {
+				return 0;
+			}
+			xml_stream_open(xs, name);
+			xml_stream_close(xs);
+			return 1;
+		}
+
+		if (c == '>') {
+			xml_stream_open(xs, name);
+			return 1;
+		}
+
+		xs->tok.len = 0;
+		do {
+			xml_sbuf_putc(&xs->tok, c);
+		} while ((c = xml_stream_getc(xs)) != EOF && !xml_stream_ws(c) && c != '=' && c != '/' && c != '>');
+
+		if (xs->nattrs == xs->attrs_size) {
+			xs->attrs_size = xs->attrs_size ? xs->attrs_size * 2 : 16;
+			xs->attrs = (xml_stream_attr_t *) switch_must_realloc(xs->attrs, xs->attrs_size * sizeof(xml_stream_attr_t));
+		}
+
+		xs->attrs[xs->nattrs].name = (char *) xml_stream_intern(xs, xs->tok.data, xs->tok.len);
+		xs->attrs[xs->nattrs].off = xs->val.len;
+		xs->attrs[xs->nattrs].len = 0;
+
+		if (c == '=' || xml_stream_ws(c)) {
+			while (c == '=' || xml_stream_ws(c)) {
+				c = xml_stream_getc(xs);
+			}
+
+			if (c != '"' && c != '\'') {
+				/* unquoted values are left to the classic parser */
+				return 0;
+			}
+
+			q = c;
+			xs->tok.len = 0;
+			while ((c = xml_stream_getc(xs)) != EOF && c != q) {
+				xml_sbuf_putc(&xs->tok, c);
+			}
+
+			if (c == EOF) {
+				return 0;
+			}
+
+			xml_stream_decode(&xs->val, xs->tok.data, xs->tok.len, ' ');
+			xs->attrs[xs->nattrs].len = xs->val.len - xs->attrs[xs->nattrs].off;
+			c = xml_stream_getc(xs);
+		}
+
+		xs->nattrs++;
+	}
+}
+
+static switch_xml_t xml_stream_parse(xml_stream_t *xs)
+{
+	xml_stream_frame_t *f;
+	int c, done = 0;
+
+	c = xml_stream_getc(xs);
+
+	/* byte order marks mean UTF-16 */
+	if (c == 0xFE || c == 0xFF) {
+		return NULL;
+	}
+
+	while (c != EOF && c != '<') {
+		c = xml_stream_getc(xs);
+	}
+
+	while (c == '<') {
+		c = xml_stream_getc(xs);
+
+		if (c == '!') {
+			c = xml_stream_getc(xs);
+
+			if (c == '-') {
+				if (xml_stream_getc(xs) != '-' || !xml_stream_until(xs, &xs->tok, "--") || xml_stream_getc(xs) != '>') {
+					return NULL;
+				}
+			} else {
+				const char *cdata = "CDATA[";
+
+				/* anything but cdata inside the root element, a DOCTYPE for one, is left to the classic parser */
+				if (c != '[' || !xs->depth) {
+					return NULL;
+				}
+
+				for (; *cdata && xml_stream_getc(xs) == *cdata; cdata++);
+
+				if (*cdata || !xml_stream_until(xs, &xs->tok, "]]>")) {
+					return NULL;
+				}
+
+				f = &xs->stack[xs->depth - 1];
+				f->node->flags |= SWITCH_XML_CDATA;
+				xml_stream_decode(&f->txt, xs->tok.data, xs->tok.len, 'c');
+			}
+		} else if (c == '?') {
+			if (!xml_stream_until(xs, &xs->tok, "?>") || strncmp(xs->tok.data, "xml", 3) ||
+				(xs->tok.len > 3 && !xml_stream_ws(xs->tok.data[3]))) {
+				return NULL;
+			}
+		} else if (c == '/') {
+			xs->tok.len = 0;
+			while ((c = xml_stream_getc(xs)) != EOF && !xml_stream_ws(c) && c != '>') {
+				xml_sbuf_putc(&xs->tok, c);
+			}
+			while (xml_stream_ws(c)) {
+				c = xml_stream_getc(xs);
+			}
+
+			if (c != '>' || !xs->depth) {
+				return NULL;
+			}
+
+			f = &xs->stack[xs->depth - 1];
+			if (strlen(f->node->name) != xs->tok.len || strncmp(f->node->name, xs->tok.data, xs->tok.len)) {
+				return NULL;
+			}
+
+			xml_stream_close(xs);
+			if (!xs->depth) {
+				done = 1;
+			}
+		} else if (c != EOF && (isalpha(c) || c == '_' || c == ':' || c >= 0x80)) {
+			if (done || !xml_stream_tag(xs, c)) {
+				return NULL;
+			}
+			if (!xs->depth) {
+				done = 1;
+			}
+		} else {
+			return NULL;
+		}
+
+		/* character content up to the next tag */
+		xs->tok.len = 0;
+		while ((c = xml_stream_getc(xs)) != EOF && c != '<') {
+			if (xs->depth) {
+				xml_sbuf_putc(&xs->tok, c);
+			}
+		}
+
+		if (c == '<' && xs->tok.len) {
+			xml_stream_decode(&xs->stack[xs->depth - 1].txt, xs->tok.data, xs->tok.len, '&');
+		}
+	}
+
+	return done ? &xs->root->xml : NULL;
+}
+
+SWITCH_DECLARE(switch_xml_t) switch_xml_parse_fd_stream(int fd)
+{
+	xml_stream_t xs = { 0 };
+	switch_xml_t xml;
+	uint32_t i;
+
+	if (fd < 0) {
+		return NULL;
+	}
+
+	xs.fd = fd;
+	xs.buf = (char *) switch_must_malloc(XML_STREAM_CHUNK);
+	xs.root = (switch_xml_root_t) switch_xml_new(NULL);
+
+	if (!(xml = xml_stream_parse(&xs))) {
+		switch_xml_free(&xs.root->xml);
+	}
+
+	for (i = 0; i < xs.stack_size; i++) {
+		switch_safe_free(xs.stack[i].txt.data);
+		switch_safe_free(xs.stack[i].types);
+	}
+	switch_safe_free(xs.stack);
+	switch_safe_free(xs.attrs);
+	switch_safe_free(xs.intern);
+	switch_safe_free(xs.tok.data);
+	switch_safe_free(xs.val.data);
+	free(xs.buf);
+
+	return xml;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_xml_arena_size(switch_xml_t xml)
+{
+	while (xml && xml->parent) {
+		xml = xml->parent;
+	}
+
+	return xml ? ((switch_xml_root_t) xml)->arena_bytes : 0;
+}
+
 static char *expand_vars(char *buf, char *ebuf, switch_size_t elen, switch_size_t *newlen, const char **err)
 {
 	char *var, *val;
@@ -1654,6 +2295,8 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 	char *new_file = NULL;
 	char *new_file_tmp = NULL;
 	const char *abs, *absw;
+	switch_time_t started = switch_micro_time_now(), parsed = 0;
+	const char *how = "stream";
 
 	abs = strrchr(file, '/');
 	absw = strrchr(file, '\\');
@@ -1688,7 +2331,27 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 			goto done;
 		}
 		if ((fd = open(new_file, O_RDONLY, 0)) > -1) {
-			if ((xml = switch_xml_parse_fd(fd))) {
+			parsed = switch_micro_time_now();
+
+			if (!STREAM_PARSE || !(xml = switch_xml_parse_fd_stream(fd))) {
+				how = "classic";
+				if (lseek(fd, 0, SEEK_SET) == 0) {
+					xml = switch_xml_parse_fd(fd);
+				}
+			}
+
+			if (xml) {
+				struct stat st = { 0 };
+				switch_time_t now = switch_micro_time_now();
+
+				fstat(fd, &st);
+				switch_log_printf(SWITCH_CHANNEL_LOG, strcmp(abs, SWITCH_GLOBAL_filenames.conf_name) ? SWITCH_LOG_DEBUG : SWITCH_LOG_INFO,
+								  "%s: preprocess %ldms, %s parse of %ld bytes %ldms, %ld bytes in the arena\n", abs,
+								  (long) ((parsed - started) / 1000), how, (long) st.st_size, (long) ((now - parsed) / 1000),
+								  (long) switch_xml_arena_size(xml));
+			}
+
+			if (xml) {
 				if (strcmp(abs, SWITCH_GLOBAL_filenames.conf_name)) {
 					xml->free_path = new_file;
 					new_file = NULL;
@@ -1718,17 +2381,16 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 	return xml;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
-												  const char *tag_name,
-												  const char *key_name,
-												  const char *key_value,
-												  switch_xml_t *root, switch_xml_t *node, switch_event_t *params, switch_bool_t clone)
+/* authoritative is cleared when a binding failed or declined to answer and the static root was used in its place */
+static switch_status_t xml_locate(const char *section, const char *tag_name, const char *key_name, const char *key_value,
+								  switch_xml_t *root, switch_xml_t *node, switch_event_t *params, switch_bool_t clone, switch_bool_t *authoritative)
 {
 	switch_xml_t conf = NULL;
 	switch_xml_t tag = NULL;
 	switch_xml_t xml = NULL;
 	switch_xml_binding_t *binding;
 	uint8_t loops = 0;
+	switch_bool_t fell_back = SWITCH_FALSE;
 	switch_xml_section_t sections = BINDINGS ? switch_xml_parse_section_string(section) : 0;
 
 	switch_thread_rwlock_rdlock(B_RWLOCK);
@@ -1761,11 +2423,18 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error[%s]\n", err);
 				switch_xml_free(xml);
 				xml = NULL;
+				fell_back = SWITCH_TRUE;
 			}
+		} else {
+			fell_back = SWITCH_TRUE;
 		}
 	}
 	switch_thread_rwlock_unlock(B_RWLOCK);
 
+	if (authoritative) {
+		*authoritative = (xml || !fell_back) ? SWITCH_TRUE : SWITCH_FALSE;
+	}
+
 	for (;;) {
 		if (!xml) {
 			if (!(xml = switch_xml_root())) {
@@ -1800,7 +2469,17 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
 	return SWITCH_STATUS_FALSE;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_xml_locate_domain(const char *domain_name, switch_event_t *params, switch_xml_t *root, switch_xml_t *domain)
+SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
+												  const char *tag_name,
+												  const char *key_name,
+												  const char *key_value,
+												  switch_xml_t *root, switch_xml_t *node, switch_event_t *params, switch_bool_t clone)
+{
+	return xml_locate(section, tag_name, key_name, key_value, root, node, params, clone, NULL);
+}
+
+static switch_status_t xml_locate_domain(const char *domain_name, switch_event_t *params, switch_xml_t *root, switch_xml_t *domain,
+										 switch_bool_t *authoritative)
 {
 	switch_event_t *my_params = NULL;
 	switch_status_t status;
@@ -1813,13 +2492,18 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_domain(const char *domain_name
 		params = my_params;
 	}
 
-	status = switch_xml_locate("directory", "domain", "name", domain_name, root, domain, params, SWITCH_FALSE);
+	status = xml_locate("directory", "domain", "name", domain_name, root, domain, params, SWITCH_FALSE, authoritative);
 	if (my_params) {
 		switch_event_destroy(&my_params);
 	}
 	return status;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_xml_locate_domain(const char *domain_name, switch_event_t *params, switch_xml_t *root, switch_xml_t *domain)
+{
+	return xml_locate_domain(domain_name, params, root, domain, NULL);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_xml_locate_group(const char *group_name,
 														const char *domain_name,
 														switch_xml_t *root, switch_xml_t *domain, switch_xml_t *group, switch_event_t *params)
@@ -1989,124 +2673,420 @@ SWITCH_DECLARE(void) switch_xml_merge_user(switch_xml_t user, switch_xml_t domai
 	}
 }
 
-SWITCH_DECLARE(uint32_t) switch_xml_clear_user_cache(const char *key, const char *user_name, const char *domain_name)
+/* The user cache is split into shards by key hash, each with its own rwlock, so concurrent lookups
+   for different users do not serialize.  Cached users are shared: a hit takes a reference on the
+   cached tree (switch_xml_free drops it), so entries must never be modified by the caller. */
+
+#define XML_USER_CACHE_SHARDS 16
+#define XML_USER_CACHE_KEY_LEN 1024
+
+static switch_status_t xml_locate_user(const char *key, const char *user_name, const char *domain_name, const char *ip, switch_xml_t *root,
+									   switch_xml_t *domain, switch_xml_t *user, switch_xml_t *ingroup, switch_event_t *params,
+									   switch_bool_t *authoritative);
+
+typedef struct xml_user_cache_entry_s {
+	/* NULL for a cached miss */
+	switch_xml_t user;
+	switch_time_t expires;
+	switch_time_t refresh;
+	volatile switch_atomic_t refreshing;
+	char *mega_key;
+	char *domain;
+	struct xml_user_cache_entry_s *next;
+} xml_user_cache_entry_t;
+
+typedef struct {
+	switch_thread_rwlock_t *rwlock;
+	switch_hash_t *hash;
+	uint32_t entries;
+	uint32_t negative_entries;
+	volatile switch_atomic_t hits;
+	volatile switch_atomic_t negative_hits;
+	volatile switch_atomic_t misses;
+	volatile switch_atomic_t expired;
+	volatile switch_atomic_t refreshes;
+} xml_user_cache_shard_t;
+
+static struct {
+	xml_user_cache_shard_t shards[XML_USER_CACHE_SHARDS];
+	uint32_t negative_ms;
+	uint32_t refresh_ahead;
+	volatile switch_atomic_t invalidated;
+	volatile switch_atomic_t jobs;
+	int running;
+} USER_CACHE;
+
+static xml_user_cache_shard_t *user_cache_shard(const char *mega_key)
+{
+	switch_ssize_t klen = (switch_ssize_t) strlen(mega_key);
+
+	return &USER_CACHE.shards[switch_hashfunc_default(mega_key, &klen) % XML_USER_CACHE_SHARDS];
+}
+
+static void user_cache_entry_free(xml_user_cache_entry_t *entry)
+{
+	if (entry->user) {
+		switch_xml_free(entry->user);
+	}
+	free(entry);
+}
+
+/* must be called with the shard write locked */
+static void user_cache_remove(xml_user_cache_shard_t *shard, xml_user_cache_entry_t *entry)
+{
+	switch_core_hash_delete(shard->hash, entry->mega_key);
+
+	if (entry->user) {
+		shard->entries--;
+	} else {
+		shard->negative_entries--;
+	}
+
+	user_cache_entry_free(entry);
+}
+
+static uint32_t user_cache_clear_shard(xml_user_cache_shard_t *shard, const char *domain_name)
 {
-	switch_hash_index_t *hi = NULL;
+	switch_hash_index_t *hi;
+	xml_user_cache_entry_t *entry, *kill = NULL;
 	void *val;
-	const void *var;
-	char mega_key[1024];
-	int r = 0;
-	switch_xml_t lookup;
-	char *expires_val = NULL;
+	uint32_t r = 0;
+
+	switch_thread_rwlock_wrlock(shard->rwlock);
+
+	for (hi = switch_core_hash_first(shard->hash); hi; hi = switch_core_hash_next(&hi)) {
+		switch_core_hash_this(hi, NULL, NULL, &val);
+		entry = (xml_user_cache_entry_t *) val;
+
+		if (!domain_name || !strcasecmp(entry->domain, domain_name)) {
+			entry->next = kill;
+			kill = entry;
+		}
+	}
+
+	while ((entry = kill)) {
+		kill = entry->next;
+		if (entry->user) {
+			r++;
+		}
+		user_cache_remove(shard, entry);
+	}
+
+	switch_thread_rwlock_unlock(shard->rwlock);
 
-	switch_mutex_lock(CACHE_MUTEX);
+	return r;
+}
+
+SWITCH_DECLARE(uint32_t) switch_xml_clear_user_cache(const char *key, const char *user_name, const char *domain_name)
+{
+	uint32_t r = 0;
+	int i;
 
 	if (key && user_name && domain_name) {
+		char mega_key[XML_USER_CACHE_KEY_LEN];
+		xml_user_cache_shard_t *shard;
+		xml_user_cache_entry_t *entry;
+
 		switch_snprintf(mega_key, sizeof(mega_key), "%s%s%s", key, user_name, domain_name);
+		shard = user_cache_shard(mega_key);
 
-		if ((lookup = switch_core_hash_find(CACHE_HASH, mega_key))) {
-			switch_core_hash_delete(CACHE_HASH, mega_key);
-			if ((expires_val = switch_core_hash_find(CACHE_EXPIRES_HASH, mega_key))) {
-				switch_core_hash_delete(CACHE_EXPIRES_HASH, mega_key);
-				free(expires_val);
-				expires_val = NULL;
+		switch_thread_rwlock_wrlock(shard->rwlock);
+		if ((entry = switch_core_hash_find(shard->hash, mega_key))) {
+			if (entry->user) {
+				r++;
 			}
-			switch_xml_free(lookup);
-			r++;
+			user_cache_remove(shard, entry);
 		}
-
+		switch_thread_rwlock_unlock(shard->rwlock);
 	} else {
-
-		while ((hi = switch_core_hash_first_iter( CACHE_HASH, hi))) {
-			switch_core_hash_this(hi, &var, NULL, &val);
-			switch_xml_free(val);
-			switch_core_hash_delete(CACHE_HASH, var);
-			r++;
+		for (i = 0; i < XML_USER_CACHE_SHARDS; i++) {
+			r += user_cache_clear_shard(&USER_CACHE.shards[i], key || user_name ? NULL : domain_name);
 		}
+	}
 
-		while ((hi = switch_core_hash_first_iter( CACHE_EXPIRES_HASH, hi))) {
-			switch_core_hash_this(hi, &var, NULL, &val);
-			switch_safe_free(val);
-			switch_core_hash_delete(CACHE_EXPIRES_HASH, var);
-		}
+	switch_atomic_add(&USER_CACHE.invalidated, r);
+
+	return r;
+}
+
+SWITCH_DECLARE(void) switch_xml_set_stream_parse(switch_bool_t on)
+{
+	STREAM_PARSE = on ? 1 : 0;
+}
 
-		switch_safe_free(hi);
+SWITCH_DECLARE(void) switch_xml_set_user_cache_negative_ms(uint32_t ms)
+{
+	USER_CACHE.negative_ms = ms;
+}
+
+SWITCH_DECLARE(void) switch_xml_set_user_cache_refresh_ahead(uint32_t percent)
+{
+	USER_CACHE.refresh_ahead = percent > 90 ? 90 : percent;
+}
+
+SWITCH_DECLARE(void) switch_xml_user_cache_stats(switch_xml_user_cache_stats_t *stats)
+{
+	int i;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->shards = XML_USER_CACHE_SHARDS;
+	stats->negative_ms = USER_CACHE.negative_ms;
+	stats->refresh_ahead = USER_CACHE.refresh_ahead;
+
+	for (i = 0; i < XML_USER_CACHE_SHARDS; i++) {
+		xml_user_cache_shard_t *shard = &USER_CACHE.shards[i];
+
+		switch_thread_rwlock_rdlock(shard->rwlock);
+		stats->entries += shard->entries;
+		stats->negative_entries += shard->negative_entries;
+		switch_thread_rwlock_unlock(shard->rwlock);
+
+		stats->hits += switch_atomic_read(&shard->hits);
+		stats->negative_hits += switch_atomic_read(&shard->negative_hits);
+		stats->misses += switch_atomic_read(&shard->misses);
+		stats->expired += switch_atomic_read(&shard->expired);
+		stats->refreshes += switch_atomic_read(&shard->refreshes);
 	}
 
-	switch_mutex_unlock(CACHE_MUTEX);
+	stats->invalidated = switch_atomic_read(&USER_CACHE.invalidated);
+}
 
-	return r;
+/* takes a reference on the cached tree for the caller, see switch_xml_free */
+static switch_xml_t user_cache_ref(switch_xml_t user)
+{
+	switch_mutex_lock(REFLOCK);
+	user->refs++;
+	switch_mutex_unlock(REFLOCK);
 
+	return user;
 }
 
-static switch_status_t switch_xml_locate_user_cache(const char *key, const char *user_name, const char *domain_name, switch_xml_t *user)
+/* must be called with the shard write locked, takes over the caller's reference on user */
+static void user_cache_insert(xml_user_cache_shard_t *shard, const char *mega_key, const char *domain_name, switch_xml_t user,
+							  switch_time_t expires, switch_time_t refresh)
 {
-	char mega_key[1024];
-	switch_status_t status = SWITCH_STATUS_FALSE;
-	switch_xml_t lookup;
+	xml_user_cache_entry_t *entry;
+	switch_size_t klen = strlen(mega_key) + 1, dlen = strlen(domain_name) + 1;
+
+	if ((entry = switch_core_hash_find(shard->hash, mega_key))) {
+		user_cache_remove(shard, entry);
+	}
+
+	switch_zmalloc(entry, sizeof(*entry) + klen + dlen);
+	entry->mega_key = (char *) (entry + 1);
+	entry->domain = entry->mega_key + klen;
+	memcpy(entry->mega_key, mega_key, klen);
+	memcpy(entry->domain, domain_name, dlen);
+	entry->user = user;
+	entry->expires = expires;
+	entry->refresh = refresh;
+
+	if (user) {
+		shard->entries++;
+	} else {
+		shard->negative_entries++;
+	}
+
+	switch_core_hash_insert(shard->hash, entry->mega_key, entry);
+}
+
+static switch_time_t user_cache_expires(switch_xml_t user, const char *user_name, const char *domain_name, switch_time_t *refresh)
+{
+	const char *cacheable = switch_xml_attr(user, "cacheable");
+	switch_time_t expires = 0;
+
+	*refresh = 0;
+
+	if (switch_is_number(cacheable)) {
+		int cache_ms = atol(cacheable);
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "caching lookup for user %s@%s for %d milliseconds\n",
+						  user_name, domain_name, cache_ms);
+		expires = switch_micro_time_now() + (cache_ms * 1000);
+
+		if (USER_CACHE.refresh_ahead) {
+			*refresh = expires - ((switch_time_t) cache_ms * 10 * USER_CACHE.refresh_ahead);
+		}
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "caching lookup for user %s@%s indefinitely\n", user_name, domain_name);
+	}
+
+	return expires;
+}
+
+/* a lookup through the bindings, merged with the domain and group, and cached when the user is cacheable */
+static switch_status_t user_cache_fetch(const char *key, const char *user_name, const char *domain_name, const char *ip,
+										switch_event_t *params, switch_xml_t *user, switch_bool_t refreshing)
+{
+	switch_xml_t xml, domain, group, x_user, x_user_dup;
+	switch_status_t status;
+	switch_bool_t authoritative = SWITCH_FALSE;
+	char mega_key[XML_USER_CACHE_KEY_LEN];
+	xml_user_cache_shard_t *shard;
+
+	*user = NULL;
 
 	switch_snprintf(mega_key, sizeof(mega_key), "%s%s%s", key, user_name, domain_name);
+	shard = user_cache_shard(mega_key);
+
+	if ((status = xml_locate_user(key, user_name, domain_name, ip, &xml, &domain, &x_user, &group, params, &authoritative)) == SWITCH_STATUS_SUCCESS) {
+		x_user_dup = switch_xml_dup(x_user);
+		switch_xml_merge_user(x_user_dup, domain, group);
+		switch_xml_free(xml);
 
-	switch_mutex_lock(CACHE_MUTEX);
-	if ((lookup = switch_core_hash_find(CACHE_HASH, mega_key))) {
-		char *expires_lookup = NULL;
+		if (!zstr(switch_xml_attr(x_user_dup, "cacheable")) && domain_name && USER_CACHE.running) {
+			switch_time_t refresh, expires = user_cache_expires(x_user_dup, user_name, domain_name, &refresh);
 
-		if ((expires_lookup = switch_core_hash_find(CACHE_EXPIRES_HASH, mega_key))) {
-			switch_time_t time_expires = 0;
-			switch_time_t time_now = 0;
+			/* one reference for the cache and one for the caller */
+			switch_set_flag(x_user_dup, SWITCH_XML_ROOT);
+			x_user_dup->refs = 2;
 
-			time_now = switch_micro_time_now();
-			time_expires = atol(expires_lookup);
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Cache Info\nTime Now:\t%ld\nExpires:\t%ld\n", (long)time_now, (long)time_expires);
-			if (time_expires < time_now) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Cache expired for %s@%s, doing fresh lookup\n", user_name, domain_name);
-			} else {
-				*user = switch_xml_dup(lookup);
-				status = SWITCH_STATUS_SUCCESS;
+			switch_thread_rwlock_wrlock(shard->rwlock);
+			user_cache_insert(shard, mega_key, domain_name, x_user_dup, expires, refresh);
+			switch_thread_rwlock_unlock(shard->rwlock);
+		} else if (USER_CACHE.running) {
+			/* a cached copy that is no longer cacheable must not outlive this lookup */
+			xml_user_cache_entry_t *entry;
+
+			switch_thread_rwlock_wrlock(shard->rwlock);
+			if ((entry = switch_core_hash_find(shard->hash, mega_key))) {
+				user_cache_remove(shard, entry);
 			}
-		} else {
-			*user = switch_xml_dup(lookup);
-			status = SWITCH_STATUS_SUCCESS;
+			switch_thread_rwlock_unlock(shard->rwlock);
 		}
+
+		*user = x_user_dup;
+	} else if (status == SWITCH_STATUS_FALSE && authoritative && !refreshing && USER_CACHE.negative_ms && domain_name && USER_CACHE.running) {
+		/* the directory answered and the user is not in it, a failed binding is never cached,
+		   and a background refresh never replaces a cached user with a miss */
+		switch_thread_rwlock_wrlock(shard->rwlock);
+		user_cache_insert(shard, mega_key, domain_name, NULL, switch_micro_time_now() + (USER_CACHE.negative_ms * 1000), 0);
+		switch_thread_rwlock_unlock(shard->rwlock);
 	}
-	switch_mutex_unlock(CACHE_MUTEX);
 
 	return status;
 }
 
-static void switch_xml_user_cache(const char *key, const char *user_name, const char *domain_name, switch_xml_t user, switch_time_t expires)
-{
-	char mega_key[1024];
-	switch_xml_t lookup;
-	char *expires_lookup;
+struct user_cache_job {
+	char *key;
+	char *user_name;
+	char *domain_name;
+	char *ip;
+	char *mega_key;
+	switch_event_t *params;
+	switch_memory_pool_t *pool;
+};
 
-	switch_snprintf(mega_key, sizeof(mega_key), "%s%s%s", key, user_name, domain_name);
+static void *SWITCH_THREAD_FUNC user_cache_refresh_thread(switch_thread_t *thread, void *obj)
+{
+	struct user_cache_job *job = (struct user_cache_job *) obj;
+	switch_xml_t user = NULL;
+
+	if (USER_CACHE.running &&
+		user_cache_fetch(job->key, job->user_name, job->domain_name, job->ip, job->params, &user, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS) {
+		switch_xml_free(user);
+	} else if (USER_CACHE.running) {
+		/* keep serving the cached copy until it expires and let the next hit try again */
+		xml_user_cache_shard_t *shard = user_cache_shard(job->mega_key);
+		xml_user_cache_entry_t *entry;
+
+		switch_thread_rwlock_rdlock(shard->rwlock);
+		if ((entry = switch_core_hash_find(shard->hash, job->mega_key))) {
+			switch_atomic_set(&entry->refreshing, 0);
+		}
+		switch_thread_rwlock_unlock(shard->rwlock);
+	}
 
-	switch_mutex_lock(CACHE_MUTEX);
-	if ((lookup = switch_core_hash_find(CACHE_HASH, mega_key))) {
-		switch_core_hash_delete(CACHE_HASH, mega_key);
-		switch_xml_free(lookup);
+	if (job->params) {
+		switch_event_destroy(&job->params);
 	}
-	if ((expires_lookup = switch_core_hash_find(CACHE_EXPIRES_HASH, mega_key))) {
-		switch_core_hash_delete(CACHE_EXPIRES_HASH, mega_key);
-		switch_safe_free(expires_lookup);
+
+	switch_atomic_dec(&USER_CACHE.jobs);
+
+	return NULL;
+}
+
+static void user_cache_refresh(const char *key, const char *user_name, const char *domain_name, const char *ip,
+							   const char *mega_key, switch_event_t *params)
+{
+	switch_memory_pool_t *pool;
+	switch_thread_data_t *td;
+	struct user_cache_job *job;
+
+	switch_core_new_memory_pool(&pool);
+
+	td = switch_core_alloc(pool, sizeof(*td));
+	job = switch_core_alloc(pool, sizeof(*job));
+
+	job->key = switch_core_strdup(pool, key);
+	job->user_name = switch_core_strdup(pool, user_name);
+	job->domain_name = switch_core_strdup(pool, domain_name);
+	job->ip = ip ? switch_core_strdup(pool, ip) : NULL;
+	job->mega_key = switch_core_strdup(pool, mega_key);
+	job->pool = pool;
+
+	if (params) {
+		switch_event_dup(&job->params, params);
 	}
-	if (expires) {
-		char *expires_val = switch_must_malloc(1024);
-		if (sprintf(expires_val, "%ld", (long)expires)) {
-			switch_core_hash_insert(CACHE_EXPIRES_HASH, mega_key, expires_val);
+
+	td->func = user_cache_refresh_thread;
+	td->obj = job;
+	td->pool = pool;
+
+	switch_atomic_inc(&USER_CACHE.jobs);
+	switch_thread_pool_launch_thread(&td);
+}
+
+static switch_status_t switch_xml_locate_user_cache(const char *key, const char *user_name, const char *domain_name, const char *ip,
+													switch_event_t *params, switch_xml_t *user)
+{
+	char mega_key[XML_USER_CACHE_KEY_LEN];
+	switch_status_t status = SWITCH_STATUS_NOTFOUND;
+	xml_user_cache_shard_t *shard;
+	xml_user_cache_entry_t *entry;
+	int refresh = 0;
+
+	switch_snprintf(mega_key, sizeof(mega_key), "%s%s%s", key, user_name, domain_name);
+	shard = user_cache_shard(mega_key);
+
+	switch_thread_rwlock_rdlock(shard->rwlock);
+	if ((entry = switch_core_hash_find(shard->hash, mega_key))) {
+		switch_time_t now = switch_micro_time_now();
+
+		if (entry->expires && entry->expires < now) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Cache expired for %s@%s, doing fresh lookup\n", user_name, domain_name);
+			switch_atomic_inc(&shard->expired);
+		} else if (entry->user) {
+			*user = user_cache_ref(entry->user);
+			status = SWITCH_STATUS_SUCCESS;
+			switch_atomic_inc(&shard->hits);
+
+			if (entry->refresh && entry->refresh < now && switch_atomic_cas(&entry->refreshing, 1, 0) == 0) {
+				refresh = 1;
+			}
 		} else {
-			switch_safe_free(expires_val);
+			status = SWITCH_STATUS_FALSE;
+			switch_atomic_inc(&shard->negative_hits);
 		}
 	}
-	switch_core_hash_insert(CACHE_HASH, mega_key, switch_xml_dup(user));
-	switch_mutex_unlock(CACHE_MUTEX);
+	switch_thread_rwlock_unlock(shard->rwlock);
+
+	if (status == SWITCH_STATUS_NOTFOUND) {
+		switch_atomic_inc(&shard->misses);
+	}
+
+	if (refresh) {
+		switch_atomic_inc(&shard->refreshes);
+		user_cache_refresh(key, user_name, domain_name, ip, mega_key, params);
+	}
+
+	return status;
 }
 
 SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_merged(const char *key, const char *user_name, const char *domain_name,
 															  const char *ip, switch_xml_t *user, switch_event_t *params)
 {
-	switch_xml_t xml, domain, group, x_user, x_user_dup;
+	switch_xml_t x_user;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	char *kdup = NULL;
 	char *keys[10] = {0};
@@ -2121,33 +3101,14 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_merged(const char *key, c
 	}
 
 	for(i = 0; i < nkeys; i++) {
-		if ((status = switch_xml_locate_user_cache(keys[i], user_name, domain_name, &x_user)) == SWITCH_STATUS_SUCCESS) {
+		if ((status = switch_xml_locate_user_cache(keys[i], user_name, domain_name, ip, params, &x_user)) == SWITCH_STATUS_SUCCESS) {
 			*user = x_user;
 			break;
-		} else if ((status = switch_xml_locate_user(keys[i], user_name, domain_name, ip, &xml, &domain, &x_user, &group, params)) == SWITCH_STATUS_SUCCESS) {
-			const char *cacheable = NULL;
-
-			x_user_dup = switch_xml_dup(x_user);
-			switch_xml_merge_user(x_user_dup, domain, group);
-
-			cacheable = switch_xml_attr(x_user_dup, "cacheable");
-			if (!zstr(cacheable)) {
-				switch_time_t expires = 0;
-				switch_time_t time_now = 0;
-
-				if (switch_is_number(cacheable)) {
-					int cache_ms = atol(cacheable);
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "caching lookup for user %s@%s for %d milliseconds\n",
-									  user_name, domain_name, cache_ms);
-					time_now = switch_micro_time_now();
-					expires = time_now + (cache_ms * 1000);
-				} else {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "caching lookup for user %s@%s indefinitely\n", user_name, domain_name);
-				}
-				switch_xml_user_cache(keys[i], user_name, domain_name, x_user_dup, expires);
-			}
-			*user = x_user_dup;
-			switch_xml_free(xml);
+		} else if (status == SWITCH_STATUS_FALSE) {
+			/* a cached miss */
+			continue;
+		} else if ((status = user_cache_fetch(keys[i], user_name, domain_name, ip, params, &x_user, SWITCH_FALSE)) == SWITCH_STATUS_SUCCESS) {
+			*user = x_user;
 			break;
 		}
 	}
@@ -2158,12 +3119,10 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_merged(const char *key, c
 
 }
 
-SWITCH_DECLARE(switch_status_t) switch_xml_locate_user(const char *key,
-													   const char *user_name,
-													   const char *domain_name,
-													   const char *ip,
-													   switch_xml_t *root,
-													   switch_xml_t *domain, switch_xml_t *user, switch_xml_t *ingroup, switch_event_t *params)
+/* authoritative is set when a miss came from an answer rather than a failed binding */
+static switch_status_t xml_locate_user(const char *key, const char *user_name, const char *domain_name, const char *ip, switch_xml_t *root,
+									   switch_xml_t *domain, switch_xml_t *user, switch_xml_t *ingroup, switch_event_t *params,
+									   switch_bool_t *authoritative)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	switch_event_t *my_params = NULL;
@@ -2197,7 +3156,7 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user(const char *key,
 		switch_event_add_header_string(params, SWITCH_STACK_BOTTOM, "ip", ip);
 	}
 
-	if ((status = switch_xml_locate_domain(domain_name, params, root, domain)) != SWITCH_STATUS_SUCCESS) {
+	if ((status = xml_locate_domain(domain_name, params, root, domain, authoritative)) != SWITCH_STATUS_SUCCESS) {
 		goto end;
 	}
 
@@ -2239,6 +3198,16 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user(const char *key,
 	return status;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_xml_locate_user(const char *key,
+													   const char *user_name,
+													   const char *domain_name,
+													   const char *ip,
+													   switch_xml_t *root,
+													   switch_xml_t *domain, switch_xml_t *user, switch_xml_t *ingroup, switch_event_t *params)
+{
+	return xml_locate_user(key, user_name, domain_name, ip, root, domain, user, ingroup, params, NULL);
+}
+
 SWITCH_DECLARE(switch_xml_t) switch_xml_root(void)
 {
 	switch_xml_t xml;
@@ -2409,15 +3378,20 @@ SWITCH_DECLARE(switch_status_t) switch_xml_reload(const char **err)
 SWITCH_DECLARE(switch_status_t) switch_xml_init(switch_memory_pool_t *pool, const char **err)
 {
 	switch_xml_t xml;
+	int i;
 	XML_MEMORY_POOL = pool;
 	*err = "Success";
 
-	switch_mutex_init(&CACHE_MUTEX, SWITCH_MUTEX_NESTED, XML_MEMORY_POOL);
 	switch_mutex_init(&XML_LOCK, SWITCH_MUTEX_NESTED, XML_MEMORY_POOL);
 	switch_mutex_init(&REFLOCK, SWITCH_MUTEX_NESTED, XML_MEMORY_POOL);
 	switch_mutex_init(&FILE_LOCK, SWITCH_MUTEX_NESTED, XML_MEMORY_POOL);
-	switch_core_hash_init(&CACHE_HASH);
-	switch_core_hash_init(&CACHE_EXPIRES_HASH);
+
+	for (i = 0; i < XML_USER_CACHE_SHARDS; i++) {
+		switch_thread_rwlock_create(&USER_CACHE.shards[i].rwlock, XML_MEMORY_POOL);
+		switch_core_hash_init(&USER_CACHE.shards[i].hash);
+	}
+	USER_CACHE.refresh_ahead = 20;
+	USER_CACHE.running = 1;
 
 	switch_thread_rwlock_create(&B_RWLOCK, XML_MEMORY_POOL);
 
@@ -2434,6 +3408,7 @@ SWITCH_DECLARE(switch_status_t) switch_xml_init(switch_memory_pool_t *pool, cons
 SWITCH_DECLARE(switch_status_t) switch_xml_destroy(void)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
+	int i;
 
 
 	switch_mutex_lock(XML_LOCK);
@@ -2449,10 +3424,17 @@ SWITCH_DECLARE(switch_status_t) switch_xml_destroy(void)
 	switch_mutex_unlock(XML_LOCK);
 	switch_mutex_unlock(REFLOCK);
 
+	USER_CACHE.running = 0;
+
+	for (i = 0; i < 500 && switch_atomic_read(&USER_CACHE.jobs); i++) {
+		switch_yield(10000);
+	}
+
 	switch_xml_clear_user_cache(NULL, NULL, NULL);
 
-	switch_core_hash_destroy(&CACHE_HASH);
-	switch_core_hash_destroy(&CACHE_EXPIRES_HASH);
+	for (i = 0; i < XML_USER_CACHE_SHARDS; i++) {
+		switch_core_hash_destroy(&USER_CACHE.shards[i].hash);
+	}
 
 	return status;
 }
@@ -2841,9 +3823,12 @@ SWITCH_DECLARE(void) switch_xml_free(switch_xml_t xml)
 			free(root->m);		/* malloced xml data */
 		if (root->u)
 			free(root->u);		/* utf8 conversion */
+		if (root->arena)
+			xml_arena_free(root);	/* streamed tree, every tag below has been walked already */
 	}
 
-	switch_xml_free_attr(xml->attr);	/* tag attributes */
+	if (!(xml->flags & SWITCH_XML_ARENA_ATTR))
+		switch_xml_free_attr(xml->attr);	/* tag attributes */
 	if ((xml->flags & SWITCH_XML_TXTM))
 		free(xml->txt);			/* character content */
 	if ((xml->flags & SWITCH_XML_NAMEM))
@@ -2851,10 +3836,12 @@ SWITCH_DECLARE(void) switch_xml_free(switch_xml_t xml)
 	if (xml->ordered) {
 		orig_xml = xml;
 		xml = xml->ordered;
-		free(orig_xml);
+		if (!(orig_xml->flags & SWITCH_XML_ARENA))
+			free(orig_xml);
 		goto tailrecurse;
 	}
-	free(xml);
+	if (!(xml->flags & SWITCH_XML_ARENA))
+		free(xml);
 }
 
 /* return parser error message or empty string if none */
@@ -2977,6 +3964,8 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_set_attr(switch_xml_t xml, const char *n
 
 	if (!xml)
 		return NULL;
+	if (xml->flags & SWITCH_XML_ARENA_ATTR)
+		xml_arena_detach_attr(xml);
 	while (xml->attr[l] && strcmp(xml->attr[l], name))
 		l += 2;
 	if (!xml->attr[l]) {		/* not found, add as new attribute */
@@ -0,0 +1,115 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_channel.c -- tests channel variable expansion
+ *
+ */
+#include <switch.h>
+#include <stdlib.h>
+
+#include <test/switch_test.h>
+
+static const char *templates[] = {
+	"plain ${ev_a} text",
+	"${ev_b}/${ev_a:1:3}/${ev_a:-2}/${ev_a:9}",
+	"$${ev_a} \\${ev_a} \\\\${ev_a} \\'q\\'",
+	"${ev_${ev_n}}-${ev_missing}-${ev_a",
+	"${strlen(${ev_a})} ${strlen ${ev_b}}",
+	NULL
+};
+
+static int check_expand(switch_channel_t *channel, const char *in)
+{
+	char *legacy = switch_channel_expand_variables_uncompiled(channel, in, NULL, NULL, 0);
+	char *compiled = switch_channel_expand_variables(channel, in);
+	int r = !strcmp(compiled, legacy);
+
+	if (legacy != in) free(legacy);
+	if (compiled != in) free(compiled);
+
+	return r;
+}
+
+FST_CORE_BEGIN("./conf")
+{
+	FST_SUITE_BEGIN(switch_channel)
+	{
+		FST_SETUP_BEGIN()
+		{
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_SESSION_BEGIN(expand_variables_compiled)
+		{
+			int i, x;
+
+			switch_channel_set_variable(fst_channel, "ev_a", "alpha");
+			switch_channel_set_variable(fst_channel, "ev_b", "${ev_a}-beta");
+			switch_channel_set_variable(fst_channel, "ev_n", "a");
+
+			/* the second pass runs from the cache */
+			for (x = 0; x < 2; x++) {
+				for (i = 0; templates[i]; i++) {
+					fst_xcheck(check_expand(fst_channel, templates[i]), templates[i]);
+				}
+			}
+
+			/* a cached program must follow the variables, not the values it first saw */
+			switch_channel_set_variable(fst_channel, "ev_a", "omega");
+			for (i = 0; templates[i]; i++) {
+				fst_xcheck(check_expand(fst_channel, templates[i]), templates[i]);
+			}
+		}
+		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(expand_variables_cache_eviction)
+		{
+			char buf[64];
+			int i, bad = 0;
+
+			switch_channel_set_variable(fst_channel, "ev_a", "alpha");
+			switch_channel_set_variable(fst_channel, "ev_b", "${ev_a}-beta");
+			switch_channel_set_variable(fst_channel, "ev_n", "a");
+
+			/* churn well past the cache size while a few strings stay hot, every expansion must stay correct */
+			for (i = 0; i < 10000; i++) {
+				switch_snprintf(buf, sizeof(buf), "one-off %d ${ev_a} ${ev_b}", i);
+				bad += !check_expand(fst_channel, buf);
+				bad += !check_expand(fst_channel, templates[i % 5]);
+			}
+
+			fst_check_int_equals(bad, 0);
+		}
+		FST_SESSION_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
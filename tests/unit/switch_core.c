@@ -82,6 +82,101 @@ FST_CORE_BEGIN("./conf")
 			switch_safe_free(var_default_password);
 		}
 		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_pool_cache)
+		{
+			switch_memory_pool_t *pool = NULL;
+			switch_memory_pool_stats_t before, after;
+			char expected[32];
+			char *str;
+			int i;
+
+			switch_core_memory_pool_cache_set(4, 16384, SWITCH_FALSE);
+			switch_core_memory_pool_stats(&before);
+
+			for (i = 0; i < 10; i++) {
+				fst_requires(switch_core_new_memory_pool(&pool) == SWITCH_STATUS_SUCCESS);
+				fst_requires(pool);
+				switch_snprintf(expected, sizeof(expected), "pool %d", i);
+				str = switch_core_strdup(pool, expected);
+				fst_check_string_equals(str, expected);
+				fst_check(switch_core_alloc(pool, 32768) != NULL);
+				switch_core_destroy_memory_pool(&pool);
+				fst_check(pool == NULL);
+			}
+
+			switch_core_memory_pool_stats(&after);
+			switch_core_memory_pool_cache_set(0, 0, SWITCH_FALSE);
+			switch_core_memory_reclaim();
+
+			fst_check(after.requests - before.requests >= 10);
+			fst_check(after.released - before.released >= 10);
+			fst_check(after.hits > before.hits);
+			fst_check(after.cached <= after.slots * 4);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_resample_cache)
+		{
+			switch_audio_resampler_t *a = NULL, *b = NULL;
+			int16_t in[160] = { 0 };
+			uint32_t idle;
+
+			switch_resample_cache_set(4);
+			idle = switch_resample_cache_idle();
+
+			fst_requires(switch_resample_create(&a, 8000, 16000, 320, SWITCH_RESAMPLE_QUALITY, 1) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_resample_process(a, in, 160) > 0);
+			switch_resample_destroy(&a);
+			fst_check(a == NULL);
+			fst_check(switch_resample_cache_idle() == idle + 1);
+
+			fst_requires(switch_resample_create(&b, 8000, 16000, 640, SWITCH_RESAMPLE_QUALITY, 1) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_resample_cache_idle() == idle);
+			fst_check(b->from_rate == 8000 && b->to_rate == 16000 && b->channels == 1);
+			fst_check(b->to_size >= 640);
+			switch_resample_destroy(&b);
+
+			switch_resample_cache_set(0);
+			fst_check(switch_resample_cache_idle() == 0);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_sample_conversion)
+		{
+			float f[37], back[37];
+			short s[37], a[37], b[37];
+			int i;
+
+			for (i = 0; i < 37; i++) {
+				f[i] = (float) (i - 18) / 16.0f;
+				a[i] = (short) (i * 1811 - 32768);
+				b[i] = (short) (32767 - i * 907);
+			}
+			f[0] = 0.25f / 32768.0f * 2.0f;
+			f[1] = -2.5f / 32768.0f;
+
+			switch_float_to_short(f, s, 37);
+			fst_check(s[0] == 1);
+			fst_check(s[1] == -3);
+			fst_check(s[18] == 0);
+			fst_check(s[19] == 2048);
+			fst_check(s[34] == 16383);
+			fst_check(s[2] == -16383);
+
+			switch_short_to_float(s, back, 37);
+			for (i = 0; i < 37; i++) {
+				fst_check(back[i] == (float) s[i] / 32768.0f);
+			}
+
+			switch_merge_sln(a, 37, b, 37, 1);
+			for (i = 0; i < 37; i++) {
+				int32_t z = (short) (i * 1811 - 32768) + (short) (32767 - i * 907);
+				switch_normalize_to_16bit(z);
+				fst_check(a[i] == z);
+			}
+		}
+		FST_TEST_END()
 	}
 	FST_SUITE_END()
 }
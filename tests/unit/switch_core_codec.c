@@ -127,6 +127,51 @@ FST_CORE_BEGIN("./conf")
 
 		}
 		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_codec_pref_cache)
+		{
+			const char *codec_string = "OPUS,G722,PCMU@20i,PCMA@20i,PCMU,OPUS@48000h@20i,PCMU@30i";
+			const switch_codec_implementation_t *sorted[SWITCH_MAX_CODECS] = { 0 };
+			const switch_codec_implementation_t *cached[SWITCH_MAX_CODECS] = { 0 };
+			char fmtp[SWITCH_MAX_CODECS][MAX_FMTP_LEN];
+			char *prefs[SWITCH_MAX_CODECS];
+			char *dup;
+			int i, x, num_sorted, num_cached, loops = 100000;
+			switch_time_t start;
+
+			dup = strdup(codec_string);
+			num_sorted = switch_separate_string(dup, ',', prefs, SWITCH_MAX_CODECS);
+			num_sorted = switch_loadable_module_get_codecs_sorted(sorted, fmtp, SWITCH_MAX_CODECS, prefs, num_sorted);
+			free(dup);
+
+			num_cached = switch_loadable_module_get_codecs_by_string(cached, fmtp, SWITCH_MAX_CODECS, codec_string);
+			fst_check(num_sorted > 0);
+			fst_check(num_cached == num_sorted);
+
+			for (i = 0; i < num_sorted && i < num_cached; i++) {
+				fst_check(cached[i] == sorted[i]);
+			}
+
+			/* a second lookup comes from the cache and must match */
+			num_cached = switch_loadable_module_get_codecs_by_string(cached, fmtp, SWITCH_MAX_CODECS, codec_string);
+			fst_check(num_cached == num_sorted);
+
+			start = switch_time_now();
+			for (x = 0; x < loops; x++) {
+				dup = strdup(codec_string);
+				i = switch_separate_string(dup, ',', prefs, SWITCH_MAX_CODECS);
+				switch_loadable_module_get_codecs_sorted(sorted, fmtp, SWITCH_MAX_CODECS, prefs, i);
+				free(dup);
+			}
+			printf("codec prefs parsed: %d loops in %" SWITCH_TIME_T_FMT "us\n", loops, switch_time_now() - start);
+
+			start = switch_time_now();
+			for (x = 0; x < loops; x++) {
+				switch_loadable_module_get_codecs_by_string(cached, fmtp, SWITCH_MAX_CODECS, codec_string);
+			}
+			printf("codec prefs cached: %d loops in %" SWITCH_TIME_T_FMT "us\n", loops, switch_time_now() - start);
+		}
+		FST_TEST_END()
 	}
 	FST_SUITE_END()
 }
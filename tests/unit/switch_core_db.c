@@ -118,6 +118,98 @@ FST_CORE_DB_BEGIN("./conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(test_switch_cache_db_queue_manager_push_row)
+		{
+			int i;
+			char id[16];
+			const char *values[2];
+			switch_sql_queue_manager_t *qm = NULL;
+
+			switch_sql_queue_manager_init_name("TEST_ROWS",
+				&qm,
+				2,
+				"test_switch_cache_db_queue_manager_push_row",
+				SWITCH_MAX_TRANS,
+				NULL, NULL, NULL, NULL);
+
+			switch_sql_queue_manager_start(qm);
+
+			switch_sql_queue_manager_push_confirm(qm, "DROP TABLE IF EXISTS r;", 0, SWITCH_TRUE);
+			switch_sql_queue_manager_push_confirm(qm, "CREATE TABLE r (id VARCHAR(16), val VARCHAR(16));", 0, SWITCH_TRUE);
+
+			/* every id is written twice, the keyed rows must leave one row per id */
+			for (i = 0; i < max_rows * 2; i++) {
+				switch_snprintf(id, sizeof(id), "%d", i % max_rows);
+				values[0] = id;
+				values[1] = i < max_rows ? "old" : NULL;
+				fst_requires(switch_sql_queue_manager_push_row(qm, 0, "r", "id,val", "id", values, 2) == SWITCH_STATUS_SUCCESS);
+			}
+
+			values[0] = "x";
+			fst_check(switch_sql_queue_manager_push_row(qm, 0, "r", "id,val", "val2", values, 2) == SWITCH_STATUS_FALSE);
+			fst_check(switch_sql_queue_manager_push_row(qm, 0, "r", "id,val", NULL, values, 1) == SWITCH_STATUS_FALSE);
+
+			while (switch_sql_queue_manager_size(qm, 0)) {
+				switch_cond_next();
+			}
+
+			switch_sql_queue_manager_push_confirm(qm, "SELECT 1;", 0, SWITCH_TRUE);
+
+			status = 0;
+			switch_sql_queue_manager_execute_sql_callback(qm, "SELECT COUNT(*) FROM r WHERE val IS NULL;", table_count_func, NULL);
+			fst_check_int_equals(status, max_rows);
+
+			status = 0;
+			switch_sql_queue_manager_execute_sql_callback(qm, "SELECT COUNT(*) FROM r;", table_count_func, NULL);
+			fst_check_int_equals(status, max_rows);
+
+			switch_sql_queue_manager_stop(qm);
+			switch_sql_queue_manager_destroy(&qm);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_switch_cache_db_queue_manager_push_row_bad_row)
+		{
+			int i;
+			char id[16];
+			const char *values[2];
+			switch_sql_queue_manager_t *qm = NULL;
+
+			switch_sql_queue_manager_init_name("TEST_BAD_ROWS",
+				&qm,
+				2,
+				"test_switch_cache_db_queue_manager_push_row_bad_row",
+				SWITCH_MAX_TRANS,
+				NULL, NULL, NULL, NULL);
+
+			switch_sql_queue_manager_start(qm);
+
+			switch_sql_queue_manager_push_confirm(qm, "DROP TABLE IF EXISTS rb;", 0, SWITCH_TRUE);
+			switch_sql_queue_manager_push_confirm(qm, "CREATE TABLE rb (id VARCHAR(16), val VARCHAR(16) NOT NULL);", 0, SWITCH_TRUE);
+
+			/* every tenth row violates the constraint, only those may be lost */
+			for (i = 0; i < max_rows; i++) {
+				switch_snprintf(id, sizeof(id), "%d", i);
+				values[0] = id;
+				values[1] = i % 10 ? "ok" : NULL;
+				fst_requires(switch_sql_queue_manager_push_row(qm, 0, "rb", "id,val", NULL, values, 2) == SWITCH_STATUS_SUCCESS);
+			}
+
+			while (switch_sql_queue_manager_size(qm, 0)) {
+				switch_cond_next();
+			}
+
+			switch_sql_queue_manager_push_confirm(qm, "SELECT 1;", 0, SWITCH_TRUE);
+
+			status = 0;
+			switch_sql_queue_manager_execute_sql_callback(qm, "SELECT COUNT(*) FROM rb;", table_count_func, NULL);
+			fst_check_int_equals(status, max_rows - max_rows / 10);
+
+			switch_sql_queue_manager_stop(qm);
+			switch_sql_queue_manager_destroy(&qm);
+		}
+		FST_TEST_END()
+
 
 	}
 	FST_SUITE_END()
@@ -223,6 +223,53 @@ FST_CORE_BEGIN("./conf")
 			unlink(filename);
 		}
 		FST_TEST_END()
+		FST_TEST_BEGIN(test_switch_core_file_write_behind)
+		{
+			switch_status_t status = SWITCH_STATUS_FALSE;
+			switch_file_handle_t fhw = { 0 };
+			switch_file_handle_t fhr = { 0 };
+			switch_file_write_behind_stats_t stats = { 0 };
+			static char filename[] = "/tmp/fs_write_behind_unit_test.wav";
+			int16_t buf[160];
+			int nr_frames = 500, i;
+			switch_size_t len, total = 0;
+
+			status = switch_core_file_open(&fhw, "{write_behind=true}/tmp/fs_write_behind_unit_test.wav", 1, 8000, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			fst_check(fhw.write_behind != NULL);
+
+			for (i = 0; i < nr_frames; i++) {
+				len = 160;
+				memset(buf, i, sizeof(buf));
+				status = switch_core_file_write(&fhw, buf, &len);
+				fst_requires(status == SWITCH_STATUS_SUCCESS);
+			}
+
+			status = switch_core_file_pre_close(&fhw);
+			fst_check(status == SWITCH_STATUS_SUCCESS);
+			status = switch_core_file_get_write_behind_stats(&fhw, &stats);
+			fst_check(status == SWITCH_STATUS_SUCCESS);
+			fst_check(stats.backlog_bytes == 0);
+			fst_check(stats.dropped_frames == 0);
+			fst_check(stats.bytes_written == nr_frames * sizeof(buf));
+			fst_check(fhw.samples_out == nr_frames * 160);
+			status = switch_core_file_close(&fhw);
+			fst_check(status == SWITCH_STATUS_SUCCESS);
+
+			status = switch_core_file_open(&fhr, filename, 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+
+			do {
+				len = 160;
+				status = switch_core_file_read(&fhr, buf, &len);
+				total += len;
+			} while (status == SWITCH_STATUS_SUCCESS && len);
+
+			fst_check(total == nr_frames * 160);
+			switch_core_file_close(&fhr);
+			unlink(filename);
+		}
+		FST_TEST_END()
 
 	}
 	FST_SUITE_END()
@@ -34,6 +34,32 @@
 
 #include <test/switch_test.h>
 
+static int img_planes_equal(switch_image_t *a, switch_image_t *b)
+{
+	int i;
+
+	for (i = 0; i < (int)a->d_h; i++) {
+		if (memcmp(a->planes[SWITCH_PLANE_Y] + i * a->stride[SWITCH_PLANE_Y], b->planes[SWITCH_PLANE_Y] + i * b->stride[SWITCH_PLANE_Y], a->d_w)) return 0;
+	}
+
+	for (i = 0; i < (int)(a->d_h + 1) / 2; i++) {
+		if (memcmp(a->planes[SWITCH_PLANE_U] + i * a->stride[SWITCH_PLANE_U], b->planes[SWITCH_PLANE_U] + i * b->stride[SWITCH_PLANE_U], (a->d_w + 1) / 2)) return 0;
+		if (memcmp(a->planes[SWITCH_PLANE_V] + i * a->stride[SWITCH_PLANE_V], b->planes[SWITCH_PLANE_V] + i * b->stride[SWITCH_PLANE_V], (a->d_w + 1) / 2)) return 0;
+	}
+
+	return 1;
+}
+
+static void img_fill_pattern(switch_image_t *img, int seed)
+{
+	int i, len = img->stride[SWITCH_PLANE_PACKED] * img->d_h;
+	uint8_t *p = img->planes[SWITCH_PLANE_PACKED];
+
+	for (i = 0; i < len; i++) {
+		p[i] = (uint8_t)(i * 7 + (i >> 5) + seed);
+	}
+}
+
 FST_CORE_BEGIN("./conf")
 {
 	FST_SUITE_BEGIN(switch_ivr_originate)
@@ -84,6 +110,100 @@ FST_CORE_BEGIN("./conf")
 			switch_img_free(&argb_img);
 		}
 		FST_TEST_END()
+
+		FST_TEST_BEGIN(patch_simd_test)
+		{
+			switch_image_t *canvas_c = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 320, 180, 1);
+			switch_image_t *canvas_simd = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 320, 180, 1);
+			switch_image_t *argb_img = switch_img_alloc(NULL, SWITCH_IMG_FMT_ARGB, 101, 67, 1);
+			switch_image_t *i420_img = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, 77, 45, 1);
+			switch_image_t *dot = switch_img_alloc(NULL, SWITCH_IMG_FMT_ARGB, 2, 1, 1);
+			switch_rgb_color_t bg = { 0 }, fg = { 0 };
+			const char *simd = switch_core_video_simd("auto");
+			uint8_t *px;
+
+			bg.r = 10; bg.g = 200; bg.b = 30; bg.a = 255;
+			fg.r = 255; fg.g = 128; fg.b = 0; fg.a = 255;
+
+			fst_check(simd != NULL);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "video kernels: %s\n", simd);
+
+			img_fill_pattern(argb_img, 0);
+			switch_img_fill(i420_img, 0, 0, i420_img->d_w, i420_img->d_h, &fg);
+
+			switch_img_fill(canvas_c, 0, 0, canvas_c->d_w, canvas_c->d_h, &bg);
+			switch_img_fill(canvas_simd, 0, 0, canvas_simd->d_w, canvas_simd->d_h, &bg);
+
+			fst_check_string_equals(switch_core_video_simd("scalar"), "scalar");
+			switch_img_patch(canvas_c, argb_img, 11, 7);
+			switch_img_patch(canvas_c, argb_img, -13, 150);
+			switch_img_patch(canvas_c, argb_img, 270, -20);
+			switch_img_overlay(canvas_c, i420_img, 30, 41, 60);
+
+			fst_check_string_equals(switch_core_video_simd(simd), simd);
+			switch_img_patch(canvas_simd, argb_img, 11, 7);
+			switch_img_patch(canvas_simd, argb_img, -13, 150);
+			switch_img_patch(canvas_simd, argb_img, 270, -20);
+			switch_img_overlay(canvas_simd, i420_img, 30, 41, 60);
+
+			fst_check(img_planes_equal(canvas_c, canvas_simd));
+
+			/* opaque pixels are a plain rgb to yuv conversion, transparent ones leave the canvas alone */
+			px = dot->planes[SWITCH_PLANE_PACKED];
+			*(switch_rgb_color_t *)px = fg;
+			*(switch_rgb_color_t *)(px + 4) = fg;
+			((switch_rgb_color_t *)(px + 4))->a = 0;
+			switch_img_patch(canvas_simd, dot, 0, 0);
+			fst_check_int_equals(canvas_simd->planes[SWITCH_PLANE_Y][0], ((66 * 255 + 129 * 128 + 25 * 0 + 128) >> 8) + 16);
+			fst_check_int_equals(canvas_simd->planes[SWITCH_PLANE_U][0], ((-38 * 255 - 74 * 128 + 112 * 0 + 128) >> 8) + 128);
+			fst_check_int_equals(canvas_simd->planes[SWITCH_PLANE_V][0], ((112 * 255 - 94 * 128 - 18 * 0 + 128) >> 8) + 128);
+			fst_check_int_equals(canvas_simd->planes[SWITCH_PLANE_Y][1], canvas_c->planes[SWITCH_PLANE_Y][1]);
+
+			switch_img_free(&canvas_c);
+			switch_img_free(&canvas_simd);
+			switch_img_free(&argb_img);
+			switch_img_free(&i420_img);
+			switch_img_free(&dot);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(patch_benchmark)
+		{
+			const char *levels[] = { "scalar", "sse2", "avx2" };
+			int sizes[][2] = { { 640, 360 }, { 1280, 720 }, { 1920, 1080 } };
+			int loops = 50;
+			int s, l, i;
+
+			for (s = 0; s < 3; s++) {
+				switch_image_t *canvas = switch_img_alloc(NULL, SWITCH_IMG_FMT_I420, sizes[s][0], sizes[s][1], 1);
+				switch_image_t *argb_img = switch_img_alloc(NULL, SWITCH_IMG_FMT_ARGB, sizes[s][0], sizes[s][1], 1);
+
+				img_fill_pattern(argb_img, s);
+
+				for (l = 0; l < 3; l++) {
+					switch_time_t start, elapsed;
+
+					if (strcmp(switch_core_video_simd(levels[l]), levels[l])) continue;
+
+					start = switch_time_now();
+
+					for (i = 0; i < loops; i++) {
+						switch_img_patch(canvas, argb_img, 0, 0);
+					}
+
+					elapsed = switch_time_now() - start;
+
+					printf("patch %dx%d %-6s %8.2f frames/sec\n", sizes[s][0], sizes[s][1], levels[l],
+						   elapsed ? (double)loops * 1000000 / elapsed : 0);
+				}
+
+				switch_img_free(&canvas);
+				switch_img_free(&argb_img);
+			}
+
+			switch_core_video_simd("auto");
+		}
+		FST_TEST_END()
 	}
 	FST_SUITE_END()
 }
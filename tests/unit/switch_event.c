@@ -107,6 +107,56 @@ FST_TEST_BEGIN(benchmark)
 }
 FST_TEST_END()
 
+FST_TEST_BEGIN(variable_snapshot)
+{
+  switch_event_t *vars = NULL, *scope = NULL, *event = NULL, *dup = NULL;
+  switch_event_snapshot_t *snapshot = NULL;
+  char *str = NULL;
+
+  switch_event_create_plain(&vars, SWITCH_EVENT_CHANNEL_DATA);
+  switch_event_add_header_string(vars, SWITCH_STACK_BOTTOM, "foo", "bar");
+  switch_event_add_header_string(vars, SWITCH_STACK_BOTTOM, "baz", "qux");
+  switch_event_create_plain(&scope, SWITCH_EVENT_CHANNEL_DATA);
+  switch_event_add_header_string(scope, SWITCH_STACK_BOTTOM, "foo", "scoped");
+
+  snapshot = switch_event_snapshot_create(vars, scope);
+  switch_event_destroy(&vars);
+  switch_event_destroy(&scope);
+
+  switch_event_create(&event, SWITCH_EVENT_CHANNEL_ANSWER);
+  switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Unique-ID", "1234");
+  switch_event_set_snapshot(event, snapshot);
+
+  /* other headers do not pull the variables in */
+  fst_check_string_equals(switch_event_get_header(event, "Unique-ID"), "1234");
+  fst_check(event->snapshot == snapshot);
+
+  fst_requires(switch_event_dup(&dup, event) == SWITCH_STATUS_SUCCESS);
+  fst_check(dup->snapshot == snapshot);
+
+  /* lookups are answered from the snapshot, adding a variable copies it in */
+  fst_check_string_equals(switch_event_get_header(event, "variable_foo"), "bar");
+  fst_check_string_equals(switch_event_get_header(event, "scope_variable_foo"), "scoped");
+  fst_check(event->snapshot == snapshot);
+  switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "variable_new", "1");
+  fst_check(event->snapshot == NULL);
+  fst_check_string_equals(switch_event_get_header(event, "variable_baz"), "qux");
+
+  /* the snapshot outlives the creator's reference and is still shared with the copy */
+  switch_event_snapshot_release(&snapshot);
+  fst_check(snapshot == NULL);
+
+  switch_event_serialize(dup, &str, SWITCH_FALSE);
+  fst_requires(str);
+  fst_check(strstr(str, "variable_baz: qux") != NULL);
+  fst_check(dup->snapshot == NULL);
+
+  switch_safe_free(str);
+  switch_event_destroy(&dup);
+  switch_event_destroy(&event);
+}
+FST_TEST_END()
+
 FST_SUITE_END()
 
 FST_MINCORE_END()
@@ -96,6 +96,91 @@ FST_TEARDOWN_END()
 		switch_core_destroy_memory_pool(&pool);
 	}
 	FST_TEST_END()
+
+	FST_TEST_BEGIN(test_rtp_relay)
+	{
+		switch_rtp_t *rtp_a = NULL, *rtp_b = NULL;
+		switch_socket_t *peer_a = NULL, *peer_b = NULL;
+		switch_sockaddr_t *addr_a = NULL, *addr_b = NULL, *addr_to = NULL, *from = NULL;
+		unsigned char pkt[12 + 160] = { 0 }, in[sizeof(pkt)] = { 0 };
+		uint16_t seq = 0;
+		int i, got = 0;
+
+		switch_core_new_memory_pool(&pool);
+
+		rtp_a = switch_rtp_new(rx_host, 12360, tx_host, 12370, TEST_PT, 8000, 20 * 1000, flags, NULL, &err, pool, 0, 0);
+		rtp_b = switch_rtp_new(rx_host, 12362, tx_host, 12372, 0, 8000, 20 * 1000, flags, NULL, &err, pool, 0, 0);
+		fst_requires(switch_rtp_ready(rtp_a));
+		fst_requires(switch_rtp_ready(rtp_b));
+		switch_rtp_set_ssrc(rtp_b, 0x1234);
+
+		fst_requires(switch_sockaddr_info_get(&addr_a, tx_host, SWITCH_UNSPEC, 12370, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_sockaddr_info_get(&addr_b, tx_host, SWITCH_UNSPEC, 12372, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_sockaddr_info_get(&addr_to, rx_host, SWITCH_UNSPEC, 12360, 0, pool) == SWITCH_STATUS_SUCCESS);
+		switch_sockaddr_create(&from, pool);
+		fst_requires(switch_socket_create(&peer_a, AF_INET, SOCK_DGRAM, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_socket_create(&peer_b, AF_INET, SOCK_DGRAM, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_socket_bind(peer_a, addr_a) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_socket_bind(peer_b, addr_b) == SWITCH_STATUS_SUCCESS);
+		switch_socket_timeout_set(peer_b, 500000);
+
+		fst_check(switch_rtp_relay_start(rtp_a, rtp_b) == SWITCH_STATUS_SUCCESS);
+		fst_check(switch_rtp_relay_active(rtp_a));
+		fst_check(!switch_rtp_relay_active(rtp_b));
+		fst_check(switch_rtp_relay_start(rtp_a, rtp_b) != SWITCH_STATUS_SUCCESS);
+
+		pkt[0] = 0x80;
+		pkt[1] = TEST_PT;
+		pkt[8] = 0xca;
+		pkt[9] = 0xfe;
+
+		for (i = 0; i < 5; i++) {
+			switch_size_t len = sizeof(pkt);
+
+			pkt[2] = 0;
+			pkt[3] = (unsigned char) (100 + i);
+			pkt[7] = (unsigned char) (i * 160 % 256);
+			pkt[6] = (unsigned char) (i * 160 / 256);
+			switch_socket_sendto(peer_a, addr_to, 0, (void *) pkt, &len);
+
+			len = sizeof(in);
+			if (switch_socket_recvfrom(from, peer_b, 0, (void *) in, &len) == SWITCH_STATUS_SUCCESS && len == sizeof(pkt)) {
+				uint16_t rseq = (in[2] << 8) | in[3];
+
+				fst_check((in[1] & 0x7f) == 0);
+				fst_check(in[8] == 0 && in[9] == 0 && in[10] == 0x12 && in[11] == 0x34);
+				fst_check((in[1] & 0x80) == (got ? 0 : 0x80));
+				if (got) {
+					fst_check(rseq == (uint16_t) (seq + 1));
+				}
+				seq = rseq;
+				got++;
+			}
+		}
+
+		fst_check(got == 5);
+		fst_check(switch_rtp_relay_wait(rtp_a, 20) == SWITCH_STATUS_SUCCESS);
+
+		/* a telephone-event packet hands the socket back to the session */
+		pkt[1] = 101;
+		{
+			switch_size_t len = sizeof(pkt);
+			switch_socket_sendto(peer_a, addr_to, 0, (void *) pkt, &len);
+		}
+
+		fst_check(switch_rtp_relay_wait(rtp_a, 1000) == SWITCH_STATUS_FALSE);
+		fst_check(!switch_rtp_relay_active(rtp_a));
+
+		switch_rtp_relay_start(rtp_a, rtp_b);
+		switch_rtp_destroy(&rtp_b);
+		fst_check(!switch_rtp_relay_active(rtp_a));
+
+		switch_rtp_destroy(&rtp_a);
+		switch_socket_close(peer_a);
+		switch_socket_close(peer_b);
+		switch_core_destroy_memory_pool(&pool);
+	}
+	FST_TEST_END()
 }
 FST_SUITE_END()
 }
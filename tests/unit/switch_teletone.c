@@ -0,0 +1,190 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_teletone.c -- tests libteletone tone detection
+ *
+ */
+#include <switch.h>
+#include <stdlib.h>
+
+#include <test/switch_test.h>
+
+static const char *dtmf_digits = "123A456B789C*0#D";
+static const float dtmf_rows[4] = { 697.0f, 770.0f, 852.0f, 941.0f };
+static const float dtmf_cols[4] = { 1209.0f, 1336.0f, 1477.0f, 1633.0f };
+
+static void feed_dtmf(teletone_dtmf_detect_state_t *dt, int16_t *buf, int samples, char *out, int *n)
+{
+	int i;
+	char digit;
+	unsigned int dur;
+
+	/* 20ms frames, the way the core feeds the detector */
+	for (i = 0; i < samples; i += 160) {
+		teletone_dtmf_detect(dt, buf + i, samples - i < 160 ? samples - i : 160);
+		if (teletone_dtmf_get(dt, &digit, &dur) && !dt->zc && *n < 63) {
+			out[(*n)++] = digit;
+		}
+	}
+}
+
+/* Play every digit for 100ms with 100ms of silence after it at the given level and return what was detected */
+static void detect_dtmf(float level, char *out)
+{
+	teletone_generation_session_t ts;
+	teletone_tone_map_t map;
+	teletone_dtmf_detect_state_t dt;
+	int16_t silence[800] = { 0 };
+	int i, n = 0;
+
+	teletone_init_session(&ts, 0, NULL, NULL);
+	ts.volume = level;
+	ts.duration = 800;
+	ts.wait = 0;
+	teletone_dtmf_detect_init(&dt, 8000);
+
+	for (i = 0; i < 16; i++) {
+		memset(&map, 0, sizeof(map));
+		map.freqs[0] = dtmf_rows[i / 4];
+		map.freqs[1] = dtmf_cols[i % 4];
+		teletone_mux_tones(&ts, &map);
+		feed_dtmf(&dt, ts.buffer, ts.samples, out, &n);
+		feed_dtmf(&dt, silence, 800, out, &n);
+	}
+
+	out[n] = '\0';
+	teletone_destroy_session(&ts);
+}
+
+/* Play f1+f2 for one second at the given level into a 350+440Hz detector and return the number of hits */
+static int detect_multi_tone(float level, float f1, float f2)
+{
+	teletone_generation_session_t ts;
+	teletone_tone_map_t map;
+	teletone_multi_tone_t mt;
+	int i, hits = 0;
+
+	memset(&mt, 0, sizeof(mt));
+	memset(&map, 0, sizeof(map));
+	map.freqs[0] = 350.0f;
+	map.freqs[1] = 440.0f;
+	teletone_multi_tone_init(&mt, &map);
+
+	teletone_init_session(&ts, 0, NULL, NULL);
+	ts.volume = level;
+	ts.duration = 8000;
+	ts.wait = 0;
+	memset(&map, 0, sizeof(map));
+	map.freqs[0] = f1;
+	map.freqs[1] = f2;
+	teletone_mux_tones(&ts, &map);
+
+	for (i = 0; i + 160 <= ts.samples; i += 160) {
+		hits += teletone_multi_tone_detect(&mt, ts.buffer + i, 160);
+	}
+
+	teletone_destroy_session(&ts);
+
+	return hits;
+}
+
+FST_MINCORE_BEGIN("./conf")
+{
+	FST_SUITE_BEGIN(switch_teletone)
+	{
+		FST_SETUP_BEGIN()
+		{
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(dtmf_detect_levels)
+		{
+			char out[64];
+
+			/* every digit exactly once from a loud signal down to a few dB above the detection threshold */
+			detect_dtmf(-10, out);
+			fst_check_string_equals(out, dtmf_digits);
+			detect_dtmf(-20, out);
+			fst_check_string_equals(out, dtmf_digits);
+			detect_dtmf(-30, out);
+			fst_check_string_equals(out, dtmf_digits);
+			detect_dtmf(-50, out);
+			fst_check_string_equals(out, dtmf_digits);
+
+			/* and nothing once the signal is well under it */
+			detect_dtmf(-60, out);
+			fst_check_string_equals(out, "");
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(multi_tone_detect_levels)
+		{
+			int level, hits = 0, false_hits = 0;
+
+			for (level = -5; level >= -30; level--) {
+				hits += detect_multi_tone((float) level, 350.0f, 440.0f);
+				false_hits += detect_multi_tone((float) level, 480.0f, 620.0f);
+			}
+
+			fst_check(hits > 0);
+			fst_check_int_equals(false_hits, 0);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(multi_tone_init_reuse)
+		{
+			teletone_multi_tone_t mt;
+			teletone_tone_map_t map;
+			int i;
+
+			/* a detector reused for a shorter map must not keep the lanes of the longer one */
+			memset(&mt, 0, sizeof(mt));
+			for (i = 0; i < TELETONE_BANK_LANES; i++) {
+				mt.bank.fac[i] = 1.5f;
+			}
+			mt.bank.lanes = TELETONE_BANK_LANES;
+
+			memset(&map, 0, sizeof(map));
+			map.freqs[0] = 350.0f;
+			map.freqs[1] = 440.0f;
+			teletone_multi_tone_init(&mt, &map);
+
+			fst_check_int_equals(mt.tone_count, 2);
+			fst_check_int_equals(mt.bank.lanes, 4);
+			for (i = 2; i < TELETONE_BANK_LANES; i++) {
+				fst_check(mt.bank.fac[i] == 0.0f);
+			}
+		}
+		FST_TEST_END()
+	}
+	FST_SUITE_END()
+}
+FST_MINCORE_END()
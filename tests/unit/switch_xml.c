@@ -34,6 +34,27 @@
 
 #include <test/switch_test.h>
 
+static int directory_lookups = 0;
+
+static switch_xml_t directory_lookup(const char *section, const char *tag_name, const char *key_name, const char *key_value,
+									 switch_event_t *params, void *user_data)
+{
+	directory_lookups++;
+
+	return switch_xml_parse_str_dup("<document type=\"freeswitch/xml\"><section name=\"directory\">"
+									"<domain name=\"cache.test\"><users><user id=\"1000\" cacheable=\"60000\">"
+									"<params><param name=\"password\" value=\"1234\"/></params></user></users></domain>"
+									"</section></document>");
+}
+
+static switch_xml_t directory_outage(const char *section, const char *tag_name, const char *key_name, const char *key_value,
+									 switch_event_t *params, void *user_data)
+{
+	directory_lookups++;
+
+	return NULL;
+}
+
 FST_MINCORE_BEGIN("./conf")
 {
 	FST_SUITE_BEGIN(switch_xml)
@@ -117,6 +138,106 @@ FST_MINCORE_BEGIN("./conf")
 			free(xml_string);
 		}
 		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_stream_parse)
+		{
+			const char *text = "<?xml version=\"1.0\"?>\n<document type=\"freeswitch/xml\">\n"
+				"  <!-- a comment -->\n"
+				"  <section name=\"directory\">\n"
+				"    <user id=\"1000\"><param name=\"a\" value=\"x &amp; y&#33;\"/>text<![CDATA[<raw>]]></user>\n"
+				"    <group name=\"g\"/>\n"
+				"    <user id=\"1001\"/>\n"
+				"  </section>\n"
+				"</document>\n";
+			const char *path = "test_stream_parse.xml";
+			switch_xml_t classic, stream, user;
+			char *a, *b;
+			FILE *f;
+			int fd;
+
+			fst_requires((f = fopen(path, "w")));
+			fputs(text, f);
+			fclose(f);
+
+			fst_requires((fd = open(path, O_RDONLY)) > -1);
+			classic = switch_xml_parse_fd(fd);
+			lseek(fd, 0, SEEK_SET);
+			stream = switch_xml_parse_fd_stream(fd);
+			close(fd);
+			unlink(path);
+
+			fst_requires(classic);
+			fst_requires(stream);
+			fst_check(switch_xml_arena_size(stream) > 0);
+
+			a = switch_xml_toxml(classic, SWITCH_FALSE);
+			b = switch_xml_toxml(stream, SWITCH_FALSE);
+			fst_check_string_equals(a, b);
+
+			user = switch_xml_find_child(switch_xml_child(stream, "section"), "user", "id", "1001");
+			fst_requires(user);
+			fst_check_string_equals(switch_xml_attr(switch_xml_child(switch_xml_child(switch_xml_child(stream, "section"), "user"), "param"), "value"), "x & y!");
+
+			/* arena tags can still be modified */
+			switch_xml_set_attr_d(user, "cacheable", "true");
+			switch_xml_add_child_d(user, "params", 0);
+			fst_check_string_equals(switch_xml_attr(user, "cacheable"), "true");
+
+			switch_safe_free(a);
+			switch_safe_free(b);
+			switch_xml_free(classic);
+			switch_xml_free(stream);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_user_cache)
+		{
+			switch_xml_t user = NULL, again = NULL;
+			switch_xml_user_cache_stats_t stats;
+
+			switch_xml_clear_user_cache(NULL, NULL, NULL);
+			switch_xml_set_user_cache_negative_ms(60000);
+			switch_xml_bind_search_function(directory_lookup, switch_xml_parse_section_string("directory"), NULL);
+
+			fst_requires(switch_xml_locate_user_merged("id", "1000", "cache.test", NULL, &user, NULL) == SWITCH_STATUS_SUCCESS);
+			fst_requires(switch_xml_locate_user_merged("id", "1000", "cache.test", NULL, &again, NULL) == SWITCH_STATUS_SUCCESS);
+			fst_check(user == again);
+			fst_check_string_equals(switch_xml_attr(user, "domain-name"), "cache.test");
+			fst_check_int_equals(directory_lookups, 1);
+			switch_xml_free(user);
+			switch_xml_free(again);
+
+			/* unknown users are remembered too */
+			fst_check(switch_xml_locate_user_merged("id", "9999", "cache.test", NULL, &user, NULL) != SWITCH_STATUS_SUCCESS);
+			fst_check(switch_xml_locate_user_merged("id", "9999", "cache.test", NULL, &user, NULL) != SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(directory_lookups, 2);
+
+			switch_xml_user_cache_stats(&stats);
+			fst_check_int_equals(stats.entries, 1);
+			fst_check_int_equals(stats.negative_entries, 1);
+			fst_check(stats.hits >= 1);
+			fst_check(stats.negative_hits >= 1);
+
+			fst_check_int_equals(switch_xml_clear_user_cache(NULL, NULL, "cache.test"), 1);
+			fst_requires(switch_xml_locate_user_merged("id", "1000", "cache.test", NULL, &user, NULL) == SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(directory_lookups, 3);
+			switch_xml_free(user);
+
+			switch_xml_unbind_search_function_ptr(directory_lookup);
+
+			/* a binding that fails is not an answer, the miss must not be remembered */
+			switch_xml_bind_search_function(directory_outage, switch_xml_parse_section_string("directory"), NULL);
+			fst_check(switch_xml_locate_user_merged("id", "9999", "cache.test", NULL, &user, NULL) != SWITCH_STATUS_SUCCESS);
+			fst_check(switch_xml_locate_user_merged("id", "9999", "cache.test", NULL, &user, NULL) != SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(directory_lookups, 5);
+			switch_xml_user_cache_stats(&stats);
+			fst_check_int_equals(stats.negative_entries, 0);
+			switch_xml_unbind_search_function_ptr(directory_outage);
+
+			switch_xml_set_user_cache_negative_ms(0);
+			switch_xml_clear_user_cache(NULL, NULL, NULL);
+		}
+		FST_TEST_END()
 	}
 	FST_SUITE_END()
 }